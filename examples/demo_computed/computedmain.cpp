@@ -32,6 +32,10 @@
 #include "osgHimmel/himmel.h"
 #include "osgHimmel/timef.h"
 #include "osgHimmel/himmelenvmap.h"
+#include "osgHimmel/skyharmonics.h"
+#include "osgHimmel/noise.h"
+#include "osgHimmel/starsgeode.h"
+#include "osgHimmel/starquery.h"
 
 #include <osgDB/ReadFile>
 
@@ -46,12 +50,16 @@
 #include <osgGA/TerrainManipulator>
 
 #include <iostream>
+#include <algorithm>
 #include <assert.h>
 
 #include <osg/Matrix>
 #include <osg/MatrixTransform>
 #include <osg/TextureCubeMap>
 #include <osg/Texture2D>
+#include <osg/Timer>
+
+#include <vector>
 
 
 using namespace osgHimmel;
@@ -121,6 +129,12 @@ public:
                     else
                         g_timef->start();
                 }
+                else if(ea.getKey() == 's' || ea.getKey() == 'S')
+                {
+                    StarsGeode *stars = g_himmel->stars();
+                    stars->setExpansionMode(stars->getExpansionMode() == StarsGeode::EM_PointSprites
+                        ? StarsGeode::EM_GeometryShader : StarsGeode::EM_PointSprites);
+                }
                 else if(ea.getKey() == '-')
                 {
                     g_timef->setSecondsPerCycle(g_timef->getSecondsPerCycle() * 1.08f);
@@ -191,6 +205,190 @@ osg::Group *createScene(
 
 
 
+void benchmarkHarmonics(
+    osgViewer::Viewer &viewer
+,   const unsigned int updates)
+{
+    // the first frame precomputes the atmosphere tables
+    viewer.frame();
+
+    osg::ref_ptr<SkyHarmonics> harmonics = new SkyHarmonics();
+    g_himmel->setHarmonics(harmonics);
+
+    g_timef->pause();
+
+    double sum = 0.0;
+    double min = 1e+9;
+    double max = 0.0;
+
+    for(unsigned int i = 0; i < updates; ++i)
+    {
+        // sweeps the sun over a day
+        g_timef->setf(static_cast<t_longf>(i) / updates, true);
+        harmonics->dirty();
+
+        g_himmel->update();
+
+        const double t = harmonics->getLastUpdateTime();
+
+        sum += t;
+        min = std::min(min, t);
+        max = std::max(max, t);
+    }
+
+    osg::notify(osg::NOTICE) << "Sky harmonics: " << harmonics->numSamples() << " samples, " 
+        << updates << " updates, " << sum / updates << " ms avg (" << min << " ms min, " << max << " ms max)" << std::endl;
+}
+
+
+void benchmarkNoise(const unsigned int size)
+{
+    // single threaded throughput of a cloud noise volume of size^2 x 4 texels
+    const unsigned int slices = 4;
+    const unsigned int count = size * size * slices;
+
+    std::vector<float> x(size);
+    std::vector<float> y(size);
+    std::vector<float> z(size);
+    std::vector<float> w(size);
+    std::vector<float> volume(count);
+
+    const Noise noise(8, 0.31f, 0.67f);
+    const osg::Timer *timer = osg::Timer::instance();
+
+    // current path: independent 2D slices (as HighCloudLayerGeode::createNoiseArray)
+
+    osg::Timer_t t = timer->tick();
+    for(unsigned int i = 0; i < size * slices; ++i)
+        noise.noise2Row(size, i % size, 6, &volume[i * size], 0.5f, 0.5f);
+    const double t2 = timer->delta_s(t, timer->tick());
+
+    // true 3D and sliced 4D simplex noise, 64 cells along s and t
+
+    const float cells = 64.f / static_cast<float>(size);
+
+    t = timer->tick();
+    for(unsigned int i = 0; i < size * slices; ++i)
+    {
+        for(unsigned int s = 0; s < size; ++s)
+        {
+            x[s] = s * cells;
+            y[s] = (i % size) * cells;
+            z[s] = (i / size) * 0.5f;
+        }
+        noise.simplex3(size, &x[0], &y[0], &z[0], &volume[i * size], 0.5f, 0.5f);
+    }
+    const double t3 = timer->delta_s(t, timer->tick());
+
+    t = timer->tick();
+    for(unsigned int i = 0; i < size * slices; ++i)
+    {
+        for(unsigned int s = 0; s < size; ++s)
+        {
+            x[s] = s * cells;
+            y[s] = (i % size) * cells;
+            z[s] = (i / size) * 0.5f;
+            w[s] = 0.f;
+        }
+        noise.simplex4(size, &x[0], &y[0], &z[0], &w[0], &volume[i * size], 0.5f, 0.5f);
+    }
+    const double t4 = timer->delta_s(t, timer->tick());
+
+    t = timer->tick();
+    for(unsigned int i = 0; i < size * slices; ++i)
+    for(unsigned int s = 0; s < size; ++s)
+        volume[i * size + s] = noise.simplex3(s * cells, (i % size) * cells, (i / size) * 0.5f) * 0.5f + 0.5f;
+    const double t3s = timer->delta_s(t, timer->tick());
+
+    osg::notify(osg::NOTICE) << "Noise volume " << size << "^2 x " << slices << " (Mtexels/s): "
+        << "2D slices " << count / t2 * 1e-6 << ", simplex3 " << count / t3 * 1e-6 
+        << " (scalar " << count / t3s * 1e-6 << "), simplex4 " << count / t4 * 1e-6 << std::endl;
+}
+
+
+void benchmarkStars(osgViewer::Viewer &viewer)
+{
+    // stars processed (submitted to the vertex shader) versus field of view
+
+    viewer.frame();
+
+    StarsGeode *stars = g_himmel->stars();
+    const osg::Timer *timer = osg::Timer::instance();
+
+    const float fovs[] = { 120.f, 90.f, 60.f, 30.f, 10.f, 5.f, 2.f, 1.f };
+    const unsigned int updates = 1000;
+
+    for(unsigned int i = 0; i < sizeof(fovs) / sizeof(float); ++i)
+    {
+        g_fov = fovs[i];
+        fovChanged();
+
+        // q is shared by the himmel and only updated on changes of the view
+        g_himmel->update();
+        const unsigned int changedUpdates = g_himmel->getUniformUpdateCount();
+        g_himmel->update();
+        const unsigned int unchangedUpdates = g_himmel->getUniformUpdateCount();
+
+        osg::Timer_t t = timer->tick();
+        for(unsigned int j = 0; j < updates; ++j)
+            stars->updateView(*g_himmel);
+        const double dt = timer->delta_m(t, timer->tick()) / updates;
+
+        osg::notify(osg::NOTICE) << "Stars at " << g_fov << " deg fov: " << stars->getDrawnStarCount() 
+            << " drawn, " << stars->index()->getVisibleStarCount() << " in visible cells of " 
+            << stars->catalogue()->numStars() << ", " << stars->index()->getTestedNodeCount() 
+            << " nodes tested, " << dt << " ms per view update, " << changedUpdates 
+            << " himmel uniform updates on fov change (" << unchangedUpdates << " otherwise)" << std::endl;
+    }
+}
+
+
+void benchmarkStarQuery(const unsigned int queries)
+{
+    // latency of typical navigation queries, for an observer moving in time
+
+    osg::ref_ptr<StarQuery> query = new StarQuery;
+    if(!query->open("resources/brightstars"))
+        return;
+
+    const AbstractAstronomy &astronomy(*g_himmel->astro());
+    const osg::Timer *timer = osg::Timer::instance();
+
+    t_aTime aTime(t_aTime::fromTimeF(*g_timef));
+
+    StarQuery::t_stars stars;
+    unsigned int found[2] = { 0, 0 };
+
+    double dt[3] = { 0.0, 0.0, 0.0 };
+
+    for(unsigned int i = 0; i < queries; ++i)
+    {
+        aTime.minute = static_cast<short>((aTime.minute + 7) % 60);
+
+        osg::Timer_t t = timer->tick();
+        query->setObserver(astronomy, aTime, g_himmel->getLatitude(), g_himmel->getLongitude());
+        dt[0] += timer->delta_m(t, timer->tick());
+
+        stars.clear();
+
+        t = timer->tick();
+        found[0] += query->band(10.f, 90.f, 3.f, stars);
+        dt[1] += timer->delta_m(t, timer->tick());
+
+        stars.clear();
+
+        t = timer->tick();
+        found[1] += query->cone(osg::Vec3f(0.f, 1.f, 1.f), 15.f, 6.f, stars);
+        dt[2] += timer->delta_m(t, timer->tick());
+    }
+
+    osg::notify(osg::NOTICE) << "Star queries over " << query->numStars() << " stars, " 
+        << dt[0] / queries << " ms per observer update, "
+        << dt[1] / queries << " ms per band (above 10 deg up to mag 3, " << found[0] / queries << " stars), "
+        << dt[2] / queries << " ms per cone (15 deg up to mag 6, " << found[1] / queries << " stars)" << std::endl;
+}
+
+
 int main(int argc, char* argv[])
 {
     osg::ArgumentParser arguments(&argc, argv);
@@ -200,6 +398,10 @@ int main(int argc, char* argv[])
 
     arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName());
     arguments.getApplicationUsage()->addCommandLineOption("-h or --help", "Display this information.");
+    arguments.getApplicationUsage()->addCommandLineOption("--benchmark-harmonics <n>", "Measures n sky harmonics updates and exits.");
+    arguments.getApplicationUsage()->addCommandLineOption("--benchmark-noise <size>", "Measures cloud noise generation for size^2 x 4 texels and exits.");
+    arguments.getApplicationUsage()->addCommandLineOption("--benchmark-stars", "Reports the stars processed for several fields of view and exits.");
+    arguments.getApplicationUsage()->addCommandLineOption("--benchmark-star-query <n>", "Measures n star visibility queries and exits.");
 
     osgViewer::Viewer viewer(arguments);
 
@@ -209,9 +411,17 @@ int main(int argc, char* argv[])
         return 1;
     }
 
+    unsigned int noiseSize = 0;
+    if(arguments.read("--benchmark-noise", noiseSize) && noiseSize > 0)
+    {
+        benchmarkNoise(noiseSize);
+        return 0;
+    }
+
     osg::notify(osg::NOTICE) << "Use [1] to [4] to select camera manipulator." << std::endl;
     osg::notify(osg::NOTICE) << "Use [p] to pause/unpause time." << std::endl;
     osg::notify(osg::NOTICE) << "Use [r] to reset the time." << std::endl;
+    osg::notify(osg::NOTICE) << "Use [s] to toggle point sprites/geometry shader for stars." << std::endl;
     osg::notify(osg::NOTICE) << "Use [+] and [-] to increase/decrease seconds per cycle." << std::endl;
     osg::notify(osg::NOTICE) << "Use [mouse wheel] to change field of view." << std::endl;
 
@@ -247,5 +457,25 @@ int main(int argc, char* argv[])
 
     root->addChild(g_himmel);
 
+    unsigned int updates = 0;
+    if(arguments.read("--benchmark-harmonics", updates) && updates > 0)
+    {
+        benchmarkHarmonics(viewer, updates);
+        return 0;
+    }
+
+    if(arguments.read("--benchmark-stars"))
+    {
+        benchmarkStars(viewer);
+        return 0;
+    }
+
+    unsigned int queries = 0;
+    if(arguments.read("--benchmark-star-query", queries) && queries > 0)
+    {
+        benchmarkStarQuery(queries);
+        return 0;
+    }
+
     return viewer.run();
 }
\ No newline at end of file
@@ -0,0 +1,139 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "osgHimmel/mathmacros.h"
+#include "osgHimmel/starcatalogue.h"
+#include "osgHimmel/starmapbaker.h"
+
+#include <osg/ArgumentParser>
+#include <osg/Notify>
+#include <osg/Timer>
+
+#include <iostream>
+#include <limits>
+
+using namespace osgHimmel;
+
+
+int main(int argc, char* argv[])
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    arguments.getApplicationUsage()->setDescription(
+        arguments.getApplicationName() + " bakes the faint stars of a catalogue into a star map cube for the StarMapGeode");
+
+    arguments.getApplicationUsage()->setCommandLineUsage(arguments.getApplicationName() + " [options] <catalogue> <cube map path with '?'>");
+    arguments.getApplicationUsage()->addCommandLineOption("-h or --help", "Display this information.");
+    arguments.getApplicationUsage()->addCommandLineOption("--size <texels>", "Edge length of the faces (default 1024).");
+    arguments.getApplicationUsage()->addCommandLineOption("--sigma <texels>", "Standard deviation of the point spread function.");
+    arguments.getApplicationUsage()->addCommandLineOption("--reference <magnitude>", "Magnitude of a star with a flux of one.");
+    arguments.getApplicationUsage()->addCommandLineOption("--brightest <magnitude>", "Only stars fainter than this are baked.");
+    arguments.getApplicationUsage()->addCommandLineOption("--faintest <magnitude>", "Only stars up to this magnitude are baked.");
+    arguments.getApplicationUsage()->addCommandLineOption("--points <catalogue>", "Bakes only stars fainter than the ones of the catalogue drawn as points.");
+    arguments.getApplicationUsage()->addCommandLineOption("--threads <n>", "Number of threads (default all processors).");
+
+    if(arguments.read("-h") || arguments.read("--help"))
+    {
+        arguments.getApplicationUsage()->write(std::cout);
+        return 1;
+    }
+
+    unsigned int size = 1024;
+    arguments.read("--size", size);
+
+    StarMapBaker baker(size);
+
+    float sigma = StarMapBaker::defaultSigma();
+    if(arguments.read("--sigma", sigma))
+        baker.setSigma(sigma);
+
+    float reference = StarMapBaker::defaultReferenceMagnitude();
+    if(arguments.read("--reference", reference))
+        baker.setReferenceMagnitude(reference);
+
+    float brightest = -std::numeric_limits<float>::max();
+    float faintest = std::numeric_limits<float>::max();
+
+    arguments.read("--brightest", brightest);
+    arguments.read("--faintest", faintest);
+
+    // The stars drawn as points by the StarsGeode should not be baked twice.
+
+    std::string pointsFilePath;
+    if(arguments.read("--points", pointsFilePath))
+    {
+        osg::ref_ptr<StarCatalogue> points = new StarCatalogue;
+        if(!points->open(pointsFilePath.c_str()))
+        {
+            OSG_WARN << "Catalogue could not be opened: " << pointsFilePath << std::endl;
+            return 1;
+        }
+
+        for(unsigned int i = 0; i < points->numStars(); ++i)
+            brightest = _ma(brightest, points->colors()[i][3]);
+    }
+    baker.setMagnitudeRange(brightest, faintest);
+
+    unsigned int threads = 0;
+    if(arguments.read("--threads", threads))
+        baker.setNumThreads(threads);
+
+    arguments.reportRemainingOptionsAsUnrecognized();
+    if(arguments.errors())
+    {
+        arguments.writeErrorMessages(std::cout);
+        return 1;
+    }
+
+    // the catalogue and the cube map path remain after the options
+    if(arguments.argc() != 3)
+    {
+        arguments.getApplicationUsage()->write(std::cout);
+        return 1;
+    }
+
+    const std::string catalogueFilePath(arguments[1]);
+    const std::string cubeMapFilePath(arguments[2]);
+
+    osg::ref_ptr<StarCatalogue> catalogue = new StarCatalogue;
+    if(!catalogue->open(catalogueFilePath.c_str()))
+    {
+        OSG_WARN << "Catalogue could not be opened: " << catalogueFilePath << std::endl;
+        return 1;
+    }
+
+    const osg::Timer_t t0 = osg::Timer::instance()->tick();
+    const unsigned int baked = baker.bake(*catalogue);
+    const osg::Timer_t t1 = osg::Timer::instance()->tick();
+
+    OSG_NOTICE << "Baked " << baked << " of " << catalogue->numStars() << " stars in " 
+        << osg::Timer::instance()->delta_m(t0, t1) << " ms." << std::endl;
+
+    return baker.write(cubeMapFilePath) ? 0 : 1;
+}
@@ -107,7 +107,12 @@ public:
     // TODO: seems ugly - optimize this!
 
     void setCameraHint(osg::Camera *camera);
+    const bool hasCameraHint() const;
     const float getCameraFovHint() const;
+    const float getCameraAspectRatioHint() const;
+
+    // View direction in world coordinates (the horizontal system).
+    const osg::Vec3f getCameraDirectionHint() const;
 
     void setViewSizeHint(unsigned int width, unsigned int height);
     const unsigned int getViewSizeWidthHint() const;
@@ -0,0 +1,168 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __ANALYTICSKY_H__
+#define __ANALYTICSKY_H__
+
+#include "declspec.h"
+
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/Vec3f>
+
+#include <vector>
+
+
+namespace osg
+{
+    class Image;
+    class Texture2D;
+    class Uniform;
+}
+
+
+namespace osgHimmel
+{
+
+class AtmosphereQuery;
+
+// Analytic sky model after Preetham et al. 1999, "A Practical Analytic 
+// Model for Daylight", used as precompute free alternative to the Bruneton
+// tables. The Perez coefficients depend on the turbidity only and are 
+// provided as uniform. Everything depending on the sun elevation (zenith 
+// values normalized by the Perez function and an rgb gain) is cached in a 
+// small table of two rows, that is sampled linearly by elevation:
+//   row 0: (Yz / F_Y(0, thetaS), xz / F_x(0, thetaS), yz / F_y(0, thetaS))
+//   row 1: rgb gain (scale to the shaders' radiance, twilight falloff)
+// The gains can be fitted to Bruneton tables (e.g., computed once offline)
+// for a matching look, and errorReport compares both models.
+
+class OSGH_API AnalyticSky : public osg::Referenced
+{
+public:
+
+    typedef struct ErrorReport
+    {
+        // Relative rms error of the radiance per table entry (sun elevation).
+        std::vector<float> rmsError;
+
+        float maxRmsError;
+        float avgRmsError;
+
+    } t_errorReport;
+
+public:
+
+    AnalyticSky();
+    virtual ~AnalyticSky();
+
+    // Number of sun elevations in the table, covering [-10;90] degrees.
+    static const unsigned int tableSize();
+
+    const float setTurbidity(const float turbidity); // [2;10]
+    const float getTurbidity() const;
+    static const float defaultTurbidity();
+
+    // Uniform "perez" (vec3[5] holding A to E for Y, x and y).
+    osg::Uniform *getPerezUniform() const;
+    osg::Texture2D *getTableTexture() const;
+
+    // Radiance in rgb for a direction and sun position (horizontal system, 
+    // z up), evaluated like in the shader, including the table lookup.
+    const osg::Vec3f radiance(
+        const osg::Vec3f &direction
+    ,   const osg::Vec3f &sun) const;
+
+    // Fits the gains per sun elevation by least squares to the inscatter 
+    // of the reference (upper hemisphere only).
+    const bool fit(const AtmosphereQuery &reference);
+    // Restores the unfitted gains.
+    void resetFit();
+
+    inline const bool isFitted() const
+    {
+        return m_fitted;
+    }
+
+    // Compares against the reference in between the table entries (hence 
+    // including interpolation errors) and logs the results.
+    const t_errorReport errorReport(const AtmosphereQuery &reference) const;
+
+protected:
+
+    void updatePerez();
+    void updateTable();
+
+    // Sun elevation of table entry i in radians.
+    static const float elevation(const float i);
+
+    // Perez function for the three channels Y, x, and y.
+    const osg::Vec3f perez(
+        const float cosTheta
+    ,   const float gamma) const;
+
+    // Zenith values divided by F(0, thetaS).
+    const osg::Vec3f zenith(const float thetaS) const;
+
+    static const osg::Vec3f defaultGain(const float elevation);
+
+    // Model radiance without gain for a sun within the table.
+    const osg::Vec3f radiance(
+        const osg::Vec3f &direction
+    ,   const osg::Vec3f &sun
+    ,   const osg::Vec3f &zenith) const;
+
+    const osg::Vec3f lookup(
+        const unsigned int row
+    ,   const float elevation) const;
+
+    static void stratifiedHemisphere(
+        const unsigned int strata
+    ,   std::vector<float> &x
+    ,   std::vector<float> &y
+    ,   std::vector<float> &z);
+
+protected:
+
+    float m_turbidity;
+    bool m_fitted;
+
+    // A to E for Y, x and y
+    osg::Vec3f m_perez[5];
+
+    osg::ref_ptr<osg::Uniform> u_perez;
+
+    osg::ref_ptr<osg::Image> m_table;
+    osg::ref_ptr<osg::Texture2D> m_tableTexture;
+};
+
+} // namespace osgHimmel
+
+#endif // __ANALYTICSKY_H__
\ No newline at end of file
@@ -0,0 +1,194 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __ATMOSPHEREATLAS_H__
+#define __ATMOSPHEREATLAS_H__
+
+#include "declspec.h"
+#include "halffloat.h"
+
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+
+#include <vector>
+#include <string>
+
+
+namespace osgHimmel
+{
+
+class AtmospherePrecompute;
+
+// The atlas holds precomputed atmosphere tables for a grid of Mie parameters
+// (scattering coefficient, thickness and phase g). Tables for parameters in 
+// between are blended multilinearly from the nearest entries, avoiding any 
+// precompute at runtime. The entries are stored as half floats (approx. 
+// 8.5 MiB per entry for the default texture config), so keep the grid small.
+
+class OSGH_API AtmosphereAtlas : public osg::Referenced
+{
+public:
+
+    enum e_Table
+    {
+        T_Transmittance
+    ,   T_Irradiance
+    ,   T_Inscatter
+    ,   T_NumTables
+    };
+
+    typedef struct ErrorReport
+    {
+        // Maximum absolute error relative to the tables maximum value.
+        float maxError[T_NumTables];
+        // Root mean square error relative to the tables rms value.
+        float rmsError[T_NumTables];
+
+    } t_errorReport;
+
+public:
+
+    AtmosphereAtlas();
+    virtual ~AtmosphereAtlas();
+
+    // Samples need to be in strictly ascending order. Setting them clears 
+    // all entries.
+    void setScatteringMieSamples(const std::vector<float> &samples);
+    void setThicknessMieSamples(const std::vector<float> &samples);
+    void setPhaseGSamples(const std::vector<float> &samples);
+
+    inline const std::vector<float> &getScatteringMieSamples() const
+    {
+        return m_samples[0];
+    }
+    inline const std::vector<float> &getThicknessMieSamples() const
+    {
+        return m_samples[1];
+    }
+    inline const std::vector<float> &getPhaseGSamples() const
+    {
+        return m_samples[2];
+    }
+
+    // Used to compute the entries. Its model config provides all 
+    // parameters that are not sampled by the atlas.
+    inline AtmospherePrecompute *getPrecompute() const
+    {
+        return m_precompute.get();
+    }
+
+    const unsigned int numEntries() const;
+    const bool isComplete() const;
+
+    // Precomputes all entries (this takes numEntries precomputes).
+    const bool compute();
+
+    // Atlases can be computed offline. Loading replaces the samples 
+    // and fails if the table sizes do not match the precomputes, or if an 
+    // axis has more than 64 or not strictly ascending samples.
+    const bool save(const std::string &filePath) const;
+    const bool load(const std::string &filePath);
+
+    // Writes the blended tables into the targets tables and sets the 
+    // targets Mie model config accordingly (parameters get clamped).
+    const bool blend(
+        AtmospherePrecompute &target
+    ,   const float scatteringMie
+    ,   const float thicknessMie
+    ,   const float g) const;
+
+    // Compares blended tables with exactly precomputed ones.
+    const t_errorReport errorReport(
+        const float scatteringMie
+    ,   const float thicknessMie
+    ,   const float g);
+
+    // Reports (OSG_NOTICE) the errors at the center of all grid cells, 
+    // where they are expected to be largest, and returns the worst.
+    const t_errorReport errorReport();
+
+protected:
+
+    typedef std::vector<t_half> t_table;
+
+    typedef struct Entry
+    {
+        t_table tables[T_NumTables];
+
+    } t_entry;
+
+    const unsigned int entryIndex(
+        const unsigned int s
+    ,   const unsigned int h
+    ,   const unsigned int g) const;
+
+    // Number of floats of the table, given by the precomputes texture config.
+    const unsigned int tableSize(const e_Table table) const;
+
+    static const unsigned int tableSize(
+        const AtmospherePrecompute &precompute
+    ,   const e_Table table);
+
+    void setSamples(
+        const int axis
+    ,   const std::vector<float> &samples);
+
+    void setModel(
+        AtmospherePrecompute &precompute
+    ,   const float scatteringMie
+    ,   const float thicknessMie
+    ,   const float g) const;
+
+    // Blends all tables into the given float buffers.
+    void blendTables(
+        float *dest[T_NumTables]
+    ,   const float scatteringMie
+    ,   const float thicknessMie
+    ,   const float g) const;
+
+    // Returns the lower sample index and the weight of the upper one.
+    static void interval(
+        const std::vector<float> &samples
+    ,   const float value
+    ,   unsigned int &index
+    ,   float &weight);
+
+protected:
+
+    osg::ref_ptr<AtmospherePrecompute> m_precompute;
+
+    // scattering, thickness and phase g samples
+    std::vector<float> m_samples[3];
+    std::vector<t_entry> m_entries;
+};
+
+} // namespace osgHimmel
+
+#endif // __ATMOSPHEREATLAS_H__
\ No newline at end of file
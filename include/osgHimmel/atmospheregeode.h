@@ -45,6 +45,8 @@ namespace osg
 namespace osgHimmel
 {
 
+class AnalyticSky;
+class AtmosphereAtlas;
 class AtmospherePrecompute;
 class Himmel;
 class HimmelQuad;
@@ -54,7 +56,15 @@ class OSGH_API AtmosphereGeode : public osg::Geode
 {
 public:
 
-    AtmosphereGeode();
+    enum e_SkyModel
+    {
+        SM_Precomputed  // Bruneton's precomputed atmospheric scattering
+    ,   SM_Analytic     // Preetham's analytic daylight (no precompute)
+    };
+
+public:
+
+    AtmosphereGeode(const e_SkyModel model = SM_Precomputed);
     virtual ~AtmosphereGeode();
 
     void update(const Himmel &himmel);
@@ -84,6 +94,40 @@ public:
     void setScatteringMie(const float coefficient); 
     void setPhaseG(const float g);  // [-1;+1]
 
+    void setMaxScatteringOrder(const int order); // >= 1
+    void setScatteringOrderThreshold(const float threshold); // 0 for fixed order count
+
+    // Replaces the tables by the ones blended from the atlas, setting the
+    // Mie parameters accordingly (without precompute or shader update).
+    const bool blendFromAtlas(
+        const AtmosphereAtlas &atlas
+    ,   const float scatteringMie
+    ,   const float thicknessMie
+    ,   const float g);
+
+    // Access to the precomputed tables and their storage options.
+    inline AtmospherePrecompute *getPrecompute() const
+    {
+        return m_precompute;
+    }
+
+    // Switching to the precomputed model computes the tables if required.
+    void setSkyModel(const e_SkyModel model);
+    inline const e_SkyModel getSkyModel() const
+    {
+        return m_model;
+    }
+
+    // Access to the analytic model (e.g., for fitting it to the tables).
+    inline AnalyticSky *getAnalyticSky() const
+    {
+        return m_analytic.get();
+    }
+
+    // Turbidity of the analytic model.
+    const float setTurbidity(const float turbidity);
+    const float getTurbidity() const;
+
 protected:
 
     void precompute();
@@ -96,12 +140,16 @@ protected:
 
     const std::string getVertexShaderSource();
     const std::string getFragmentShaderSource();
+    const std::string getAnalyticFragmentShaderSource();
 
 protected:
 
     HimmelQuad *m_hquad;
 
+    e_SkyModel m_model;
+
     AtmospherePrecompute *m_precompute;
+    osg::ref_ptr<AnalyticSky> m_analytic;
 
     osg::Texture2D *m_transmittance;
     osg::Texture2D *m_irradiance;
@@ -114,6 +162,7 @@ protected:
     osg::ref_ptr<osg::Uniform> u_sunScale;
     osg::ref_ptr<osg::Uniform> u_exposure;
     osg::ref_ptr<osg::Uniform> u_lheurebleue;
+    osg::ref_ptr<osg::Uniform> u_mieG;
 
     float m_scale;
 
@@ -31,6 +31,8 @@
 #ifndef __ATMOSPHEREPRECOMPUTE_H__
 #define __ATMOSPHEREPRECOMPUTE_H__
 
+#include "declspec.h"
+
 #include <osg/Referenced>
 #include <osg/GL>
 #include <osg/ref_ptr>
@@ -64,7 +66,7 @@ namespace osgViewer
 namespace osgHimmel
 {
 
-class AtmospherePrecompute : public osg::Referenced
+class OSGH_API AtmospherePrecompute : public osg::Referenced
 {
 public:
     
@@ -86,6 +88,12 @@ public:
         int irradianceIntegralSamples;
         int inscatterSphericalIntegralSamples;
 
+        // Multiple scattering is computed for orders 2 to maxScatteringOrder.
+        // If scatteringOrderThreshold is greater than zero, the loop stops as
+        // soon as the relative energy an order adds to E or S drops below it.
+        int maxScatteringOrder;
+        float scatteringOrderThreshold;
+
     } t_preTexCfg;
 
     typedef struct PhysicalModelConfig
@@ -106,6 +114,24 @@ public:
     {
         return m_modelCfg;
     }
+    const t_modelCfg &getModelConfig() const
+    {
+        return m_modelCfg;
+    }
+
+    const t_preTexCfg &getTextureConfig() const
+    {
+        return m_preTexCfg;
+    }
+
+    // The transmittance, irradiance and inscatter tables are rendered into
+    // float images. This decides what is kept on the CPU after a compute.
+    enum e_TableStorage
+    {
+        TS_Float    // keeps the float images
+    ,   TS_Half     // packs the images into half floats (also halves upload size)
+    ,   TS_Release  // releases the images after upload (no CPU access)
+    };
 
 protected:
 
@@ -130,13 +156,71 @@ public:
     osg::Texture2D *getIrradianceTexture();
     osg::Texture3D *getInscatterTexture();
 
+    // CPU copies of the tables (NULL if released, see e_TableStorage).
+    inline osg::Image *getTransmittanceImage() const
+    {
+        return m_transmittanceImage.get();
+    }
+    inline osg::Image *getIrradianceImage() const
+    {
+        return m_irradianceImage.get();
+    }
+    inline osg::Image *getInscatterImage() const
+    {
+        return m_inscatterImage.get();
+    }
+
     const bool compute(const bool ifDirtyOnly = true);
     void dirty();
 
+    // Allows to assign the tables without computing them (e.g., from an 
+    // AtmosphereAtlas): begin provides the float images for writing, end 
+    // uploads them, applies the table storage and clears the dirty state.
+    void beginTableUpdate();
+    void endTableUpdate();
+
     void substituteMacros(std::string &source);
 
+
+    const int setMaxScatteringOrder(const int order);
+    const int getMaxScatteringOrder() const;
+    static const int defaultMaxScatteringOrder();
+
+    // Zero disables the adaptive mode (all orders up to the max are computed).
+    const float setScatteringOrderThreshold(const float threshold);
+    const float getScatteringOrderThreshold() const;
+    static const float defaultScatteringOrderThreshold();
+
+    // Switching to TS_Half converts the current tables in place, 
+    // other switches take effect on the next compute.
+    void setTableStorage(const e_TableStorage storage);
+    inline const e_TableStorage getTableStorage() const
+    {
+        return m_tableStorage;
+    }
+
+    // Bytes currently used by the CPU copies of all three tables.
+    const unsigned int getTableMemoryUsage() const;
+
+    // Highest scattering order used by the last compute.
+    inline const int getLastScatteringOrder() const
+    {
+        return m_lastScatteringOrder;
+    }
+
 protected:
 
+    // Sum of the rgb channels of all texels of a float image.
+    static const double energy(const osg::Image *image);
+
+    // (Re)allocates float images for tables that were packed or released.
+    void prepareTables();
+    // Applies the table storage to the computed images.
+    void storeTables();
+
+    static void packImage(osg::Image *image);
+
+
     osg::Texture2D *getDeltaETexture();
     osg::Texture3D *getDeltaSRTexture();
     osg::Texture3D *getDeltaSMTexture();
@@ -223,6 +307,10 @@ protected:
 
     bool m_dirty;
 
+    int m_lastScatteringOrder;
+
+    e_TableStorage m_tableStorage;
+
     t_preTexCfg m_preTexCfg;
     t_modelCfg m_modelCfg;
 
@@ -0,0 +1,252 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __ATMOSPHEREQUERY_H__
+#define __ATMOSPHEREQUERY_H__
+
+#include "declspec.h"
+
+#include <osg/Referenced>
+#include <osg/Vec3f>
+#include <osg/Vec4f>
+
+#include <vector>
+
+
+namespace osg
+{
+    class Image;
+}
+
+
+namespace osgHimmel
+{
+
+class AtmospherePrecompute;
+
+// Samples copies of the precomputed transmittance, irradiance and inscatter
+// tables on the CPU, using the same parameterization and filtering as the 
+// bruneton_common shader fragments. This gives sky colors, sun light and 
+// ambient irradiance without any GPU readback (e.g., for light probes).
+// All directions are in the horizontal system with z pointing up (as the 
+// sun position of the Himmel, which should be passed refraction corrected).
+// Radiances are linear and in the shader's units (ISun = 100).
+//
+// The queries are const and may be called concurrently, update is not.
+
+class OSGH_API AtmosphereQuery : public osg::Referenced
+{
+public:
+
+    AtmosphereQuery();
+    virtual ~AtmosphereQuery();
+
+    // Copies the tables and the model config of the precompute (half tables 
+    // are decoded). This is skipped if the tables were not modified since 
+    // the last update. Returns false if the tables were released.
+    const bool update(const AtmospherePrecompute &precompute);
+
+    inline const bool isValid() const
+    {
+        return m_valid;
+    }
+
+    // Increases whenever update copied modified tables.
+    inline const unsigned int getModifiedCount() const
+    {
+        return m_modifiedCount;
+    }
+
+    // Altitude of the observer in km, clamped like Himmel::setAltitude.
+    const float setAltitude(const float altitude);
+    const float getAltitude() const;
+
+    // Transmittance from the observer towards infinity in the given 
+    // direction, or zero if the ray intersects the ground.
+    const osg::Vec3f transmittance(const osg::Vec3f &direction) const;
+
+    // Sun light reaching the observer (without the sun's angular size).
+    const osg::Vec3f sunColor(const osg::Vec3f &sun) const;
+
+    // Sky light irradiance on a horizontal surface at the observer.
+    const osg::Vec3f irradiance(const osg::Vec3f &sun) const;
+
+    // Light scattered towards the observer from the given direction (this 
+    // is the sky color of the AtmosphereGeode without sun and l'heure bleue).
+    const osg::Vec3f inscatter(
+        const osg::Vec3f &direction
+    ,   const osg::Vec3f &sun) const;
+
+    // Batch versions for many directions, given and returned as separate 
+    // component arrays (structure of arrays). The directions do not need to 
+    // be normalized. Large batches are split over several threads. The 
+    // results equal those of the single direction queries: only the 
+    // direction normalization is hoisted out of the table lookups, these 
+    // remain scalar (and branch like the shader does). Batch inscatter is 
+    // virtual, so that other sky models can serve as reference for fitting 
+    // (see AnalyticSky).
+
+    void transmittance(
+        const unsigned int count
+    ,   const float *x
+    ,   const float *y
+    ,   const float *z
+    ,   float *r
+    ,   float *g
+    ,   float *b) const;
+
+    virtual void inscatter(
+        const unsigned int count
+    ,   const float *x
+    ,   const float *y
+    ,   const float *z
+    ,   const osg::Vec3f &sun
+    ,   float *r
+    ,   float *g
+    ,   float *b) const;
+
+    // Sun irradiance scale of the shaders (ISun).
+    static const float sunIntensity();
+
+    // Tone mapping as used by the AtmosphereGeode (glsl_bruneton_hdr).
+    static const osg::Vec3f hdr(
+        const osg::Vec3f &radiance
+    ,   const float exposure);
+
+protected:
+
+    typedef struct Table
+    {
+        int width;
+        int height;
+        int depth;
+        int components;
+
+        std::vector<float> data;
+
+        // identifies the source image state the data was copied from
+        const osg::Image *source;
+        unsigned int modifiedCount;
+
+    } t_table;
+
+    const bool copyTable(
+        const osg::Image *image
+    ,   t_table &table);
+
+    // Linear filtering with clamp to edge, as for the precompute textures.
+    static void sample2D(
+        const t_table &table
+    ,   const float u
+    ,   const float v
+    ,   float *result);
+
+    static void sample3D(
+        const t_table &table
+    ,   const float u
+    ,   const float v
+    ,   const float w
+    ,   float *result);
+
+    const osg::Vec3f transmittance(
+        const float r
+    ,   const float mu) const;
+
+    const osg::Vec3f transmittanceWithShadow(
+        const float r
+    ,   const float mu) const;
+
+    const osg::Vec4f texture4D(
+        const float r
+    ,   const float mu
+    ,   const float muS
+    ,   const float nu) const;
+
+    // Core of the inscatter shader function for an observer at (0, 0, r).
+    const osg::Vec3f inscatter(
+        const float r
+    ,   const float mu
+    ,   const float muS
+    ,   const float nu) const;
+
+    const float phaseFunctionR(const float mu) const;
+    const float phaseFunctionM(const float mu) const;
+
+    // Process a block of directions (used by the batch kernels).
+
+    class InscatterKernel;
+    class TransmittanceKernel;
+
+    void inscatterBlock(
+        const unsigned int count
+    ,   const float *x
+    ,   const float *y
+    ,   const float *z
+    ,   const osg::Vec3f &sun
+    ,   float *r
+    ,   float *g
+    ,   float *b) const;
+
+    void transmittanceBlock(
+        const unsigned int count
+    ,   const float *x
+    ,   const float *y
+    ,   const float *z
+    ,   float *r
+    ,   float *g
+    ,   float *b) const;
+
+protected:
+
+    bool m_valid;
+    unsigned int m_modifiedCount;
+
+    float m_altitude;
+
+    // bottom and top radius of the atmosphere in km
+    float m_Rg;
+    float m_Rt;
+
+    int m_resR;
+    int m_resMu;
+    int m_resMuS;
+    int m_resNu;
+
+    float m_mieG;
+    osg::Vec3f m_betaR;
+
+    t_table m_transmittance;
+    t_table m_irradiance;
+    t_table m_inscatter;
+};
+
+} // namespace osgHimmel
+
+#endif // __ATMOSPHEREQUERY_H__
\ No newline at end of file
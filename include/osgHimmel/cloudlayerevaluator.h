@@ -0,0 +1,168 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __CLOUDLAYEREVALUATOR_H__
+#define __CLOUDLAYEREVALUATOR_H__
+
+#include "declspec.h"
+
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/Vec2f>
+#include <osg/Vec3f>
+
+
+namespace osgHimmel
+{
+
+// Evaluates the cloud layers on the cpu, e.g., for querying whether the sun
+// or moon is covered. It reproduces the noise of the pre rendered pass and 
+// the layer intersection of the HighCloudLayerGeode and DubeCloudLayerGeode
+// shaders, using the same noise arrays and parameters. The pre rendered 
+// noise is evaluated directly instead of bilinearly from its texture.
+
+// Directions are given in the horizontal system (z up) and need not be 
+// normalized. Results are the layers alpha, clamped to [0;1].
+
+class OSGH_API CloudLayerEvaluator
+{
+public:
+
+    enum e_LayerModel
+    {
+        LM_High // HighCloudLayerGeode
+    ,   LM_Dube // DubeCloudLayerGeode
+    };
+
+public:
+
+    CloudLayerEvaluator(const e_LayerModel model = LM_High);
+    virtual ~CloudLayerEvaluator();
+
+    // The i-th of the four noise arrays (texSize^2 x slices luminance floats,
+    // see NoiseCache). The data is not copied; an optional owner is 
+    // referenced for keeping it valid.
+    void setNoiseArray(
+        const unsigned int i
+    ,   const float *data
+    ,   const unsigned int texSize
+    ,   const unsigned int slices
+    ,   osg::Referenced *owner = NULL);
+
+    const bool isValid() const;
+
+    // Parameters as set for the layer uniforms.
+
+    void setTime(const float time);
+    void setCoverage(const float coverage);
+    void setSharpness(const float sharpness);
+    void setChange(const float change);
+    void setWind(const osg::Vec2f &wind);
+    void setAltitude(const float altitude);
+    void setScale(const osg::Vec2f &scale);
+
+    // Only used by the dube model.
+    void setThickness(const float thickness);
+    void setOffset(const float offset);
+
+    // Observer altitude above mean sea level and earth radius, in km.
+    void setObserver(
+        const float altitude
+    ,   const float earthRadius);
+
+    // Pre rendered noise for texture coordinates (repeats in [0;1]).
+    const float noise(
+        const float u
+    ,   const float v) const;
+
+    // Layer alpha for the view direction, 0 below the horizon.
+    const float density(const osg::Vec3f &direction) const;
+
+    // Batch variant, processed in parallel.
+    void density(
+        const unsigned int count
+    ,   const osg::Vec3f *directions
+    ,   float *dest) const;
+
+    // Mean alpha over a disc of the given angular radius (in radians) around
+    // the direction, e.g., the covered fraction of the suns disc.
+    const float occlusion(
+        const osg::Vec3f &direction
+    ,   const float angularRadius) const;
+
+protected:
+
+    const float sample(
+        const unsigned int i
+    ,   const float s
+    ,   const float t
+    ,   const float r) const;
+
+    const bool belowHorizon(const osg::Vec3f &d) const;
+
+    const bool layerIntersection(
+        const osg::Vec3f &d
+    ,   const osg::Vec3f &o
+    ,   const float altitude
+    ,   float &t) const;
+
+    // Texture lookup of the layer at the world position.
+    const float T(const osg::Vec3f &stu) const;
+
+    const float highDensity(const osg::Vec3f &eye) const;
+    const float dubeDensity(const osg::Vec3f &eye) const;
+
+protected:
+
+    e_LayerModel m_model;
+
+    const float *m_noise[4];
+    unsigned int m_noiseSize[4];
+    unsigned int m_noiseSlices[4];
+    osg::ref_ptr<osg::Referenced> m_noiseOwner[4];
+
+    float m_time;
+    float m_coverage;
+    float m_sharpness;
+    float m_change;
+    osg::Vec2f m_wind;
+    float m_altitude;
+    osg::Vec2f m_scale;
+
+    float m_thickness;
+    float m_offset;
+
+    float m_observerAltitude;
+    float m_earthRadius;
+};
+
+} // namespace osgHimmel
+
+#endif // __CLOUDLAYEREVALUATOR_H__
\ No newline at end of file
@@ -32,6 +32,7 @@
 #define __DUBECLOUDLAYERGEODE_H__
 
 #include "declspec.h"
+#include "cloudlayerevaluator.h"
 
 #include <osg/Group>
 
@@ -48,6 +49,7 @@ namespace osgHimmel
 
 class Himmel;
 class HimmelQuad;
+class PreRenderedNoiseRefresh;
 
 
 class OSGH_API DubeCloudLayerGeode : public osg::Group
@@ -59,6 +61,17 @@ public:
 
     void update(const Himmel &himmel);
 
+    // Controls when and how often the pre rendered noise is refreshed.
+    inline PreRenderedNoiseRefresh *preNoiseRefresh() const
+    {
+        return m_preNoiseRefresh;
+    }
+
+    // Snapshot of the layer for cpu queries, e.g., sun occlusion, at the 
+    // himmels altitude. The noise uses the inputs of the pre rendered noise
+    // (see PreRenderedNoiseRefresh), so it matches what is drawn.
+    const CloudLayerEvaluator evaluator(const Himmel &himmel) const;
+
 
 
     const float setCoverage(const float coverage);
@@ -109,7 +122,11 @@ protected:
     HimmelQuad *m_hquad;
     
     osg::Texture2D *m_preNoise;
+    osg::ref_ptr<PreRenderedNoiseRefresh> m_preNoiseRefresh;
     osg::Texture3D *m_noise[4];
+
+    // references the noise arrays
+    CloudLayerEvaluator m_evaluator;
         
     int m_noiseSize;
 
@@ -117,7 +134,6 @@ protected:
     osg::Shader *m_vShader;
     osg::Shader *m_fShader;
 
-    osg::ref_ptr<osg::Uniform> u_q;
     osg::ref_ptr<osg::Uniform> u_clouds;
     osg::ref_ptr<osg::Uniform> u_noise;
 
@@ -32,6 +32,8 @@
 #define __HIGHCLOUDLAYERGEODE_H__
 
 #include "declspec.h"
+#include "random.h"
+#include "cloudlayerevaluator.h"
 
 #include <osg/Group>
 
@@ -48,6 +50,7 @@ namespace osgHimmel
 
 class Himmel;
 class HimmelQuad;
+class PreRenderedNoiseRefresh;
 
 
 /*
@@ -69,6 +72,17 @@ public:
 
     void update(const Himmel &himmel);
 
+    // Controls when and how often the pre rendered noise is refreshed.
+    inline PreRenderedNoiseRefresh *preNoiseRefresh() const
+    {
+        return m_preNoiseRefresh;
+    }
+
+    // Snapshot of the layer for cpu queries, e.g., sun occlusion, at the 
+    // himmels altitude. The noise uses the inputs of the pre rendered noise
+    // (see PreRenderedNoiseRefresh), so it matches what is drawn.
+    const CloudLayerEvaluator evaluator(const Himmel &himmel) const;
+
     const float setCoverage(const float coverage);
     const float getCoverage() const;
 
@@ -99,17 +113,52 @@ public:
         const unsigned texSize
     ,   osg::Texture2D *texture);
 
+    // The noise offsets are derived from the seed (see Random).
+
     static osg::ref_ptr<osg::Image> createNoiseSlice(
         const unsigned int texSize
-    ,   const unsigned int octave);
+    ,   const unsigned int octave
+    ,   const unsigned int seed = Random::globalSeed());
 
+    // Reuses the array via the NoiseCache.
     static osg::Texture3D *createNoiseArray(
         const unsigned int texSize 
     ,   const unsigned int octave
-    ,   const unsigned int slices);
+    ,   const unsigned int slices
+    ,   const unsigned int seed = Random::globalSeed());
+
+    // Creates a noise volume that is seamless along all three axes (at REPEAT
+    // wrap), with period lattice cells along s and t. Since no texel is spent
+    // on hiding seams, smaller sizes can be used for the same frequency.
+    static osg::Texture3D *createTileableNoiseArray(
+        const unsigned int texSize 
+    ,   const unsigned int period
+    ,   const unsigned int slices
+    ,   const unsigned int seed = Random::globalSeed());
+
+    // Creates a Perlin-Worley volume (see WorleyNoise), seamless along all 
+    // three axes with period cells along s and t, via the NoiseCache. Its 
+    // billowy shapes need fewer samples than summed gradient noise.
+    static osg::Texture3D *createPerlinWorleyNoiseArray(
+        const unsigned int texSize 
+    ,   const unsigned int period
+    ,   const unsigned int slices
+    ,   const unsigned int seed = Random::globalSeed());
+
+    // Creates a noise volume from 4D simplex noise: s and t are mapped onto a 
+    // torus (seamless, frequency cells along each axis) and the slices move 
+    // the torus coherently through the fourth dimension, so r is a smooth 
+    // temporal evolution instead of unrelated slices.
+    static osg::Texture3D *createSimplexNoiseArray(
+        const unsigned int texSize 
+    ,   const unsigned int frequency
+    ,   const unsigned int slices
+    ,   const unsigned int seed = Random::globalSeed());
 
 protected:
 
+    static osg::Texture3D *createNoiseTexture(osg::Image *image);
+
     virtual void setupUniforms(osg::StateSet* stateSet);
     virtual void setupNode    (osg::StateSet* stateSet);
     virtual void setupTextures(osg::StateSet* stateSet);
@@ -123,7 +172,11 @@ protected:
     HimmelQuad *m_hquad;
     
     osg::Texture2D *m_preNoise;
+    osg::ref_ptr<PreRenderedNoiseRefresh> m_preNoiseRefresh;
     osg::Texture3D *m_noise[4];
+
+    // references the noise arrays
+    CloudLayerEvaluator m_evaluator;
         
     int m_noiseSize;
 
@@ -131,7 +184,6 @@ protected:
     osg::Shader *m_vShader;
     osg::Shader *m_fShader;
 
-    osg::ref_ptr<osg::Uniform> u_q;
     osg::ref_ptr<osg::Uniform> u_preNoise;
 
     osg::ref_ptr<osg::Uniform> u_time;
@@ -34,6 +34,7 @@
 #include "declspec.h"
 #include "abstracthimmel.h"
 #include "atime.h"
+#include "random.h"
 
 #ifdef OSGHIMMEL_EXPORTS
 
@@ -45,6 +46,7 @@
 #include "starmapgeode.h"
 #include "highcloudlayergeode.h"
 #include "dubecloudlayergeode.h"
+#include "skyharmonics.h"
 
 #else // #ifdef OSGHIMMEL_EXPORTS
 
@@ -58,6 +60,7 @@ namespace osgHimmel
     class StarMapGeode;
     class HighCloudLayerGeode;
     class DubeCloudLayerGeode;
+    class SkyHarmonics;
 } // namespace osgHimmel
 
 #endif // #ifdef OSGHIMMEL_EXPORTS
@@ -142,10 +145,38 @@ public:
         return m_dubeLayer;
     }
 
+    // Optional spherical harmonics of the sky, updated when dirty. Its 
+    // uniform is added to the himmels state set.
+    void setHarmonics(SkyHarmonics *harmonics);
+
+    inline SkyHarmonics *harmonics() const
+    {
+        return m_harmonics;
+    }
+
 
     const osg::Vec3f getSunPosition() const;
     const osg::Vec3f getSunPosition(const t_aTime &aTime) const;
 
+    // Equatorial to horizontal transform of the last update, shared as 
+    // uniform R by the stars and the starmap.
+    const osg::Matrixf getEquToHorTransform() const;
+
+
+    // Updates the view dependent parameters of the camera and view size 
+    // hints, only if these changed (called by update). The uniform q is 
+    // shared by all geodes: 2 sqrt(2) tan(fov / 2) / height, scaled by the
+    // shaders as required.
+    void updateView();
+
+    const float getViewFov() const;
+    const float getViewAspectRatio() const;
+    const float getViewQ() const;
+
+    // Number of uniforms set by the himmel with the last update, including
+    // the shared ones (but not those of the geodes).
+    const unsigned int getUniformUpdateCount() const;
+
 protected:
 
     void updateSeed();
@@ -167,6 +198,17 @@ protected:
     // height above mean sea level in km, mean earth radius in km
     osg::ref_ptr<osg::Uniform> u_common; 
 
+    // shared by the geodes
+    osg::ref_ptr<osg::Uniform> u_R; // equatorial to horizontal
+    osg::ref_ptr<osg::Uniform> u_q;
+
+    // view of the last update of q
+    float m_fov;
+    float m_aspectRatio;
+    unsigned int m_height;
+
+    unsigned int m_uniformUpdates;
+
     AbstractAstronomy *m_astronomy;
 
     osg::ref_ptr<AtmosphereGeode>     m_atmosphere;
@@ -176,6 +218,11 @@ protected:
     osg::ref_ptr<StarMapGeode>        m_starmap;
     osg::ref_ptr<HighCloudLayerGeode> m_highLayer;
     osg::ref_ptr<DubeCloudLayerGeode> m_dubeLayer;
+
+    osg::ref_ptr<SkyHarmonics> m_harmonics;
+
+    // dither seed per frame, independent of the global rand() state
+    Random m_random;
 };
 
 } // namespace osgHimmel
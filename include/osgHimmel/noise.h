@@ -73,6 +73,78 @@ public:
     ,   const float t
     ,   const unsigned int r) const;
 
+    // Batch variant of noise2(s, t, r) for a whole row, with s = i / size for
+    // i in [0;size) and t = row / size, written as noise * scale + bias. The 
+    // results match the scalar variant exactly.
+    void noise2Row(
+        const unsigned int size
+    ,   const unsigned int row
+    ,   const unsigned int r
+    ,   float *dest
+    ,   const float scale = 1.f
+    ,   const float bias = 0.f) const;
+
+    // Periodic (tileable) noise with arbitrary integer periods in lattice 
+    // units, i.e., pnoise2(x + px, y, px, py) == pnoise2(x, y, px, py). The 
+    // offsets of the constructor select a different lattice (seed).
+
+    const float pnoise2(
+        const float x
+    ,   const float y
+    ,   const unsigned int px
+    ,   const unsigned int py) const;
+    const float pnoise3(
+        const float x
+    ,   const float y
+    ,   const float z
+    ,   const unsigned int px
+    ,   const unsigned int py
+    ,   const unsigned int pz) const;
+
+    // Simplex noise with range [-1;+1], not periodic. The offsets of the 
+    // constructor shift the lattice along x and y (seed).
+
+    const float simplex3(
+        const float x
+    ,   const float y
+    ,   const float z) const;
+    const float simplex4(
+        const float x
+    ,   const float y
+    ,   const float z
+    ,   const float w) const;
+
+    // Batch variants of simplex3/simplex4 for count points given by separate
+    // coordinate arrays, written as noise * scale + bias. The results match
+    // the scalar variants exactly.
+
+    void simplex3(
+        const unsigned int count
+    ,   const float *x
+    ,   const float *y
+    ,   const float *z
+    ,   float *dest
+    ,   const float scale = 1.f
+    ,   const float bias = 0.f) const;
+    void simplex4(
+        const unsigned int count
+    ,   const float *x
+    ,   const float *y
+    ,   const float *z
+    ,   const float *w
+    ,   float *dest
+    ,   const float scale = 1.f
+    ,   const float bias = 0.f) const;
+
+    // Same as noise2Row, but with an arbitrary t (e.g., for non square maps).
+    void noise2Line(
+        const unsigned int size
+    ,   const float t
+    ,   const unsigned int r
+    ,   float *dest
+    ,   const float scale = 1.f
+    ,   const float bias = 0.f) const;
+
 //    const std::string noise2GlslSource();
 
 protected:
@@ -87,6 +159,11 @@ protected:
     ,   const unsigned int y
     ,   const unsigned int r) const;
 
+    const unsigned int hash3(
+        const unsigned int x
+    ,   const unsigned int y
+    ,   const unsigned int z) const;
+
     const osg::Vec2f grad2(
         const unsigned int x
     ,   const unsigned int y) const;
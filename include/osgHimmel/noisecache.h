@@ -0,0 +1,131 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __NOISECACHE_H__
+#define __NOISECACHE_H__
+
+#include "declspec.h"
+
+#include <osg/ref_ptr>
+
+#include <string>
+
+namespace osg
+{
+    class Image;
+}
+
+
+namespace osgHimmel
+{
+
+// Generates the noise arrays of the cloud layers (texSize^2 x slices 
+// luminance floats in [0;1] of 2D noise with frequency 2^octave) and keeps 
+// them keyed by (texSize, octave, slices, seed). Arrays are shared within 
+// the process (e.g., between cloud layers and Himmel instances) and stored 
+// as half floats in the cache directory, so they are only generated once.
+// Generated arrays are rounded to half floats as well, so the data does not
+// depend on whether the cache was hit.
+
+class OSGH_API NoiseCache
+{
+public:
+
+    // Returns the cached array for the key, loaded from disk or generated on 
+    // a miss. The image is shared, so do not modify it.
+    static osg::ref_ptr<osg::Image> noiseArray(
+        const unsigned int texSize
+    ,   const unsigned int octave
+    ,   const unsigned int slices
+    ,   const unsigned int seed);
+
+    // Returns the cached Perlin-Worley volume (texSize^2 x slices, seamless
+    // along all axes, see WorleyNoise::generatePerlinWorley1f with period and 
+    // three octaves), loaded from disk or generated on a miss.
+    static osg::ref_ptr<osg::Image> perlinWorleyArray(
+        const unsigned int texSize
+    ,   const unsigned int period
+    ,   const unsigned int slices
+    ,   const unsigned int seed);
+
+    // Generates an array without caching. The per slice noise offsets are 
+    // derived from the seed.
+    static osg::ref_ptr<osg::Image> generate(
+        const unsigned int texSize
+    ,   const unsigned int octave
+    ,   const unsigned int slices
+    ,   const unsigned int seed);
+
+    // An empty directory disables the disk cache. Defaults to the value of 
+    // the OSGHIMMEL_CACHE environment variable or an osghimmel directory in 
+    // the user's cache directory (XDG_CACHE_HOME, ~/.cache, or LOCALAPPDATA 
+    // on Windows). The directory is created on the first write, files are 
+    // written to a new file first and then renamed.
+    static void setDirectory(const std::string &directory);
+    static const std::string directory();
+
+    // Releases all arrays held within the process.
+    static void clear();
+
+protected:
+
+    enum e_ArrayType
+    {
+        AT_Noise
+    ,   AT_PerlinWorley
+    };
+
+    static osg::ref_ptr<osg::Image> array(
+        const e_ArrayType type
+    ,   const unsigned int texSize
+    ,   const unsigned int frequency
+    ,   const unsigned int slices
+    ,   const unsigned int seed);
+
+    static const std::string filePath(
+        const e_ArrayType type
+    ,   const unsigned int texSize
+    ,   const unsigned int frequency
+    ,   const unsigned int slices
+    ,   const unsigned int seed);
+
+    static osg::Image *load(
+        const std::string &filePath
+    ,   const unsigned int texSize
+    ,   const unsigned int slices);
+
+    static const bool save(
+        const std::string &filePath
+    ,   const osg::Image &image);
+};
+
+} // namespace osgHimmel
+
+#endif // __NOISECACHE_H__
\ No newline at end of file
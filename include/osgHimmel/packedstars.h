@@ -0,0 +1,123 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __PACKEDSTARS_H__
+#define __PACKEDSTARS_H__
+
+#include "declspec.h"
+#include "brightstars.h"
+
+#include <osg/Vec4f>
+
+#include <vector>
+
+
+namespace osgHimmel
+{
+
+// Compressed encoding of bright stars, 12 instead of 32 bytes per star:
+//   direction:     equatorial unit vector, octahedral mapped (2 x 16 bit snorm)
+//   magnitude:     16 bit unorm in [minMagnitude;maxMagnitude]
+//   proper motion: 2 x 8 bit snorm, square root companded up to 
+//                  maxProperMotion (arcsec per year, larger ones are clamped)
+//   color:         sRGB, 3 x 8 bit unorm
+//
+// The direction error is below 0.0025 degrees (9 arcsec), magnitude and color are off 
+// by at most half a quantization step. The proper motion error is bound by 
+// sqrt(|pm| * maxProperMotion) / 127 + maxProperMotion / 64516.
+//
+// File layout (native byte order, tagged):
+//   char[8]     magic "OSGHPACK"
+//   uint32      version
+//   uint32      endian tag 0x01020304
+//   uint32      number of stars n
+//   n x 12 byte packed stars
+
+class OSGH_API PackedStars
+{
+public:
+
+    typedef struct PackedStar
+    {
+        short direction[2];
+        unsigned short magnitude;
+        signed char properMotion[2]; // ra, de
+        unsigned char sRGB[3];
+        unsigned char reserved;
+    } t_packedStar;
+
+    typedef std::vector<t_packedStar> t_packedStars;
+
+    static const float minMagnitude();
+    static const float maxMagnitude();
+    static const float maxProperMotion();
+
+    static void encode(
+        const BrightStars::s_BrightStar *source
+    ,   t_packedStar *dest
+    ,   const unsigned int count);
+
+    static void decode(
+        const t_packedStar *source
+    ,   BrightStars::s_BrightStar *dest
+    ,   const unsigned int count);
+
+    // Decodes into the vertex layout of the StarsGeode (see StarCatalogue), 
+    // i.e., equatorial unit vector and index (starting at firstIndex) as 
+    // positions, sRGB and visual magnitude as colors. Decodes four stars 
+    // at once if SSE2 is available.
+    static void decode(
+        const t_packedStar *source
+    ,   osg::Vec4f *positions
+    ,   osg::Vec4f *colors
+    ,   const unsigned int count
+    ,   const unsigned int firstIndex = 0);
+
+    // Scalar reference of the vertex layout decoding.
+    static void decode(
+        const t_packedStar &source
+    ,   osg::Vec4f &position
+    ,   osg::Vec4f &color
+    ,   const unsigned int index);
+
+    static const bool isPackedFile(const char *fileName);
+
+    static const bool fromFile(
+        const char *fileName
+    ,   t_packedStars &stars);
+
+    static const bool toFile(
+        const char *fileName
+    ,   const t_packedStars &stars);
+};
+
+} // namespace osgHimmel
+
+#endif // __PACKEDSTARS_H__
@@ -0,0 +1,192 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __PAGEDSTARCATALOGUE_H__
+#define __PAGEDSTARCATALOGUE_H__
+
+#include "declspec.h"
+
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/Array>
+
+#include <string>
+#include <vector>
+
+
+namespace osgHimmel
+{
+
+class StarCatalogue;
+class StarSkyIndex;
+
+// Star catalogue that is too large to be held in memory at once (e.g., 
+// Tycho-2 with about 2.5 million stars). The stars are stored in tiles, one 
+// per sky cell (see StarSkyIndex) and magnitude tier, which are loaded on 
+// demand by a background thread and kept under a memory budget, releasing 
+// the least recently requested tiles first.
+//
+// File layout (native byte order, tagged):
+//   char[8]     magic "OSGHPAGE"
+//   uint32      version
+//   uint32      endian tag 0x01020304
+//   uint32      depth of the sky cells
+//   uint32      number of tiers t
+//   uint32      number of stars n
+//   uint32      byte offset of the tile table
+//   uint32      byte offset of the first tile
+//   float[t-1]  tier limits, the faintest magnitude of each but the last tier
+//   per tile    uint32 byte offset, uint32 count, float brightest and 
+//               faintest magnitude (tile i is tier i % t of cell i / t)
+//   per tile    count x float4 positions, then count x float4 colors (as 
+//               in the StarCatalogue), sorted by magnitude
+//
+// The table and tiles are 16 byte aligned.
+
+class OSGH_API PagedStarCatalogue : public osg::Referenced
+{
+public:
+
+    PagedStarCatalogue();
+
+    // Writes the catalogue as tiles for cells of the given depth and tiers 
+    // split at the given, ascending magnitude limits (stars fainter than the 
+    // last limit form the last tier). The catalogue is reordered by cell.
+    static const bool toFile(
+        const char *fileName
+    ,   StarCatalogue &catalogue
+    ,   const std::vector<float> &tierLimits
+    ,   const unsigned int depth = 4);
+
+    // True if the file starts with the magic of paged catalogues.
+    static const bool isPagedFile(const char *fileName);
+
+    // Reads the tile table and starts the loader. No stars are loaded yet.
+    const bool open(const char *fileName);
+    void close();
+
+    // Cells with the star count and brightest magnitude of all their tiers, 
+    // used for culling (without catalogue, see StarSkyIndex::assign).
+    StarSkyIndex *index();
+    const StarSkyIndex *index() const;
+
+    const unsigned int numStars() const;
+    const unsigned int numTiers() const;
+    const unsigned int numTiles() const;
+
+    const unsigned int tile(
+        const unsigned int cell
+    ,   const unsigned int tier) const;
+
+    // Requests the tiles of the indices visible cells with stars of at most 
+    // the given magnitude, picks up the tiles loaded meanwhile, and releases 
+    // tiles not requested by this update, exceeding the memory budget. 
+    // Pending requests of previous updates are replaced.
+    void update(const float magnitude);
+
+    // Tiles requested by the last update, resident or pending.
+    const std::vector<unsigned int> &requestedTiles() const;
+
+    // Resident tiles provide their stars as vertex arrays.
+    const bool isResident(const unsigned int tile) const;
+
+    osg::Vec4Array *positions(const unsigned int tile) const;
+    osg::Vec4Array *colors(const unsigned int tile) const;
+
+    const unsigned int tileSize(const unsigned int tile) const;
+    const float tileBrightest(const unsigned int tile) const;
+
+    // Number of leading stars of a resident tile with a magnitude of at most
+    // the given one.
+    const unsigned int numStarsUpTo(
+        const unsigned int tile
+    ,   const float magnitude) const;
+
+    // Upper bound for the bytes of resident tiles. Tiles requested by the 
+    // last update are kept regardless.
+    void setMemoryBudget(const unsigned int bytes);
+    const unsigned int getMemoryBudget() const;
+    static const unsigned int defaultMemoryBudget();
+
+    const unsigned int getResidentBytes() const;
+    const unsigned int getResidentTileCount() const;
+
+    // Number of tiles read from the file since opening.
+    const unsigned int getLoadCount() const;
+
+    // Blocks until the loader has no pending requests. Loaded tiles become 
+    // resident with the next update.
+    void wait();
+
+protected:
+
+    virtual ~PagedStarCatalogue();
+
+    void release(const unsigned int tile);
+
+protected:
+
+    class Loader;
+
+    struct s_Tile
+    {
+        unsigned int offset;
+        unsigned int count;
+        float brightest;
+        float faintest;
+
+        osg::ref_ptr<osg::Vec4Array> positions;
+        osg::ref_ptr<osg::Vec4Array> colors;
+
+        // update the tile was last requested by
+        unsigned int requested;
+    };
+
+    std::string m_fileName;
+
+    std::vector<s_Tile> m_tiles;
+
+    unsigned int m_numStars;
+    unsigned int m_numTiers;
+
+    osg::ref_ptr<StarSkyIndex> m_index;
+    Loader *m_loader;
+
+    std::vector<unsigned int> m_requested;
+    unsigned int m_updates;
+
+    unsigned int m_memoryBudget;
+    unsigned int m_residentBytes;
+    unsigned int m_residentTiles;
+};
+
+} // namespace osgHimmel
+
+#endif // __PAGEDSTARCATALOGUE_H__
\ No newline at end of file
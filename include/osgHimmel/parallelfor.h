@@ -0,0 +1,74 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __PARALLELFOR_H__
+#define __PARALLELFOR_H__
+
+#include "declspec.h"
+
+
+namespace osgHimmel
+{
+
+// Splits an index range into contiguous chunks that are processed by 
+// OpenThreads worker threads (the calling thread takes the first chunk).
+// The call returns after all chunks are processed.
+
+class OSGH_API ParallelFor
+{
+public:
+
+    class Kernel
+    {
+    public:
+        virtual ~Kernel() { };
+
+        // Processes the indices within [begin;end).
+        virtual void operator()(
+            const int begin
+        ,   const int end) = 0;
+    };
+
+public:
+
+    // The chunk size is a multiple of grain. If numThreads is zero, 
+    // the number of processors is used.
+    static void run(
+        const int count
+    ,   Kernel &kernel
+    ,   const int grain = 1
+    ,   const unsigned int numThreads = 0);
+
+    static const unsigned int numProcessors();
+};
+
+} // namespace osgHimmel
+
+#endif // __PARALLELFOR_H__
\ No newline at end of file
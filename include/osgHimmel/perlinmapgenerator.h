@@ -70,6 +70,21 @@ public:
     ,   const int octaves = 5
     ,   const bool normalize = true);
 
+    // Generates a seamless 2D (depth = 1) or 3D tile of fBm noise in [0;1]. 
+    // The first octave has period lattice cells along the width, the other
+    // axes use the same cell size (at least one cell). Each further octave 
+    // doubles the frequency and halves the amplitude.
+
+    static void generateTileable1f(
+        const int width
+    ,   const int height
+    ,   const int depth
+    ,   float *dest
+    ,   const int period = 8
+    ,   const int octaves = 1
+    ,   const float xOffset = 0.f
+    ,   const float yOffset = 0.f);
+
 protected:
 
     template<typename T, int N>
@@ -0,0 +1,171 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __PRERENDEREDNOISEREFRESH_H__
+#define __PRERENDEREDNOISEREFRESH_H__
+
+#include "declspec.h"
+
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/Vec2f>
+
+#include <string>
+
+namespace osg
+{
+    class Group;
+    class Camera;
+    class Uniform;
+}
+
+
+namespace osgHimmel
+{
+
+// Controls the pre render pass of the cloud noise (see 
+// HighCloudLayerGeode::createPreRenderedNoise). The pass is only enabled
+// if its inputs changed visibly since the last refresh, optionally limited 
+// to a maximum refresh rate. A refresh can be amortized over several 
+// frames by rendering one horizontal band per frame; all bands of a 
+// refresh use the same snapshot of the inputs.
+
+class OSGH_API PreRenderedNoiseRefresh : public osg::Referenced
+{
+public:
+
+    // A noise term summed by the pre render shader. The shader is generated 
+    // from the terms (see termsGlsl), so the refresh estimates exactly the 
+    // offsets the shader applies.
+    typedef struct NoiseTerm
+    {
+        unsigned int array; // index of the noise array (sampler noise<array>)
+        float size;         // texture size of the array
+        float scale;        // of the texture coordinates
+        float weight;
+        float wind;         // factor of the wind offset
+        float evolution;    // factor of the evolution (offset along the slices)
+
+    } t_noiseTerm;
+
+    static const unsigned int numTerms();
+    static const t_noiseTerm &term(const unsigned int i);
+
+    // Slices per noise array.
+    static const unsigned int numSlices();
+
+    // GLSL statements adding the weighted terms to n, for the texture 
+    // coordinates uv, the wind offset m and the evolution t.
+    static const std::string termsGlsl();
+
+public:
+
+    // The pre rendered noise group is expected to have the pre render camera 
+    // as its first child. The snapshot uniforms are added to its state set.
+    PreRenderedNoiseRefresh(
+        osg::Group *preNoise
+    ,   const unsigned int texSize);
+
+    // Enables or disables the pass for the current frame.
+    void update(
+        const float time
+    ,   const float coverage
+    ,   const float sharpness
+    ,   const float change
+    ,   const osg::Vec2f &wind);
+
+    // Enforces a full refresh with the next update.
+    void dirty();
+
+    // Minimum shift (in texels of the finest noise array) of the noise 
+    // that triggers a refresh. Defaults to 0.25.
+    void setThreshold(const float texels);
+    const float getThreshold() const;
+
+    // Maximum refreshes per second (wall clock), 0 for no limit (default).
+    void setMaxRefreshRate(const float rate);
+    const float getMaxRefreshRate() const;
+
+    // Number of bands a refresh is split into (one per frame), default 1.
+    void setNumBands(const unsigned int bands);
+    const unsigned int getNumBands() const;
+
+    // Number of updates and number of frames the pass actually ran.
+    const unsigned int getUpdateCount() const;
+    const unsigned int getPassCount() const;
+
+    // Inputs of the last refresh, i.e., those of the pre rendered noise 
+    // (during a banded refresh, the ones being rendered). Valid as soon as 
+    // the pass ran once.
+    const float getTime() const;
+    const float getCoverage() const;
+    const float getSharpness() const;
+    const float getChange() const;
+    const osg::Vec2f getWind() const;
+
+protected:
+
+    virtual ~PreRenderedNoiseRefresh();
+
+    const bool changedVisibly(
+        const float time
+    ,   const float coverage
+    ,   const float sharpness
+    ,   const float change
+    ,   const osg::Vec2f &wind) const;
+
+protected:
+
+    osg::ref_ptr<osg::Camera> m_camera;
+    const unsigned int m_texSize;
+
+    // inputs of the last refresh, applied to the pass
+    osg::ref_ptr<osg::Uniform> u_time;
+    osg::ref_ptr<osg::Uniform> u_coverage;
+    osg::ref_ptr<osg::Uniform> u_sharpness;
+    osg::ref_ptr<osg::Uniform> u_change;
+    osg::ref_ptr<osg::Uniform> u_wind;
+
+    bool m_dirty;
+
+    float m_threshold;
+    float m_maxRefreshRate;
+    double m_lastRefresh;
+
+    unsigned int m_numBands;
+    unsigned int m_band; // next band of the current refresh, m_numBands if done
+
+    unsigned int m_updateCount;
+    unsigned int m_passCount;
+};
+
+} // namespace osgHimmel
+
+#endif // __PRERENDEREDNOISEREFRESH_H__
\ No newline at end of file
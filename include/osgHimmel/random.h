@@ -0,0 +1,110 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __RANDOM_H__
+#define __RANDOM_H__
+
+#include "declspec.h"
+
+
+namespace osgHimmel
+{
+
+// Counter based pseudo random numbers (Philox2x32-10, from Parallel Random 
+// Numbers: As Easy as 1, 2, 3 - Salmon et al. - 2011). The n-th number of a
+// (seed, stream) pair is a pure function of n, so work can be split across
+// threads deterministically by counter ranges (at) or by streams, and the 
+// sequential interface can jump ahead in constant time (skip).
+//
+// Each generator or Himmel owns its instance, so there is no shared state 
+// as with rand(). The global seed is the default for all instances and can 
+// be set once at startup for reproducible runs. It is accessed atomically,
+// but instances created before setting it keep the previous seed.
+
+class OSGH_API Random
+{
+public:
+
+    Random(
+        const unsigned int seed = globalSeed()
+    ,   const unsigned int stream = 0);
+
+    // Sequential interface, advancing the counter.
+
+    const unsigned int next();
+
+    // Uniform in [min;max).
+    const float nextf(
+        const float min = 0.f
+    ,   const float max = 1.f);
+
+    // Uniform in [min;max].
+    const int nexti(
+        const int min
+    ,   const int max);
+
+    void skip(const unsigned int count);
+
+    // Counter based interface, independent of the current counter.
+
+    const unsigned int at(const unsigned int counter) const;
+    const float atf(
+        const unsigned int counter
+    ,   const float min = 0.f
+    ,   const float max = 1.f) const;
+
+    void setCounter(const unsigned int counter);
+    const unsigned int counter() const;
+
+    const unsigned int seed() const;
+    const unsigned int stream() const;
+
+    static void setGlobalSeed(const unsigned int seed);
+    static const unsigned int globalSeed();
+
+    // Returns the first word of Philox2x32-10 for the given counter and key.
+    static const unsigned int philox(
+        const unsigned int counter0
+    ,   const unsigned int counter1
+    ,   const unsigned int key);
+
+    // Maps to [0;1) using the upper 24 bits.
+    static const float toUnit(const unsigned int value);
+
+protected:
+
+    unsigned int m_seed;
+    unsigned int m_stream;
+    unsigned int m_counter;
+};
+
+} // namespace osgHimmel
+
+#endif // __RANDOM_H__
\ No newline at end of file
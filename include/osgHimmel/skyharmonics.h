@@ -0,0 +1,172 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __SKYHARMONICS_H__
+#define __SKYHARMONICS_H__
+
+#include "declspec.h"
+
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/Vec3f>
+
+#include <vector>
+
+
+namespace osg
+{
+    class Uniform;
+}
+
+
+namespace osgHimmel
+{
+
+class Himmel;
+class AtmosphereQuery;
+
+// Projects the sky radiance into second order (L2, 9 coefficients) spherical
+// harmonics for ambient lighting. The atmosphere is sampled on the CPU from 
+// the precomputed tables using a stratified set of directions, the moon is 
+// added as directional light (scaled by its illuminated fraction) and the 
+// stars as constant radiance of the upper hemisphere. The sun's direct light 
+// is not included (see AtmosphereQuery::sunColor).
+//
+// The coefficients are provided as "skySH" uniform (vec3[9], order: l0, l1 
+// with m = -1, 0, 1, l2 with m = -2 .. 2) holding radiance; for irradiance 
+// they are to be scaled by PI, 2PI/3 and PI/4 per band (see irradiance).
+
+class OSGH_API SkyHarmonics : public osg::Referenced
+{
+public:
+
+    static const unsigned int NUM_COEFFICIENTS = 9;
+
+public:
+
+    // Uses strata x 2 strata jittered samples (cos theta x phi).
+    SkyHarmonics(const unsigned int strata = defaultStrata());
+    virtual ~SkyHarmonics();
+
+    static const unsigned int defaultStrata();
+
+    // Reprojects the sky if the tables, the altitude or the sun or moon 
+    // directions changed noticeably since the last projection. This is 
+    // called by the Himmel when it is dirty. Returns true on reprojection.
+    const bool update(const Himmel &himmel);
+
+    // Forces reprojection on next update.
+    void dirty();
+
+    inline const osg::Vec3f &getCoefficient(const unsigned int i) const
+    {
+        return m_coefficients[i];
+    }
+
+    osg::Uniform *getUniform() const;
+
+    // Irradiance for a surface with the given normal.
+    const osg::Vec3f irradiance(const osg::Vec3f &normal) const;
+
+    inline const unsigned int numSamples() const
+    {
+        return static_cast<unsigned int>(m_x.size());
+    }
+
+    // Time in milliseconds the last reprojection took.
+    inline const double getLastUpdateTime() const
+    {
+        return m_lastUpdateTime;
+    }
+
+
+    // Angle in radians the sun or moon have to move for reprojection.
+    const float setThreshold(const float angle);
+    const float getThreshold() const;
+    static const float defaultThreshold();
+
+    // Full moon irradiance relative to the sun's.
+    const float setMoonIntensity(const float intensity);
+    const float getMoonIntensity() const;
+    static const float defaultMoonIntensity();
+
+    // Radiance of the starry sky relative to the sun's irradiance.
+    const float setStarsIntensity(const float intensity);
+    const float getStarsIntensity() const;
+    static const float defaultStarsIntensity();
+
+protected:
+
+    void setupSamples(const unsigned int strata);
+
+    static void basis(
+        const osg::Vec3f &v
+    ,   float *Y);
+
+    void project(const Himmel &himmel);
+
+    // Projects the radiance samples (m_r, m_g and m_b) into the coefficients.
+    void projectSamples();
+
+protected:
+
+    osg::ref_ptr<AtmosphereQuery> m_query;
+    osg::ref_ptr<osg::Uniform> u_coefficients;
+
+    osg::Vec3f m_coefficients[NUM_COEFFICIENTS];
+
+    // sample directions and basis functions (NUM_COEFFICIENTS x samples)
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_z;
+    std::vector<float> m_basis;
+
+    // inscattered radiance per sample
+    std::vector<float> m_r;
+    std::vector<float> m_g;
+    std::vector<float> m_b;
+
+    bool m_dirty;
+
+    osg::Vec3f m_sun;
+    osg::Vec3f m_moon;
+    float m_altitude;
+    unsigned int m_tablesModifiedCount;
+
+    float m_threshold;
+    float m_moonIntensity;
+    float m_starsIntensity;
+
+    double m_lastUpdateTime;
+};
+
+} // namespace osgHimmel
+
+#endif // __SKYHARMONICS_H__
\ No newline at end of file
@@ -0,0 +1,139 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __STARCATALOGUE_H__
+#define __STARCATALOGUE_H__
+
+#include "declspec.h"
+
+#include <osg/Referenced>
+#include <osg/Vec4f>
+
+#include <vector>
+
+
+namespace osgHimmel
+{
+
+class BrightStars;
+
+// Star catalogue laid out as the vertex arrays of the StarsGeode. Catalogue 
+// files are memory mapped, so loading is a bounds check and a mapping.
+//
+// File layout (native byte order, tagged):
+//   char[8]     magic "OSGHSTAR"
+//   uint32      version
+//   uint32      endian tag 0x01020304
+//   uint32      number of stars n
+//   uint32      byte offset of the positions
+//   uint32      byte offset of the colors
+//   uint32      flags (1: sorted by magnitude, brightest first; 2: grouped 
+//               by sky cell, see setSortedByCell, with the cell depth in 
+//               bits 8 to 15)
+//   n x float4  positions: equatorial unit vector and the stars index
+//   n x float4  colors: approximated sRGB and visual magnitude
+//
+// Both blocks are 16 byte aligned. Files written after building a sky 
+// index (see StarSkyIndex::build) are in cell order and stay mapped when 
+// an index of the same depth is built for them.
+
+class OSGH_API StarCatalogue : public osg::Referenced
+{
+public:
+
+    StarCatalogue();
+
+    // Maps a catalogue file. Packed star files (see PackedStars) are decoded 
+    // and raw bright star files without header (see BrightStars) are 
+    // converted instead.
+    const bool open(const char *fileName);
+    void close();
+
+    // Converts the bright stars, e.g., for writing a catalogue file.
+    void assign(const BrightStars &brightStars);
+
+    const bool toFile(const char *fileName) const;
+
+    // Sorts the stars by magnitude, brightest first (stable, the indices 
+    // are kept). Mapped stars are copied before.
+    void sortByMagnitude();
+    const bool isSortedByMagnitude() const;
+
+    // Permutes the stars, the i-th star is the former order[i]-th one (e.g., 
+    // for grouping by sky cells, see StarSkyIndex). Mapped stars are copied 
+    // before. Resets the magnitude and the cell order.
+    void reorder(const std::vector<unsigned int> &order);
+
+    // Marks the stars as grouped by the cells of a sky index of the given 
+    // depth and sorted by magnitude within (set by StarSkyIndex::build).
+    void setSortedByCell(const unsigned int depth);
+    const bool isSortedByCell(const unsigned int depth) const;
+
+    // Number of leading stars with a magnitude of at most the given one. 
+    // Requires the stars to be sorted by magnitude.
+    const unsigned int numStarsUpTo(const float magnitude) const;
+
+    // True if the data is mapped from a catalogue file.
+    const bool isMapped() const;
+
+    const unsigned int numStars() const;
+
+    const osg::Vec4f *positions() const;
+    const osg::Vec4f *colors() const;
+
+protected:
+
+    virtual ~StarCatalogue();
+
+    const bool map(const char *fileName);
+    const bool unpack(const char *fileName);
+
+protected:
+
+    void *m_mapping;
+    size_t m_mappingSize;
+
+    // storage of converted stars
+    std::vector<osg::Vec4f> m_convertedPositions;
+    std::vector<osg::Vec4f> m_convertedColors;
+
+    const osg::Vec4f *m_positions;
+    const osg::Vec4f *m_colors;
+
+    unsigned int m_numStars;
+    bool m_sortedByMagnitude;
+
+    bool m_sortedByCell;
+    unsigned int m_cellDepth;
+};
+
+} // namespace osgHimmel
+
+#endif // __STARCATALOGUE_H__
\ No newline at end of file
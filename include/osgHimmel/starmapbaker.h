@@ -0,0 +1,126 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __STARMAPBAKER_H__
+#define __STARMAPBAKER_H__
+
+#include "declspec.h"
+
+#include <string>
+#include <vector>
+
+namespace osg
+{
+    class Image;
+}
+
+
+namespace osgHimmel
+{
+
+class StarCatalogue;
+
+// Rasterizes the stars of a catalogue into the six faces of a cube map as 
+// used by the StarMapGeode (equatorial directions, faces in the order +x, 
+// -x, +y, -y, +z, -z with the texture coordinates of gl cube maps). Each 
+// star is splatted by a gaussian point spread function with its catalogue 
+// color (approximated sRGB, see Stars::sRgbColor) and flux relative to the
+// reference magnitude. Texels are radiances, i.e., corrected for their 
+// solid angle, and stored as rgb floats (HDR).
+//
+// Faint stars are baked while bright ones are left to the StarsGeode (see 
+// setMagnitudeRange). Faces are processed in row blocks on multiple 
+// threads, but every texel sums its stars in catalogue order, so the 
+// output is the same for any number of threads.
+
+class OSGH_API StarMapBaker
+{
+public:
+
+    StarMapBaker(const unsigned int size = 1024);
+    virtual ~StarMapBaker();
+
+    // Edge length of the faces in texels.
+    const unsigned int size() const;
+
+    // Stars of magnitudes within (brightest;faintest] are baked, e.g., with 
+    // brightest being the faintest star drawn as point by the StarsGeode.
+    void setMagnitudeRange(
+        const float brightest
+    ,   const float faintest);
+
+    const float getBrightestMagnitude() const;
+    const float getFaintestMagnitude() const;
+
+    // Standard deviation of the point spread function in texels.
+    const float setSigma(const float sigma);
+    const float getSigma() const;
+    static const float defaultSigma();
+
+    // A star of the reference magnitude has a flux of one.
+    const float setReferenceMagnitude(const float magnitude);
+    const float getReferenceMagnitude() const;
+    static const float defaultReferenceMagnitude();
+
+    // Zero uses all processors.
+    void setNumThreads(const unsigned int numThreads);
+
+    // Rebakes all faces. Returns the number of baked stars.
+    const unsigned int bake(const StarCatalogue &catalogue);
+
+    // Rgb floats of the face, rows of increasing t.
+    const float *face(const unsigned int i) const;
+
+    // Returns a new image (GL_RGB, GL_FLOAT) of the face.
+    osg::Image *createImage(const unsigned int i) const;
+
+    // The file path should contain a questionmark '?' that is replaced by 
+    // the face extensions '_px', '_nx', '_py', etc. (see StarMapGeode). Use, 
+    // e.g., ".hdr" for keeping the dynamic range.
+    const bool write(const std::string &cubeMapFilePath) const;
+
+protected:
+
+    unsigned int m_size;
+
+    float m_brightest;
+    float m_faintest;
+
+    float m_sigma;
+    float m_referenceMagnitude;
+
+    unsigned int m_numThreads;
+
+    std::vector<float> m_faces[6];
+};
+
+} // namespace osgHimmel
+
+#endif // __STARMAPBAKER_H__
\ No newline at end of file
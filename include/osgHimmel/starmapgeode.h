@@ -54,6 +54,8 @@ public:
     StarMapGeode(const char* cubeMapFilePath);
     virtual ~StarMapGeode();
 
+    // Kept for compatibility only: R and q are shared by the himmel, so 
+    // there is nothing left to update.
     void update(const Himmel &himmel);
 
     const float setColorRatio(const float ratio);
@@ -98,8 +100,6 @@ protected:
 
     float m_apparentMagnitude;
 
-    osg::ref_ptr<osg::Uniform> u_R;
-    osg::ref_ptr<osg::Uniform> u_q;
     osg::ref_ptr<osg::Uniform> u_starmapCube;
     osg::ref_ptr<osg::Uniform> u_color;
     osg::ref_ptr<osg::Uniform> u_deltaM;
@@ -0,0 +1,151 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __STARQUERY_H__
+#define __STARQUERY_H__
+
+#include "declspec.h"
+#include "atime.h"
+
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/Vec3f>
+#include <osg/Matrix>
+
+#include <vector>
+
+
+namespace osgHimmel
+{
+
+class AbstractAstronomy;
+class BrightStars;
+class StarCatalogue;
+class StarSkyIndex;
+
+// Answers which stars an observer sees, e.g., "all stars above 10 degrees 
+// brighter than magnitude 3 with their altitude and azimuth". The stars are 
+// grouped by the cells of a StarSkyIndex and sorted by magnitude within, so 
+// a query only converts the magnitude limited prefixes of the cells that 
+// can intersect the queried region. Results are sorted by magnitude, 
+// brightest first.
+//
+// All directions and angles are in the horizontal system (x east, y north, 
+// z up, as the positions of the Himmel), angles in degrees. The queries are
+// const and may be called concurrently, assign and the observer setters 
+// are not.
+
+class OSGH_API StarQuery : public osg::Referenced
+{
+public:
+
+    typedef struct Star
+    {
+        unsigned int index; // in the BrightStars or catalogue file
+        float magnitude;
+
+        float altitude; 
+        float azimuth;  // in [0;360), from north over east
+
+        osg::Vec3f direction;
+
+    } t_star;
+
+    typedef std::vector<t_star> t_stars;
+
+public:
+
+    StarQuery(const unsigned int depth = 3);
+
+    void assign(const BrightStars &brightStars);
+
+    // Opens a bright stars or star catalogue file (see StarCatalogue).
+    const bool open(const char *fileName);
+
+    const unsigned int numStars() const;
+
+    // Transform of equatorial into horizontal directions, as used by the 
+    // StarsGeode (see AbstractAstronomy::getEquToHorTransform).
+    void setEquToHorTransform(const osg::Matrixf &R);
+
+    void setObserver(
+        const AbstractAstronomy &astronomy
+    ,   const t_aTime &aTime
+    ,   const float latitude
+    ,   const float longitude);
+
+    // Stars with a magnitude up to the given one, within the angle (radius)
+    // around the direction, which need not be normalized. Appends to stars 
+    // and returns the number of stars found.
+    const unsigned int cone(
+        const osg::Vec3f &direction
+    ,   const float radius
+    ,   const float magnitude
+    ,   t_stars &stars) const;
+
+    // Stars with a magnitude up to the given one, with an altitude between 
+    // the given ones (e.g., from 10 to 90 for all above 10 degrees). Appends
+    // to stars and returns the number of stars found.
+    const unsigned int band(
+        const float minAltitude
+    ,   const float maxAltitude
+    ,   const float magnitude
+    ,   t_stars &stars) const;
+
+protected:
+
+    virtual ~StarQuery();
+
+    void updateCells();
+
+    // Converts the magnitude limited stars of the cells into horizontal 
+    // coordinates and appends those passing the test.
+    template<typename Test>
+    const unsigned int collect(
+        const std::vector<unsigned int> &cells
+    ,   const float magnitude
+    ,   const Test &test
+    ,   t_stars &stars) const;
+
+protected:
+
+    osg::ref_ptr<StarCatalogue> m_catalogue;
+    osg::ref_ptr<StarSkyIndex> m_index;
+
+    osg::Matrixf m_R;
+
+    // horizontal cell centers and radii (radians)
+    std::vector<osg::Vec3f> m_centers;
+    std::vector<float> m_radii;
+};
+
+} // namespace osgHimmel
+
+#endif // __STARQUERY_H__
\ No newline at end of file
@@ -55,6 +55,26 @@ public:
     static const osg::Vec3f sRgbColor(const osg::Vec2f planckianLocus);
     static const osg::Vec3f sRgbColor(const osg::Vec3f xyzTrisimulus);
 
+    // Temperature range of the planckian locus approximation in K.
+    static const t_longf minTemperature();
+    static const t_longf maxTemperature();
+
+    // Color of the temperature, interpolated from a table sampled uniformly 
+    // in reciprocal temperature (i.e., almost uniformly in B-V). Temperatures 
+    // out of range are clamped.
+    static const osg::Vec3f sRgbColorFromTable(const t_longf t /* temperature in K */);
+
+    // Color of the B-V color index by the exact chain of temperature, 
+    // planckian locus, and tristimulus, with the temperature clamped.
+    static const osg::Vec3f sRgbColorFromBV(const t_longf BtoV);
+
+    // Colors of count B-V color indices using the table, e.g., for 
+    // recoloring whole catalogues.
+    static void sRgbColorsFromBV(
+        const float *BtoV
+    ,   osg::Vec3f *colors
+    ,   const unsigned int count);
+
 
     static const t_equd apparentPosition(
         const t_julianDay t
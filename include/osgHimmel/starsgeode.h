@@ -33,8 +33,17 @@
 
 #include "declspec.h"
 #include "brightstars.h"
+#include "starcatalogue.h"
+#include "starskyindex.h"
+#include "pagedstarcatalogue.h"
 
 #include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Point>
+#include <osg/PointSprite>
+
+#include <map>
+#include <vector>
 
 
 namespace osgHimmel
@@ -47,11 +56,29 @@ class OSGH_API StarsGeode : public osg::Geode
 {
 public:
 
-    StarsGeode(const char *brightStarsFilePath);
+    // Either way every star is a single point of the same vertex arrays 
+    // with the same draw ranges, only its expansion into a sprite differs.
+    enum e_ExpansionMode
+    {
+        EM_GeometryShader // points are expanded to quads by a geometry shader
+    ,   EM_PointSprites   // points are rasterized as point sprites sized by the vertex shader
+    };
+
+public:
+
+    StarsGeode(
+        const char *brightStarsFilePath
+    ,   const e_ExpansionMode mode = EM_GeometryShader);
     virtual ~StarsGeode();
 
+    // Kept for compatibility, forwards to updateView.
     void update(const Himmel &himmel);
 
+    // Updates the view dependent state (magnitude cutoff and culling of the
+    // sky cells) for the himmels view, required every frame. The uniforms 
+    // R and q are shared by the himmel.
+    void updateView(const Himmel &himmel);
+
     const float setApparentMagnitude(const float vMag);
     const float getApparentMagnitude() const;
     static const float defaultApparentMagnitude();
@@ -83,6 +110,45 @@ public:
     const float setScale(const float scale);
     const float getScale() const;
 
+    // Point sprites avoid the geometry shader stage, which is slow on many 
+    // drivers, but their size is limited by the maximum point size (which 
+    // may clip the glare of the brightest stars for small fields of view).
+    void setExpansionMode(const e_ExpansionMode mode);
+    inline const e_ExpansionMode getExpansionMode() const
+    {
+        return m_mode;
+    }
+
+    // Stars are sorted by magnitude and only those brighter than the cutoff
+    // are drawn. The cutoff is the faintest magnitude the shader would not 
+    // discard for the current apparent magnitude, view (q), and sun altitude.
+    const float getMagnitudeCutoff() const;
+
+    // Number of stars submitted for drawing with the last view update, i.e., 
+    // in visible sky cells and brighter than the cutoff.
+    const unsigned int getDrawnStarCount() const;
+
+    // Sky cells the stars are drawn by, each with its own draw range. Cells
+    // outside the view or below the horizon are skipped.
+    inline const StarSkyIndex *index() const
+    {
+        return m_index;
+    }
+
+    // The catalogue the stars were created from (see StarCatalogue). It is 
+    // empty if the stars are paged.
+    inline const StarCatalogue *catalogue() const
+    {
+        return m_catalogue;
+    }
+
+    // Paged catalogue if created from such a file (see PagedStarCatalogue), 
+    // whose visible tiles are loaded in the background and drawn as is.
+    inline PagedStarCatalogue *pagedCatalogue() const
+    {
+        return m_paged;
+    }
+
 protected:
 
     void setupUniforms(osg::StateSet* stateSet);
@@ -93,23 +159,46 @@ protected:
 
     void setupTextures(osg::StateSet* stateSet);
     void setupShader  (osg::StateSet* stateSet);
+    void updateShader (osg::StateSet* stateSet);
 
     void createAndAddDrawable(
         const char *brightStarsFilePath);
 
+    osg::Geometry *createGeometry(
+        osg::Vec4Array *vAry
+    ,   osg::Vec4Array *cAry);
+
+    void updateTiles();
+
     const std::string getVertexShaderSource();
     const std::string getGeometryShaderSource();
     const std::string getFragmentShaderSource();
 
 protected:
 
+    osg::ref_ptr<StarCatalogue> m_catalogue;
+    osg::ref_ptr<StarSkyIndex> m_index;
+
+    std::vector<osg::ref_ptr<osg::DrawArrays> > m_cellDrawArrays;
+
+    osg::ref_ptr<PagedStarCatalogue> m_paged;
+
+    typedef std::map<unsigned int, osg::ref_ptr<osg::Geometry> > t_tileGeometries;
+    t_tileGeometries m_tileGeometries;
+
+    osg::ref_ptr<osg::Point> m_point;
+
+    e_ExpansionMode m_mode;
+    osg::ref_ptr<osg::PointSprite> m_pointSprite;
+
+    float m_magnitudeCutoff;
+    unsigned int m_drawnStarCount;
+
     osg::Program *m_program;
     osg::Shader *m_vShader;
     osg::Shader *m_gShader;
     osg::Shader *m_fShader;
 
-    osg::ref_ptr<osg::Uniform> u_R;
-    osg::ref_ptr<osg::Uniform> u_q;
     osg::ref_ptr<osg::Uniform> u_noise1;
 
     osg::ref_ptr<osg::Uniform> u_color;
@@ -0,0 +1,168 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __STARSKYINDEX_H__
+#define __STARSKYINDEX_H__
+
+#include "declspec.h"
+
+#include <osg/Referenced>
+#include <osg/Vec3f>
+
+#include <vector>
+
+
+namespace osgHimmel
+{
+
+class StarCatalogue;
+
+// Hierarchical partition of the sky into the cells of a cube face quadtree 
+// (6 x 4^depth cells at the leaves). Building the index groups the stars of 
+// a catalogue by cell, each cell being a contiguous range, sorted by 
+// magnitude (brightest first). Cells are numbered in morton order per face,
+// so the cells of every quadtree node are contiguous as well.
+//
+// Culling marks the cells that intersect a view cone and are not entirely 
+// below the horizon. All directions are in the space of the catalogue 
+// positions (equatorial) and need not be normalized.
+
+class OSGH_API StarSkyIndex : public osg::Referenced
+{
+public:
+
+    // Angular margin (radians) added to a cells' bounds for the magnitude of 
+    // its brightest star, e.g., for sprites and glare extending beyond the 
+    // stars position.
+    class Margin
+    {
+    public:
+        virtual ~Margin() { }
+        virtual const float operator()(const float magnitude) const = 0;
+    };
+
+public:
+
+    StarSkyIndex(const unsigned int depth = 3);
+
+    // Reorders the catalogue by cell and magnitude, unless it is in this 
+    // order already (see StarCatalogue::isSortedByCell), and builds the 
+    // ranges.
+    void build(StarCatalogue &catalogue);
+
+    // Sets the star count and the brightest magnitude per cell without a 
+    // catalogue, e.g., for culling the tiles of a PagedStarCatalogue.
+    void assign(
+        const std::vector<unsigned int> &counts
+    ,   const std::vector<float> &brightest);
+
+    const unsigned int depth() const;
+    const unsigned int numCells() const;
+
+    // Leaf cell containing the direction.
+    const unsigned int cell(const osg::Vec3f &direction) const;
+
+    // Range of the cells stars in the catalogue.
+    const unsigned int begin(const unsigned int cell) const;
+    const unsigned int end(const unsigned int cell) const;
+
+    // Number of leading stars of the cell with a magnitude of at most the 
+    // given one (see StarCatalogue::numStarsUpTo).
+    const unsigned int numStarsUpTo(
+        const unsigned int cell
+    ,   const float magnitude) const;
+
+    // Bounding cone of a cell: normalized center direction and the angle 
+    // (radians) to its farthest corner.
+    const osg::Vec3f &center(const unsigned int cell) const;
+    const float radius(const unsigned int cell) const;
+
+    // Marks the non empty cells that intersect the cone of the given axis 
+    // and half angle (radians), and that reach above the horizon, i.e., 
+    // have points less than 90 degrees plus dip (radians) from the zenith. 
+    // Returns the number of visible cells.
+    const unsigned int cull(
+        const osg::Vec3f &axis
+    ,   const float halfAngle
+    ,   const osg::Vec3f &zenith
+    ,   const float dip
+    ,   const Margin *margin = NULL);
+
+    // Marks all non empty cells as visible.
+    const unsigned int cullNone();
+
+    const bool isVisible(const unsigned int cell) const;
+
+    // Number of stars in visible cells of the last cull.
+    const unsigned int getVisibleStarCount() const;
+
+    // Number of quadtree nodes tested by the last cull.
+    const unsigned int getTestedNodeCount() const;
+
+protected:
+
+    virtual ~StarSkyIndex();
+
+    const unsigned int nodeIndex(
+        const unsigned int level
+    ,   const unsigned int node) const;
+
+    void cullNode(
+        const unsigned int level
+    ,   const unsigned int node);
+
+protected:
+
+    unsigned int m_depth;
+    const StarCatalogue *m_catalogue;
+
+    // first star per cell and one past the last
+    std::vector<unsigned int> m_offsets;
+
+    // bounds and brightest magnitude of all nodes, level by level
+    std::vector<osg::Vec3f> m_centers;
+    std::vector<float> m_radii;
+    std::vector<float> m_brightest;
+
+    std::vector<bool> m_visible;
+    unsigned int m_numVisibleStars;
+    unsigned int m_numTestedNodes;
+
+    // parameters of the current cull
+    osg::Vec3f m_axis;
+    float m_halfAngle;
+    osg::Vec3f m_zenith;
+    float m_dip;
+    const Margin *m_margin;
+};
+
+} // namespace osgHimmel
+
+#endif // __STARSKYINDEX_H__
\ No newline at end of file
@@ -0,0 +1,121 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#ifndef __WORLEYNOISE_H__
+#define __WORLEYNOISE_H__
+
+#include "declspec.h"
+#include "random.h"
+
+#include <vector>
+
+
+namespace osgHimmel
+{
+
+// Cellular noise (A Cellular Texture Basis Function - Worley - 1996) with 
+// one feature point per cell of a periodic grid, i.e., the noise tiles 
+// with the grid. Coordinates are given in cell units.
+
+class OSGH_API WorleyNoise
+{
+public:
+
+    // The feature points are placed by the seed and stream (see Random).
+    WorleyNoise(
+        const unsigned int px
+    ,   const unsigned int py
+    ,   const unsigned int pz
+    ,   const unsigned int seed = Random::globalSeed()
+    ,   const unsigned int stream = 0);
+
+    // Distance to the closest feature point (F1).
+    const float worley3(
+        const float x
+    ,   const float y
+    ,   const float z) const;
+
+    // Batch variant of worley3 for a row, with x = i * px / size for i in 
+    // [0;size), written as F1 * scale + bias. The results match the scalar 
+    // variant exactly.
+    void worley3Row(
+        const unsigned int size
+    ,   const float y
+    ,   const float z
+    ,   float *dest
+    ,   const float scale = 1.f
+    ,   const float bias = 0.f) const;
+
+    // Generates a seamless 3D tile of inverted Worley fBm in [0;1], i.e., 
+    // billowy cells. Periods and octaves are the same as for 
+    // PerlinMapGenerator::generateTileable1f.
+    static void generateTileable1f(
+        const int width
+    ,   const int height
+    ,   const int depth
+    ,   float *dest
+    ,   const int period = 4
+    ,   const int octaves = 3
+    ,   const unsigned int seed = Random::globalSeed());
+
+    // Generates a seamless 3D tile of Perlin fBm remapped by the inverted 
+    // Worley fBm of the same period (Perlin-Worley noise, from The Real-time
+    // Volumetric Cloudscapes of Horizon Zero Dawn - Schneider - 2015): 
+    // connected shapes of Perlin noise with the billowy edges of cells.
+    static void generatePerlinWorley1f(
+        const int width
+    ,   const int height
+    ,   const int depth
+    ,   float *dest
+    ,   const int period = 4
+    ,   const int octaves = 3
+    ,   const unsigned int seed = Random::globalSeed());
+
+protected:
+
+    void gather(
+        const int x
+    ,   const int y
+    ,   const int z
+    ,   float *px
+    ,   float *py
+    ,   float *pz) const;
+
+protected:
+
+    unsigned int m_period[3];
+
+    // feature point offsets within their cells, 3 per cell
+    std::vector<float> m_points;
+};
+
+} // namespace osgHimmel
+
+#endif // __WORLEYNOISE_H__
\ No newline at end of file
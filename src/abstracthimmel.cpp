@@ -234,6 +234,11 @@ void AbstractHimmel::setCameraHint(osg::Camera *camera)
     m_cameraHint = camera;
 }
 
+const bool AbstractHimmel::hasCameraHint() const
+{
+    return NULL != m_cameraHint;
+}
+
 const float AbstractHimmel::getCameraFovHint() const
 {
     assert(m_cameraHint);
@@ -245,6 +250,30 @@ const float AbstractHimmel::getCameraFovHint() const
     return 0;
 }
 
+const float AbstractHimmel::getCameraAspectRatioHint() const
+{
+    assert(m_cameraHint);
+    
+    double aspectRatio, dummy;
+    if(m_cameraHint->getProjectionMatrixAsPerspective(dummy, aspectRatio, dummy, dummy))
+        return aspectRatio;
+
+    return 0;
+}
+
+const osg::Vec3f AbstractHimmel::getCameraDirectionHint() const
+{
+    assert(m_cameraHint);
+
+    osg::Vec3f eye, center, up;
+    m_cameraHint->getViewMatrixAsLookAt(eye, center, up);
+
+    osg::Vec3f direction(center - eye);
+    direction.normalize();
+
+    return direction;
+}
+
 
 void AbstractHimmel::setViewSizeHint(unsigned int width, unsigned int height)
 {
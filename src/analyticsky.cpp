@@ -0,0 +1,463 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "analyticsky.h"
+
+#include "atmospherequery.h"
+#include "mathmacros.h"
+
+#include <osg/Image>
+#include <osg/Texture2D>
+#include <osg/Uniform>
+#include <osg/Notify>
+
+#include <math.h>
+#include <assert.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    const unsigned int TABLE_SIZE(32);
+
+    const float MIN_ELEVATION(static_cast<float>(_rad(-10.0)));
+    const float MAX_ELEVATION(static_cast<float>(_PI_2));
+
+    // scales Preetham's luminance (kcd/m^2) approx. to the shaders' radiance
+    const float DEFAULT_SCALE(0.05f);
+
+    // directions used for fitting and error reports
+    const unsigned int STRATA(16);
+
+
+    inline const float smoothstep(
+        const float edge0
+    ,   const float edge1
+    ,   const float x)
+    {
+        const float t = _clamp(0.f, 1.f, (x - edge0) / (edge1 - edge0));
+        return t * t * (3.f - 2.f * t);
+    }
+
+    // the model assumes the sun to be above the horizon
+    inline const osg::Vec3f clampToHorizon(const osg::Vec3f &sun)
+    {
+        const float z = _ma(0.f, sun[2]);
+        const float l = sqrtf(sun[0] * sun[0] + sun[1] * sun[1]);
+        const float s = sqrtf(1.f - z * z) / _ma(l, 1e-6f);
+
+        return osg::Vec3f(sun[0] * s, sun[1] * s, z);
+    }
+}
+
+
+AnalyticSky::AnalyticSky()
+:   osg::Referenced()
+,   m_turbidity(defaultTurbidity())
+,   m_fitted(false)
+,   u_perez(new osg::Uniform(osg::Uniform::FLOAT_VEC3, "perez", 5))
+,   m_table(new osg::Image)
+,   m_tableTexture(new osg::Texture2D)
+{
+    m_table->setInternalTextureFormat(GL_RGB32F_ARB);
+    m_table->allocateImage(TABLE_SIZE, 2, 1, GL_RGB, GL_FLOAT);
+
+    m_tableTexture->setImage(m_table);
+    m_tableTexture->setInternalFormat(GL_RGB32F_ARB);
+
+    m_tableTexture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR);
+    m_tableTexture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+    m_tableTexture->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+    m_tableTexture->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+
+    updatePerez();
+    updateTable();
+    resetFit();
+}
+
+
+AnalyticSky::~AnalyticSky()
+{
+}
+
+
+const unsigned int AnalyticSky::tableSize()
+{
+    return TABLE_SIZE;
+}
+
+
+const float AnalyticSky::elevation(const float i)
+{
+    return MIN_ELEVATION + (MAX_ELEVATION - MIN_ELEVATION) * i / (TABLE_SIZE - 1);
+}
+
+
+const float AnalyticSky::setTurbidity(const float turbidity)
+{
+    m_turbidity = _clamp(2.f, 10.f, turbidity);
+
+    updatePerez();
+    updateTable();
+
+    return getTurbidity();
+}
+
+const float AnalyticSky::getTurbidity() const
+{
+    return m_turbidity;
+}
+
+const float AnalyticSky::defaultTurbidity()
+{
+    return 3.f;
+}
+
+
+osg::Uniform *AnalyticSky::getPerezUniform() const
+{
+    return u_perez.get();
+}
+
+osg::Texture2D *AnalyticSky::getTableTexture() const
+{
+    return m_tableTexture.get();
+}
+
+
+void AnalyticSky::updatePerez()
+{
+    const float T = m_turbidity;
+
+    // Y, x, y (Preetham et al. 1999, Appendix A.2)
+
+    m_perez[0] = osg::Vec3f( 0.1787f * T - 1.4630f, -0.0193f * T - 0.2592f, -0.0167f * T - 0.2608f);
+    m_perez[1] = osg::Vec3f(-0.3554f * T + 0.4275f, -0.0665f * T + 0.0008f, -0.0950f * T + 0.0092f);
+    m_perez[2] = osg::Vec3f(-0.0227f * T + 5.3251f, -0.0004f * T + 0.2125f, -0.0079f * T + 0.2102f);
+    m_perez[3] = osg::Vec3f( 0.1206f * T - 2.5771f, -0.0641f * T - 0.8989f, -0.0441f * T - 1.6537f);
+    m_perez[4] = osg::Vec3f(-0.0670f * T + 0.3703f, -0.0033f * T + 0.0452f, -0.0109f * T + 0.0529f);
+
+    for(unsigned int i = 0; i < 5; ++i)
+        u_perez->setElement(i, m_perez[i]);
+}
+
+
+const osg::Vec3f AnalyticSky::perez(
+    const float cosTheta
+,   const float gamma) const
+{
+    const float cosGamma = cosf(gamma);
+
+    osg::Vec3f F;
+    for(int i = 0; i < 3; ++i)
+    {
+        F[i] = (1.f + m_perez[0][i] * expf(m_perez[1][i] / cosTheta)) 
+            * (1.f + m_perez[2][i] * expf(m_perez[3][i] * gamma) + m_perez[4][i] * cosGamma * cosGamma);
+    }
+    return F;
+}
+
+
+const osg::Vec3f AnalyticSky::zenith(const float thetaS) const
+{
+    const float T  = m_turbidity;
+    const float T2 = T * T;
+
+    const float t  = thetaS;
+    const float t2 = t * t;
+    const float t3 = t * t2;
+
+    // (Preetham et al. 1999, Appendix A.2)
+
+    const float chi = (4.f / 9.f - T / 120.f) * (static_cast<float>(_PI) - 2.f * t);
+    const float Yz  = (4.0453f * T - 4.9710f) * tanf(chi) - 0.2155f * T + 2.4192f;
+
+    const float xz = 
+        T2 * ( 0.00166f * t3 - 0.00375f * t2 + 0.00209f * t)
+    +   T  * (-0.02903f * t3 + 0.06377f * t2 - 0.03202f * t + 0.00394f)
+    +        ( 0.11693f * t3 - 0.21196f * t2 + 0.06052f * t + 0.25886f);
+
+    const float yz = 
+        T2 * ( 0.00275f * t3 - 0.00610f * t2 + 0.00317f * t)
+    +   T  * (-0.04214f * t3 + 0.08970f * t2 - 0.04153f * t + 0.00516f)
+    +        ( 0.15346f * t3 - 0.26756f * t2 + 0.06670f * t + 0.26688f);
+
+    const osg::Vec3f F0 = perez(1.f, thetaS);
+
+    return osg::Vec3f(_ma(0.f, Yz) / F0[0], xz / F0[1], yz / F0[2]);
+}
+
+
+const osg::Vec3f AnalyticSky::defaultGain(const float elevation)
+{
+    return osg::Vec3f(1.f, 1.f, 1.f) * (DEFAULT_SCALE * smoothstep(MIN_ELEVATION, 0.f, elevation));
+}
+
+
+void AnalyticSky::updateTable()
+{
+    float *data = reinterpret_cast<float*>(m_table->data());
+
+    for(unsigned int i = 0; i < TABLE_SIZE; ++i)
+    {
+        const float thetaS = static_cast<float>(_PI_2) - _ma(0.f, elevation(static_cast<float>(i)));
+        const osg::Vec3f z = zenith(thetaS);
+
+        for(int c = 0; c < 3; ++c)
+            data[i * 3 + c] = z[c];
+    }
+    m_table->dirty();
+}
+
+
+void AnalyticSky::resetFit()
+{
+    float *data = reinterpret_cast<float*>(m_table->data()) + TABLE_SIZE * 3;
+
+    for(unsigned int i = 0; i < TABLE_SIZE; ++i)
+    {
+        const osg::Vec3f gain = defaultGain(elevation(static_cast<float>(i)));
+
+        for(int c = 0; c < 3; ++c)
+            data[i * 3 + c] = gain[c];
+    }
+    m_table->dirty();
+
+    m_fitted = false;
+}
+
+
+const osg::Vec3f AnalyticSky::lookup(
+    const unsigned int row
+,   const float elevation) const
+{
+    assert(row < 2);
+
+    // linear filtering as done by the texture
+
+    const float t = _clamp(0.f, 1.f, (elevation - MIN_ELEVATION) / (MAX_ELEVATION - MIN_ELEVATION));
+    const float x = t * (TABLE_SIZE - 1);
+
+    const unsigned int i0 = _mi(static_cast<unsigned int>(x), TABLE_SIZE - 1);
+    const unsigned int i1 = _mi(i0 + 1, TABLE_SIZE - 1);
+    const float a = x - i0;
+
+    const float *data = reinterpret_cast<const float*>(m_table->data()) + row * TABLE_SIZE * 3;
+
+    osg::Vec3f result;
+    for(int c = 0; c < 3; ++c)
+        result[c] = data[i0 * 3 + c] * (1.f - a) + data[i1 * 3 + c] * a;
+
+    return result;
+}
+
+
+const osg::Vec3f AnalyticSky::radiance(
+    const osg::Vec3f &direction
+,   const osg::Vec3f &sun
+,   const osg::Vec3f &zenith) const
+{
+    // rays below the horizon get the horizon's color
+
+    osg::Vec3f v(direction);
+    v.normalize();
+    v[2] = _ma(0.01f, v[2]);
+    v.normalize();
+
+    const osg::Vec3f s = clampToHorizon(sun);
+    const float gamma = acosf(_clamp(-1.f, 1.f, v * s));
+
+    const osg::Vec3f F = perez(v[2], gamma);
+
+    const float Y = zenith[0] * F[0];
+    const float x = zenith[1] * F[1];
+    const float y = zenith[2] * F[2];
+
+    const float X = x / y * Y;
+    const float Z = (1.f - x - y) / y * Y;
+
+    // XYZ to linear sRGB
+
+    return osg::Vec3f(
+        _ma(0.f,  3.2406f * X - 1.5372f * Y - 0.4986f * Z)
+    ,   _ma(0.f, -0.9689f * X + 1.8758f * Y + 0.0415f * Z)
+    ,   _ma(0.f,  0.0557f * X - 0.2040f * Y + 1.0570f * Z));
+}
+
+
+const osg::Vec3f AnalyticSky::radiance(
+    const osg::Vec3f &direction
+,   const osg::Vec3f &sun) const
+{
+    osg::Vec3f s(sun);
+    s.normalize();
+
+    const float e = asinf(_clamp(-1.f, 1.f, s[2]));
+
+    const osg::Vec3f L = radiance(direction, s, lookup(0, e));
+    const osg::Vec3f gain = lookup(1, e);
+
+    return osg::Vec3f(L[0] * gain[0], L[1] * gain[1], L[2] * gain[2]);
+}
+
+
+void AnalyticSky::stratifiedHemisphere(
+    const unsigned int strata
+,   std::vector<float> &x
+,   std::vector<float> &y
+,   std::vector<float> &z)
+{
+    // centered strata of cos theta and phi (uniform in solid angle)
+
+    const unsigned int strataPhi = strata * 2;
+
+    x.resize(strata * strataPhi);
+    y.resize(strata * strataPhi);
+    z.resize(strata * strataPhi);
+
+    unsigned int i = 0;
+    for(unsigned int t = 0; t < strata; ++t)
+        for(unsigned int p = 0; p < strataPhi; ++p, ++i)
+        {
+            const float cosTheta = (t + 0.5f) / strata;
+            const float sinTheta = sqrtf(1.f - cosTheta * cosTheta);
+            const float phi = static_cast<float>(_PI2) * (p + 0.5f) / strataPhi;
+
+            x[i] = sinTheta * cosf(phi);
+            y[i] = sinTheta * sinf(phi);
+            z[i] = cosTheta;
+        }
+}
+
+
+const bool AnalyticSky::fit(const AtmosphereQuery &reference)
+{
+    if(!reference.isValid())
+        return false;
+
+    std::vector<float> x, y, z;
+    stratifiedHemisphere(STRATA, x, y, z);
+
+    const unsigned int count = static_cast<unsigned int>(x.size());
+    std::vector<float> r(count), g(count), b(count);
+
+    float *data = reinterpret_cast<float*>(m_table->data());
+
+    for(unsigned int i = 0; i < TABLE_SIZE; ++i)
+    {
+        const float e = elevation(static_cast<float>(i));
+        const osg::Vec3f sun(cosf(e), 0.f, sinf(e));
+
+        reference.inscatter(count, &x[0], &y[0], &z[0], sun, &r[0], &g[0], &b[0]);
+
+        const osg::Vec3f zenith(data[i * 3 + 0], data[i * 3 + 1], data[i * 3 + 2]);
+
+        // least squares gain per channel: sum(p * b) / sum(p * p)
+
+        double pb[3] = { 0.0, 0.0, 0.0 };
+        double pp[3] = { 0.0, 0.0, 0.0 };
+
+        for(unsigned int j = 0; j < count; ++j)
+        {
+            const osg::Vec3f p = radiance(osg::Vec3f(x[j], y[j], z[j]), sun, zenith);
+
+            pb[0] += p[0] * r[j];
+            pb[1] += p[1] * g[j];
+            pb[2] += p[2] * b[j];
+
+            pp[0] += p[0] * p[0];
+            pp[1] += p[1] * p[1];
+            pp[2] += p[2] * p[2];
+        }
+
+        float *gain = data + (TABLE_SIZE + i) * 3;
+
+        for(int c = 0; c < 3; ++c)
+            gain[c] = pp[c] > 0.0 ? static_cast<float>(pb[c] / pp[c]) : 0.f;
+    }
+    m_table->dirty();
+
+    m_fitted = true;
+    return true;
+}
+
+
+const AnalyticSky::t_errorReport AnalyticSky::errorReport(const AtmosphereQuery &reference) const
+{
+    t_errorReport report;
+
+    report.maxRmsError = 0.f;
+    report.avgRmsError = 0.f;
+
+    if(!reference.isValid())
+        return report;
+
+    std::vector<float> x, y, z;
+    stratifiedHemisphere(STRATA, x, y, z);
+
+    const unsigned int count = static_cast<unsigned int>(x.size());
+    std::vector<float> r(count), g(count), b(count);
+
+    for(unsigned int i = 0; i < TABLE_SIZE - 1; ++i)
+    {
+        const float e = elevation(i + 0.5f);
+        const osg::Vec3f sun(cosf(e), 0.f, sinf(e));
+
+        reference.inscatter(count, &x[0], &y[0], &z[0], sun, &r[0], &g[0], &b[0]);
+
+        double error = 0.0;
+        double norm  = 0.0;
+
+        for(unsigned int j = 0; j < count; ++j)
+        {
+            const osg::Vec3f ref(r[j], g[j], b[j]);
+            const osg::Vec3f d = radiance(osg::Vec3f(x[j], y[j], z[j]), sun) - ref;
+
+            error += d * d;
+            norm  += ref * ref;
+        }
+
+        const float rms = norm > 0.0 ? static_cast<float>(sqrt(error / norm)) : 0.f;
+        report.rmsError.push_back(rms);
+
+        report.maxRmsError = _ma(report.maxRmsError, rms);
+        report.avgRmsError += rms / (TABLE_SIZE - 1);
+
+        OSG_INFO << "Analytic sky at " << _deg(e) << " deg sun elevation: " << rms * 100.f << " % rms error" << std::endl;
+    }
+
+    OSG_NOTICE << "Analytic sky (turbidity " << m_turbidity << (m_fitted ? ", fitted" : "") << ") vs. reference: " 
+        << report.avgRmsError * 100.f << " % avg, " << report.maxRmsError * 100.f << " % max rms error" << std::endl;
+
+    return report;
+}
+
+} // namespace osgHimmel
\ No newline at end of file
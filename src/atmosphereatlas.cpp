@@ -0,0 +1,650 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "atmosphereatlas.h"
+
+#include "atmosphereprecompute.h"
+#include "parallelfor.h"
+#include "mathmacros.h"
+
+#include <osg/Image>
+#include <osg/Notify>
+#include <osg/Timer>
+
+#include <fstream>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    const char ATLAS_MAGIC[8] = { 'O', 'S', 'G', 'H', 'A', 'T', 'L', 'S' };
+    const unsigned int ATLAS_VERSION(1);
+    const unsigned int ATLAS_ENDIAN (0x01020304);
+
+    const unsigned int MAX_BLEND_SOURCES(8);
+
+    // Upper bound of samples per axis accepted by load. It rejects corrupt 
+    // headers before allocating, and far exceeds practical grids (an entry 
+    // takes approx. 8.5 MiB).
+    const unsigned int MAX_SAMPLES(64);
+
+
+    // Strictly ascending, as required by interval (also rejects nans).
+    const bool isAscending(const std::vector<float> &samples)
+    {
+        for(unsigned int i = 1; i < samples.size(); ++i)
+            if(!(samples[i - 1] < samples[i]))
+                return false;
+
+        return true;
+    }
+
+
+    class BlendKernel : public ParallelFor::Kernel
+    {
+    public:
+        BlendKernel(float *dest)
+        :   m_dest(dest)
+        ,   m_numSources(0)
+        {
+        }
+
+        void addSource(
+            const t_half *source
+        ,   const float weight)
+        {
+            assert(m_numSources < MAX_BLEND_SOURCES);
+
+            m_sources[m_numSources] = source;
+            m_weights[m_numSources] = weight;
+            ++m_numSources;
+        }
+
+        virtual void operator()(
+            const int begin
+        ,   const int end)
+        {
+            // decode blocks of halfs that stay in the cache while accumulating
+
+            static const int BLOCK = 1024;
+            float block[BLOCK];
+
+            for(int b = begin; b < end; b += BLOCK)
+            {
+                const int n = _mi(BLOCK, end - b);
+                float *dest = m_dest + b;
+
+                memset(dest, 0, n * sizeof(float));
+
+                for(unsigned int s = 0; s < m_numSources; ++s)
+                {
+                    HalfFloat::toFloat(m_sources[s] + b, block, n);
+
+                    const float w = m_weights[s];
+                    for(int i = 0; i < n; ++i)
+                        dest[i] += w * block[i];
+                }
+            }
+        }
+
+    protected:
+        float *m_dest;
+
+        const t_half *m_sources[MAX_BLEND_SOURCES];
+        float m_weights[MAX_BLEND_SOURCES];
+        unsigned int m_numSources;
+    };
+
+
+    osg::Image *tableImage(
+        AtmospherePrecompute &precompute
+    ,   const AtmosphereAtlas::e_Table table)
+    {
+        switch(table)
+        {
+        case AtmosphereAtlas::T_Transmittance:
+            return precompute.getTransmittanceImage();
+        case AtmosphereAtlas::T_Irradiance:
+            return precompute.getIrradianceImage();
+        case AtmosphereAtlas::T_Inscatter:
+        default:
+            return precompute.getInscatterImage();
+        }
+    }
+}
+
+
+AtmosphereAtlas::AtmosphereAtlas()
+:   m_precompute(new AtmospherePrecompute)
+{
+    const float defaultS = m_precompute->getModelConfig().betaMSca[0];
+    const float defaultH = m_precompute->getModelConfig().HM;
+    const float defaultG = m_precompute->getModelConfig().mieG;
+
+    // clear, hazy and polluted skies around the default model
+
+    std::vector<float> samples;
+
+    samples.push_back(defaultS * 0.25f);
+    samples.push_back(defaultS);
+    samples.push_back(defaultS * 2.5f);
+    m_samples[0] = samples;
+
+    samples.clear();
+    samples.push_back(defaultH * 0.2f);
+    samples.push_back(defaultH);
+    m_samples[1] = samples;
+
+    samples.clear();
+    samples.push_back(defaultG);
+    m_samples[2] = samples;
+}
+
+
+AtmosphereAtlas::~AtmosphereAtlas()
+{
+}
+
+
+void AtmosphereAtlas::setScatteringMieSamples(const std::vector<float> &samples)
+{
+    setSamples(0, samples);
+}
+
+void AtmosphereAtlas::setThicknessMieSamples(const std::vector<float> &samples)
+{
+    setSamples(1, samples);
+}
+
+void AtmosphereAtlas::setPhaseGSamples(const std::vector<float> &samples)
+{
+    setSamples(2, samples);
+}
+
+
+void AtmosphereAtlas::setSamples(
+    const int axis
+,   const std::vector<float> &samples)
+{
+    assert(!samples.empty());
+    assert(isAscending(samples));
+
+    m_samples[axis] = samples;
+    m_entries.clear();
+}
+
+
+const unsigned int AtmosphereAtlas::numEntries() const
+{
+    return m_samples[0].size() * m_samples[1].size() * m_samples[2].size();
+}
+
+
+const bool AtmosphereAtlas::isComplete() const
+{
+    return !m_entries.empty() && m_entries.size() == numEntries();
+}
+
+
+const unsigned int AtmosphereAtlas::entryIndex(
+    const unsigned int s
+,   const unsigned int h
+,   const unsigned int g) const
+{
+    return (s * m_samples[1].size() + h) * m_samples[2].size() + g;
+}
+
+
+const unsigned int AtmosphereAtlas::tableSize(const e_Table table) const
+{
+    return tableSize(*m_precompute, table);
+}
+
+const unsigned int AtmosphereAtlas::tableSize(
+    const AtmospherePrecompute &precompute
+,   const e_Table table)
+{
+    // same as the float images of AtmospherePrecompute::prepareTables
+
+    const AtmospherePrecompute::t_preTexCfg &tc(precompute.getTextureConfig());
+
+    switch(table)
+    {
+    case T_Transmittance:
+        return tc.transmittanceWidth * tc.transmittanceHeight * 3;
+    case T_Irradiance:
+        return tc.skyWidth * tc.skyHeight * 3;
+    case T_Inscatter:
+    default:
+        return tc.resMuS * tc.resNu * tc.resMu * tc.resR * 4;
+    }
+}
+
+
+void AtmosphereAtlas::setModel(
+    AtmospherePrecompute &precompute
+,   const float scatteringMie
+,   const float thicknessMie
+,   const float g) const
+{
+    // same as AtmosphereGeode::setScatteringMie, setThicknessMie, and setPhaseG
+
+    precompute.getModelConfig().betaMSca = osg::Vec3f(1.f, 1.f, 1.f) * scatteringMie;
+    precompute.getModelConfig().betaMEx  = precompute.getModelConfig().betaMSca / 0.9f;
+    precompute.getModelConfig().HM   = thicknessMie;
+    precompute.getModelConfig().mieG = g;
+}
+
+
+const bool AtmosphereAtlas::compute()
+{
+    m_entries.clear();
+    m_entries.resize(numEntries());
+
+    m_precompute->setTableStorage(AtmospherePrecompute::TS_Float);
+
+    osg::Timer_t t = osg::Timer::instance()->tick();
+
+    for(unsigned int s = 0; s < m_samples[0].size(); ++s)
+    for(unsigned int h = 0; h < m_samples[1].size(); ++h)
+    for(unsigned int g = 0; g < m_samples[2].size(); ++g)
+    {
+        setModel(*m_precompute, m_samples[0][s], m_samples[1][h], m_samples[2][g]);
+
+        m_precompute->dirty();
+        if(!m_precompute->compute())
+        {
+            m_entries.clear();
+            return false;
+        }
+
+        t_entry &entry(m_entries[entryIndex(s, h, g)]);
+
+        for(int i = 0; i < T_NumTables; ++i)
+        {
+            const osg::Image *image = tableImage(*m_precompute, static_cast<e_Table>(i));
+            const unsigned int size = tableSize(static_cast<e_Table>(i));
+
+            entry.tables[i].resize(size);
+            HalfFloat::toHalf(reinterpret_cast<const float*>(image->data()), &entry.tables[i][0], size);
+        }
+    }
+
+    OSG_NOTICE << "Atmosphere Atlas with " << numEntries() << " entries precomputed (took " 
+        << osg::Timer::instance()->delta_s(t,  osg::Timer::instance()->tick()) << " s)" << std::endl;
+
+    return true;
+}
+
+
+const bool AtmosphereAtlas::save(const std::string &filePath) const
+{
+    if(!isComplete())
+        return false;
+
+    std::ofstream out(filePath.c_str(), std::ios::binary);
+    if(!out.good())
+        return false;
+
+    out.write(ATLAS_MAGIC, sizeof(ATLAS_MAGIC));
+    out.write(reinterpret_cast<const char*>(&ATLAS_VERSION), sizeof(unsigned int));
+    out.write(reinterpret_cast<const char*>(&ATLAS_ENDIAN), sizeof(unsigned int));
+
+    for(int a = 0; a < 3; ++a)
+    {
+        const unsigned int n = m_samples[a].size();
+
+        out.write(reinterpret_cast<const char*>(&n), sizeof(unsigned int));
+        out.write(reinterpret_cast<const char*>(&m_samples[a][0]), n * sizeof(float));
+    }
+
+    for(int i = 0; i < T_NumTables; ++i)
+    {
+        const unsigned int size = m_entries[0].tables[i].size();
+        out.write(reinterpret_cast<const char*>(&size), sizeof(unsigned int));
+    }
+
+    for(unsigned int e = 0; e < m_entries.size(); ++e)
+        for(int i = 0; i < T_NumTables; ++i)
+            out.write(reinterpret_cast<const char*>(&m_entries[e].tables[i][0])
+                , m_entries[e].tables[i].size() * sizeof(t_half));
+
+    return out.good();
+}
+
+
+const bool AtmosphereAtlas::load(const std::string &filePath)
+{
+    std::ifstream in(filePath.c_str(), std::ios::binary);
+    if(!in.good())
+        return false;
+
+    char magic[sizeof(ATLAS_MAGIC)];
+    unsigned int version(0);
+    unsigned int endian(0);
+
+    in.read(magic, sizeof(ATLAS_MAGIC));
+    in.read(reinterpret_cast<char*>(&version), sizeof(unsigned int));
+    in.read(reinterpret_cast<char*>(&endian), sizeof(unsigned int));
+
+    if(!in.good() || memcmp(magic, ATLAS_MAGIC, sizeof(ATLAS_MAGIC)) != 0 
+        || version != ATLAS_VERSION || endian != ATLAS_ENDIAN)
+    {
+        OSG_WARN << "Atmosphere Atlas " << filePath << " has an unsupported format." << std::endl;
+        return false;
+    }
+
+    std::vector<float> samples[3];
+
+    for(int a = 0; a < 3; ++a)
+    {
+        unsigned int n(0);
+        in.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
+
+        if(!in.good() || n == 0 || n > MAX_SAMPLES)
+        {
+            OSG_WARN << "Atmosphere Atlas " << filePath << " has " << n << " samples (1 to " 
+                << MAX_SAMPLES << " are supported)." << std::endl;
+            return false;
+        }
+
+        samples[a].resize(n);
+        in.read(reinterpret_cast<char*>(&samples[a][0]), n * sizeof(float));
+
+        if(!in.good() || !isAscending(samples[a]))
+        {
+            OSG_WARN << "Atmosphere Atlas " << filePath << " has samples not in ascending order." << std::endl;
+            return false;
+        }
+    }
+
+    for(int i = 0; i < T_NumTables; ++i)
+    {
+        unsigned int size(0);
+        in.read(reinterpret_cast<char*>(&size), sizeof(unsigned int));
+
+        if(!in.good() || size != tableSize(static_cast<e_Table>(i)))
+        {
+            OSG_WARN << "Atmosphere Atlas " << filePath << " does not match the texture config." << std::endl;
+            return false;
+        }
+    }
+
+    // read into temporaries, so that a truncated file keeps the atlas
+
+    std::vector<t_entry> entries(samples[0].size() * samples[1].size() * samples[2].size());
+
+    for(unsigned int e = 0; e < entries.size(); ++e)
+        for(int i = 0; i < T_NumTables; ++i)
+        {
+            t_table &table(entries[e].tables[i]);
+
+            table.resize(tableSize(static_cast<e_Table>(i)));
+            in.read(reinterpret_cast<char*>(&table[0]), table.size() * sizeof(t_half));
+        }
+
+    if(!in.good())
+    {
+        OSG_WARN << "Atmosphere Atlas " << filePath << " is truncated." << std::endl;
+        return false;
+    }
+
+    for(int a = 0; a < 3; ++a)
+        m_samples[a] = samples[a];
+
+    m_entries.swap(entries);
+    return true;
+}
+
+
+void AtmosphereAtlas::interval(
+    const std::vector<float> &samples
+,   const float value
+,   unsigned int &index
+,   float &weight)
+{
+    assert(!samples.empty());
+
+    index = 0;
+    weight = 0.f;
+
+    if(samples.size() == 1 || value <= samples.front())
+        return;
+
+    if(value >= samples.back())
+    {
+        index = samples.size() - 2;
+        weight = 1.f;
+        return;
+    }
+
+    while(value > samples[index + 1])
+        ++index;
+
+    weight = (value - samples[index]) / (samples[index + 1] - samples[index]);
+}
+
+
+void AtmosphereAtlas::blendTables(
+    float *dest[T_NumTables]
+,   const float scatteringMie
+,   const float thicknessMie
+,   const float g) const
+{
+    assert(isComplete());
+
+    const float values[3] = { scatteringMie, thicknessMie, g };
+
+    unsigned int index[3];
+    float weight[3];
+
+    for(int a = 0; a < 3; ++a)
+        interval(m_samples[a], values[a], index[a], weight[a]);
+
+    for(int i = 0; i < T_NumTables; ++i)
+    {
+        BlendKernel kernel(dest[i]);
+
+        // up to 8 corners of the enclosing grid cell
+
+        for(int c = 0; c < 8; ++c)
+        {
+            float w = 1.f;
+            unsigned int corner[3];
+
+            for(int a = 0; a < 3; ++a)
+            {
+                const bool upper = (c >> a) & 1;
+
+                w *= upper ? weight[a] : 1.f - weight[a];
+                corner[a] = index[a] + (upper ? 1 : 0);
+            }
+            if(w <= 0.f)
+                continue;
+
+            const t_entry &entry(m_entries[entryIndex(corner[0], corner[1], corner[2])]);
+            kernel.addSource(&entry.tables[i][0], w);
+        }
+
+        ParallelFor::run(static_cast<int>(m_entries[0].tables[i].size()), kernel, 4096);
+    }
+}
+
+
+const bool AtmosphereAtlas::blend(
+    AtmospherePrecompute &target
+,   const float scatteringMie
+,   const float thicknessMie
+,   const float g) const
+{
+    if(!isComplete())
+        return false;
+
+    // Check all tables before the update reallocates the targets images.
+
+    for(int i = 0; i < T_NumTables; ++i)
+    {
+        if(tableSize(target, static_cast<e_Table>(i)) != m_entries[0].tables[i].size())
+        {
+            OSG_WARN << "Atmosphere Atlas does not match the targets texture config." << std::endl;
+            return false;
+        }
+    }
+
+    target.beginTableUpdate();
+
+    float *dest[T_NumTables];
+
+    for(int i = 0; i < T_NumTables; ++i)
+    {
+        osg::Image *image = tableImage(target, static_cast<e_Table>(i));
+
+        assert(image->s() * image->t() * image->r() * osg::Image::computeNumComponents(image->getPixelFormat()) 
+            == m_entries[0].tables[i].size());
+
+        dest[i] = reinterpret_cast<float*>(image->data());
+    }
+
+    const float s = _clamp(m_samples[0].front(), m_samples[0].back(), scatteringMie);
+    const float h = _clamp(m_samples[1].front(), m_samples[1].back(), thicknessMie);
+    const float p = _clamp(m_samples[2].front(), m_samples[2].back(), g);
+
+    blendTables(dest, s, h, p);
+    setModel(target, s, h, p);
+
+    target.endTableUpdate();
+
+    return true;
+}
+
+
+const AtmosphereAtlas::t_errorReport AtmosphereAtlas::errorReport(
+    const float scatteringMie
+,   const float thicknessMie
+,   const float g)
+{
+    t_errorReport report;
+    memset(&report, 0, sizeof(t_errorReport));
+
+    if(!isComplete())
+        return report;
+
+    std::vector<float> blended[T_NumTables];
+    float *dest[T_NumTables];
+
+    for(int i = 0; i < T_NumTables; ++i)
+    {
+        blended[i].resize(tableSize(static_cast<e_Table>(i)));
+        dest[i] = &blended[i][0];
+    }
+    blendTables(dest, scatteringMie, thicknessMie, g);
+
+    setModel(*m_precompute, scatteringMie, thicknessMie, g);
+
+    m_precompute->dirty();
+    if(!m_precompute->compute())
+        return report;
+
+    for(int i = 0; i < T_NumTables; ++i)
+    {
+        const osg::Image *image = tableImage(*m_precompute, static_cast<e_Table>(i));
+        const float *exact = reinterpret_cast<const float*>(image->data());
+
+        const unsigned int size = blended[i].size();
+
+        double maxValue(0.0), maxError(0.0);
+        double sumValues(0.0), sumErrors(0.0);
+
+        for(unsigned int j = 0; j < size; ++j)
+        {
+            const double e = fabs(blended[i][j] - exact[j]);
+
+            maxValue  = _ma(maxValue, fabs(exact[j]));
+            maxError  = _ma(maxError, e);
+            sumValues += exact[j] * exact[j];
+            sumErrors += e * e;
+        }
+
+        report.maxError[i] = maxValue  > 0.0 ? static_cast<float>(maxError / maxValue) : 0.f;
+        report.rmsError[i] = sumValues > 0.0 ? static_cast<float>(sqrt(sumErrors / sumValues)) : 0.f;
+    }
+    return report;
+}
+
+
+const AtmosphereAtlas::t_errorReport AtmosphereAtlas::errorReport()
+{
+    t_errorReport worst;
+    memset(&worst, 0, sizeof(t_errorReport));
+
+    if(!isComplete())
+        return worst;
+
+    // centers of the grid cells for each axis
+
+    std::vector<float> centers[3];
+
+    for(int a = 0; a < 3; ++a)
+    {
+        if(m_samples[a].size() == 1)
+            centers[a].push_back(m_samples[a][0]);
+
+        for(unsigned int i = 1; i < m_samples[a].size(); ++i)
+            centers[a].push_back((m_samples[a][i - 1] + m_samples[a][i]) * 0.5f);
+    }
+
+    static const char *names[T_NumTables] = { "transmittance", "irradiance", "inscatter" };
+
+    for(unsigned int s = 0; s < centers[0].size(); ++s)
+    for(unsigned int h = 0; h < centers[1].size(); ++h)
+    for(unsigned int g = 0; g < centers[2].size(); ++g)
+    {
+        const t_errorReport report = errorReport(centers[0][s], centers[1][h], centers[2][g]);
+
+        OSG_NOTICE << "Atmosphere Atlas error at betaMSca " << centers[0][s] 
+            << ", HM " << centers[1][h] << ", mieG " << centers[2][g] << ":" << std::endl;
+
+        for(int i = 0; i < T_NumTables; ++i)
+        {
+            OSG_NOTICE << "  " << names[i] << " max " << report.maxError[i] * 100.f 
+                << " %, rms " << report.rmsError[i] * 100.f << " %" << std::endl;
+
+            worst.maxError[i] = _ma(worst.maxError[i], report.maxError[i]);
+            worst.rmsError[i] = _ma(worst.rmsError[i], report.rmsError[i]);
+        }
+    }
+    return worst;
+}
+
+} // namespace osgHimmel
@@ -33,6 +33,8 @@
 #include "himmelquad.h"
 #include "abstractastronomy.h"
 #include "atmosphereprecompute.h"
+#include "atmosphereatlas.h"
+#include "analyticsky.h"
 
 #include "shaderfragment/common.h"
 #include "shaderfragment/bruneton_common.h"
@@ -51,10 +53,12 @@
 namespace osgHimmel
 {
 
-AtmosphereGeode::AtmosphereGeode()
+AtmosphereGeode::AtmosphereGeode(const e_SkyModel model)
 :   osg::Geode()
 
+,   m_model(model)
 ,   m_precompute(NULL)
+,   m_analytic(NULL)
 
 ,   m_program(new osg::Program)
 ,   m_vShader(new osg::Shader(osg::Shader::VERTEX))
@@ -69,6 +73,7 @@ AtmosphereGeode::AtmosphereGeode()
 ,   u_sunScale(NULL)
 ,   u_lheurebleue(NULL)
 ,   u_exposure(NULL)
+,   u_mieG(NULL)
 {
     setName("Atmosphere");
 
@@ -77,6 +82,7 @@ AtmosphereGeode::AtmosphereGeode()
     osg::StateSet* stateSet = getOrCreateStateSet();
 
     m_precompute = new AtmospherePrecompute();
+    m_analytic = new AnalyticSky();
 
     setupNode(stateSet);
     setupUniforms(stateSet);
@@ -128,7 +134,7 @@ void AtmosphereGeode::setupShader(osg::StateSet* stateSet)
 
 void AtmosphereGeode::updateShader(osg::StateSet*)
 {
-    std::string fSource(getFragmentShaderSource());
+    std::string fSource(m_model == SM_Analytic ? getAnalyticFragmentShaderSource() : getFragmentShaderSource());
     m_precompute->substituteMacros(fSource);
 
     m_fShader->setShaderSource(fSource);
@@ -147,7 +153,11 @@ void AtmosphereGeode::setupUniforms(osg::StateSet* stateSet)
 
     u_lheurebleue = new osg::Uniform("lheurebleue", osg::Vec4f(hb[0], hb[1], hb[2], defaultLHeureBleueIntensity()));
     stateSet->addUniform(u_lheurebleue);
-    
+
+    u_mieG = new osg::Uniform("mieG", m_precompute->getModelConfig().mieG);
+    stateSet->addUniform(u_mieG);
+
+    stateSet->addUniform(m_analytic->getPerezUniform());
 }
 
 
@@ -167,11 +177,17 @@ void AtmosphereGeode::setupTextures(osg::StateSet* stateSet)
     stateSet->addUniform(new osg::Uniform("transmittanceSampler", 0));
     stateSet->addUniform(new osg::Uniform("irradianceSampler", 1));
     stateSet->addUniform(new osg::Uniform("inscatterSampler", 2));
+
+    stateSet->setTextureAttributeAndModes(3, m_analytic->getTableTexture());
+    stateSet->addUniform(new osg::Uniform("analyticSampler", 3));
 }
 
 
 void AtmosphereGeode::precompute()
 {   
+    if(m_model != SM_Precomputed)
+        return;
+
     if(m_precompute->compute())
         updateShader(getOrCreateStateSet());
 }
@@ -305,6 +321,55 @@ void AtmosphereGeode::setPhaseG(const float g)
 {
     m_precompute->getModelConfig().mieG = g;
     m_precompute->dirty();
+
+    u_mieG->set(g);
+}
+
+void AtmosphereGeode::setMaxScatteringOrder(const int order)
+{
+    m_precompute->setMaxScatteringOrder(order);
+}
+
+void AtmosphereGeode::setScatteringOrderThreshold(const float threshold)
+{
+    m_precompute->setScatteringOrderThreshold(threshold);
+}
+
+void AtmosphereGeode::setSkyModel(const e_SkyModel model)
+{
+    if(model == m_model)
+        return;
+
+    m_model = model;
+
+    updateShader(getOrCreateStateSet());
+    precompute();
+}
+
+
+const float AtmosphereGeode::setTurbidity(const float turbidity)
+{
+    return m_analytic->setTurbidity(turbidity);
+}
+
+const float AtmosphereGeode::getTurbidity() const
+{
+    return m_analytic->getTurbidity();
+}
+
+
+const bool AtmosphereGeode::blendFromAtlas(
+    const AtmosphereAtlas &atlas
+,   const float scatteringMie
+,   const float thicknessMie
+,   const float g)
+{
+    if(!atlas.blend(*m_precompute, scatteringMie, thicknessMie, g))
+        return false;
+
+    // (blend clamps the parameters to the atlas)
+    u_mieG->set(m_precompute->getModelConfig().mieG);
+    return true;
 }
 
 
@@ -345,9 +410,14 @@ const std::string AtmosphereGeode::getFragmentShaderSource()
 
     +   glsl_bruneton_const_RSize()
     +   glsl_bruneton_const_R()
-    +   glsl_bruneton_const_M()
     +   glsl_bruneton_const_PI()
 
+    +   "const float HM      = %HM%;\n"
+        "const vec3 betaMSca = %betaMSca%;\n"
+        "const vec3 betaMEx  = %betaMEx%;\n"
+        "uniform float mieG;\n" // uniform, since atlas blending changes it without shader update
+        "\n"
+
 
     +   "in vec4 m_ray;\n"
         "\n"
@@ -554,6 +624,105 @@ const std::string AtmosphereGeode::getFragmentShaderSource()
 
 
 
+const std::string AtmosphereGeode::getAnalyticFragmentShaderSource()
+{
+    return glsl_version_150()
+
+    +   glsl_cmn_uniform()
+    +   
+        "uniform vec3 sun;\n"
+        "uniform vec3 sunr;\n"
+
+    +   glsl_pseudo_rand()
+    +   glsl_dither()
+
+    +   glsl_bruneton_const_R()
+
+    +   "const float HM      = %HM%;\n"
+        "const vec3 betaMEx  = %betaMEx%;\n"
+        "\n"
+
+    +   "in vec4 m_ray;\n"
+        "\n"
+        "const float ISun = 100.0;\n"
+        "\n"
+        "const float MIN_ELEVATION = -0.17453292;\n" // -10 deg, see AnalyticSky
+        "const float MAX_ELEVATION =  1.57079633;\n"
+        "\n"
+        "uniform float sunScale;\n"
+        "uniform float exposure;\n"
+        "\n"
+        "uniform vec4 lheurebleue;\n" // rgb and w for instensity
+        "\n"
+        "uniform vec3 perez[5];\n"             // A to E for Y, x, and y
+        "uniform sampler2D analyticSampler;\n" // zenith values and gains by sun elevation
+        "\n"
+
+    +   glsl_bruneton_opticalDepth()
+    +   glsl_bruneton_analyticTransmittance()
+    +   glsl_bruneton_hdr()
+
+    +
+        "vec3 perezF(float cosTheta, float gamma) {\n"
+        "    float cosGamma = cos(gamma);\n"
+        "    return (1.0 + perez[0] * exp(perez[1] / cosTheta))\n"
+        "        * (1.0 + perez[2] * exp(perez[3] * gamma) + perez[4] * cosGamma * cosGamma);\n"
+        "}\n"
+        "\n"
+
+        // Preetham's sky for view ray v and sun s, as in AnalyticSky::radiance
+        "vec3 analytic(vec3 v, vec3 s) {\n"
+        "    float e = asin(clamp(s.z, -1.0, 1.0));\n"
+        "    float N = float(textureSize(analyticSampler, 0).x);\n"
+        "    float u = (0.5 + clamp((e - MIN_ELEVATION) / (MAX_ELEVATION - MIN_ELEVATION), 0.0, 1.0) * (N - 1.0)) / N;\n"
+        "    vec3 zenith = texture(analyticSampler, vec2(u, 0.25)).rgb;\n"
+        "    vec3 gain   = texture(analyticSampler, vec2(u, 0.75)).rgb;\n"
+        "\n"
+            // rays below the horizon get the horizon's color, the sun is kept above
+        "    v = normalize(vec3(v.xy, max(v.z, 0.01)));\n"
+        "    float sz = max(s.z, 0.0);\n"
+        "    s = vec3(s.xy * sqrt(1.0 - sz * sz) / max(length(s.xy), 1e-6), sz);\n"
+        "\n"
+        "    vec3 Yxy = zenith * perezF(v.z, acos(clamp(dot(v, s), -1.0, 1.0)));\n"
+        "    vec3 XYZ = vec3(Yxy.y / Yxy.z * Yxy.x, Yxy.x, (1.0 - Yxy.y - Yxy.z) / Yxy.z * Yxy.x);\n"
+        "\n"
+        "    vec3 rgb = mat3(3.2406, -0.9689, 0.0557, -1.5372, 1.8758, -0.2040, -0.4986, 0.0415, 1.0570) * XYZ;\n"
+        "    return max(rgb, 0.0) * gain;\n"
+        "}\n"
+        "\n"
+
+        // direct sun light using analytic transmittance up to the top of the atmosphere
+        "vec3 sunColor(float r, float mu, float t, vec3 v, vec3 s) {\n"
+        "    if (t > 0.0) {\n"
+        "        return vec3(0.0);\n"
+        "    }\n"
+        "    float d = -r * mu + sqrt(r * r * (mu * mu - 1.0) + cmn[2] * cmn[2]);\n"
+        "    float isun = step(cos(sunScale), dot(v, s)) * ISun;\n"
+        "    return analyticTransmittance(r, mu, d) * isun;\n"
+        "}\n"
+        "\n"
+
+        "void main() {\n"
+        "    vec3 ray = normalize(m_ray.xyz);\n"
+        "\n"
+        "    float r = cmn[1] + cmn[0];\n"
+        "    float mu = ray.z;\n"
+        "    float t = -r * mu - sqrt(r * r * (mu * mu - 1.0) + cmn[1] * cmn[1]);\n"
+        "\n"
+        "    vec3 skyColor = analytic(ray, sunr);\n"
+        "    vec3 sunColor = sunColor(r, mu, t, ray, sunr);\n"
+        "\n"
+        "    float hb = t > 0.0 ? 0.0 : exp(-pow(sunr.z, 2.0) * 166) + 0.03;\n"
+        "    vec3 bluehour = lheurebleue.w * lheurebleue.rgb * (dot(ray, sunr) + 1.5) * hb;\n"
+        "\n"
+        "    gl_FragColor = vec4(HDR(bluehour + sunColor + skyColor), 1.0)\n"
+        "        + dither(3, int(cmn[3]));\n"
+        "}";
+}
+
+
+
+
 #ifdef OSGHIMMEL_EXPOSE_SHADERS
 
 osg::Shader *AtmosphereGeode::getVertexShader()
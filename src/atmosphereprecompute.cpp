@@ -42,6 +42,8 @@
 #include "himmel.h"
 #include "earth.h"
 #include "strutils.h"
+#include "mathmacros.h"
+#include "halffloat.h"
 
 #include "shaderfragment/bruneton_common.h"
 #include "shaderfragment/bruneton_inscatter.h"
@@ -57,6 +59,10 @@
 #include <assert.h>
 #include <cstring>
 
+#ifndef GL_HALF_FLOAT_ARB
+#define GL_HALF_FLOAT_ARB 0x140B
+#endif
+
 
 namespace osgHimmel
 {
@@ -66,6 +72,8 @@ AtmospherePrecompute::AtmospherePrecompute()
 ,   m_irradianceImage(new osg::Image)
 ,   m_inscatterImage(new osg::Image)
 ,   m_dirty(true)
+,   m_lastScatteringOrder(0)
+,   m_tableStorage(TS_Float)
 {
     m_preTexCfg.transmittanceWidth  = 256;
     m_preTexCfg.transmittanceHeight =  64;
@@ -83,6 +91,9 @@ AtmospherePrecompute::AtmospherePrecompute()
     m_preTexCfg.irradianceIntegralSamples         =  32;
     m_preTexCfg.inscatterSphericalIntegralSamples =  16;
 
+    m_preTexCfg.maxScatteringOrder       = defaultMaxScatteringOrder();
+    m_preTexCfg.scatteringOrderThreshold = defaultScatteringOrderThreshold();
+
     m_modelCfg.avgGroundReflectance = 0.1f;
 
     m_modelCfg.HR = 8.f;
@@ -135,6 +146,200 @@ void AtmospherePrecompute::dirty()
 }
 
 
+const int AtmospherePrecompute::setMaxScatteringOrder(const int order)
+{
+    m_preTexCfg.maxScatteringOrder = _ma(1, order);
+    dirty();
+
+    return getMaxScatteringOrder();
+}
+
+const int AtmospherePrecompute::getMaxScatteringOrder() const
+{
+    return m_preTexCfg.maxScatteringOrder;
+}
+
+const int AtmospherePrecompute::defaultMaxScatteringOrder()
+{
+    return 4;
+}
+
+
+const float AtmospherePrecompute::setScatteringOrderThreshold(const float threshold)
+{
+    m_preTexCfg.scatteringOrderThreshold = _ma(0.f, threshold);
+    dirty();
+
+    return getScatteringOrderThreshold();
+}
+
+const float AtmospherePrecompute::getScatteringOrderThreshold() const
+{
+    return m_preTexCfg.scatteringOrderThreshold;
+}
+
+const float AtmospherePrecompute::defaultScatteringOrderThreshold()
+{
+    return 0.f;
+}
+
+
+void AtmospherePrecompute::setTableStorage(const e_TableStorage storage)
+{
+    if(storage == m_tableStorage)
+        return;
+
+    const bool packNow = !m_dirty && storage == TS_Half && m_tableStorage == TS_Float;
+    m_tableStorage = storage;
+
+    if(packNow)
+        storeTables();
+    else
+        dirty();
+}
+
+
+const unsigned int AtmospherePrecompute::getTableMemoryUsage() const
+{
+    unsigned int size = 0;
+
+    if(m_transmittanceImage.valid())
+        size += m_transmittanceImage->getTotalSizeInBytes();
+    if(m_irradianceImage.valid())
+        size += m_irradianceImage->getTotalSizeInBytes();
+    if(m_inscatterImage.valid())
+        size += m_inscatterImage->getTotalSizeInBytes();
+
+    return size;
+}
+
+
+void AtmospherePrecompute::prepareTables()
+{
+    const t_preTexCfg &tc(getTextureConfig());
+
+    if(!m_transmittanceImage.valid())
+        m_transmittanceImage = new osg::Image;
+    if(!m_irradianceImage.valid())
+        m_irradianceImage = new osg::Image;
+    if(!m_inscatterImage.valid())
+        m_inscatterImage = new osg::Image;
+
+    if(!m_transmittanceImage->data() || m_transmittanceImage->getDataType() != GL_FLOAT)
+    {
+        m_transmittanceImage->setInternalTextureFormat(GL_RGB16F_ARB);
+        m_transmittanceImage->allocateImage(tc.transmittanceWidth, tc.transmittanceHeight, 1, GL_RGB, GL_FLOAT);
+    }
+    if(!m_irradianceImage->data() || m_irradianceImage->getDataType() != GL_FLOAT)
+    {
+        m_irradianceImage->setInternalTextureFormat(GL_RGB16F_ARB);
+        m_irradianceImage->allocateImage(tc.skyWidth, tc.skyHeight, 1, GL_RGB, GL_FLOAT);
+    }
+    if(!m_inscatterImage->data() || m_inscatterImage->getDataType() != GL_FLOAT)
+    {
+        m_inscatterImage->setInternalTextureFormat(GL_RGBA16F_ARB);
+        m_inscatterImage->allocateImage(tc.resMuS * tc.resNu, tc.resMu, tc.resR, GL_RGBA, GL_FLOAT);
+    }
+
+    m_transmittanceTexture->setImage(m_transmittanceImage);
+    m_irradianceTexture->setImage(m_irradianceImage);
+    m_inscatterTexture->setImage(m_inscatterImage);
+
+    m_transmittanceTexture->setUnRefImageDataAfterApply(false);
+    m_irradianceTexture->setUnRefImageDataAfterApply(false);
+    m_inscatterTexture->setUnRefImageDataAfterApply(false);
+}
+
+
+void AtmospherePrecompute::beginTableUpdate()
+{
+    prepareTables();
+}
+
+
+void AtmospherePrecompute::endTableUpdate()
+{
+    m_transmittanceImage->dirty();
+    m_irradianceImage->dirty();
+    m_inscatterImage->dirty();
+
+    m_dirty = false;
+
+    storeTables();
+}
+
+
+void AtmospherePrecompute::storeTables()
+{
+    switch(m_tableStorage)
+    {
+    case TS_Half:
+
+        packImage(m_transmittanceImage);
+        packImage(m_irradianceImage);
+        packImage(m_inscatterImage);
+        break;
+
+    case TS_Release:
+
+        // The textures hold the last reference and drop it after upload.
+
+        m_transmittanceTexture->setUnRefImageDataAfterApply(true);
+        m_irradianceTexture->setUnRefImageDataAfterApply(true);
+        m_inscatterTexture->setUnRefImageDataAfterApply(true);
+
+        m_transmittanceImage = NULL;
+        m_irradianceImage = NULL;
+        m_inscatterImage = NULL;
+        break;
+
+    case TS_Float:
+    default:
+        break;
+    }
+
+    OSG_INFO << "Atmosphere tables use " << getTableMemoryUsage() / 1024 << " KiB on the CPU" << std::endl;
+}
+
+
+void AtmospherePrecompute::packImage(osg::Image *image)
+{
+    assert(image);
+
+    if(image->getDataType() != GL_FLOAT)
+        return;
+
+    const unsigned int count = image->s() * image->t() * image->r()
+        * osg::Image::computeNumComponents(image->getPixelFormat());
+
+    t_half *data = new t_half[count];
+    HalfFloat::toHalf(reinterpret_cast<const float*>(image->data()), data, count);
+
+    // replaces (and deletes) the float data, the texture stays assigned
+    image->setImage(image->s(), image->t(), image->r()
+        , image->getInternalTextureFormat(), image->getPixelFormat(), GL_HALF_FLOAT_ARB
+        , reinterpret_cast<unsigned char*>(data), osg::Image::USE_NEW_DELETE, image->getPacking());
+}
+
+
+const double AtmospherePrecompute::energy(const osg::Image *image)
+{
+    assert(image);
+    assert(image->getDataType() == GL_FLOAT);
+
+    const int components = osg::Image::computeNumComponents(image->getPixelFormat());
+    const int size = image->s() * image->t() * image->r();
+
+    const float *data = reinterpret_cast<const float*>(image->data());
+
+    double sum(0.0);
+    for(int i = 0; i < size; ++i, data += components)
+        sum += data[0] + data[1] + data[2];
+
+    return sum;
+}
+
+
 const bool AtmospherePrecompute::compute(const bool ifDirtyOnly)
 {
     if(ifDirtyOnly && !m_dirty)
@@ -145,6 +350,8 @@ const bool AtmospherePrecompute::compute(const bool ifDirtyOnly)
 
     osg::Timer_t t = osg::Timer::instance()->tick();
 
+    prepareTables();
+
     // Setup Viewer
 
     osgViewer::CompositeViewer *viewer = new osgViewer::CompositeViewer;
@@ -225,7 +432,19 @@ const bool AtmospherePrecompute::compute(const bool ifDirtyOnly)
      
     // loop for each scattering order (line 6 in algorithm 4.1)
 
-    for(int order = 2; order <= 4; ++order)
+    // The irradiance and inscatter images are read back after each pass, so the
+    // energy an order adds can be measured without reading back deltaE and deltaS.
+
+    const int maxOrder(getTextureConfig().maxScatteringOrder);
+    const float threshold(getTextureConfig().scatteringOrderThreshold);
+
+    double E = threshold > 0.f ? energy(m_irradianceImage) : 0.0;
+    double S = threshold > 0.f ? energy(m_inscatterImage)  : 0.0;
+
+    m_lastScatteringOrder = 1;
+    const osg::Timer_t tOrders = osg::Timer::instance()->tick();
+
+    for(int order = 2; order <= maxOrder; ++order)
     {
         const float first = order == 2 ? 1.f : 0.f;
 
@@ -278,15 +497,52 @@ const bool AtmospherePrecompute::compute(const bool ifDirtyOnly)
         samplers3D[1] = m_inscatterTexture;
 
         render3D(viewer, quad, targets3D, samplers2D, samplers3D, uniforms, glsl_bruneton_f_copyInscatterN().c_str());
+
+        m_lastScatteringOrder = order;
+
+        if(threshold <= 0.f)
+            continue;
+
+        // relative energy added by deltaE and deltaS
+
+        const double E1 = energy(m_irradianceImage);
+        const double S1 = energy(m_inscatterImage);
+
+        const double dE = E1 > 0.0 ? (E1 - E) / E1 : 0.0;
+        const double dS = S1 > 0.0 ? (S1 - S) / S1 : 0.0;
+
+        E = E1;
+        S = S1;
+
+        OSG_INFO << "Atmosphere scattering order " << order 
+            << " added " << dE * 100.0 << " % irradiance and " << dS * 100.0 << " % inscatter" << std::endl;
+
+        if(_ma(dE, dS) < threshold)
+            break;
     }
 
+    const double ordersTime = osg::Timer::instance()->delta_s(tOrders, osg::Timer::instance()->tick());
+
     // Unref
 
     delete viewer;
 
+    storeTables();
+
     OSG_NOTICE << "Atmopshere Precomputed (took " 
         << osg::Timer::instance()->delta_s(t,  osg::Timer::instance()->tick()) << " s)" << std::endl;
 
+    if(m_lastScatteringOrder > 1)
+    {
+        // estimated by the average time per order
+
+        const int skipped = maxOrder - m_lastScatteringOrder;
+        const double saved = skipped * ordersTime / (m_lastScatteringOrder - 1);
+
+        OSG_NOTICE << "Atmosphere scattering orders used: " << m_lastScatteringOrder << " of " << maxOrder
+            << " (saved approx. " << saved << " s)" << std::endl;
+    }
+
     return true;
 }
 
@@ -0,0 +1,702 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "atmospherequery.h"
+
+#include "atmosphereprecompute.h"
+#include "himmel.h"
+#include "earth.h"
+#include "halffloat.h"
+#include "parallelfor.h"
+#include "mathmacros.h"
+
+#include <osg/Image>
+
+#include <algorithm>
+#include <math.h>
+#include <assert.h>
+
+#ifndef GL_HALF_FLOAT_ARB
+#define GL_HALF_FLOAT_ARB 0x140B
+#endif
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    const float ISun(100.f);
+
+    // directions per block, small enough to keep the block's 
+    // intermediates in the cache and large enough to let the compiler 
+    // vectorize the normalization loop
+    const unsigned int BLOCK(256);
+
+    // batches below this are processed on the calling thread only
+    const int PARALLEL_GRAIN(2048);
+
+
+    inline const float smoothstep(
+        const float edge0
+    ,   const float edge1
+    ,   const float x)
+    {
+        const float t = _clamp(0.f, 1.f, (x - edge0) / (edge1 - edge0));
+        return t * t * (3.f - 2.f * t);
+    }
+
+    inline const float safeRatio(
+        const float a
+    ,   const float b)
+    {
+        return b > 0.f ? _mi(a / b, 1.f) : 1.f;
+    }
+}
+
+
+class AtmosphereQuery::InscatterKernel : public ParallelFor::Kernel
+{
+public:
+    InscatterKernel(
+        const AtmosphereQuery &query
+    ,   const float *x
+    ,   const float *y
+    ,   const float *z
+    ,   const osg::Vec3f &sun
+    ,   float *r
+    ,   float *g
+    ,   float *b)
+    :   m_query(query)
+    ,   m_x(x), m_y(y), m_z(z)
+    ,   m_sun(sun)
+    ,   m_r(r), m_g(g), m_b(b)
+    {
+    }
+
+    virtual void operator()(
+        const int begin
+    ,   const int end)
+    {
+        for(int i = begin; i < end; i += BLOCK)
+        {
+            const unsigned int n = _mi(static_cast<int>(BLOCK), end - i);
+            m_query.inscatterBlock(n, m_x + i, m_y + i, m_z + i, m_sun, m_r + i, m_g + i, m_b + i);
+        }
+    }
+
+protected:
+    const AtmosphereQuery &m_query;
+
+    const float *m_x, *m_y, *m_z;
+    const osg::Vec3f m_sun;
+    float *m_r, *m_g, *m_b;
+};
+
+
+class AtmosphereQuery::TransmittanceKernel : public ParallelFor::Kernel
+{
+public:
+    TransmittanceKernel(
+        const AtmosphereQuery &query
+    ,   const float *x
+    ,   const float *y
+    ,   const float *z
+    ,   float *r
+    ,   float *g
+    ,   float *b)
+    :   m_query(query)
+    ,   m_x(x), m_y(y), m_z(z)
+    ,   m_r(r), m_g(g), m_b(b)
+    {
+    }
+
+    virtual void operator()(
+        const int begin
+    ,   const int end)
+    {
+        for(int i = begin; i < end; i += BLOCK)
+        {
+            const unsigned int n = _mi(static_cast<int>(BLOCK), end - i);
+            m_query.transmittanceBlock(n, m_x + i, m_y + i, m_z + i, m_r + i, m_g + i, m_b + i);
+        }
+    }
+
+protected:
+    const AtmosphereQuery &m_query;
+
+    const float *m_x, *m_y, *m_z;
+    float *m_r, *m_g, *m_b;
+};
+
+
+AtmosphereQuery::AtmosphereQuery()
+:   osg::Referenced()
+,   m_valid(false)
+,   m_modifiedCount(0)
+,   m_altitude(Himmel::defaultAltitude())
+,   m_Rg(static_cast<float>(Earth::meanRadius()))
+,   m_Rt(static_cast<float>(Earth::meanRadius() + Earth::atmosphereThicknessNonUniform()))
+,   m_resR(0)
+,   m_resMu(0)
+,   m_resMuS(0)
+,   m_resNu(0)
+,   m_mieG(0.f)
+{
+    m_transmittance.source = NULL;
+    m_irradiance.source = NULL;
+    m_inscatter.source = NULL;
+}
+
+
+AtmosphereQuery::~AtmosphereQuery()
+{
+}
+
+
+const bool AtmosphereQuery::update(const AtmospherePrecompute &precompute)
+{
+    const AtmospherePrecompute::t_preTexCfg &tc(precompute.getTextureConfig());
+    const AtmospherePrecompute::t_modelCfg &mc(precompute.getModelConfig());
+
+    m_resR   = tc.resR;
+    m_resMu  = tc.resMu;
+    m_resMuS = tc.resMuS;
+    m_resNu  = tc.resNu;
+
+    m_mieG  = mc.mieG;
+    m_betaR = mc.betaR;
+
+    m_valid = copyTable(precompute.getTransmittanceImage(), m_transmittance)
+        && copyTable(precompute.getIrradianceImage(), m_irradiance)
+        && copyTable(precompute.getInscatterImage(), m_inscatter);
+
+    return isValid();
+}
+
+
+const bool AtmosphereQuery::copyTable(
+    const osg::Image *image
+,   t_table &table)
+{
+    if(!image || !image->data())
+    {
+        table.source = NULL;
+        table.data.clear();
+
+        return false;
+    }
+
+    if(table.source == image && table.modifiedCount == image->getModifiedCount())
+        return true;
+
+    table.width  = image->s();
+    table.height = image->t();
+    table.depth  = image->r();
+    table.components = osg::Image::computeNumComponents(image->getPixelFormat());
+
+    const unsigned int count = table.width * table.height * table.depth * table.components;
+    table.data.resize(count);
+
+    switch(image->getDataType())
+    {
+    case GL_FLOAT:
+        {
+            const float *source = reinterpret_cast<const float*>(image->data());
+            std::copy(source, source + count, table.data.begin());
+        }
+        break;
+
+    case GL_HALF_FLOAT_ARB:
+
+        HalfFloat::toFloat(reinterpret_cast<const t_half*>(image->data()), &table.data[0], count);
+        break;
+
+    default:
+        assert(false);
+
+        table.source = NULL;
+        return false;
+    }
+
+    table.source = image;
+    table.modifiedCount = image->getModifiedCount();
+
+    ++m_modifiedCount;
+
+    return true;
+}
+
+
+const float AtmosphereQuery::setAltitude(const float altitude)
+{
+    m_altitude = _clamp(0.001f, static_cast<float>(Earth::atmosphereThicknessNonUniform()), altitude);
+    return getAltitude();
+}
+
+const float AtmosphereQuery::getAltitude() const
+{
+    return m_altitude;
+}
+
+
+void AtmosphereQuery::sample2D(
+    const t_table &table
+,   const float u
+,   const float v
+,   float *result)
+{
+    const int w = table.width;
+    const int h = table.height;
+    const int c = table.components;
+
+    const float x = u * w - 0.5f;
+    const float y = v * h - 0.5f;
+
+    const float fx = floorf(x);
+    const float fy = floorf(y);
+
+    const float ax = x - fx;
+    const float ay = y - fy;
+
+    const int x0 = _clamp(0, w - 1, static_cast<int>(fx));
+    const int x1 = _clamp(0, w - 1, static_cast<int>(fx) + 1);
+    const int y0 = _clamp(0, h - 1, static_cast<int>(fy));
+    const int y1 = _clamp(0, h - 1, static_cast<int>(fy) + 1);
+
+    const float *t00 = &table.data[(y0 * w + x0) * c];
+    const float *t10 = &table.data[(y0 * w + x1) * c];
+    const float *t01 = &table.data[(y1 * w + x0) * c];
+    const float *t11 = &table.data[(y1 * w + x1) * c];
+
+    for(int i = 0; i < c; ++i)
+    {
+        const float a = t00[i] + (t10[i] - t00[i]) * ax;
+        const float b = t01[i] + (t11[i] - t01[i]) * ax;
+
+        result[i] = a + (b - a) * ay;
+    }
+}
+
+
+void AtmosphereQuery::sample3D(
+    const t_table &table
+,   const float u
+,   const float v
+,   const float w
+,   float *result)
+{
+    const int sw = table.width;
+    const int sh = table.height;
+    const int sd = table.depth;
+    const int c  = table.components;
+
+    const float x = u * sw - 0.5f;
+    const float y = v * sh - 0.5f;
+    const float z = w * sd - 0.5f;
+
+    const float fx = floorf(x);
+    const float fy = floorf(y);
+    const float fz = floorf(z);
+
+    const float ax = x - fx;
+    const float ay = y - fy;
+    const float az = z - fz;
+
+    const int x0 = _clamp(0, sw - 1, static_cast<int>(fx));
+    const int x1 = _clamp(0, sw - 1, static_cast<int>(fx) + 1);
+    const int y0 = _clamp(0, sh - 1, static_cast<int>(fy));
+    const int y1 = _clamp(0, sh - 1, static_cast<int>(fy) + 1);
+    const int z0 = _clamp(0, sd - 1, static_cast<int>(fz));
+    const int z1 = _clamp(0, sd - 1, static_cast<int>(fz) + 1);
+
+    const float *s0 = &table.data[z0 * sw * sh * c];
+    const float *s1 = &table.data[z1 * sw * sh * c];
+
+    const int i00 = (y0 * sw + x0) * c;
+    const int i10 = (y0 * sw + x1) * c;
+    const int i01 = (y1 * sw + x0) * c;
+    const int i11 = (y1 * sw + x1) * c;
+
+    for(int i = 0; i < c; ++i)
+    {
+        const float a0 = s0[i00 + i] + (s0[i10 + i] - s0[i00 + i]) * ax;
+        const float b0 = s0[i01 + i] + (s0[i11 + i] - s0[i01 + i]) * ax;
+        const float a1 = s1[i00 + i] + (s1[i10 + i] - s1[i00 + i]) * ax;
+        const float b1 = s1[i01 + i] + (s1[i11 + i] - s1[i01 + i]) * ax;
+
+        const float c0 = a0 + (b0 - a0) * ay;
+        const float c1 = a1 + (b1 - a1) * ay;
+
+        result[i] = c0 + (c1 - c0) * az;
+    }
+}
+
+
+const osg::Vec3f AtmosphereQuery::transmittance(
+    const float r
+,   const float mu) const
+{
+    // getTransmittanceUV
+
+    const float uR  = sqrtf(_ma(0.f, (r - m_Rg) / (m_Rt - m_Rg)));
+    const float uMu = atanf((mu + 0.15f) / (1.f + 0.15f) * tanf(1.5f)) / 1.5f;
+
+    osg::Vec3f result;
+    sample2D(m_transmittance, uMu, uR, result.ptr());
+
+    return result;
+}
+
+
+const osg::Vec3f AtmosphereQuery::transmittanceWithShadow(
+    const float r
+,   const float mu) const
+{
+    const float horizon = -sqrtf(_ma(0.f, 1.f - (m_Rg / r) * (m_Rg / r)));
+    return mu < horizon ? osg::Vec3f(0.f, 0.f, 0.f) : transmittance(r, mu);
+}
+
+
+const osg::Vec4f AtmosphereQuery::texture4D(
+    const float r
+,   const float mu
+,   const float muS
+,   const float nu) const
+{
+    const float H   = sqrtf(m_Rt * m_Rt - m_Rg * m_Rg);
+    const float rho = sqrtf(_ma(0.f, r * r - m_Rg * m_Rg));
+
+    const float rmu   = r * mu;
+    const float delta = rmu * rmu - r * r + m_Rg * m_Rg;
+
+    const bool ground = rmu < 0.f && delta > 0.f;
+
+    const float cstx = ground ?  1.f : -1.f;
+    const float csty = ground ?  0.f : H * H;
+    const float cstz = ground ?  0.f : H;
+    const float cstw = 0.5f + (ground ? -0.5f : 0.5f) / m_resMu;
+
+    const float uR   = 0.5f / m_resR + rho / H * (1.f - 1.f / m_resR);
+    const float uMu  = cstw + (rmu * cstx + sqrtf(_ma(0.f, delta + csty))) / (rho + cstz) * (0.5f - 1.f / m_resMu);
+    const float uMuS = 0.5f / m_resMuS + (atanf(_ma(muS, -0.1975f) * tanf(1.26f * 1.1f)) / 1.1f + (1.f - 0.26f)) * 0.5f * (1.f - 1.f / m_resMuS);
+
+    float lerp = (nu + 1.f) / 2.f * (m_resNu - 1.f);
+    const float uNu = floorf(lerp);
+    lerp = lerp - uNu;
+
+    osg::Vec4f a, b;
+    sample3D(m_inscatter, (uNu + uMuS) / m_resNu, uMu, uR, a.ptr());
+    sample3D(m_inscatter, (uNu + uMuS + 1.f) / m_resNu, uMu, uR, b.ptr());
+
+    return a * (1.f - lerp) + b * lerp;
+}
+
+
+const float AtmosphereQuery::phaseFunctionR(const float mu) const
+{
+    return (3.f / (16.f * static_cast<float>(_PI))) * (1.f + mu * mu);
+}
+
+const float AtmosphereQuery::phaseFunctionM(const float mu) const
+{
+    const float g2 = m_mieG * m_mieG;
+    return 1.5f * 1.f / (4.f * static_cast<float>(_PI)) * (1.f - g2) 
+        * powf(1.f + g2 - 2.f * m_mieG * mu, -3.f / 2.f) * (1.f + mu * mu) / (2.f + g2);
+}
+
+
+const osg::Vec3f AtmosphereQuery::inscatter(
+    const float r
+,   const float mu
+,   const float muS
+,   const float nu) const
+{
+    // The observer is within the atmosphere (see setAltitude), so the top 
+    // boundary handling of the shader is not required.
+
+    const float discriminant = r * r * (mu * mu - 1.f) + m_Rg * m_Rg;
+    const float t = discriminant >= 0.f ? -r * mu - sqrtf(discriminant) : -1.f;
+
+    const float phaseR = phaseFunctionR(nu);
+    const float phaseM = phaseFunctionM(nu);
+
+    osg::Vec4f inscatter = texture4D(r, mu, muS, nu);
+    for(int i = 0; i < 4; ++i)
+        inscatter[i] = _ma(0.f, inscatter[i]);
+
+    if(t > 0.f)
+    {
+        // x0 = x + t * v with x = (0, 0, r)
+
+        const float r0   = sqrtf(r * r + t * t + 2.f * r * t * mu);
+        const float rMu0 = r * mu + t;
+        const float mu0  = rMu0 / r0;
+        const float muS0 = (r * muS + t * nu) / r0;
+
+        // transmittance(r, mu, v, x0), including the shader's mu1
+        const float mu1 = rMu0 / r;
+
+        osg::Vec3f attenuation;
+        if(mu > 0.f)
+        {
+            const osg::Vec3f t0 = transmittance(r, mu);
+            const osg::Vec3f t1 = transmittance(r0, mu1);
+            attenuation = osg::Vec3f(safeRatio(t0[0], t1[0]), safeRatio(t0[1], t1[1]), safeRatio(t0[2], t1[2]));
+        }
+        else
+        {
+            const osg::Vec3f t0 = transmittance(r0, -mu1);
+            const osg::Vec3f t1 = transmittance(r, -mu);
+            attenuation = osg::Vec3f(safeRatio(t0[0], t1[0]), safeRatio(t0[1], t1[1]), safeRatio(t0[2], t1[2]));
+        }
+
+        if(r0 > m_Rg + 0.01f)
+        {
+            const osg::Vec4f inscatter0 = texture4D(r0, mu0, muS0, nu);
+            const osg::Vec4f attenuation4(attenuation, attenuation[0]);
+
+            for(int i = 0; i < 4; ++i)
+                inscatter[i] = _ma(0.f, inscatter[i] - attenuation4[i] * inscatter0[i]);
+        }
+    }
+
+    inscatter[3] *= smoothstep(0.00f, 0.02f, muS);
+
+    // getMie
+
+    const float mie = inscatter[3] / _ma(inscatter[0], 1e-4f);
+
+    osg::Vec3f result;
+    for(int i = 0; i < 3; ++i)
+    {
+        const float m = inscatter[i] * mie * (m_betaR[0] / m_betaR[i]);
+        result[i] = _ma(0.f, inscatter[i] * phaseR + m * phaseM) * ISun;
+    }
+    return result;
+}
+
+
+const osg::Vec3f AtmosphereQuery::transmittance(const osg::Vec3f &direction) const
+{
+    if(!isValid())
+        return osg::Vec3f(0.f, 0.f, 0.f);
+
+    osg::Vec3f v(direction);
+    v.normalize();
+
+    return transmittanceWithShadow(m_Rg + m_altitude, v.z());
+}
+
+
+const osg::Vec3f AtmosphereQuery::sunColor(const osg::Vec3f &sun) const
+{
+    return transmittance(sun) * ISun;
+}
+
+
+const osg::Vec3f AtmosphereQuery::irradiance(const osg::Vec3f &sun) const
+{
+    if(!isValid())
+        return osg::Vec3f(0.f, 0.f, 0.f);
+
+    osg::Vec3f s(sun);
+    s.normalize();
+
+    // getIrradianceUV
+
+    const float uR   = m_altitude / (m_Rt - m_Rg);
+    const float uMuS = (s.z() + 0.2f) / (1.f + 0.2f);
+
+    osg::Vec3f result;
+    sample2D(m_irradiance, uMuS, uR, result.ptr());
+
+    return result * ISun;
+}
+
+
+const osg::Vec3f AtmosphereQuery::inscatter(
+    const osg::Vec3f &direction
+,   const osg::Vec3f &sun) const
+{
+    if(!isValid())
+        return osg::Vec3f(0.f, 0.f, 0.f);
+
+    osg::Vec3f v(direction);
+    v.normalize();
+    osg::Vec3f s(sun);
+    s.normalize();
+
+    return inscatter(m_Rg + m_altitude, v.z(), s.z(), v * s);
+}
+
+
+void AtmosphereQuery::inscatterBlock(
+    const unsigned int count
+,   const float *x
+,   const float *y
+,   const float *z
+,   const osg::Vec3f &sun
+,   float *r
+,   float *g
+,   float *b) const
+{
+    assert(count <= BLOCK);
+
+    // With the observer at (0, 0, r) only mu and nu vary per direction. 
+    // They are computed in a separate loop over the block, the table 
+    // lookups that follow are the scalar ones. The normalization is done as
+    // by osg::Vec3f::normalize (zero length directions stay zero), so that 
+    // the results equal those of the single direction query (the lookups 
+    // are not continuous).
+
+    float mu[BLOCK];
+    float nu[BLOCK];
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const float length = sqrtf(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+        const float l = length > 0.f ? 1.f / length : 0.f;
+
+        mu[i] = z[i] * l;
+        nu[i] = x[i] * l * sun[0] + y[i] * l * sun[1] + mu[i] * sun[2];
+    }
+
+    const float radius = m_Rg + m_altitude;
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const osg::Vec3f result = inscatter(radius, mu[i], sun[2], nu[i]);
+
+        r[i] = result[0];
+        g[i] = result[1];
+        b[i] = result[2];
+    }
+}
+
+
+void AtmosphereQuery::transmittanceBlock(
+    const unsigned int count
+,   const float *x
+,   const float *y
+,   const float *z
+,   float *r
+,   float *g
+,   float *b) const
+{
+    assert(count <= BLOCK);
+
+    float mu[BLOCK];
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const float length = sqrtf(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+        mu[i] = length > 0.f ? z[i] * (1.f / length) : 0.f;
+    }
+
+    const float radius = m_Rg + m_altitude;
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const osg::Vec3f result = transmittanceWithShadow(radius, mu[i]);
+
+        r[i] = result[0];
+        g[i] = result[1];
+        b[i] = result[2];
+    }
+}
+
+
+void AtmosphereQuery::transmittance(
+    const unsigned int count
+,   const float *x
+,   const float *y
+,   const float *z
+,   float *r
+,   float *g
+,   float *b) const
+{
+    if(!isValid())
+    {
+        std::fill(r, r + count, 0.f);
+        std::fill(g, g + count, 0.f);
+        std::fill(b, b + count, 0.f);
+        return;
+    }
+
+    TransmittanceKernel kernel(*this, x, y, z, r, g, b);
+    ParallelFor::run(static_cast<int>(count), kernel, PARALLEL_GRAIN);
+}
+
+
+void AtmosphereQuery::inscatter(
+    const unsigned int count
+,   const float *x
+,   const float *y
+,   const float *z
+,   const osg::Vec3f &sun
+,   float *r
+,   float *g
+,   float *b) const
+{
+    if(!isValid())
+    {
+        std::fill(r, r + count, 0.f);
+        std::fill(g, g + count, 0.f);
+        std::fill(b, b + count, 0.f);
+        return;
+    }
+
+    osg::Vec3f s(sun);
+    s.normalize();
+
+    InscatterKernel kernel(*this, x, y, z, s, r, g, b);
+    ParallelFor::run(static_cast<int>(count), kernel, PARALLEL_GRAIN);
+}
+
+
+const float AtmosphereQuery::sunIntensity()
+{
+    return ISun;
+}
+
+
+const osg::Vec3f AtmosphereQuery::hdr(
+    const osg::Vec3f &radiance
+,   const float exposure)
+{
+    osg::Vec3f L(radiance * exposure);
+
+    for(int i = 0; i < 3; ++i)
+        L[i] = L[i] < 1.413f ? powf(L[i] * 0.38317f, 1.f / 2.2f) : 1.f - expf(-L[i]);
+
+    return L;
+}
+
+} // namespace osgHimmel
\ No newline at end of file
@@ -74,36 +74,41 @@ const unsigned int BrightStars::numStars() const
 
 unsigned int BrightStars::fromFile(const char *fileName)
 {
-    if(m_stars)
-        delete[] m_stars;
-
-    // Retrieve file size.
+    delete[] m_stars;
 
-    FILE *f;
-#ifdef __GNUC__
-    f = std::fopen(fileName, "r");
-#else // __GNUC__
-    fopen_s(&f, fileName, "r");
-#endif // __GNUC__
+    m_stars = NULL;
+    m_numStars = 0;
 
-    if(!f)
+    std::ifstream instream(fileName, std::ios::binary);
+    if(!instream.good())
         return 0;
-    
-    std::fseek(f, 0, SEEK_END);
-    const long fileSize = std::ftell(f);
 
-    std::fclose(f);
+    // Retrieve file size.
 
+    instream.seekg(0, std::ios::end);
+    const std::streamoff fileSize = instream.tellg();
+    instream.seekg(0, std::ios::beg);
 
-    m_numStars = fileSize / sizeof(s_BrightStar);
-    //assert(NUM_BRIGHTSTARS == numStars);
+    // The raw format has no header, so at least reject partial stars.
 
-    m_stars = new s_BrightStar[m_numStars];
+    if(fileSize <= 0 || fileSize % sizeof(s_BrightStar) != 0)
+        return 0;
 
-    std::ifstream instream(fileName, std::ios::binary);
+    const unsigned int numStars = static_cast<unsigned int>(fileSize / sizeof(s_BrightStar));
+    //assert(NUM_BRIGHTSTARS == numStars);
+
+    m_stars = new s_BrightStar[numStars];
 
     instream.read(reinterpret_cast<char*>(m_stars), fileSize);
+    if(!instream.good())
+    {
+        delete[] m_stars;
+        m_stars = NULL;
 
+        return 0;
+    }
+
+    m_numStars = numStars;
     return m_numStars;
 }
 
@@ -112,10 +117,10 @@ unsigned int BrightStars::toFile(const char *fileName) const
 {
     std::ofstream outstream(fileName, std::ios::binary);
 
-    outstream.write((char*)&m_stars, sizeof(m_stars) * m_numStars);
+    outstream.write(reinterpret_cast<const char*>(m_stars), sizeof(s_BrightStar) * m_numStars);
     outstream.close();
 
-    return m_numStars;
+    return outstream.good() ? m_numStars : 0;
 }
 
 
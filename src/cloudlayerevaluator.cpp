@@ -0,0 +1,462 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "cloudlayerevaluator.h"
+
+#include "earth.h"
+#include "mathmacros.h"
+#include "parallelfor.h"
+#include "prerenderednoiserefresh.h"
+
+#include <assert.h>
+#include <math.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    // Same as the linear filtered, repeated texture lookup.
+
+    inline const unsigned int wrap(
+        const int i
+    ,   const unsigned int size)
+    {
+        const int r = i % static_cast<int>(size);
+        return r < 0 ? r + size : r;
+    }
+
+    // Parameters of the dube cloud layers fragment shader.
+
+    const int   SCATTER_STEPS(128);
+    const float SCATTER_RANGE(8.f);
+
+    // Samples of the occluded disc.
+
+    const unsigned int DISC_SAMPLES(16);
+
+
+    class DensityKernel : public ParallelFor::Kernel
+    {
+    public:
+        DensityKernel(
+            const CloudLayerEvaluator &evaluator
+        ,   const osg::Vec3f *directions
+        ,   float *dest)
+        :   m_evaluator(evaluator)
+        ,   m_directions(directions)
+        ,   m_dest(dest)
+        {
+        }
+
+        virtual void operator()(
+            const int begin
+        ,   const int end)
+        {
+            for(int i = begin; i < end; ++i)
+                m_dest[i] = m_evaluator.density(m_directions[i]);
+        }
+
+    protected:
+        const CloudLayerEvaluator &m_evaluator;
+        const osg::Vec3f *m_directions;
+        float *m_dest;
+    };
+}
+
+
+CloudLayerEvaluator::CloudLayerEvaluator(const e_LayerModel model)
+:   m_model(model)
+,   m_time(0.f)
+,   m_coverage(0.2f)
+,   m_sharpness(model == LM_High ? 0.5f : 0.3f)
+,   m_change(0.1f)
+,   m_wind(0.f, 0.f)
+,   m_altitude(model == LM_High ? 8.f : 2.f)
+,   m_scale(model == LM_High ? osg::Vec2f(32.f, 32.f) : osg::Vec2f(128.f, 128.f))
+,   m_thickness(3.f)
+,   m_offset(-0.5f)
+,   m_observerAltitude(0.2f)
+,   m_earthRadius(static_cast<float>(Earth::meanRadius()))
+{
+    for(unsigned int i = 0; i < 4; ++i)
+    {
+        m_noise[i] = NULL;
+        m_noiseSize[i] = 0;
+        m_noiseSlices[i] = 0;
+    }
+}
+
+
+CloudLayerEvaluator::~CloudLayerEvaluator()
+{
+}
+
+
+void CloudLayerEvaluator::setNoiseArray(
+    const unsigned int i
+,   const float *data
+,   const unsigned int texSize
+,   const unsigned int slices
+,   osg::Referenced *owner)
+{
+    assert(i < 4);
+
+    m_noise[i] = data;
+    m_noiseSize[i] = texSize;
+    m_noiseSlices[i] = slices;
+    m_noiseOwner[i] = owner;
+}
+
+
+const bool CloudLayerEvaluator::isValid() const
+{
+    for(unsigned int i = 0; i < 4; ++i)
+        if(!m_noise[i] || !m_noiseSize[i] || !m_noiseSlices[i])
+            return false;
+
+    return true;
+}
+
+
+void CloudLayerEvaluator::setTime(const float time)
+{
+    m_time = time;
+}
+
+void CloudLayerEvaluator::setCoverage(const float coverage)
+{
+    m_coverage = coverage;
+}
+
+void CloudLayerEvaluator::setSharpness(const float sharpness)
+{
+    m_sharpness = sharpness;
+}
+
+void CloudLayerEvaluator::setChange(const float change)
+{
+    m_change = change;
+}
+
+void CloudLayerEvaluator::setWind(const osg::Vec2f &wind)
+{
+    m_wind = wind;
+}
+
+void CloudLayerEvaluator::setAltitude(const float altitude)
+{
+    m_altitude = altitude;
+}
+
+void CloudLayerEvaluator::setScale(const osg::Vec2f &scale)
+{
+    m_scale = scale;
+}
+
+void CloudLayerEvaluator::setThickness(const float thickness)
+{
+    m_thickness = thickness;
+}
+
+void CloudLayerEvaluator::setOffset(const float offset)
+{
+    m_offset = offset;
+}
+
+void CloudLayerEvaluator::setObserver(
+    const float altitude
+,   const float earthRadius)
+{
+    m_observerAltitude = altitude;
+    m_earthRadius = earthRadius;
+}
+
+
+const float CloudLayerEvaluator::sample(
+    const unsigned int i
+,   const float s
+,   const float t
+,   const float r) const
+{
+    const unsigned int size = m_noiseSize[i];
+    const unsigned int slices = m_noiseSlices[i];
+
+    const float x = s * size   - 0.5f;
+    const float y = t * size   - 0.5f;
+    const float z = r * slices - 0.5f;
+
+    const float fx = floor(x);
+    const float fy = floor(y);
+    const float fz = floor(z);
+
+    const float ax = x - fx;
+    const float ay = y - fy;
+    const float az = z - fz;
+
+    const unsigned int x0 = wrap(static_cast<int>(fx), size);
+    const unsigned int y0 = wrap(static_cast<int>(fy), size);
+    const unsigned int z0 = wrap(static_cast<int>(fz), slices);
+    const unsigned int x1 = x0 + 1 < size ? x0 + 1 : 0;
+    const unsigned int y1 = y0 + 1 < size ? y0 + 1 : 0;
+    const unsigned int z1 = z0 + 1 < slices ? z0 + 1 : 0;
+
+    const float *s0 = m_noise[i] + z0 * size * size;
+    const float *s1 = m_noise[i] + z1 * size * size;
+
+    const float *r00 = s0 + y0 * size;
+    const float *r01 = s0 + y1 * size;
+    const float *r10 = s1 + y0 * size;
+    const float *r11 = s1 + y1 * size;
+
+    const float v00 = r00[x0] + ax * (r00[x1] - r00[x0]);
+    const float v01 = r01[x0] + ax * (r01[x1] - r01[x0]);
+    const float v10 = r10[x0] + ax * (r10[x1] - r10[x0]);
+    const float v11 = r11[x0] + ax * (r11[x1] - r11[x0]);
+
+    const float v0 = v00 + ay * (v01 - v00);
+    const float v1 = v10 + ay * (v11 - v10);
+
+    return v0 + az * (v1 - v0);
+}
+
+
+const float CloudLayerEvaluator::noise(
+    const float u
+,   const float v) const
+{
+    assert(isValid());
+
+    // same as in HighCloudLayerGeode::createPreRenderedNoise
+
+    float t = m_time * 3600.f;
+
+    const osg::Vec2f m = m_wind * t;
+    t *= m_change;
+
+    float n = 0.f;
+
+    for(unsigned int i = 0; i < PreRenderedNoiseRefresh::numTerms(); ++i)
+    {
+        const PreRenderedNoiseRefresh::t_noiseTerm &term(PreRenderedNoiseRefresh::term(i));
+
+        n += term.weight * sample(term.array
+            , u * term.scale + m[0] * term.wind, v * term.scale + m[1] * term.wind, t * term.evolution);
+    }
+    n *= 0.76f;
+
+    n = n - 1.f + m_coverage;
+    n /= m_coverage;
+    n = _ma(0.f, n);
+
+    return static_cast<float>(pow(n, 1.f - m_sharpness));
+}
+
+
+const bool CloudLayerEvaluator::belowHorizon(const osg::Vec3f &d) const
+{
+    if(d[2] > 0.f)
+        return false;
+
+    const float r = m_earthRadius + m_observerAltitude;
+    const float mu = d[2];
+
+    const float B = r * r * (mu * mu - 1.f) + m_earthRadius * m_earthRadius;
+    if(B < 0.f)
+        return false;
+
+    return r * mu - sqrt(B) < 0.f;
+}
+
+
+const bool CloudLayerEvaluator::layerIntersection(
+    const osg::Vec3f &d
+,   const osg::Vec3f &o
+,   const float altitude
+,   float &t) const
+{
+    const float r = m_earthRadius + altitude;
+
+    // for now, ignore if altitude is above cloud layer
+    if(o[2] > r)
+        return false;
+
+    const float a = d * d;
+    const float b = 2.f * (d * o);
+    const float c = o * o - r * r;
+
+    const float B = sqrt(_ma(0.f, b * b - 4.f * a * c));
+
+    const float q = b < 0.f ? (-b - B) * 0.5f : (-b + B) * 0.5f;
+
+    float t0 = q / a;
+    float t1 = c / q;
+
+    if(t0 > t1)
+    {
+        const float swap = t0;
+        t0 = t1;
+        t1 = swap;
+    }
+
+    if(t1 < 0.f)
+        return false;
+
+    t = t0 < 0.f ? t1 : t0;
+    return true;
+}
+
+
+const float CloudLayerEvaluator::T(const osg::Vec3f &stu) const
+{
+    const float m = 2.f * (1.f + stu[2]);
+
+    const float u = stu[0] / m + 0.5f;
+    const float v = stu[1] / m + 0.5f;
+
+    return noise(u * m_scale[0], v * m_scale[1]);
+}
+
+
+const float CloudLayerEvaluator::highDensity(const osg::Vec3f &eye) const
+{
+    const osg::Vec3f o(0.f, 0.f, m_earthRadius + m_observerAltitude);
+
+    float t;
+    if(!layerIntersection(eye, o, m_altitude, t))
+        return 0.f;
+
+    return T(o + eye * t);
+}
+
+
+const float CloudLayerEvaluator::dubeDensity(const osg::Vec3f &eye) const
+{
+    const osg::Vec3f o(0.f, 0.f, m_earthRadius + m_observerAltitude);
+
+    // same as scatter of the DubeCloudLayerGeode, without the scattering
+
+    const float a1 = m_thickness + m_offset;
+
+    float t0, t1;
+
+    if(!layerIntersection(eye, o, m_altitude + m_offset, t0))
+        return 0.f;
+    if(!layerIntersection(eye, o, m_altitude + a1, t1))
+        return 0.f;
+
+    const float iSteps = 1.f / (SCATTER_STEPS - 1);
+
+    const osg::Vec3f Dstu = eye * ((t1 - t0) * iSteps);
+    osg::Vec3f stu = o + eye * t0;
+
+    const float Da = m_thickness * iSteps;
+
+    float d = 0.f;
+    for(int i = 0; i < SCATTER_STEPS; ++i)
+    {
+        const float n = T(stu);
+        const float a = m_offset + i * Da;
+
+        if(a > n * m_offset && a < n * a1)
+            ++d;
+        if(d >= SCATTER_RANGE)
+            break;
+
+        stu += Dstu;
+    }
+    d /= SCATTER_RANGE;
+
+    float t;
+    layerIntersection(eye, o, m_altitude, t);
+
+    return d * (1.f - static_cast<float>(pow(t, 0.8f)) * 12e-3f);
+}
+
+
+const float CloudLayerEvaluator::density(const osg::Vec3f &direction) const
+{
+    assert(isValid());
+
+    osg::Vec3f eye(direction);
+    eye.normalize();
+
+    if(belowHorizon(eye))
+        return 0.f;
+
+    const float n = m_model == LM_High ? highDensity(eye) : dubeDensity(eye);
+    return _clamp(0.f, 1.f, n);
+}
+
+
+void CloudLayerEvaluator::density(
+    const unsigned int count
+,   const osg::Vec3f *directions
+,   float *dest) const
+{
+    assert(isValid());
+
+    DensityKernel kernel(*this, directions, dest);
+    ParallelFor::run(count, kernel, 64);
+}
+
+
+const float CloudLayerEvaluator::occlusion(
+    const osg::Vec3f &direction
+,   const float angularRadius) const
+{
+    osg::Vec3f n(direction);
+    n.normalize();
+
+    // tangent frame of the disc
+
+    const osg::Vec3f a = fabs(n[2]) < 0.9f ? osg::Vec3f(0.f, 0.f, 1.f) : osg::Vec3f(1.f, 0.f, 0.f);
+
+    osg::Vec3f u = n ^ a;
+    u.normalize();
+    const osg::Vec3f v = n ^ u;
+
+    // equal area samples (sunflower pattern)
+
+    const float golden = static_cast<float>(_PI * (3.0 - sqrt(5.0)));
+
+    float sum = 0.f;
+    for(unsigned int i = 0; i < DISC_SAMPLES; ++i)
+    {
+        const float rho = angularRadius * sqrt((i + 0.5f) / DISC_SAMPLES);
+        const float phi = golden * i;
+
+        const osg::Vec3f d = n * cos(rho) + (u * cos(phi) + v * sin(phi)) * sin(rho);
+        sum += density(d);
+    }
+    return sum / DISC_SAMPLES;
+}
+
+} // namespace osgHimmel
\ No newline at end of file
@@ -32,9 +32,13 @@
 
 #include "highcloudlayergeode.h"
 #include "noise.h"
+#include "noisecache.h"
+#include "random.h"
 #include "himmel.h"
 #include "mathmacros.h"
+#include "earth.h"
 #include "himmelquad.h"
+#include "prerenderednoiserefresh.h"
 #include  "timef.h"
 
 #include "shaderfragment/common.h"
@@ -46,9 +50,11 @@
 
 #include <osg/Texture2D>
 #include <osg/Texture3D>
+#include <osg/Image>
 #include <osg/Geode>
 #include <osg/Depth>
 #include <osg/BlendFunc>
+#include <osg/Timer>
 
 #include <osgDB/WriteFile>
 
@@ -68,9 +74,10 @@ DubeCloudLayerGeode::DubeCloudLayerGeode(const int texSize)
 
 ,   m_hquad(new HimmelQuad())
 ,   m_preNoise(NULL)
+,   m_preNoiseRefresh(NULL)
+,   m_evaluator(CloudLayerEvaluator::LM_Dube)
 ,   m_noiseSize(texSize)
 
-,   u_q(NULL)
 ,   u_clouds(NULL)
 ,   u_noise(NULL)
 ,   u_time(NULL)
@@ -108,13 +115,75 @@ DubeCloudLayerGeode::~DubeCloudLayerGeode()
 
 void DubeCloudLayerGeode::update(const Himmel &himmel)
 {
-    // TODO: starmap and planets also require this ... - find better place
-    const float fov = himmel.getCameraFovHint();
-    const float height = himmel.getViewSizeHeightHint();
+    const float time = static_cast<float>(himmel.getTime()->getf());
+    u_time->set(time);
 
-    u_q->set(static_cast<float>(sqrt(2.0) * 2.0 * tan(_rad(fov * 0.5)) / height));
+    // the pre rendered noise is only refreshed on visible changes
 
-    u_time->set(static_cast<float>(himmel.getTime()->getf()));
+    float coverage, sharpness, change;
+    osg::Vec2f wind;
+
+    u_coverage->get(coverage);
+    u_sharpness->get(sharpness);
+    u_change->get(change);
+    u_wind->get(wind);
+
+    m_preNoiseRefresh->update(time, coverage, sharpness, change, wind);
+}
+
+
+const CloudLayerEvaluator DubeCloudLayerGeode::evaluator(const Himmel &himmel) const
+{
+    CloudLayerEvaluator evaluator(m_evaluator);
+
+    evaluator.setObserver(himmel.getAltitude(), static_cast<float>(Earth::meanRadius()));
+
+    // The noise is evaluated for the inputs of the pre rendered noise, 
+    // which follows the live ones only on visible changes.
+
+    if(m_preNoiseRefresh.valid() && m_preNoiseRefresh->getPassCount() > 0)
+    {
+        evaluator.setTime(m_preNoiseRefresh->getTime());
+        evaluator.setCoverage(m_preNoiseRefresh->getCoverage());
+        evaluator.setSharpness(m_preNoiseRefresh->getSharpness());
+        evaluator.setChange(m_preNoiseRefresh->getChange());
+        evaluator.setWind(m_preNoiseRefresh->getWind());
+    }
+    else
+    {
+        float coverage, sharpness, change;
+        osg::Vec2f wind;
+
+        u_coverage->get(coverage);
+        u_sharpness->get(sharpness);
+        u_change->get(change);
+        u_wind->get(wind);
+
+        evaluator.setTime(static_cast<float>(himmel.getTime()->getf()));
+        evaluator.setCoverage(coverage);
+        evaluator.setSharpness(sharpness);
+        evaluator.setChange(change);
+        evaluator.setWind(wind);
+    }
+
+    float altitude;
+    osg::Vec2f scale;
+
+    u_altitude->get(altitude);
+    u_scale->get(scale);
+
+    evaluator.setAltitude(altitude);
+    evaluator.setScale(scale);
+
+    float thickness, offset;
+
+    u_thickness->get(thickness);
+    u_offset->get(offset);
+
+    evaluator.setThickness(thickness);
+    evaluator.setOffset(offset);
+
+    return evaluator;
 }
 
 
@@ -140,9 +209,6 @@ void DubeCloudLayerGeode::setupShader(osg::StateSet* stateSet)
 
 void DubeCloudLayerGeode::setupUniforms(osg::StateSet *stateSet)
 {
-    u_q = new osg::Uniform("q", 0.0f);
-    stateSet->addUniform(u_q);
-
     u_clouds = new osg::Uniform(osg::Uniform::SAMPLER_2D, "clouds");
     stateSet->addUniform(u_clouds);
 
@@ -192,8 +258,6 @@ void DubeCloudLayerGeode::setupUniforms(osg::StateSet *stateSet)
 
 void DubeCloudLayerGeode::setupTextures(osg::StateSet* stateSet)
 {
-    srand(time(NULL));
-
     m_preNoise = new osg::Texture2D;
 
     osg::Group *preNoise(HighCloudLayerGeode::createPreRenderedNoise(m_noiseSize, m_preNoise));
@@ -205,12 +269,36 @@ void DubeCloudLayerGeode::setupTextures(osg::StateSet* stateSet)
     // TODO: the use of m_noise as an array insead of a texture array was due to problems
     // with osg and not enough time and vigor to fix this.. :D
 
-    m_noise[0] = HighCloudLayerGeode::createNoiseArray(1 << 6, 3, 4);
-    m_noise[1] = HighCloudLayerGeode::createNoiseArray(1 << 7, 4, 4);
-    m_noise[2] = HighCloudLayerGeode::createNoiseArray(1 << 8, 5, 4);
-    m_noise[3] = HighCloudLayerGeode::createNoiseArray(1 << 8, 6, 4);
+    const osg::Timer_t t = osg::Timer::instance()->tick();
+
+    // the arrays are shared with the high cloud layer via the noise cache
+
+    const unsigned int seed = Random::globalSeed();
+
+    const unsigned int slices = PreRenderedNoiseRefresh::numSlices();
+
+    m_noise[0] = HighCloudLayerGeode::createNoiseArray(1 << 6, 3, slices, seed);
+    m_noise[1] = HighCloudLayerGeode::createNoiseArray(1 << 7, 4, slices, seed);
+    m_noise[2] = HighCloudLayerGeode::createNoiseArray(1 << 8, 5, slices, seed);
+    m_noise[3] = HighCloudLayerGeode::createNoiseArray(1 << 8, 6, slices, seed);
+
+    // the pre render pass and its refresh assume these sizes
+    for(unsigned int i = 0; i < PreRenderedNoiseRefresh::numTerms(); ++i)
+        assert(m_noise[PreRenderedNoiseRefresh::term(i).array]->getImage()->s() 
+            == static_cast<int>(PreRenderedNoiseRefresh::term(i).size));
+
+    for(unsigned int i = 0; i < 4; ++i)
+    {
+        osg::Image *image(m_noise[i]->getImage());
+        m_evaluator.setNoiseArray(i, reinterpret_cast<const float*>(image->data())
+            , image->s(), image->r(), image);
+    }
+
+    OSG_INFO << "Dube cloud layer noise generated (took " 
+        << osg::Timer::instance()->delta_m(t, osg::Timer::instance()->tick()) << " ms)" << std::endl;
 
-    pnStateSet->addUniform(u_time);
+    // time, coverage, sharpness, change, and wind of the pass are snapshots
+    m_preNoiseRefresh = new PreRenderedNoiseRefresh(preNoise, m_noiseSize);
 
     pnStateSet->addUniform(u_noise0);
     u_noise0->set(1);
@@ -29,9 +29,8 @@
 
 #include "gaussianmapgenerator.h"
 
-#include "mathmacros.h"
+#include "random.h"
 
-#include <stdlib.h>
 #include <assert.h>
 
 
@@ -56,19 +55,19 @@ void GaussianMapGenerator::generate(
     for(unsigned int i = 0; i < size * N; ++i)
         dest[i] = static_cast<T>(1.f * scale);
 
-    srand(seed);
+    Random random(static_cast<unsigned int>(seed));
 
 
     const float p = probability * 2.f;
 
     for(unsigned int j = 0; j < p * size; ++j)
     {
-        const int k(_rand(0, width  - 1));
-        const int l(_rand(0, height - 1));
+        const int k(random.nexti(0, width  - 1));
+        const int l(random.nexti(0, height - 1));
 
         const int i(l * width + k);
 
-        const T v = static_cast<T>(_randf(scale - scale * amount, scale));
+        const T v = static_cast<T>(random.nextf(scale - scale * amount, scale));
 
         for(unsigned int n = 0; n < N; ++n)
             dest[i * N + n] = v;
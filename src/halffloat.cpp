@@ -0,0 +1,237 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+// The scalar and SSE2 conversions are based on Fabian Giesens' public 
+// domain half float code (https://gist.github.com/rygorous/2156668).
+
+#include "halffloat.h"
+
+#include "simd.h"
+
+#include <string.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    inline const unsigned int asUInt(const float f)
+    {
+        unsigned int u;
+        memcpy(&u, &f, sizeof(float));
+        return u;
+    }
+
+    inline const float asFloat(const unsigned int u)
+    {
+        float f;
+        memcpy(&f, &u, sizeof(float));
+        return f;
+    }
+
+#if defined(OSGH_SSE2) && !defined(OSGH_F16C)
+
+    // Returns the halfs sign extended to 32 bit, ready for _mm_packs_epi32.
+
+    inline __m128i toHalf4(const __m128 f)
+    {
+        const __m128i signMask     = _mm_set1_epi32(0x80000000);
+        const __m128i f16max       = _mm_set1_epi32((127 + 16) << 23);
+        const __m128i nanBit       = _mm_set1_epi32(0x200);
+        const __m128i infinity     = _mm_set1_epi32(0x7c00);
+        const __m128i minNormal    = _mm_set1_epi32((127 - 14) << 23);
+        const __m128i subnormMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+        const __m128i normalBias   = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+        const __m128  sign    = _mm_and_ps(_mm_castsi128_ps(signMask), f);
+        const __m128  absf    = _mm_xor_ps(f, sign);
+        const __m128i absi    = _mm_castps_si128(absf);
+
+        const __m128  isNaN     = _mm_cmpunord_ps(absf, absf);
+        const __m128i isRegular = _mm_cmpgt_epi32(f16max, absi);
+        const __m128i infOrNaN  = _mm_or_si128(_mm_and_si128(_mm_castps_si128(isNaN), nanBit), infinity);
+
+        const __m128i isSubnormal = _mm_cmpgt_epi32(minNormal, absi);
+
+        // subnormal results: the magic add rounds the mantissa
+
+        const __m128  subnormal1 = _mm_add_ps(absf, _mm_castsi128_ps(subnormMagic));
+        const __m128i subnormal  = _mm_sub_epi32(_mm_castps_si128(subnormal1), subnormMagic);
+
+        // normal results: rebias exponent and round to nearest even
+
+        const __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absi, 31 - 13), 31);
+        const __m128i rounded     = _mm_sub_epi32(_mm_add_epi32(absi, normalBias), mantissaOdd);
+        const __m128i normal      = _mm_srli_epi32(rounded, 13);
+
+        const __m128i nonSpecial = _mm_or_si128(
+            _mm_and_si128(subnormal, isSubnormal), _mm_andnot_si128(isSubnormal, normal));
+        const __m128i joined     = _mm_or_si128(
+            _mm_and_si128(nonSpecial, isRegular), _mm_andnot_si128(isRegular, infOrNaN));
+
+        return _mm_or_si128(joined, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+    }
+
+    // Expects the halfs zero extended to 32 bit.
+
+    inline __m128 toFloat4(const __m128i h)
+    {
+        const __m128i noSignMask = _mm_set1_epi32(0x7fff);
+        const __m128  magic      = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+        const __m128i wasInfNaN  = _mm_set1_epi32(0x7bff);
+        const __m128  expInfNaN  = _mm_castsi128_ps(_mm_set1_epi32(255 << 23));
+
+        const __m128i expMantissa = _mm_and_si128(noSignMask, h);
+        const __m128i sign        = _mm_slli_epi32(_mm_xor_si128(h, expMantissa), 16);
+
+        // the multiply rebiases the exponent and handles denormals
+        const __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expMantissa, 13)), magic);
+        const __m128 infNaN = _mm_and_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(expMantissa, wasInfNaN)), expInfNaN);
+
+        return _mm_or_ps(scaled, _mm_or_ps(_mm_castsi128_ps(sign), infNaN));
+    }
+
+#endif // OSGH_SSE2 && !OSGH_F16C
+}
+
+
+const t_half HalfFloat::toHalf(const float value)
+{
+    const unsigned int f32infinity(255 << 23);
+    const unsigned int f16max((127 + 16) << 23);
+    const unsigned int denormMagic(((127 - 15) + (23 - 10) + 1) << 23);
+    // 0xfff - ((127 - 15) << 23), the addition wraps around
+    const unsigned int normalBias(0xc8000fff);
+
+    unsigned int f = asUInt(value);
+
+    const unsigned int sign = f & 0x80000000;
+    f ^= sign;
+
+    unsigned int h;
+
+    if(f >= f16max) // inf or nan (nan becomes qnan)
+        h = f > f32infinity ? 0x7e00 : 0x7c00;
+    else if(f < (113 << 23)) // subnormal or zero
+        h = asUInt(asFloat(f) + asFloat(denormMagic)) - denormMagic;
+    else
+    {
+        const unsigned int mantissaOdd = (f >> 13) & 1;
+
+        f += normalBias;
+        f += mantissaOdd;
+
+        h = f >> 13;
+    }
+    return static_cast<t_half>(h | (sign >> 16));
+}
+
+
+const float HalfFloat::toFloat(const t_half value)
+{
+    const float magic(asFloat(113 << 23));
+    const unsigned int shiftedExp(0x7c00 << 13);
+
+    unsigned int f = (value & 0x7fff) << 13;
+    const unsigned int exp = shiftedExp & f;
+
+    f += (127 - 15) << 23;
+
+    if(exp == shiftedExp) // inf or nan
+        f += (128 - 16) << 23;
+    else if(exp == 0) // zero or denormal
+        f = asUInt(asFloat(f + (1 << 23)) - magic);
+
+    return asFloat(f | ((value & 0x8000) << 16));
+}
+
+
+void HalfFloat::toHalf(
+    const float *source
+,   t_half *dest
+,   const unsigned int count)
+{
+    unsigned int i = 0;
+
+#if defined(OSGH_F16C)
+
+    for(; i + 8 <= count; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i)
+            , _mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT));
+
+#elif defined(OSGH_SSE2)
+
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m128i lo = toHalf4(_mm_loadu_ps(source + i));
+        const __m128i hi = toHalf4(_mm_loadu_ps(source + i + 4));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_packs_epi32(lo, hi));
+    }
+
+#endif
+
+    for(; i < count; ++i)
+        dest[i] = toHalf(source[i]);
+}
+
+
+void HalfFloat::toFloat(
+    const t_half *source
+,   float *dest
+,   const unsigned int count)
+{
+    unsigned int i = 0;
+
+#if defined(OSGH_F16C)
+
+    for(; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(dest + i
+            , _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i))));
+
+#elif defined(OSGH_SSE2)
+
+    const __m128i zero = _mm_setzero_si128();
+
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+
+        _mm_storeu_ps(dest + i,     toFloat4(_mm_unpacklo_epi16(h, zero)));
+        _mm_storeu_ps(dest + i + 4, toFloat4(_mm_unpackhi_epi16(h, zero)));
+    }
+
+#endif
+
+    for(; i < count; ++i)
+        dest[i] = toFloat(source[i]);
+}
+
+} // namespace osgHimmel
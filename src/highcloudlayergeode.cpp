@@ -31,10 +31,16 @@
 #include "highcloudlayergeode.h"
 
 #include "noise.h"
+#include "perlinmapgenerator.h"
+#include "noisecache.h"
+#include "random.h"
 #include "himmel.h"
 #include "mathmacros.h"
+#include "earth.h"
 #include "himmelquad.h"
+#include "prerenderednoiserefresh.h"
 #include "timef.h"
+#include "parallelfor.h"
 
 #include "shaderfragment/common.h"
 #include "shaderfragment/bruneton_common.h"
@@ -45,13 +51,16 @@
 
 #include <osg/Texture2D>
 #include <osg/Texture3D>
+#include <osg/Image>
 #include <osg/Geode>
 #include <osg/Depth>
 #include <osg/BlendFunc>
+#include <osg/Timer>
 
 #include <assert.h>
 #include "strutils.h"
 #include <cstdlib>
+#include <vector>
 
 
 namespace osgHimmel
@@ -66,9 +75,10 @@ HighCloudLayerGeode::HighCloudLayerGeode(const int texSize)
 
 ,   m_hquad(new HimmelQuad())
 ,   m_preNoise(NULL)
+,   m_preNoiseRefresh(NULL)
+,   m_evaluator(CloudLayerEvaluator::LM_High)
 ,   m_noiseSize(texSize)
 
-,   u_q(NULL)
 ,   u_preNoise(NULL)
 ,   u_time(NULL)
 
@@ -174,13 +184,7 @@ osg::Group* HighCloudLayerGeode::createPreRenderedNoise(
         "   vec2  m = t * wind;\n"
         "   t *= change;\n"
         "\n"
-        "   n += 1.00000 * texture3D(noise0, vec3(uv     + m * 0.18, t * 0.01)).r;\n"
-        "   n += 0.50000 * texture3D(noise1, vec3(uv     + m * 0.16, t * 0.02)).r;\n"
-        "   n += 0.25000 * texture3D(noise2, vec3(uv     + m * 0.14, t * 0.04)).r;\n"
-        "   n += 0.12500 * texture3D(noise3, vec3(uv     + m * 0.12, t * 0.08)).r;\n"
-        "   n += 0.06750 * texture3D(noise3, vec3(uv * 2 + m * 0.10, t * 0.16)).r;\n"
-        //"   n += 0.06125 * texture3D(noise3, vec3(uv * 4 + m * 0.08, t * 0.32)).r;\n"
-//        "   n += 0.06125 * texture3D(noise2, vec3(uv * 8 + m * 0.06, t * 0.64)).r;\n"
+        "%NOISE_TERMS%"
         "   n *= 0.76;\n"
         "\n"
         "   n = n - 1 + coverage;\n"
@@ -192,6 +196,7 @@ osg::Group* HighCloudLayerGeode::createPreRenderedNoise(
         "}");
 
     replace(fsrc, "%NOISE_SIZE%", static_cast<int>(texSize));
+    replace(fsrc, "%NOISE_TERMS%", PreRenderedNoiseRefresh::termsGlsl());
 
     const std::string vsrc = glsl_version_150()
 
@@ -231,22 +236,21 @@ osg::Group* HighCloudLayerGeode::createPreRenderedNoise(
 
 osg::ref_ptr<osg::Image> HighCloudLayerGeode::createNoiseSlice(
     const unsigned int texSize
-,   const unsigned int octave)
+,   const unsigned int octave
+,   const unsigned int seed)
 {
     const unsigned int size2 = texSize * texSize;
-    const float oneOverTexSize = 1.f / static_cast<float>(texSize);
 
-    Noise n(1 << (octave + 2), _randf(0.f, 1.f), _randf(0.f, 1.f));
+    Random random(seed);
+    const float xOffset = random.nextf();
+    const float yOffset = random.nextf();
+
+    Noise n(1 << (octave + 2), xOffset, yOffset);
 
     float *noise = new float[size2];
-    unsigned int o;
 
-    for(unsigned int s = 0; s < texSize; ++s)
     for(unsigned int t = 0; t < texSize; ++t)
-    {
-        o = t * texSize + s;
-        noise[o] = n.noise2(s * oneOverTexSize, t * oneOverTexSize, octave) * 0.5 + 0.5;
-    }
+        n.noise2Row(texSize, t, octave, noise + t * texSize, 0.5f, 0.5f);
 
     osg::ref_ptr<osg::Image> image = new osg::Image();
     image->setImage(texSize, texSize, 1
@@ -260,14 +264,27 @@ osg::ref_ptr<osg::Image> HighCloudLayerGeode::createNoiseSlice(
 osg::Texture3D *HighCloudLayerGeode::createNoiseArray(
     const unsigned int texSize
 ,   const unsigned int octave
-,   const unsigned int slices)
+,   const unsigned int slices
+,   const unsigned int seed)
 {
-    osg::ref_ptr<osg::Image> image = new osg::Image();
-    image->allocateImage(texSize, texSize, slices, GL_LUMINANCE, GL_FLOAT);
+    osg::ref_ptr<osg::Image> image = NoiseCache::noiseArray(texSize, octave, slices, seed);
+    return createNoiseTexture(image);
+}
 
-    for(unsigned int s = 0; s < slices; ++s)
-        image->copySubImage(0, 0, s, createNoiseSlice(texSize, octave)); 
 
+osg::Texture3D *HighCloudLayerGeode::createPerlinWorleyNoiseArray(
+    const unsigned int texSize
+,   const unsigned int period
+,   const unsigned int slices
+,   const unsigned int seed)
+{
+    osg::ref_ptr<osg::Image> image = NoiseCache::perlinWorleyArray(texSize, period, slices, seed);
+    return createNoiseTexture(image);
+}
+
+
+osg::Texture3D *HighCloudLayerGeode::createNoiseTexture(osg::Image *image)
+{
     osg::Texture3D *texture = new osg::Texture3D(image);
 
     texture->setUnRefImageDataAfterApply(true);
@@ -283,15 +300,181 @@ osg::Texture3D *HighCloudLayerGeode::createNoiseArray(
 }
 
 
+namespace
+{
+    // Fills the rows of a simplex noise volume, one row per index.
+
+    class SimplexRowKernel : public ParallelFor::Kernel
+    {
+    public:
+        SimplexRowKernel(
+            const Noise &noise
+        ,   const unsigned int texSize
+        ,   const unsigned int frequency
+        ,   float *dest)
+        :   m_noise(noise)
+        ,   m_texSize(texSize)
+        ,   m_dest(dest)
+        ,   m_cos(texSize)
+        ,   m_sin(texSize)
+        {
+            // torus radius for frequency lattice cells along its circumference
+            const float radius = static_cast<float>(frequency) / static_cast<float>(_PI2);
+
+            for(unsigned int i = 0; i < texSize; ++i)
+            {
+                const float a = static_cast<float>(_PI2) * i / static_cast<float>(texSize);
+
+                m_cos[i] = cos(a) * radius;
+                m_sin[i] = sin(a) * radius;
+            }
+        }
+
+        virtual void operator()(
+            const int begin
+        ,   const int end)
+        {
+            std::vector<float> x(m_texSize);
+            std::vector<float> y(m_texSize);
+            std::vector<float> z(m_texSize);
+            std::vector<float> w(m_texSize);
+
+            for(int i = begin; i < end; ++i)
+            {
+                const unsigned int r = static_cast<unsigned int>(i) / m_texSize;
+                const unsigned int t = static_cast<unsigned int>(i) % m_texSize;
+
+                // each slice moves half a cell along (1, 1, 1, 1) / 2
+                const float shift = 0.25f * r;
+
+                for(unsigned int s = 0; s < m_texSize; ++s)
+                {
+                    x[s] = m_cos[s] + shift;
+                    y[s] = m_sin[s] + shift;
+                    z[s] = m_cos[t] + shift;
+                    w[s] = m_sin[t] + shift;
+                }
+                m_noise.simplex4(m_texSize, &x[0], &y[0], &z[0], &w[0], m_dest + i * m_texSize, 0.5f, 0.5f);
+            }
+        }
+
+    protected:
+        const Noise &m_noise;
+
+        const unsigned int m_texSize;
+        float *m_dest;
+
+        std::vector<float> m_cos;
+        std::vector<float> m_sin;
+    };
+}
+
+
+osg::Texture3D *HighCloudLayerGeode::createSimplexNoiseArray(
+    const unsigned int texSize
+,   const unsigned int frequency
+,   const unsigned int slices
+,   const unsigned int seed)
+{
+    osg::ref_ptr<osg::Image> image = new osg::Image();
+    image->allocateImage(texSize, texSize, slices, GL_LUMINANCE, GL_FLOAT);
+
+    Random random(seed);
+    const float xOffset = random.nextf();
+    const float yOffset = random.nextf();
+
+    const Noise n(8, xOffset, yOffset);
+
+    SimplexRowKernel kernel(n, texSize, frequency, reinterpret_cast<float*>(image->data()));
+    ParallelFor::run(static_cast<int>(slices * texSize), kernel, 16);
+
+    return createNoiseTexture(image);
+}
+
+
+osg::Texture3D *HighCloudLayerGeode::createTileableNoiseArray(
+    const unsigned int texSize
+,   const unsigned int period
+,   const unsigned int slices
+,   const unsigned int seed)
+{
+    osg::ref_ptr<osg::Image> image = new osg::Image();
+    image->allocateImage(texSize, texSize, slices, GL_LUMINANCE, GL_FLOAT);
+
+    Random random(seed);
+    const float xOffset = random.nextf();
+    const float yOffset = random.nextf();
+
+    PerlinMapGenerator::generateTileable1f(texSize, texSize, slices
+        , reinterpret_cast<float*>(image->data()), period, 1, xOffset, yOffset);
+
+    return createNoiseTexture(image);
+}
+
+
 void HighCloudLayerGeode::update(const Himmel &himmel)
 {
-    // TODO: starmap and planets also require this ... - find better place
-    const float fov = himmel.getCameraFovHint();
-    const float height = himmel.getViewSizeHeightHint();
+    const float time = static_cast<float>(himmel.getTime()->getf());
+    u_time->set(time);
+
+    // the pre rendered noise is only refreshed on visible changes
+
+    float coverage, sharpness, change;
+    osg::Vec2f wind;
+
+    u_coverage->get(coverage);
+    u_sharpness->get(sharpness);
+    u_change->get(change);
+    u_wind->get(wind);
+
+    m_preNoiseRefresh->update(time, coverage, sharpness, change, wind);
+}
+
+
+const CloudLayerEvaluator HighCloudLayerGeode::evaluator(const Himmel &himmel) const
+{
+    CloudLayerEvaluator evaluator(m_evaluator);
+
+    evaluator.setObserver(himmel.getAltitude(), static_cast<float>(Earth::meanRadius()));
+
+    // The noise is evaluated for the inputs of the pre rendered noise, 
+    // which follows the live ones only on visible changes.
+
+    if(m_preNoiseRefresh.valid() && m_preNoiseRefresh->getPassCount() > 0)
+    {
+        evaluator.setTime(m_preNoiseRefresh->getTime());
+        evaluator.setCoverage(m_preNoiseRefresh->getCoverage());
+        evaluator.setSharpness(m_preNoiseRefresh->getSharpness());
+        evaluator.setChange(m_preNoiseRefresh->getChange());
+        evaluator.setWind(m_preNoiseRefresh->getWind());
+    }
+    else
+    {
+        float coverage, sharpness, change;
+        osg::Vec2f wind;
+
+        u_coverage->get(coverage);
+        u_sharpness->get(sharpness);
+        u_change->get(change);
+        u_wind->get(wind);
+
+        evaluator.setTime(static_cast<float>(himmel.getTime()->getf()));
+        evaluator.setCoverage(coverage);
+        evaluator.setSharpness(sharpness);
+        evaluator.setChange(change);
+        evaluator.setWind(wind);
+    }
+
+    float altitude;
+    osg::Vec2f scale;
 
-    u_q->set(static_cast<float>(sqrt(2.0) * 2.0 * tan(_rad(fov * 0.5)) / height));
+    u_altitude->get(altitude);
+    u_scale->get(scale);
 
-    u_time->set(static_cast<float>(himmel.getTime()->getf()));
+    evaluator.setAltitude(altitude);
+    evaluator.setScale(scale);
+
+    return evaluator;
 }
 
 
@@ -319,9 +502,6 @@ void HighCloudLayerGeode::setupShader(osg::StateSet* stateSet)
 
 void HighCloudLayerGeode::setupUniforms(osg::StateSet *stateSet)
 {
-    u_q = new osg::Uniform("q", 0.0f);
-    stateSet->addUniform(u_q);
-
     u_preNoise = new osg::Uniform("noise", 0);
     stateSet->addUniform(u_preNoise);
 
@@ -359,8 +539,6 @@ void HighCloudLayerGeode::setupUniforms(osg::StateSet *stateSet)
 
 void HighCloudLayerGeode::setupTextures(osg::StateSet* stateSet)
 {
-    srand(time(NULL));
-
     m_preNoise = new osg::Texture2D;
 
     osg::Group *preNoise(createPreRenderedNoise(m_noiseSize, m_preNoise));
@@ -372,12 +550,34 @@ void HighCloudLayerGeode::setupTextures(osg::StateSet* stateSet)
     // TODO: the use of m_noise as an array insead of a texture array was due to problems
     // with osg and not enough time and vigor to fix this.. :D
 
-    m_noise[0] = createNoiseArray(1 << 6, 3, 4);
-    m_noise[1] = createNoiseArray(1 << 7, 4, 4);
-    m_noise[2] = createNoiseArray(1 << 8, 5, 4);
-    m_noise[3] = createNoiseArray(1 << 8, 6, 4);
+    const osg::Timer_t t = osg::Timer::instance()->tick();
+
+    const unsigned int seed = Random::globalSeed();
+
+    const unsigned int slices = PreRenderedNoiseRefresh::numSlices();
+
+    m_noise[0] = createNoiseArray(1 << 6, 3, slices, seed);
+    m_noise[1] = createNoiseArray(1 << 7, 4, slices, seed);
+    m_noise[2] = createNoiseArray(1 << 8, 5, slices, seed);
+    m_noise[3] = createNoiseArray(1 << 8, 6, slices, seed);
+
+    // the pre render pass and its refresh assume these sizes
+    for(unsigned int i = 0; i < PreRenderedNoiseRefresh::numTerms(); ++i)
+        assert(m_noise[PreRenderedNoiseRefresh::term(i).array]->getImage()->s() 
+            == static_cast<int>(PreRenderedNoiseRefresh::term(i).size));
+
+    for(unsigned int i = 0; i < 4; ++i)
+    {
+        osg::Image *image(m_noise[i]->getImage());
+        m_evaluator.setNoiseArray(i, reinterpret_cast<const float*>(image->data())
+            , image->s(), image->r(), image);
+    }
+
+    OSG_INFO << "High cloud layer noise generated (took " 
+        << osg::Timer::instance()->delta_m(t, osg::Timer::instance()->tick()) << " ms)" << std::endl;
 
-    pnStateSet->addUniform(u_time);
+    // time, coverage, sharpness, change, and wind of the pass are snapshots
+    m_preNoiseRefresh = new PreRenderedNoiseRefresh(preNoise, m_noiseSize);
 
     pnStateSet->addUniform(u_noise0);
     u_noise0->set(1);
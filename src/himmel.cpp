@@ -42,6 +42,7 @@
 #include "highcloudlayergeode.h"
 #include "dubecloudlayergeode.h"
 
+#include <osg/Camera>
 #include <osg/ShapeDrawable>
 
 #include <stdlib.h>
@@ -96,19 +97,27 @@ Himmel::Himmel(
 ,   DubeCloudLayerGeode *dubeLayer
 ,   AbstractAstronomy *astronomy)
 :   AbstractHimmel()
-,   m_starmap(milkyWay)
+,   u_sun(NULL)
+,   u_sunr(NULL)
+,   u_time(NULL)
+,   u_common(NULL)
+,   u_R(NULL)
+,   u_q(NULL)
+,   m_fov(-1.f)
+,   m_aspectRatio(0.f)
+,   m_height(0)
+,   m_uniformUpdates(0)
+
+,   m_astronomy(astronomy)
+,   m_atmosphere(atmosphere)
 ,   m_moon(moon)
 ,   m_moonGlare(NULL)
 ,   m_stars(stars)
-,   m_atmosphere(atmosphere)
+,   m_starmap(milkyWay)
 ,   m_highLayer(highLayer)
 ,   m_dubeLayer(dubeLayer)
-,   m_astronomy(astronomy)
-
-,   u_sun(NULL)
-,   u_sunr(NULL)
-,   u_time(NULL)
-,   u_common(NULL)
+,   m_harmonics(NULL)
+,   m_random(Random::globalSeed())
 {
     assert(m_astronomy);
 
@@ -128,6 +137,15 @@ Himmel::Himmel(
     u_common = cmnUniform();
     getOrCreateStateSet()->addUniform(u_common);
 
+    // The view dependent uniforms are shared by all geodes, instead of 
+    // each geode computing them (the moon overrides R).
+
+    u_R = new osg::Uniform("R", osg::Matrixf::identity());
+    getOrCreateStateSet()->addUniform(u_R);
+
+    u_q = new osg::Uniform("q", 0.f);
+    getOrCreateStateSet()->addUniform(u_q);
+
 
     int bin = 0;
     static const std::string binName("RenderBin");
@@ -215,7 +233,10 @@ void Himmel::update()
 {
     AbstractHimmel::update();
 
+    m_uniformUpdates = 0;
+
     updateSeed();
+    updateView();
 
     if(isDirty())
     {
@@ -224,21 +245,23 @@ void Himmel::update()
 
         osg::Vec3f sunv = astro()->getSunPosition(false);
         u_sun->set(sunv);
+        ++m_uniformUpdates;
 
         osg::Vec3f sunrv = astro()->getSunPosition(true);
         u_sunr->set(sunrv);
+        ++m_uniformUpdates;
 
         u_time->set(static_cast<float>(getTime()->getf()));
+        ++m_uniformUpdates;
+
+        u_R->set(astro()->getEquToHorTransform());
+        ++m_uniformUpdates;
 
-        if(m_starmap)
-            m_starmap->update(*this);
         if(m_moon)
         {
             m_moon->update(*this);
             //m_moonGlare->update(*this);
         }
-        if(m_stars)
-            m_stars->update(*this);
         if(m_atmosphere)
             m_atmosphere->update(*this);
         if(m_highLayer)
@@ -247,8 +270,15 @@ void Himmel::update()
         if(m_dubeLayer)
             m_dubeLayer->update(*this);
 
+        if(m_harmonics)
+            m_harmonics->update(*this);
+
         dirty(false);
     }
+
+    // the view may change independently of time
+    if(m_stars)
+        m_stars->updateView(*this);
 }
 
 
@@ -257,8 +287,79 @@ void Himmel::updateSeed()
     osg::Vec4f temp; 
     u_common->get(temp);
 
-    temp[3] = rand();
+    // 24 bits are exactly representable by the float uniform
+    temp[3] = static_cast<float>(m_random.next() >> 8);
     u_common->set(temp);
+
+    ++m_uniformUpdates;
+}
+
+
+void Himmel::updateView()
+{
+    // A single decomposition of the projection per frame, q is updated 
+    // only if the fov or the view size changed.
+
+    double fov(0.0), aspectRatio(0.0), zNear, zFar;
+    if(!m_cameraHint || !m_cameraHint->getProjectionMatrixAsPerspective(fov, aspectRatio, zNear, zFar))
+        fov = aspectRatio = 0.0;
+
+    // the height hint is 0 until set, which would make q infinite
+    const unsigned int height = _ma(1u, getViewSizeHeightHint());
+
+    if(static_cast<float>(fov) == m_fov && static_cast<float>(aspectRatio) == m_aspectRatio 
+    && height == m_height)
+        return;
+
+    m_fov = static_cast<float>(fov);
+    m_aspectRatio = static_cast<float>(aspectRatio);
+    m_height = height;
+
+    u_q->set(static_cast<float>(sqrt(2.0) * 2.0 * tan(_rad(fov * 0.5)) / height));
+
+    ++m_uniformUpdates;
+}
+
+
+const float Himmel::getViewFov() const
+{
+    return m_fov;
+}
+
+const float Himmel::getViewAspectRatio() const
+{
+    return m_aspectRatio;
+}
+
+const float Himmel::getViewQ() const
+{
+    float q;
+    u_q->get(q);
+
+    return q;
+}
+
+
+const unsigned int Himmel::getUniformUpdateCount() const
+{
+    return m_uniformUpdates;
+}
+
+
+void Himmel::setHarmonics(SkyHarmonics *harmonics)
+{
+    if(m_harmonics)
+        getOrCreateStateSet()->removeUniform(m_harmonics->getUniform());
+
+    m_harmonics = harmonics;
+
+    if(m_harmonics)
+    {
+        getOrCreateStateSet()->addUniform(m_harmonics->getUniform());
+
+        m_harmonics->dirty();
+        dirty();
+    }
 }
 
 
@@ -277,6 +378,15 @@ const osg::Vec3f Himmel::getSunPosition(const t_aTime &aTime) const
 }
 
 
+const osg::Matrixf Himmel::getEquToHorTransform() const
+{
+    osg::Matrixf R;
+    u_R->get(R);
+
+    return R;
+}
+
+
 const float Himmel::setLatitude(const float latitude)
 {
     assert(m_astronomy);
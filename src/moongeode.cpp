@@ -74,7 +74,6 @@ MoonGeode::MoonGeode(const char* cubeMapFilePath)
 ,   u_moonCube(NULL)
 
 ,   u_R(NULL)
-,   u_q(NULL)
 
 ,   u_sunShine(NULL)    // [0,1,2] = color; [3] = intensity
 ,   u_earthShine(NULL)  // [0,1,2] = color;
@@ -123,14 +122,6 @@ void MoonGeode::update(const Himmel &himmel)
         * himmel.astro()->getEarthShineIntensity() * m_earthShineScale);
 
 
-    // TODO: starmap and planets  and stars also require / use this ... - find better place 
-    // issue 11..
-    const float fov = himmel.getCameraFovHint();
-    const float height = himmel.getViewSizeHeightHint();
- 
-    u_q->set(static_cast<float>(tan(_rad(fov * 0.5)) / (height * 0.5)));
-
-
     // approximate umbra and penumbra size in moon radii
 
     float e0 = 0, e1 = 0, e2 = 0;
@@ -204,9 +195,7 @@ void MoonGeode::setupUniforms(osg::StateSet* stateSet)
     u_eclParams = new osg::Uniform("eclParams", osg::Vec4f(0.f, 0.f, 0.f, -1.f));
     stateSet->addUniform(u_eclParams);
 
-    u_q = new osg::Uniform("q", 0.0f);
-    stateSet->addUniform(u_q);
-
+    // q is shared by the himmel, R overrides its equatorial to horizontal one
     u_R = new osg::Uniform("R", osg::Matrixf());
     stateSet->addUniform(u_R);
 
@@ -607,7 +596,7 @@ const std::string MoonGeode::getFragmentShaderSource()
         "\n"
 
         "    float zz = 1.0 - x * x - y * y;\n"
-        "    float w  = smoothstep(0.0, 2.828 * q / moon.a, zz);\n" // fov and size indepentent antialiasing 
+        "    float w  = smoothstep(0.0, 2.0 * q / moon.a, zz);\n" // fov and size indepentent antialiasing 
         "    if(w <= 0.0)\n"
         "        discard;\n"
         "\n"
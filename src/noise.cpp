@@ -33,6 +33,7 @@
 #include "mathmacros.h"
 #include "interpolate.h"
 #include "strutils.h"
+#include "simd.h"
 
 #include "shaderfragment/noise.h"
 
@@ -100,11 +101,20 @@ const unsigned int Noise::hash(
 ,   const unsigned int y
 ,   const unsigned int r) const
 {
-    assert(1 << r <= PERMSIZE);
+    assert((1u << r) <= PERMSIZE);
     return m_perm[(m_perm[x & ((1 << r) - 1)] + y) & ((1 << r) - 1)];
 }
 
 
+const unsigned int Noise::hash3(
+    const unsigned int x
+,   const unsigned int y
+,   const unsigned int z) const
+{
+    return m_perm[(m_perm[(m_perm[x & MAXPERMINDEX] + y) & MAXPERMINDEX] + z) & MAXPERMINDEX];
+}
+
+
 const osg::Vec2f Noise::grad2(
     const unsigned int x
 ,   const unsigned int y) const
@@ -277,7 +287,748 @@ const float Noise::noise2(
     return mix(i[0], i[1], fade(f[1]));
 }
 
-// TODO - add tileable variant
+namespace
+{
+    // texels processed per block of noise2Row (gathered, then computed in lanes)
+    const unsigned int ROW_BLOCK(64);
+
+#ifdef OSGH_SSE2
+
+    inline __m128 fade4(const __m128 t)
+    {
+        // same operation order as _smootherstep
+        const __m128 t3 = _mm_mul_ps(_mm_mul_ps(t, t), t);
+        const __m128 p  = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(6.f), t), _mm_set1_ps(15.f))), _mm_set1_ps(10.f));
+        return _mm_mul_ps(t3, p);
+    }
+
+    inline __m128 mix4(
+        const __m128 x
+    ,   const __m128 y
+    ,   const __m128 a)
+    {
+        return _mm_add_ps(_mm_mul_ps(x, _mm_sub_ps(_mm_set1_ps(1.f), a)), _mm_mul_ps(y, a));
+    }
+
+#endif // OSGH_SSE2
+}
+
+
+void Noise::noise2Row(
+    const unsigned int size
+,   const unsigned int row
+,   const unsigned int r
+,   float *dest
+,   const float scale
+,   const float bias) const
+{
+    noise2Line(size, row * (1.f / static_cast<float>(size)), r, dest, scale, bias);
+}
+
+
+void Noise::noise2Line(
+    const unsigned int size
+,   float t
+,   const unsigned int r
+,   float *dest
+,   const float scale
+,   const float bias) const
+{
+    assert((1u << r) <= PERMSIZE);
+
+    const unsigned int mask = (1 << r) - 1;
+    const float oneOverSize = 1.f / static_cast<float>(size);
+
+    // everything depending on t only is evaluated once per row
+
+    t += m_yoff;
+    t *= 1 << r;
+
+    const float it = floor(t);
+    const float ft = _frac(t);
+    const float ft1 = ft - 1.f;
+    const float v = fade(ft);
+
+    const unsigned int y0 = static_cast<unsigned int>(it + 0);
+    const unsigned int y1 = static_cast<unsigned int>(it + 1);
+
+    // gradient indices of both rows per (masked) cell
+
+    unsigned char g0[PERMSIZE];
+    unsigned char g1[PERMSIZE];
+
+    for(unsigned int x = 0; x <= mask; ++x)
+    {
+        g0[x] = hash(x, y0, r) & 0xf;
+        g1[x] = hash(x, y1, r) & 0xf;
+    }
+
+    // gathered per texel of a block
+
+    float fs[ROW_BLOCK];
+    float gx[4][ROW_BLOCK];
+    float gy[4][ROW_BLOCK];
+
+    for(unsigned int b = 0; b < size; b += ROW_BLOCK)
+    {
+        const unsigned int n = _mi(ROW_BLOCK, size - b);
+
+        for(unsigned int i = 0; i < n; ++i)
+        {
+            float s = (b + i) * oneOverSize;
+            s += m_xoff;
+            s *= 1 << r;
+
+            const float is = floor(s);
+            fs[i] = _frac(s);
+
+            const unsigned int x0 = static_cast<unsigned int>(is + 0) & mask;
+            const unsigned int x1 = static_cast<unsigned int>(is + 1) & mask;
+
+            gx[0][i] = m_grad[g0[x0]][0]; gy[0][i] = m_grad[g0[x0]][1];
+            gx[1][i] = m_grad[g0[x1]][0]; gy[1][i] = m_grad[g0[x1]][1];
+            gx[2][i] = m_grad[g1[x0]][0]; gy[2][i] = m_grad[g1[x0]][1];
+            gx[3][i] = m_grad[g1[x1]][0]; gy[3][i] = m_grad[g1[x1]][1];
+        }
+
+        float *d = dest + b;
+        unsigned int i = 0;
+
+#ifdef OSGH_SSE2
+
+        const __m128 ft4  = _mm_set1_ps(ft);
+        const __m128 ft14 = _mm_set1_ps(ft1);
+        const __m128 v4   = _mm_set1_ps(v);
+        const __m128 one  = _mm_set1_ps(1.f);
+
+        for(; i + 4 <= n; i += 4)
+        {
+            const __m128 f  = _mm_loadu_ps(fs + i);
+            const __m128 f1 = _mm_sub_ps(f, one);
+
+            const __m128 aa = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(gx[0] + i), f ), _mm_mul_ps(_mm_loadu_ps(gy[0] + i), ft4));
+            const __m128 ba = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(gx[1] + i), f1), _mm_mul_ps(_mm_loadu_ps(gy[1] + i), ft4));
+            const __m128 ab = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(gx[2] + i), f ), _mm_mul_ps(_mm_loadu_ps(gy[2] + i), ft14));
+            const __m128 bb = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(gx[3] + i), f1), _mm_mul_ps(_mm_loadu_ps(gy[3] + i), ft14));
+
+            const __m128 u = fade4(f);
+            const __m128 noise = mix4(mix4(aa, ba, u), mix4(ab, bb, u), v4);
+
+            _mm_storeu_ps(d + i, _mm_add_ps(_mm_mul_ps(noise, _mm_set1_ps(scale)), _mm_set1_ps(bias)));
+        }
+
+#endif // OSGH_SSE2
+
+        for(; i < n; ++i)
+        {
+            const float f  = fs[i];
+            const float f1 = f - 1.f;
+
+            const float aa = gx[0][i] * f  + gy[0][i] * ft;
+            const float ba = gx[1][i] * f1 + gy[1][i] * ft;
+            const float ab = gx[2][i] * f  + gy[2][i] * ft1;
+            const float bb = gx[3][i] * f1 + gy[3][i] * ft1;
+
+            const float u = fade(f);
+            d[i] = mix(mix(aa, ba, u), mix(ab, bb, u), v) * scale + bias;
+        }
+    }
+}
+
+namespace
+{
+    // Returns the lattice cell of x wrapped into [0;period) and the fraction.
+
+    inline const unsigned int wrap(
+        const float x
+    ,   const unsigned int period
+    ,   float &f)
+    {
+        const float i = floor(x);
+        f = x - i;
+
+        const int p = static_cast<int>(period);
+        const int w = static_cast<int>(i) % p;
+
+        return static_cast<unsigned int>(w < 0 ? w + p : w);
+    }
+}
+
+
+const float Noise::pnoise2(
+    const float x
+,   const float y
+,   const unsigned int px
+,   const unsigned int py) const
+{
+    assert(px > 0 && py > 0);
+
+    // the offsets shift the hashed lattice after wrapping, keeping the period
+
+    const unsigned int ox = static_cast<unsigned int>(m_xoff * PERMSIZE);
+    const unsigned int oy = static_cast<unsigned int>(m_yoff * PERMSIZE);
+
+    float fx, fy;
+
+    const unsigned int x0 = wrap(x, px, fx);
+    const unsigned int y0 = wrap(y, py, fy);
+
+    const unsigned int x1 = (x0 + 1) % px + ox;
+    const unsigned int y1 = (y0 + 1) % py + oy;
+
+    const unsigned char h00 = hash(x0 + ox, y0 + oy) & 0xf;
+    const unsigned char h10 = hash(x1,      y0 + oy) & 0xf;
+    const unsigned char h01 = hash(x0 + ox, y1     ) & 0xf;
+    const unsigned char h11 = hash(x1,      y1     ) & 0xf;
+
+    // range [-1;+1]
+
+    const float aa = m_grad[h00][0] *  fx        + m_grad[h00][1] *  fy;
+    const float ba = m_grad[h10][0] * (fx - 1.f) + m_grad[h10][1] *  fy;
+    const float ab = m_grad[h01][0] *  fx        + m_grad[h01][1] * (fy - 1.f);
+    const float bb = m_grad[h11][0] * (fx - 1.f) + m_grad[h11][1] * (fy - 1.f);
+
+    const float u = fade(fx);
+
+    return mix(mix(aa, ba, u), mix(ab, bb, u), fade(fy));
+}
+
+
+const float Noise::pnoise3(
+    const float x
+,   const float y
+,   const float z
+,   const unsigned int px
+,   const unsigned int py
+,   const unsigned int pz) const
+{
+    assert(px > 0 && py > 0 && pz > 0);
+
+    const unsigned int ox = static_cast<unsigned int>(m_xoff * PERMSIZE);
+    const unsigned int oy = static_cast<unsigned int>(m_yoff * PERMSIZE);
+
+    float fx, fy, fz;
+
+    const unsigned int x0 = wrap(x, px, fx);
+    const unsigned int y0 = wrap(y, py, fy);
+    const unsigned int z0 = wrap(z, pz, fz);
+
+    const unsigned int xi[2] = { x0 + ox, (x0 + 1) % px + ox };
+    const unsigned int yi[2] = { y0 + oy, (y0 + 1) % py + oy };
+    const unsigned int zi[2] = { z0, (z0 + 1) % pz };
+
+    float n[2][2][2];
+
+    for(unsigned int k = 0; k < 2; ++k)
+    for(unsigned int j = 0; j < 2; ++j)
+    for(unsigned int i = 0; i < 2; ++i)
+    {
+        const float *g = m_grad[hash3(xi[i], yi[j], zi[k]) & 0xf];
+        n[k][j][i] = g[0] * (fx - i) + g[1] * (fy - j) + g[2] * (fz - k);
+    }
+
+    const float u = fade(fx);
+    const float v = fade(fy);
+
+    return mix(
+        mix(mix(n[0][0][0], n[0][0][1], u), mix(n[0][1][0], n[0][1][1], u), v)
+    ,   mix(mix(n[1][0][0], n[1][0][1], u), mix(n[1][1][0], n[1][1][1], u), v)
+    ,   fade(fz));
+}
+
+
+// Simplex noise from (Simplex noise demystified - Gustavson - 2005)
+// http://webstaff.itn.liu.se/~stegu/simplexnoise/simplexnoise.pdf
+
+namespace
+{
+    const float F3(1.f / 3.f);
+    const float G3(1.f / 6.f);
+    const float F4(0.309016994f); // (sqrt(5) - 1) / 4
+    const float G4(0.138196601f); // (5 - sqrt(5)) / 20
+
+    // scales the sum of the corner contributions to [-1;+1]
+    const float SIMPLEX3_SCALE(32.f);
+    const float SIMPLEX4_SCALE(27.f);
+
+    const float GRAD4[32][4] =
+    {
+            { 0.f, 1.f, 1.f, 1.f}, { 0.f, 1.f, 1.f,-1.f}, { 0.f, 1.f,-1.f, 1.f}, { 0.f, 1.f,-1.f,-1.f}
+        ,   { 0.f,-1.f, 1.f, 1.f}, { 0.f,-1.f, 1.f,-1.f}, { 0.f,-1.f,-1.f, 1.f}, { 0.f,-1.f,-1.f,-1.f}
+        ,   { 1.f, 0.f, 1.f, 1.f}, { 1.f, 0.f, 1.f,-1.f}, { 1.f, 0.f,-1.f, 1.f}, { 1.f, 0.f,-1.f,-1.f}
+        ,   {-1.f, 0.f, 1.f, 1.f}, {-1.f, 0.f, 1.f,-1.f}, {-1.f, 0.f,-1.f, 1.f}, {-1.f, 0.f,-1.f,-1.f}
+        ,   { 1.f, 1.f, 0.f, 1.f}, { 1.f, 1.f, 0.f,-1.f}, { 1.f,-1.f, 0.f, 1.f}, { 1.f,-1.f, 0.f,-1.f}
+        ,   {-1.f, 1.f, 0.f, 1.f}, {-1.f, 1.f, 0.f,-1.f}, {-1.f,-1.f, 0.f, 1.f}, {-1.f,-1.f, 0.f,-1.f}
+        ,   { 1.f, 1.f, 1.f, 0.f}, { 1.f, 1.f,-1.f, 0.f}, { 1.f,-1.f, 1.f, 0.f}, { 1.f,-1.f,-1.f, 0.f}
+        ,   {-1.f, 1.f, 1.f, 0.f}, {-1.f, 1.f,-1.f, 0.f}, {-1.f,-1.f, 1.f, 0.f}, {-1.f,-1.f,-1.f, 0.f}
+    };
+
+    inline const int fastfloor(const float x)
+    {
+        const int i = static_cast<int>(x);
+        return x < i ? i - 1 : i;
+    }
+
+
+    // Contributions of a simplex corner with relative position d and gradient g.
+
+    inline const float corner3(
+        const float dx
+    ,   const float dy
+    ,   const float dz
+    ,   const float gx
+    ,   const float gy
+    ,   const float gz)
+    {
+        float t = 0.6f - dx * dx - dy * dy - dz * dz;
+        t = t < 0.f ? 0.f : t;
+        t *= t;
+
+        return t * t * (gx * dx + gy * dy + gz * dz);
+    }
+
+    inline const float corner4(
+        const float dx
+    ,   const float dy
+    ,   const float dz
+    ,   const float dw
+    ,   const float gx
+    ,   const float gy
+    ,   const float gz
+    ,   const float gw)
+    {
+        float t = 0.6f - dx * dx - dy * dy - dz * dz - dw * dw;
+        t = t < 0.f ? 0.f : t;
+        t *= t;
+
+        return t * t * (gx * dx + gy * dy + gz * dz + gw * dw);
+    }
+
+#ifdef OSGH_SSE2
+
+    inline __m128 corner3x4(
+        const __m128 dx
+    ,   const __m128 dy
+    ,   const __m128 dz
+    ,   const __m128 gx
+    ,   const __m128 gy
+    ,   const __m128 gz)
+    {
+        // same operation order as corner3
+        __m128 t = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.6f)
+            , _mm_mul_ps(dx, dx)), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        t = _mm_max_ps(t, _mm_setzero_ps());
+        t = _mm_mul_ps(t, t);
+
+        const __m128 g = _mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, dx), _mm_mul_ps(gy, dy)), _mm_mul_ps(gz, dz));
+        return _mm_mul_ps(_mm_mul_ps(t, t), g);
+    }
+
+    inline __m128 corner4x4(
+        const __m128 dx
+    ,   const __m128 dy
+    ,   const __m128 dz
+    ,   const __m128 dw
+    ,   const __m128 gx
+    ,   const __m128 gy
+    ,   const __m128 gz
+    ,   const __m128 gw)
+    {
+        // same operation order as corner4
+        __m128 t = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.6f)
+            , _mm_mul_ps(dx, dx)), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)), _mm_mul_ps(dw, dw));
+        t = _mm_max_ps(t, _mm_setzero_ps());
+        t = _mm_mul_ps(t, t);
+
+        const __m128 g = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, dx)
+            , _mm_mul_ps(gy, dy)), _mm_mul_ps(gz, dz)), _mm_mul_ps(gw, dw));
+        return _mm_mul_ps(_mm_mul_ps(t, t), g);
+    }
+
+
+    inline __m128i floor4(const __m128 x)
+    {
+        // same as fastfloor: truncation is corrected where it rounded up
+        const __m128i i = _mm_cvttps_epi32(x);
+        return _mm_add_epi32(i, _mm_castps_si128(_mm_cmplt_ps(x, _mm_cvtepi32_ps(i))));
+    }
+
+#endif // OSGH_SSE2
+
+
+    // Per point setup of the corners of a simplex: relative positions are 
+    // written to d[corner][axis], gradients to g[corner].
+
+// permutation lookup, undefined after the batch simplex noise
+#define P(v) perm[(v) & MAXPERMINDEX]
+
+    inline void setupSimplex3(
+        const unsigned char *perm
+    ,   const float (*grad)[3]
+    ,   const unsigned int ox
+    ,   const unsigned int oy
+    ,   const float x
+    ,   const float y
+    ,   const float z
+    ,   float d[4][3]
+    ,   const float *g[4])
+    {
+        const float s = (x + y + z) * F3;
+
+        const int i = fastfloor(x + s);
+        const int j = fastfloor(y + s);
+        const int k = fastfloor(z + s);
+
+        const float t = static_cast<float>(i + j + k) * G3;
+
+        d[0][0] = x - (i - t);
+        d[0][1] = y - (j - t);
+        d[0][2] = z - (k - t);
+
+        // offsets of the second and third corner (simplex traversal order),
+        // branch free since the order is hardly predictable
+
+        const int xy = d[0][0] >= d[0][1] ? 1 : 0;
+        const int yz = d[0][1] >= d[0][2] ? 1 : 0;
+        const int xz = d[0][0] >= d[0][2] ? 1 : 0;
+
+        const int o1[3] = { xy & xz, (1 - xy) & yz, (1 - xz) & (1 - yz) };
+        const int o2[3] = { xy | xz, (1 - xy) | yz, 1 - (xz & yz) };
+
+        for(int n = 0; n < 3; ++n)
+        {
+            d[1][n] = d[0][n] - o1[n] + G3;
+            d[2][n] = d[0][n] - o2[n] + 2.f * G3;
+            d[3][n] = d[0][n] - 1.f + 3.f * G3;
+        }
+
+        const unsigned int ii = static_cast<unsigned int>(i) + ox;
+        const unsigned int jj = static_cast<unsigned int>(j) + oy;
+        const unsigned int kk = static_cast<unsigned int>(k);
+
+        g[0] = grad[P(ii         + P(jj         + P(kk        ))) % 12];
+        g[1] = grad[P(ii + o1[0] + P(jj + o1[1] + P(kk + o1[2]))) % 12];
+        g[2] = grad[P(ii + o2[0] + P(jj + o2[1] + P(kk + o2[2]))) % 12];
+        g[3] = grad[P(ii + 1     + P(jj + 1     + P(kk + 1    ))) % 12];
+    }
+
+    inline void setupSimplex4(
+        const unsigned char *perm
+    ,   const unsigned int ox
+    ,   const unsigned int oy
+    ,   const float x
+    ,   const float y
+    ,   const float z
+    ,   const float w
+    ,   float d[5][4]
+    ,   const float *g[5])
+    {
+        const float s = (x + y + z + w) * F4;
+
+        const int i = fastfloor(x + s);
+        const int j = fastfloor(y + s);
+        const int k = fastfloor(z + s);
+        const int l = fastfloor(w + s);
+
+        const float t = static_cast<float>(i + j + k + l) * G4;
+
+        d[0][0] = x - (i - t);
+        d[0][1] = y - (j - t);
+        d[0][2] = z - (k - t);
+        d[0][3] = w - (l - t);
+
+        // rank the components by magnitude to find the simplex
+
+        int rank[4] = { 0, 0, 0, 0 };
+
+        for(int a = 0; a < 3; ++a)
+        for(int b = a + 1; b < 4; ++b)
+            ++rank[d[0][a] > d[0][b] ? a : b];
+
+        int o[3][4];
+
+        for(int n = 0; n < 4; ++n)
+        {
+            o[0][n] = rank[n] >= 3 ? 1 : 0;
+            o[1][n] = rank[n] >= 2 ? 1 : 0;
+            o[2][n] = rank[n] >= 1 ? 1 : 0;
+
+            d[1][n] = d[0][n] - o[0][n] + G4;
+            d[2][n] = d[0][n] - o[1][n] + 2.f * G4;
+            d[3][n] = d[0][n] - o[2][n] + 3.f * G4;
+            d[4][n] = d[0][n] - 1.f + 4.f * G4;
+        }
+
+        const unsigned int ii = static_cast<unsigned int>(i) + ox;
+        const unsigned int jj = static_cast<unsigned int>(j) + oy;
+        const unsigned int kk = static_cast<unsigned int>(k);
+        const unsigned int ll = static_cast<unsigned int>(l);
+
+        g[0] = GRAD4[P(ii           + P(jj           + P(kk           + P(ll          )))) % 32];
+        g[1] = GRAD4[P(ii + o[0][0] + P(jj + o[0][1] + P(kk + o[0][2] + P(ll + o[0][3])))) % 32];
+        g[2] = GRAD4[P(ii + o[1][0] + P(jj + o[1][1] + P(kk + o[1][2] + P(ll + o[1][3])))) % 32];
+        g[3] = GRAD4[P(ii + o[2][0] + P(jj + o[2][1] + P(kk + o[2][2] + P(ll + o[2][3])))) % 32];
+        g[4] = GRAD4[P(ii + 1       + P(jj + 1       + P(kk + 1       + P(ll + 1      )))) % 32];
+    }
+}
+
+
+const float Noise::simplex3(
+    const float x
+,   const float y
+,   const float z) const
+{
+    float d[4][3];
+    const float *g[4];
+
+    setupSimplex3(m_perm, m_grad
+        , static_cast<unsigned int>(m_xoff * PERMSIZE), static_cast<unsigned int>(m_yoff * PERMSIZE)
+        , x, y, z, d, g);
+
+    float n = 0.f;
+    for(int c = 0; c < 4; ++c)
+        n += corner3(d[c][0], d[c][1], d[c][2], g[c][0], g[c][1], g[c][2]);
+
+    return SIMPLEX3_SCALE * n;
+}
+
+
+const float Noise::simplex4(
+    const float x
+,   const float y
+,   const float z
+,   const float w) const
+{
+    float d[5][4];
+    const float *g[5];
+
+    setupSimplex4(m_perm
+        , static_cast<unsigned int>(m_xoff * PERMSIZE), static_cast<unsigned int>(m_yoff * PERMSIZE)
+        , x, y, z, w, d, g);
+
+    float n = 0.f;
+    for(int c = 0; c < 5; ++c)
+        n += corner4(d[c][0], d[c][1], d[c][2], d[c][3], g[c][0], g[c][1], g[c][2], g[c][3]);
+
+    return SIMPLEX4_SCALE * n;
+}
+
+
+void Noise::simplex3(
+    const unsigned int count
+,   const float *x
+,   const float *y
+,   const float *z
+,   float *dest
+,   const float scale
+,   const float bias) const
+{
+    unsigned int i = 0;
+
+#ifdef OSGH_SSE2
+
+    // Four points are processed per step: skewing, cell and corner positions 
+    // in lanes, the hashing is gathered per lane.
+
+    const unsigned char *perm = m_perm;
+
+    const unsigned int ox = static_cast<unsigned int>(m_xoff * PERMSIZE);
+    const unsigned int oy = static_cast<unsigned int>(m_yoff * PERMSIZE);
+
+    const __m128 one   = _mm_set1_ps(1.f);
+    const __m128 f3    = _mm_set1_ps(F3);
+    const __m128 g3[3] = { _mm_set1_ps(G3), _mm_set1_ps(2.f * G3), _mm_set1_ps(3.f * G3) };
+
+    int cell[3][4];
+    int o1[3][4];
+    int o2[3][4];
+
+    float g[4][3][4]; // corner, axis, lane
+
+    for(; i + 4 <= count; i += 4)
+    {
+        const __m128 p[3] = { _mm_loadu_ps(x + i), _mm_loadu_ps(y + i), _mm_loadu_ps(z + i) };
+
+        const __m128 s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(p[0], p[1]), p[2]), f3);
+
+        __m128i c[3];
+        for(int a = 0; a < 3; ++a)
+            c[a] = floor4(_mm_add_ps(p[a], s));
+
+        const __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_add_epi32(c[0], c[1]), c[2])), g3[0]);
+
+        __m128 d[4][3];
+        for(int a = 0; a < 3; ++a)
+            d[0][a] = _mm_sub_ps(p[a], _mm_sub_ps(_mm_cvtepi32_ps(c[a]), t));
+
+        // same traversal order as setupSimplex3
+
+        const __m128 xy = _mm_cmpge_ps(d[0][0], d[0][1]);
+        const __m128 yz = _mm_cmpge_ps(d[0][1], d[0][2]);
+        const __m128 xz = _mm_cmpge_ps(d[0][0], d[0][2]);
+
+        const __m128 f1[3] = { 
+            _mm_and_ps(_mm_and_ps(xy, xz), one)
+        ,   _mm_and_ps(_mm_andnot_ps(xy, yz), one)
+        ,   _mm_andnot_ps(_mm_or_ps(xz, yz), one) };
+        const __m128 f2[3] = { 
+            _mm_and_ps(_mm_or_ps(xy, xz), one)
+        ,   _mm_andnot_ps(_mm_andnot_ps(yz, xy), one)
+        ,   _mm_andnot_ps(_mm_and_ps(xz, yz), one) };
+
+        for(int a = 0; a < 3; ++a)
+        {
+            d[1][a] = _mm_add_ps(_mm_sub_ps(d[0][a], f1[a]), g3[0]);
+            d[2][a] = _mm_add_ps(_mm_sub_ps(d[0][a], f2[a]), g3[1]);
+            d[3][a] = _mm_add_ps(_mm_sub_ps(d[0][a], one), g3[2]);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(cell[a]), c[a]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o1[a]), _mm_cvttps_epi32(f1[a]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o2[a]), _mm_cvttps_epi32(f2[a]));
+        }
+
+        for(int l = 0; l < 4; ++l)
+        {
+            const unsigned int ii = static_cast<unsigned int>(cell[0][l]) + ox;
+            const unsigned int jj = static_cast<unsigned int>(cell[1][l]) + oy;
+            const unsigned int kk = static_cast<unsigned int>(cell[2][l]);
+
+            const float *gl[4] = {
+                m_grad[P(ii            + P(jj            + P(kk           ))) % 12]
+            ,   m_grad[P(ii + o1[0][l] + P(jj + o1[1][l] + P(kk + o1[2][l]))) % 12]
+            ,   m_grad[P(ii + o2[0][l] + P(jj + o2[1][l] + P(kk + o2[2][l]))) % 12]
+            ,   m_grad[P(ii + 1        + P(jj + 1        + P(kk + 1       ))) % 12] };
+
+            for(int k = 0; k < 4; ++k)
+            for(int a = 0; a < 3; ++a)
+                g[k][a][l] = gl[k][a];
+        }
+
+        __m128 sum = _mm_setzero_ps();
+        for(int k = 0; k < 4; ++k)
+            sum = _mm_add_ps(sum, corner3x4(d[k][0], d[k][1], d[k][2]
+                , _mm_loadu_ps(g[k][0]), _mm_loadu_ps(g[k][1]), _mm_loadu_ps(g[k][2])));
+
+        sum = _mm_mul_ps(_mm_set1_ps(SIMPLEX3_SCALE), sum);
+        _mm_storeu_ps(dest + i, _mm_add_ps(_mm_mul_ps(sum, _mm_set1_ps(scale)), _mm_set1_ps(bias)));
+    }
+
+#endif // OSGH_SSE2
+
+    for(; i < count; ++i)
+        dest[i] = simplex3(x[i], y[i], z[i]) * scale + bias;
+}
+
+
+void Noise::simplex4(
+    const unsigned int count
+,   const float *x
+,   const float *y
+,   const float *z
+,   const float *w
+,   float *dest
+,   const float scale
+,   const float bias) const
+{
+    unsigned int i = 0;
+
+#ifdef OSGH_SSE2
+
+    const unsigned char *perm = m_perm;
+
+    const unsigned int ox = static_cast<unsigned int>(m_xoff * PERMSIZE);
+    const unsigned int oy = static_cast<unsigned int>(m_yoff * PERMSIZE);
+
+    const __m128  one   = _mm_set1_ps(1.f);
+    const __m128i onei  = _mm_set1_epi32(1);
+    const __m128  f4    = _mm_set1_ps(F4);
+    const __m128  g4[4] = { _mm_set1_ps(G4), _mm_set1_ps(2.f * G4), _mm_set1_ps(3.f * G4), _mm_set1_ps(4.f * G4) };
+
+    int cell[4][4];
+    int o[3][4][4];   // corner, axis, lane
+
+    float g[5][4][4]; // corner, axis, lane
+
+    for(; i + 4 <= count; i += 4)
+    {
+        const __m128 p[4] = { _mm_loadu_ps(x + i), _mm_loadu_ps(y + i), _mm_loadu_ps(z + i), _mm_loadu_ps(w + i) };
+
+        const __m128 s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(p[0], p[1]), p[2]), p[3]), f4);
+
+        __m128i c[4];
+        for(int a = 0; a < 4; ++a)
+            c[a] = floor4(_mm_add_ps(p[a], s));
+
+        const __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(
+            _mm_add_epi32(_mm_add_epi32(_mm_add_epi32(c[0], c[1]), c[2]), c[3])), g4[0]);
+
+        __m128 d[5][4];
+        for(int a = 0; a < 4; ++a)
+            d[0][a] = _mm_sub_ps(p[a], _mm_sub_ps(_mm_cvtepi32_ps(c[a]), t));
+
+        // same ranking as setupSimplex4 (masks are -1 for true)
+
+        __m128i rank[4] = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+
+        for(int a = 0; a < 3; ++a)
+        for(int b = a + 1; b < 4; ++b)
+        {
+            const __m128i m = _mm_castps_si128(_mm_cmpgt_ps(d[0][a], d[0][b]));
+
+            rank[a] = _mm_sub_epi32(rank[a], m);
+            rank[b] = _mm_add_epi32(rank[b], _mm_add_epi32(m, onei));
+        }
+
+        for(int a = 0; a < 4; ++a)
+        {
+            for(int k = 0; k < 3; ++k)
+            {
+                const __m128i ok = _mm_and_si128(_mm_cmpgt_epi32(rank[a], _mm_set1_epi32(2 - k)), onei);
+
+                d[k + 1][a] = _mm_add_ps(_mm_sub_ps(d[0][a], _mm_cvtepi32_ps(ok)), g4[k]);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(o[k][a]), ok);
+            }
+            d[4][a] = _mm_add_ps(_mm_sub_ps(d[0][a], one), g4[3]);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(cell[a]), c[a]);
+        }
+
+        for(int l = 0; l < 4; ++l)
+        {
+            const unsigned int ii = static_cast<unsigned int>(cell[0][l]) + ox;
+            const unsigned int jj = static_cast<unsigned int>(cell[1][l]) + oy;
+            const unsigned int kk = static_cast<unsigned int>(cell[2][l]);
+            const unsigned int ll = static_cast<unsigned int>(cell[3][l]);
+
+            const float *gl[5] = {
+                GRAD4[P(ii              + P(jj              + P(kk              + P(ll             )))) % 32]
+            ,   GRAD4[P(ii + o[0][0][l] + P(jj + o[0][1][l] + P(kk + o[0][2][l] + P(ll + o[0][3][l])))) % 32]
+            ,   GRAD4[P(ii + o[1][0][l] + P(jj + o[1][1][l] + P(kk + o[1][2][l] + P(ll + o[1][3][l])))) % 32]
+            ,   GRAD4[P(ii + o[2][0][l] + P(jj + o[2][1][l] + P(kk + o[2][2][l] + P(ll + o[2][3][l])))) % 32]
+            ,   GRAD4[P(ii + 1          + P(jj + 1          + P(kk + 1          + P(ll + 1         )))) % 32] };
+
+            for(int k = 0; k < 5; ++k)
+            for(int a = 0; a < 4; ++a)
+                g[k][a][l] = gl[k][a];
+        }
+
+        __m128 sum = _mm_setzero_ps();
+        for(int k = 0; k < 5; ++k)
+            sum = _mm_add_ps(sum, corner4x4(d[k][0], d[k][1], d[k][2], d[k][3]
+                , _mm_loadu_ps(g[k][0]), _mm_loadu_ps(g[k][1]), _mm_loadu_ps(g[k][2]), _mm_loadu_ps(g[k][3])));
+
+        sum = _mm_mul_ps(_mm_set1_ps(SIMPLEX4_SCALE), sum);
+        _mm_storeu_ps(dest + i, _mm_add_ps(_mm_mul_ps(sum, _mm_set1_ps(scale)), _mm_set1_ps(bias)));
+    }
+
+#endif // OSGH_SSE2
+
+    for(; i < count; ++i)
+        dest[i] = simplex4(x[i], y[i], z[i], w[i]) * scale + bias;
+}
+
+#undef P
+
 
 //const std::string Noise::fadeGlslSource()
 //{
@@ -0,0 +1,488 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "noisecache.h"
+
+#include "noise.h"
+#include "worleynoise.h"
+#include "halffloat.h"
+#include "random.h"
+#include "parallelfor.h"
+
+#include <osg/Image>
+#include <osg/Notify>
+#include <osg/Timer>
+
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+#ifdef WIN32
+#include <windows.h>
+#else // WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif // WIN32
+
+#include <map>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    const char NOISE_MAGIC[8] = { 'O', 'S', 'G', 'H', 'N', 'O', 'I', 'S' };
+    // 2: per slice offsets from Random instead of rand()
+    const unsigned int NOISE_VERSION(2);
+    const unsigned int NOISE_ENDIAN (0x01020304);
+
+    typedef struct NoiseKey
+    {
+        unsigned int type;
+        unsigned int texSize;
+        unsigned int octave;
+        unsigned int slices;
+        unsigned int seed;
+
+        const bool operator<(const NoiseKey &key) const
+        {
+            if(type != key.type)
+                return type < key.type;
+            if(texSize != key.texSize)
+                return texSize < key.texSize;
+            if(octave != key.octave)
+                return octave < key.octave;
+            if(slices != key.slices)
+                return slices < key.slices;
+
+            return seed < key.seed;
+        }
+
+    } t_noiseKey;
+
+    // An array is loaded or generated under the lock of its entry only, so 
+    // that requests for other keys are not blocked meanwhile.
+
+    class Entry : public osg::Referenced
+    {
+    public:
+        OpenThreads::Mutex mutex;
+        osg::ref_ptr<osg::Image> image;
+    };
+
+    typedef std::map<t_noiseKey, osg::ref_ptr<Entry> > t_entries;
+
+
+    // Function local statics, constructed on first use.
+
+    OpenThreads::Mutex &mutex()
+    {
+        static OpenThreads::Mutex mutex;
+        return mutex;
+    }
+
+    t_entries &entries()
+    {
+        static t_entries entries;
+        return entries;
+    }
+
+    // Per user directories only: the file names are predictable, so a 
+    // shared temp directory would allow others to provide the arrays.
+    std::string &cacheDirectory()
+    {
+        static bool initialized(false);
+        static std::string directory;
+
+        if(!initialized)
+        {
+            if(getenv("OSGHIMMEL_CACHE"))
+                directory = getenv("OSGHIMMEL_CACHE");
+#ifdef WIN32
+            else if(getenv("LOCALAPPDATA"))
+                directory = std::string(getenv("LOCALAPPDATA")) + "/osgHimmel";
+#else // WIN32
+            else if(getenv("XDG_CACHE_HOME"))
+                directory = std::string(getenv("XDG_CACHE_HOME")) + "/osghimmel";
+            else if(getenv("HOME"))
+                directory = std::string(getenv("HOME")) + "/.cache/osghimmel";
+#endif // WIN32
+            initialized = true;
+        }
+        return directory;
+    }
+
+
+    // Writes the data to a new file next to the path, that is created 
+    // exclusively (never following an existing file or link), and renames 
+    // it to the path, so readers never see partially written files.
+
+    const bool writeFile(
+        const std::string &path
+    ,   const std::string &data)
+    {
+#ifdef WIN32
+
+        std::ostringstream stream;
+        stream << path << "." << GetCurrentProcessId() << "." << GetCurrentThreadId() << ".tmp";
+        const std::string temp = stream.str();
+
+        HANDLE file = CreateFileA(temp.c_str(), GENERIC_WRITE, 0
+            , NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+        if(file == INVALID_HANDLE_VALUE)
+            return false;
+
+        DWORD written(0);
+        bool succeeded = WriteFile(file, &data[0], static_cast<DWORD>(data.size()), &written, NULL) 
+            && written == data.size();
+
+        succeeded = CloseHandle(file) && succeeded;
+        succeeded = succeeded && MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+
+        if(!succeeded)
+            DeleteFileA(temp.c_str());
+
+#else // WIN32
+
+        const std::string pattern = path + ".XXXXXX";
+
+        std::vector<char> temp(pattern.begin(), pattern.end());
+        temp.push_back('\0');
+
+        // creates the file exclusively, readable by the user only
+        const int file = mkstemp(&temp[0]);
+        if(file < 0)
+            return false;
+
+        bool succeeded = true;
+        for(size_t offset = 0; succeeded && offset < data.size(); )
+        {
+            const ssize_t written = ::write(file, &data[offset], data.size() - offset);
+
+            succeeded = written > 0;
+            offset += succeeded ? static_cast<size_t>(written) : 0;
+        }
+
+        succeeded = ::close(file) == 0 && succeeded;
+        succeeded = succeeded && ::rename(&temp[0], path.c_str()) == 0;
+
+        if(!succeeded)
+            ::unlink(&temp[0]);
+
+#endif // WIN32
+
+        return succeeded;
+    }
+
+
+    // Rounds the array to the half precision of the cache files, so that 
+    // generated and loaded arrays are bit-identical.
+
+    void quantize(osg::Image &image)
+    {
+        float *data = reinterpret_cast<float*>(image.data());
+        const unsigned int size = image.s() * image.t() * image.r();
+
+        std::vector<t_half> half(size);
+
+        HalfFloat::toHalf(data, &half[0], size);
+        HalfFloat::toFloat(&half[0], data, size);
+    }
+
+
+    // Fills the rows of all slices of a noise array, one row per index.
+
+    class NoiseRowKernel : public ParallelFor::Kernel
+    {
+    public:
+        NoiseRowKernel(
+            const std::vector<Noise> &noises
+        ,   const unsigned int texSize
+        ,   const unsigned int octave
+        ,   float *dest)
+        :   m_noises(noises)
+        ,   m_texSize(texSize)
+        ,   m_octave(octave)
+        ,   m_dest(dest)
+        {
+        }
+
+        virtual void operator()(
+            const int begin
+        ,   const int end)
+        {
+            for(int i = begin; i < end; ++i)
+            {
+                const unsigned int s = static_cast<unsigned int>(i) / m_texSize;
+                const unsigned int t = static_cast<unsigned int>(i) % m_texSize;
+
+                m_noises[s].noise2Row(m_texSize, t, m_octave, m_dest + i * m_texSize, 0.5f, 0.5f);
+            }
+        }
+
+    protected:
+        const std::vector<Noise> &m_noises;
+
+        const unsigned int m_texSize;
+        const unsigned int m_octave;
+
+        float *m_dest;
+    };
+}
+
+
+osg::ref_ptr<osg::Image> NoiseCache::generate(
+    const unsigned int texSize
+,   const unsigned int octave
+,   const unsigned int slices
+,   const unsigned int seed)
+{
+    osg::ref_ptr<osg::Image> image = new osg::Image();
+    image->allocateImage(texSize, texSize, slices, GL_LUMINANCE, GL_FLOAT);
+
+    Random random(seed);
+
+    std::vector<Noise> noises;
+    noises.reserve(slices);
+
+    for(unsigned int s = 0; s < slices; ++s)
+    {
+        const float xOffset = random.nextf();
+        const float yOffset = random.nextf();
+
+        noises.push_back(Noise(1 << (octave + 2), xOffset, yOffset));
+    }
+
+    NoiseRowKernel kernel(noises, texSize, octave, reinterpret_cast<float*>(image->data()));
+    ParallelFor::run(static_cast<int>(slices * texSize), kernel, 16);
+
+    return image;
+}
+
+
+osg::ref_ptr<osg::Image> NoiseCache::noiseArray(
+    const unsigned int texSize
+,   const unsigned int octave
+,   const unsigned int slices
+,   const unsigned int seed)
+{
+    return array(AT_Noise, texSize, octave, slices, seed);
+}
+
+
+osg::ref_ptr<osg::Image> NoiseCache::perlinWorleyArray(
+    const unsigned int texSize
+,   const unsigned int period
+,   const unsigned int slices
+,   const unsigned int seed)
+{
+    return array(AT_PerlinWorley, texSize, period, slices, seed);
+}
+
+
+osg::ref_ptr<osg::Image> NoiseCache::array(
+    const e_ArrayType type
+,   const unsigned int texSize
+,   const unsigned int frequency
+,   const unsigned int slices
+,   const unsigned int seed)
+{
+    const t_noiseKey key = { type, texSize, frequency, slices, seed };
+
+    osg::ref_ptr<Entry> entry;
+    std::string path;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex());
+
+        osg::ref_ptr<Entry> &cached = entries()[key];
+        if(!cached.valid())
+            cached = new Entry;
+
+        entry = cached;
+        path = filePath(type, texSize, frequency, slices, seed);
+    }
+
+    // concurrent requests for this key wait here for the first one
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(entry->mutex);
+
+    if(entry->image.valid())
+        return entry->image;
+
+    const osg::Timer_t t = osg::Timer::instance()->tick();
+
+    osg::ref_ptr<osg::Image> image = path.empty() ? NULL : load(path, texSize, slices);
+
+    if(!image.valid())
+    {
+        if(type == AT_PerlinWorley)
+        {
+            image = new osg::Image();
+            image->allocateImage(texSize, texSize, slices, GL_LUMINANCE, GL_FLOAT);
+
+            WorleyNoise::generatePerlinWorley1f(texSize, texSize, slices
+                , reinterpret_cast<float*>(image->data()), frequency, 3, seed);
+        }
+        else
+            image = generate(texSize, frequency, slices, seed);
+
+        quantize(*image);
+
+        if(!path.empty() && !save(path, *image))
+            OSG_INFO << "Noise cache could not write " << path << std::endl;
+    }
+
+    OSG_INFO << (type == AT_PerlinWorley ? "Perlin-Worley array " : "Noise array ") << texSize << "^2 x " << slices 
+        << " (" << (type == AT_PerlinWorley ? "period " : "octave ") << frequency << ", seed " << seed 
+        << ") took " << osg::Timer::instance()->delta_m(t, osg::Timer::instance()->tick()) << " ms" << std::endl;
+
+    entry->image = image;
+    return image;
+}
+
+
+void NoiseCache::setDirectory(const std::string &directory)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex());
+    cacheDirectory() = directory;
+}
+
+
+const std::string NoiseCache::directory()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex());
+    return cacheDirectory();
+}
+
+
+void NoiseCache::clear()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex());
+    entries().clear();
+}
+
+
+const std::string NoiseCache::filePath(
+    const e_ArrayType type
+,   const unsigned int texSize
+,   const unsigned int frequency
+,   const unsigned int slices
+,   const unsigned int seed)
+{
+    const std::string &directory = cacheDirectory();
+
+    if(directory.empty())
+        return std::string();
+
+    std::ostringstream stream;
+    stream << directory << (type == AT_PerlinWorley ? "/osghimmel_perlinworley_" : "/osghimmel_noise_") 
+        << texSize << "_" << frequency 
+        << "_" << slices << "_" << seed << ".bin";
+
+    return stream.str();
+}
+
+
+osg::Image *NoiseCache::load(
+    const std::string &filePath
+,   const unsigned int texSize
+,   const unsigned int slices)
+{
+    std::ifstream in(filePath.c_str(), std::ios::binary);
+    if(!in.good())
+        return NULL;
+
+    char magic[sizeof(NOISE_MAGIC)];
+    unsigned int version(0);
+    unsigned int endian(0);
+    unsigned int size(0);
+
+    in.read(magic, sizeof(NOISE_MAGIC));
+    in.read(reinterpret_cast<char*>(&version), sizeof(unsigned int));
+    in.read(reinterpret_cast<char*>(&endian), sizeof(unsigned int));
+    in.read(reinterpret_cast<char*>(&size), sizeof(unsigned int));
+
+    const unsigned int count = texSize * texSize * slices;
+
+    if(!in.good() || memcmp(magic, NOISE_MAGIC, sizeof(NOISE_MAGIC)) != 0 
+        || version != NOISE_VERSION || endian != NOISE_ENDIAN || size != count)
+    {
+        OSG_INFO << "Noise cache " << filePath << " has an unsupported format." << std::endl;
+        return NULL;
+    }
+
+    std::vector<t_half> packed(count);
+    in.read(reinterpret_cast<char*>(&packed[0]), count * sizeof(t_half));
+
+    if(!in.good())
+        return NULL;
+
+    osg::Image *image = new osg::Image();
+    image->allocateImage(texSize, texSize, slices, GL_LUMINANCE, GL_FLOAT);
+
+    HalfFloat::toFloat(&packed[0], reinterpret_cast<float*>(image->data()), count);
+
+    return image;
+}
+
+
+const bool NoiseCache::save(
+    const std::string &filePath
+,   const osg::Image &image)
+{
+    const unsigned int count = image.s() * image.t() * image.r();
+
+    std::vector<t_half> packed(count);
+    HalfFloat::toHalf(reinterpret_cast<const float*>(image.data()), &packed[0], count);
+
+    std::ostringstream out(std::ios::binary);
+
+    out.write(NOISE_MAGIC, sizeof(NOISE_MAGIC));
+    out.write(reinterpret_cast<const char*>(&NOISE_VERSION), sizeof(unsigned int));
+    out.write(reinterpret_cast<const char*>(&NOISE_ENDIAN), sizeof(unsigned int));
+    out.write(reinterpret_cast<const char*>(&count), sizeof(unsigned int));
+    out.write(reinterpret_cast<const char*>(&packed[0]), count * sizeof(t_half));
+
+    const std::string directory = osgDB::getFilePath(filePath);
+    if(!directory.empty() && !osgDB::makeDirectory(directory))
+        return false;
+
+    return writeFile(filePath, out.str());
+}
+
+} // namespace osgHimmel
\ No newline at end of file
@@ -0,0 +1,450 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "packedstars.h"
+
+#include "coords.h"
+#include "mathmacros.h"
+#include "simd.h"
+
+#include <osg/Notify>
+
+#include <fstream>
+#include <math.h>
+#include <string.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    const char PACKED_MAGIC[8] = { 'O', 'S', 'G', 'H', 'P', 'A', 'C', 'K' };
+    const unsigned int PACKED_VERSION(1);
+    const unsigned int PACKED_ENDIAN (0x01020304);
+
+    // the batch decoding reads a packed star as three 32 bit words
+    typedef char t_packedStarSizeCheck[sizeof(PackedStars::t_packedStar) == 12 ? 1 : -1];
+
+    const float MIN_MAGNITUDE(-2.f);
+    const float MAX_MAGNITUDE(22.f);
+
+    // arcsec per year, includes barnards star (10.3)
+    const float MAX_PROPER_MOTION(11.f);
+
+    const float SNORM16(32767.f);
+    const float UNORM16(65535.f);
+    const float SNORM8 (127.f);
+    const float UNORM8 (255.f);
+
+    const float MAGNITUDE_STEP((MAX_MAGNITUDE - MIN_MAGNITUDE) / UNORM16);
+
+    inline const int quantize(const float value)
+    {
+        return static_cast<int>(floor(value + 0.5f));
+    }
+
+
+    inline void unpackDirection(
+        const short *direction
+    ,   float &x
+    ,   float &y
+    ,   float &z)
+    {
+        const float px = direction[0] * (1.f / SNORM16);
+        const float py = direction[1] * (1.f / SNORM16);
+
+        z = 1.f - fabsf(px) - fabsf(py);
+
+        // fold the lower hemisphere back
+        const float t = _ma(-z, 0.f);
+
+        x = px >= 0.f ? px - t : px + t;
+        y = py >= 0.f ? py - t : py + t;
+
+        const float inv = 1.f / sqrtf(x * x + y * y + z * z);
+
+        x *= inv;
+        y *= inv;
+        z *= inv;
+    }
+
+    void packDirection(
+        const osg::Vec3f &v
+    ,   short *direction)
+    {
+        const float l1 = fabsf(v.x()) + fabsf(v.y()) + fabsf(v.z());
+
+        float px = v.x() / l1;
+        float py = v.y() / l1;
+
+        if(v.z() < 0.f)
+        {
+            const float tx = (1.f - fabsf(py)) * (px >= 0.f ? 1.f : -1.f);
+            const float ty = (1.f - fabsf(px)) * (py >= 0.f ? 1.f : -1.f);
+
+            px = tx;
+            py = ty;
+        }
+
+        const int qx = quantize(_clamp(-1.f, 1.f, px) * SNORM16);
+        const int qy = quantize(_clamp(-1.f, 1.f, py) * SNORM16);
+
+        // Rounding each component is not the closest encoding in general. 
+        // The neighbours are checked, which lowers the worst case error
+        // by about a third.
+
+        // compares distances, the cosine lacks float precision near 1
+        float best = 8.f;
+
+        for(int j = -1; j <= 1; ++j)
+            for(int i = -1; i <= 1; ++i)
+            {
+                const short candidate[2] = 
+                {
+                    static_cast<short>(_clamp(-32767, 32767, qx + i))
+                ,   static_cast<short>(_clamp(-32767, 32767, qy + j))
+                };
+
+                float x, y, z;
+                unpackDirection(candidate, x, y, z);
+
+                const float distance2 = (x - v.x()) * (x - v.x()) 
+                    + (y - v.y()) * (y - v.y()) + (z - v.z()) * (z - v.z());
+                if(distance2 >= best)
+                    continue;
+
+                best = distance2;
+                direction[0] = candidate[0];
+                direction[1] = candidate[1];
+            }
+    }
+
+
+    inline const signed char packProperMotion(const float arcsec)
+    {
+        const float s = sqrtf(_mi(fabsf(arcsec), MAX_PROPER_MOTION) / MAX_PROPER_MOTION);
+        const int q = quantize(s * SNORM8);
+
+        return static_cast<signed char>(arcsec < 0.f ? -q : q);
+    }
+
+    inline const float unpackProperMotion(const signed char value)
+    {
+        const float s = value * (1.f / SNORM8);
+        return s * fabsf(s) * MAX_PROPER_MOTION;
+    }
+
+    inline const unsigned char packUnorm8(const float value)
+    {
+        return static_cast<unsigned char>(quantize(_clamp(0.f, 1.f, value) * UNORM8));
+    }
+
+#ifdef OSGH_SSE2
+
+    inline const __m128i word(
+        const PackedStars::t_packedStar *source
+    ,   const unsigned int i)
+    {
+        int w[4];
+        for(int s = 0; s < 4; ++s)
+            memcpy(&w[s], reinterpret_cast<const char*>(source + s) + i * 4, 4);
+
+        return _mm_set_epi32(w[3], w[2], w[1], w[0]);
+    }
+
+    // Decodes four stars into positions and colors. The arithmetic matches 
+    // the scalar decoding.
+
+    inline void decode4(
+        const PackedStars::t_packedStar *source
+    ,   osg::Vec4f *positions
+    ,   osg::Vec4f *colors
+    ,   const unsigned int index)
+    {
+        // words: direction, magnitude and proper motion, color
+
+        const __m128i w0 = word(source, 0);
+        const __m128i w1 = word(source, 1);
+        const __m128i w2 = word(source, 2);
+
+        const __m128 signMask = _mm_set1_ps(-0.f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one  = _mm_set1_ps(1.f);
+
+        const __m128 px = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(w0, 16), 16)), _mm_set1_ps(1.f / SNORM16));
+        const __m128 py = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(w0, 16)), _mm_set1_ps(1.f / SNORM16));
+
+        __m128 z = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, px)), _mm_andnot_ps(signMask, py));
+
+        const __m128 t = _mm_max_ps(_mm_sub_ps(zero, z), zero);
+
+        __m128 x = _mm_sub_ps(px, _mm_or_ps(t, _mm_and_ps(px, signMask)));
+        __m128 y = _mm_sub_ps(py, _mm_or_ps(t, _mm_and_ps(py, signMask)));
+
+        const __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z))));
+
+        x = _mm_mul_ps(x, inv);
+        y = _mm_mul_ps(y, inv);
+        z = _mm_mul_ps(z, inv);
+
+        __m128 w = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(static_cast<int>(index)), _mm_set_epi32(3, 2, 1, 0)));
+
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        _mm_storeu_ps(positions[0].ptr(), x);
+        _mm_storeu_ps(positions[1].ptr(), y);
+        _mm_storeu_ps(positions[2].ptr(), z);
+        _mm_storeu_ps(positions[3].ptr(), w);
+
+        const __m128i mask8 = _mm_set1_epi32(0xff);
+        const __m128 unorm8 = _mm_set1_ps(1.f / UNORM8);
+
+        __m128 r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(w2, mask8)), unorm8);
+        __m128 g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(w2, 8), mask8)), unorm8);
+        __m128 b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(w2, 16), mask8)), unorm8);
+
+        __m128 m = _mm_add_ps(_mm_set1_ps(MIN_MAGNITUDE), _mm_mul_ps(_mm_cvtepi32_ps(
+            _mm_and_si128(w1, _mm_set1_epi32(0xffff))), _mm_set1_ps(MAGNITUDE_STEP)));
+
+        _MM_TRANSPOSE4_PS(r, g, b, m);
+
+        _mm_storeu_ps(colors[0].ptr(), r);
+        _mm_storeu_ps(colors[1].ptr(), g);
+        _mm_storeu_ps(colors[2].ptr(), b);
+        _mm_storeu_ps(colors[3].ptr(), m);
+    }
+
+#endif // OSGH_SSE2
+}
+
+
+const float PackedStars::minMagnitude()
+{
+    return MIN_MAGNITUDE;
+}
+
+const float PackedStars::maxMagnitude()
+{
+    return MAX_MAGNITUDE;
+}
+
+const float PackedStars::maxProperMotion()
+{
+    return MAX_PROPER_MOTION;
+}
+
+
+void PackedStars::encode(
+    const BrightStars::s_BrightStar *source
+,   t_packedStar *dest
+,   const unsigned int count)
+{
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const BrightStars::s_BrightStar &star(source[i]);
+        t_packedStar &packed(dest[i]);
+
+        t_equf equ;
+        equ.right_ascension = _rightascd(star.RA, 0, 0);
+        equ.declination = star.DE;
+
+        packDirection(equ.toEuclidean(), packed.direction);
+
+        const float m = _clamp(MIN_MAGNITUDE, MAX_MAGNITUDE, star.Vmag);
+        packed.magnitude = static_cast<unsigned short>(quantize((m - MIN_MAGNITUDE) / MAGNITUDE_STEP));
+
+        // decimal hours and degrees to arcsec
+        packed.properMotion[0] = packProperMotion(star.pmRA * 15.f * 3600.f);
+        packed.properMotion[1] = packProperMotion(star.pmDE * 3600.f);
+
+        packed.sRGB[0] = packUnorm8(star.sRGB_R);
+        packed.sRGB[1] = packUnorm8(star.sRGB_G);
+        packed.sRGB[2] = packUnorm8(star.sRGB_B);
+
+        packed.reserved = 0;
+    }
+}
+
+
+void PackedStars::decode(
+    const t_packedStar *source
+,   BrightStars::s_BrightStar *dest
+,   const unsigned int count)
+{
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        osg::Vec4f position;
+        osg::Vec4f color;
+
+        decode(source[i], position, color, i);
+
+        BrightStars::s_BrightStar &star(dest[i]);
+
+        const float ra = static_cast<float>(_deg(atan2f(position.x(), position.y())));
+
+        star.Vmag = color.w();
+        star.RA   = (ra < 0.f ? ra + 360.f : ra) / 15.f;
+        star.DE   = static_cast<float>(_deg(asinf(_clamp(-1.f, 1.f, position.z()))));
+        star.pmRA = unpackProperMotion(source[i].properMotion[0]) / (15.f * 3600.f);
+        star.pmDE = unpackProperMotion(source[i].properMotion[1]) / 3600.f;
+
+        star.sRGB_R = color.x();
+        star.sRGB_G = color.y();
+        star.sRGB_B = color.z();
+    }
+}
+
+
+void PackedStars::decode(
+    const t_packedStar *source
+,   osg::Vec4f *positions
+,   osg::Vec4f *colors
+,   const unsigned int count
+,   const unsigned int firstIndex)
+{
+    unsigned int i = 0;
+
+#ifdef OSGH_SSE2
+
+    for(; i + 4 <= count; i += 4)
+        decode4(source + i, positions + i, colors + i, firstIndex + i);
+
+#endif // OSGH_SSE2
+
+    for(; i < count; ++i)
+        decode(source[i], positions[i], colors[i], firstIndex + i);
+}
+
+
+void PackedStars::decode(
+    const t_packedStar &source
+,   osg::Vec4f &position
+,   osg::Vec4f &color
+,   const unsigned int index)
+{
+    float x, y, z;
+    unpackDirection(source.direction, x, y, z);
+
+    position.set(x, y, z, static_cast<float>(index));
+
+    color.set(
+        source.sRGB[0] * (1.f / UNORM8)
+    ,   source.sRGB[1] * (1.f / UNORM8)
+    ,   source.sRGB[2] * (1.f / UNORM8)
+    ,   MIN_MAGNITUDE + source.magnitude * MAGNITUDE_STEP);
+}
+
+
+const bool PackedStars::isPackedFile(const char *fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+
+    char magic[sizeof(PACKED_MAGIC)];
+    in.read(magic, sizeof(magic));
+
+    return in.good() && memcmp(magic, PACKED_MAGIC, sizeof(PACKED_MAGIC)) == 0;
+}
+
+
+const bool PackedStars::fromFile(
+    const char *fileName
+,   t_packedStars &stars)
+{
+    stars.clear();
+
+    std::ifstream in(fileName, std::ios::binary);
+    if(!in)
+        return false;
+
+    in.seekg(0, std::ios::end);
+    const unsigned long long fileSize = static_cast<unsigned long long>(in.tellg());
+    in.seekg(0, std::ios::beg);
+
+    char magic[sizeof(PACKED_MAGIC)];
+    in.read(magic, sizeof(magic));
+
+    if(!in.good() || memcmp(magic, PACKED_MAGIC, sizeof(PACKED_MAGIC)) != 0)
+        return false;
+
+    unsigned int fields[3]; // version, endian, count
+    in.read(reinterpret_cast<char*>(fields), sizeof(fields));
+
+    if(!in.good() || fields[0] != PACKED_VERSION || fields[1] != PACKED_ENDIAN)
+    {
+        OSG_NOTICE << "Packed star catalogue " << fileName << " has an unsupported format." << std::endl;
+        return false;
+    }
+
+    // bounds check before allocating for the count
+    if(sizeof(PACKED_MAGIC) + sizeof(fields) + static_cast<unsigned long long>(fields[2]) * sizeof(t_packedStar) > fileSize)
+    {
+        OSG_NOTICE << "Packed star catalogue " << fileName << " is truncated." << std::endl;
+        return false;
+    }
+
+    stars.resize(fields[2]);
+    if(!stars.empty())
+        in.read(reinterpret_cast<char*>(&stars[0]), stars.size() * sizeof(t_packedStar));
+
+    if(!in.good())
+    {
+        OSG_NOTICE << "Packed star catalogue " << fileName << " is truncated." << std::endl;
+
+        stars.clear();
+        return false;
+    }
+    return true;
+}
+
+
+const bool PackedStars::toFile(
+    const char *fileName
+,   const t_packedStars &stars)
+{
+    std::ofstream out(fileName, std::ios::binary);
+    if(!out.good())
+        return false;
+
+    const unsigned int fields[3] = 
+    {
+        PACKED_VERSION, PACKED_ENDIAN, static_cast<unsigned int>(stars.size())
+    };
+
+    out.write(PACKED_MAGIC, sizeof(PACKED_MAGIC));
+    out.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+
+    if(!stars.empty())
+        out.write(reinterpret_cast<const char*>(&stars[0]), stars.size() * sizeof(t_packedStar));
+
+    return out.good();
+}
+
+} // namespace osgHimmel
@@ -0,0 +1,743 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "pagedstarcatalogue.h"
+
+#include "starcatalogue.h"
+#include "starskyindex.h"
+
+#include <osg/Notify>
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Condition>
+
+#include <fstream>
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <utility>
+#include <string.h>
+#include <assert.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    const char PAGED_MAGIC[8] = { 'O', 'S', 'G', 'H', 'P', 'A', 'G', 'E' };
+    const unsigned int PAGED_VERSION(1);
+    const unsigned int PAGED_ENDIAN (0x01020304);
+
+    // magic, version, endian, depth, tiers, count, two offsets
+    const unsigned int HEADER_SIZE(sizeof(PAGED_MAGIC) + 7 * sizeof(unsigned int));
+
+    // offset, count, brightest, faintest
+    const unsigned int TABLE_ENTRY_SIZE(4 * sizeof(unsigned int));
+
+    // position and color
+    const unsigned int STAR_SIZE(2 * sizeof(osg::Vec4f));
+
+    const unsigned int BLOCK_ALIGNMENT(16);
+
+    inline const unsigned long long aligned(const unsigned long long offset)
+    {
+        return (offset + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+    }
+
+    template<typename T>
+    inline void write(
+        std::ofstream &out
+    ,   const T &value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    inline void pad(
+        std::ofstream &out
+    ,   const unsigned long long offset)
+    {
+        static const char zeros[BLOCK_ALIGNMENT] = { 0 };
+        out.write(zeros, static_cast<std::streamsize>(aligned(offset) - offset));
+    }
+
+    template<typename T>
+    inline const T field(
+        const char *data
+    ,   const unsigned int i)
+    {
+        T value;
+        memcpy(&value, data + i * sizeof(unsigned int), sizeof(T));
+
+        return value;
+    }
+}
+
+
+// Reads requested tiles in the background. Requests are replaced as a 
+// whole with each update, so tiles that are no longer visible are not 
+// loaded. Results are picked up by the thread updating the catalogue.
+
+class PagedStarCatalogue::Loader : public OpenThreads::Thread
+{
+public:
+
+    struct s_Request
+    {
+        unsigned int tile;
+        unsigned int offset;
+        unsigned int count;
+    };
+
+    struct s_Result
+    {
+        unsigned int tile;
+
+        osg::ref_ptr<osg::Vec4Array> positions;
+        osg::ref_ptr<osg::Vec4Array> colors;
+    };
+
+public:
+
+    Loader(const std::string &fileName)
+    :   OpenThreads::Thread()
+    ,   m_fileName(fileName)
+    ,   m_current(std::numeric_limits<unsigned int>::max())
+    ,   m_busy(false)
+    ,   m_quit(false)
+    ,   m_loads(0)
+    {
+    }
+
+    virtual ~Loader()
+    {
+        quit();
+    }
+
+    void request(const std::vector<s_Request> &requests)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+        m_pending.clear();
+        for(unsigned int i = 0; i < requests.size(); ++i)
+            if(requests[i].tile != m_current)
+                m_pending.push_back(requests[i]);
+
+        m_wake.signal();
+    }
+
+    void results(std::vector<s_Result> &results)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+        results.clear();
+        results.swap(m_results);
+    }
+
+    void wait()
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+        while(!m_pending.empty() || m_busy)
+            m_idle.wait(&m_mutex);
+    }
+
+    void quit()
+    {
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+            m_quit = true;
+            m_wake.signal();
+        }
+        if(isRunning())
+            join();
+    }
+
+    const unsigned int loads()
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+        return m_loads;
+    }
+
+    virtual void run()
+    {
+        std::ifstream file(m_fileName.c_str(), std::ios::binary);
+
+        while(true)
+        {
+            s_Request request;
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+                while(m_pending.empty() && !m_quit)
+                {
+                    m_busy = false;
+                    m_current = std::numeric_limits<unsigned int>::max();
+
+                    m_idle.broadcast();
+                    m_wake.wait(&m_mutex);
+                }
+                if(m_quit)
+                    break;
+
+                request = m_pending.front();
+                m_pending.pop_front();
+
+                m_busy = true;
+                m_current = request.tile;
+            }
+
+            s_Result result;
+            result.tile = request.tile;
+            result.positions = new osg::Vec4Array(request.count);
+            result.colors    = new osg::Vec4Array(request.count);
+
+            if(request.count)
+            {
+                const std::streamsize size = request.count * sizeof(osg::Vec4f);
+
+                file.seekg(request.offset);
+                file.read(reinterpret_cast<char*>(&(*result.positions)[0]), size);
+                file.read(reinterpret_cast<char*>(&(*result.colors)[0]), size);
+
+                if(!file)
+                {
+                    OSG_WARN << "Star tile " << request.tile << " could not be read from " << m_fileName << "." << std::endl;
+
+                    // resident but empty, so it is not requested again
+                    result.positions->clear();
+                    result.colors->clear();
+
+                    file.clear();
+                }
+            }
+
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+            m_results.push_back(result);
+            ++m_loads;
+        }
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(m_mutex);
+
+        m_busy = false;
+        m_idle.broadcast();
+    }
+
+protected:
+
+    const std::string m_fileName;
+
+    OpenThreads::Mutex m_mutex;
+    OpenThreads::Condition m_wake;
+    OpenThreads::Condition m_idle;
+
+    std::deque<s_Request> m_pending;
+    std::vector<s_Result> m_results;
+
+    unsigned int m_current;
+    bool m_busy;
+    bool m_quit;
+
+    unsigned int m_loads;
+};
+
+
+PagedStarCatalogue::PagedStarCatalogue()
+:   osg::Referenced()
+,   m_numStars(0)
+,   m_numTiers(0)
+,   m_index(NULL)
+,   m_loader(NULL)
+,   m_updates(0)
+,   m_memoryBudget(defaultMemoryBudget())
+,   m_residentBytes(0)
+,   m_residentTiles(0)
+{
+}
+
+
+PagedStarCatalogue::~PagedStarCatalogue()
+{
+    close();
+}
+
+
+const bool PagedStarCatalogue::toFile(
+    const char *fileName
+,   StarCatalogue &catalogue
+,   const std::vector<float> &tierLimits
+,   const unsigned int depth)
+{
+    osg::ref_ptr<StarSkyIndex> index = new StarSkyIndex(depth);
+    index->build(catalogue);
+
+    const unsigned int numTiers = static_cast<unsigned int>(tierLimits.size()) + 1;
+    const unsigned int numTiles = index->numCells() * numTiers;
+
+    // ranges of the tiles within the catalogue, cells are sorted by magnitude
+
+    std::vector<unsigned int> begins(numTiles + 1);
+    for(unsigned int c = 0; c < index->numCells(); ++c)
+    {
+        begins[c * numTiers] = index->begin(c);
+
+        for(unsigned int t = 1; t < numTiers; ++t)
+            begins[c * numTiers + t] = index->begin(c) + index->numStarsUpTo(c, tierLimits[t - 1]);
+    }
+    begins[numTiles] = catalogue.numStars();
+
+    const unsigned long long tableOffset = aligned(HEADER_SIZE + (numTiers - 1) * sizeof(float));
+    const unsigned long long dataOffset  = aligned(tableOffset + numTiles * TABLE_ENTRY_SIZE);
+
+    const unsigned long long size = dataOffset + static_cast<unsigned long long>(catalogue.numStars()) * STAR_SIZE;
+    if(size > std::numeric_limits<unsigned int>::max())
+    {
+        OSG_WARN << "Star catalogue exceeds the 4 GB limit of paged catalogue files." << std::endl;
+        return false;
+    }
+
+    std::ofstream out(fileName, std::ios::binary);
+    if(!out)
+        return false;
+
+    out.write(PAGED_MAGIC, sizeof(PAGED_MAGIC));
+    write(out, PAGED_VERSION);
+    write(out, PAGED_ENDIAN);
+    write(out, depth);
+    write(out, numTiers);
+    write(out, catalogue.numStars());
+    write(out, static_cast<unsigned int>(tableOffset));
+    write(out, static_cast<unsigned int>(dataOffset));
+
+    for(unsigned int t = 0; t < numTiers - 1; ++t)
+        write(out, tierLimits[t]);
+    pad(out, HEADER_SIZE + (numTiers - 1) * sizeof(float));
+
+    const osg::Vec4f *positions = catalogue.positions();
+    const osg::Vec4f *colors = catalogue.colors();
+
+    unsigned long long offset = dataOffset;
+    for(unsigned int i = 0; i < numTiles; ++i)
+    {
+        const unsigned int count = begins[i + 1] - begins[i];
+
+        write(out, static_cast<unsigned int>(offset));
+        write(out, count);
+        write(out, count ? colors[begins[i]][3] : std::numeric_limits<float>::max());
+        write(out, count ? colors[begins[i + 1] - 1][3] : std::numeric_limits<float>::max());
+
+        offset += count * STAR_SIZE;
+    }
+    pad(out, tableOffset + numTiles * TABLE_ENTRY_SIZE);
+
+    for(unsigned int i = 0; i < numTiles; ++i)
+    {
+        const std::streamsize size = (begins[i + 1] - begins[i]) * sizeof(osg::Vec4f);
+        if(!size)
+            continue;
+
+        out.write(reinterpret_cast<const char*>(&positions[begins[i]]), size);
+        out.write(reinterpret_cast<const char*>(&colors[begins[i]]), size);
+    }
+    return out.good();
+}
+
+
+const bool PagedStarCatalogue::isPagedFile(const char *fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+
+    char magic[sizeof(PAGED_MAGIC)];
+    in.read(magic, sizeof(magic));
+
+    return in.good() && memcmp(magic, PAGED_MAGIC, sizeof(PAGED_MAGIC)) == 0;
+}
+
+
+const bool PagedStarCatalogue::open(const char *fileName)
+{
+    close();
+
+    std::ifstream in(fileName, std::ios::binary);
+    if(!in)
+        return false;
+
+    in.seekg(0, std::ios::end);
+    const unsigned long long fileSize = static_cast<unsigned long long>(in.tellg());
+    in.seekg(0, std::ios::beg);
+
+    char header[HEADER_SIZE];
+    in.read(header, HEADER_SIZE);
+
+    if(!in || memcmp(header, PAGED_MAGIC, sizeof(PAGED_MAGIC)) != 0)
+        return false;
+
+    const char *fields = header + sizeof(PAGED_MAGIC);
+
+    const unsigned int version     = field<unsigned int>(fields, 0);
+    const unsigned int endian      = field<unsigned int>(fields, 1);
+    const unsigned int depth       = field<unsigned int>(fields, 2);
+    const unsigned int numTiers    = field<unsigned int>(fields, 3);
+    const unsigned int numStars    = field<unsigned int>(fields, 4);
+    const unsigned int tableOffset = field<unsigned int>(fields, 5);
+
+    const unsigned long long numTiles = depth < 16 && numTiers ? 
+        (static_cast<unsigned long long>(6) << 2 * depth) * numTiers : 0;
+
+    if(version != PAGED_VERSION || endian != PAGED_ENDIAN || !numTiles
+    || tableOffset < HEADER_SIZE || tableOffset + numTiles * TABLE_ENTRY_SIZE > fileSize)
+    {
+        OSG_NOTICE << "Paged star catalogue " << fileName << " is truncated or has an unsupported format (version " << version 
+            << ", endian " << std::hex << endian << std::dec << ")." << std::endl;
+        return false;
+    }
+
+    std::vector<char> table(static_cast<size_t>(numTiles * TABLE_ENTRY_SIZE));
+
+    in.seekg(tableOffset);
+    in.read(&table[0], table.size());
+
+    if(!in)
+        return false;
+
+    // tiles and their bounds check
+
+    m_tiles.resize(static_cast<size_t>(numTiles));
+
+    std::vector<unsigned int> counts(static_cast<size_t>(numTiles / numTiers), 0);
+    std::vector<float> brightest(counts.size(), std::numeric_limits<float>::max());
+
+    unsigned long long total = 0;
+    for(unsigned int i = 0; i < m_tiles.size(); ++i)
+    {
+        s_Tile &entry(m_tiles[i]);
+
+        entry.offset    = field<unsigned int>(&table[i * TABLE_ENTRY_SIZE], 0);
+        entry.count     = field<unsigned int>(&table[i * TABLE_ENTRY_SIZE], 1);
+        entry.brightest = field<float>(&table[i * TABLE_ENTRY_SIZE], 2);
+        entry.faintest  = field<float>(&table[i * TABLE_ENTRY_SIZE], 3);
+        entry.requested = 0;
+
+        if(entry.offset + static_cast<unsigned long long>(entry.count) * STAR_SIZE > fileSize)
+        {
+            OSG_NOTICE << "Paged star catalogue " << fileName << " is truncated." << std::endl;
+
+            m_tiles.clear();
+            return false;
+        }
+
+        const unsigned int c = i / numTiers;
+
+        counts[c] += entry.count;
+        if(entry.count)
+            brightest[c] = std::min(brightest[c], entry.brightest);
+
+        total += entry.count;
+    }
+
+    if(total != numStars)
+    {
+        OSG_NOTICE << "Paged star catalogue " << fileName << " has inconsistent tiles." << std::endl;
+
+        m_tiles.clear();
+        return false;
+    }
+
+    m_fileName = fileName;
+    m_numStars = numStars;
+    m_numTiers = numTiers;
+
+    m_index = new StarSkyIndex(depth);
+    m_index->assign(counts, brightest);
+
+    m_loader = new Loader(m_fileName);
+    m_loader->start();
+
+    return true;
+}
+
+
+void PagedStarCatalogue::close()
+{
+    if(m_loader)
+    {
+        m_loader->quit();
+        delete m_loader;
+    }
+    m_loader = NULL;
+
+    m_tiles.clear();
+    m_requested.clear();
+
+    m_index = NULL;
+
+    m_numStars = 0;
+    m_numTiers = 0;
+
+    m_residentBytes = 0;
+    m_residentTiles = 0;
+}
+
+
+StarSkyIndex *PagedStarCatalogue::index()
+{
+    return m_index.get();
+}
+
+
+const StarSkyIndex *PagedStarCatalogue::index() const
+{
+    return m_index.get();
+}
+
+
+const unsigned int PagedStarCatalogue::numStars() const
+{
+    return m_numStars;
+}
+
+
+const unsigned int PagedStarCatalogue::numTiers() const
+{
+    return m_numTiers;
+}
+
+
+const unsigned int PagedStarCatalogue::numTiles() const
+{
+    return static_cast<unsigned int>(m_tiles.size());
+}
+
+
+const unsigned int PagedStarCatalogue::tile(
+    const unsigned int cell
+,   const unsigned int tier) const
+{
+    return cell * m_numTiers + tier;
+}
+
+
+void PagedStarCatalogue::update(const float magnitude)
+{
+    if(!m_loader)
+        return;
+
+    ++m_updates;
+
+    // pick up loaded tiles
+
+    std::vector<Loader::s_Result> results;
+    m_loader->results(results);
+
+    for(unsigned int i = 0; i < results.size(); ++i)
+    {
+        s_Tile &entry(m_tiles[results[i].tile]);
+        if(entry.positions.valid())
+            continue;
+
+        entry.positions = results[i].positions;
+        entry.colors    = results[i].colors;
+
+        m_residentBytes += static_cast<unsigned int>(entry.positions->size()) * STAR_SIZE;
+        ++m_residentTiles;
+    }
+
+    // request visible tiles, brighter tiers first
+
+    m_requested.clear();
+
+    std::vector<Loader::s_Request> requests;
+
+    for(unsigned int t = 0; t < m_numTiers; ++t)
+        for(unsigned int c = 0; c < m_index->numCells(); ++c)
+        {
+            if(!m_index->isVisible(c))
+                continue;
+
+            const unsigned int i = tile(c, t);
+            s_Tile &entry(m_tiles[i]);
+
+            if(!entry.count || entry.brightest > magnitude)
+                continue;
+
+            entry.requested = m_updates;
+            m_requested.push_back(i);
+
+            if(entry.positions.valid())
+                continue;
+
+            const Loader::s_Request request = { i, entry.offset, entry.count };
+            requests.push_back(request);
+        }
+
+    m_loader->request(requests);
+
+    // release least recently requested tiles exceeding the budget
+
+    if(m_residentBytes <= m_memoryBudget)
+        return;
+
+    std::vector<std::pair<unsigned int, unsigned int> > lru;
+    for(unsigned int i = 0; i < m_tiles.size(); ++i)
+        if(m_tiles[i].positions.valid() && m_tiles[i].requested != m_updates)
+            lru.push_back(std::make_pair(m_tiles[i].requested, i));
+
+    std::sort(lru.begin(), lru.end());
+
+    for(unsigned int i = 0; i < lru.size() && m_residentBytes > m_memoryBudget; ++i)
+        release(lru[i].second);
+}
+
+
+void PagedStarCatalogue::release(const unsigned int i)
+{
+    s_Tile &entry(m_tiles[i]);
+    assert(entry.positions.valid());
+
+    m_residentBytes -= static_cast<unsigned int>(entry.positions->size()) * STAR_SIZE;
+    --m_residentTiles;
+
+    entry.positions = NULL;
+    entry.colors = NULL;
+}
+
+
+const std::vector<unsigned int> &PagedStarCatalogue::requestedTiles() const
+{
+    return m_requested;
+}
+
+
+const bool PagedStarCatalogue::isResident(const unsigned int tile) const
+{
+    return m_tiles[tile].positions.valid();
+}
+
+
+osg::Vec4Array *PagedStarCatalogue::positions(const unsigned int tile) const
+{
+    return m_tiles[tile].positions.get();
+}
+
+
+osg::Vec4Array *PagedStarCatalogue::colors(const unsigned int tile) const
+{
+    return m_tiles[tile].colors.get();
+}
+
+
+const unsigned int PagedStarCatalogue::tileSize(const unsigned int tile) const
+{
+    return m_tiles[tile].count;
+}
+
+
+const float PagedStarCatalogue::tileBrightest(const unsigned int tile) const
+{
+    return m_tiles[tile].brightest;
+}
+
+
+const unsigned int PagedStarCatalogue::numStarsUpTo(
+    const unsigned int tile
+,   const float magnitude) const
+{
+    assert(isResident(tile));
+
+    const osg::Vec4Array &colors(*m_tiles[tile].colors);
+
+    // the tiles faintest star decides quickly for most tiles
+    if(colors.empty() || m_tiles[tile].faintest <= magnitude)
+        return static_cast<unsigned int>(colors.size());
+
+    // binary search for the first fainter star
+
+    unsigned int lower = 0;
+    unsigned int upper = static_cast<unsigned int>(colors.size());
+
+    while(lower < upper)
+    {
+        const unsigned int mid = lower + (upper - lower) / 2;
+
+        if(colors[mid][3] <= magnitude)
+            lower = mid + 1;
+        else
+            upper = mid;
+    }
+    return lower;
+}
+
+
+void PagedStarCatalogue::setMemoryBudget(const unsigned int bytes)
+{
+    m_memoryBudget = bytes;
+}
+
+
+const unsigned int PagedStarCatalogue::getMemoryBudget() const
+{
+    return m_memoryBudget;
+}
+
+
+const unsigned int PagedStarCatalogue::defaultMemoryBudget()
+{
+    return 64 * 1024 * 1024; // about 2 million stars
+}
+
+
+const unsigned int PagedStarCatalogue::getResidentBytes() const
+{
+    return m_residentBytes;
+}
+
+
+const unsigned int PagedStarCatalogue::getResidentTileCount() const
+{
+    return m_residentTiles;
+}
+
+
+const unsigned int PagedStarCatalogue::getLoadCount() const
+{
+    return m_loader ? m_loader->loads() : 0;
+}
+
+
+void PagedStarCatalogue::wait()
+{
+    if(m_loader)
+        m_loader->wait();
+}
+
+} // namespace osgHimmel
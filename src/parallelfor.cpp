@@ -0,0 +1,127 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "parallelfor.h"
+
+#include "mathmacros.h"
+
+#include <OpenThreads/Thread>
+
+#include <vector>
+#include <assert.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    class ChunkThread : public OpenThreads::Thread
+    {
+    public:
+        ChunkThread(
+            ParallelFor::Kernel &kernel
+        ,   const int begin
+        ,   const int end)
+        :   OpenThreads::Thread()
+        ,   m_kernel(kernel)
+        ,   m_begin(begin)
+        ,   m_end(end)
+        {
+        }
+
+        virtual void run()
+        {
+            m_kernel(m_begin, m_end);
+        }
+
+    protected:
+        ParallelFor::Kernel &m_kernel;
+
+        const int m_begin;
+        const int m_end;
+    };
+}
+
+
+const unsigned int ParallelFor::numProcessors()
+{
+    return _ma(1, OpenThreads::GetNumberOfProcessors());
+}
+
+
+void ParallelFor::run(
+    const int count
+,   Kernel &kernel
+,   const int grain
+,   const unsigned int numThreads)
+{
+    assert(grain > 0);
+
+    if(count <= 0)
+        return;
+
+    const int threads = _mi(static_cast<int>(numThreads ? numThreads : numProcessors()), (count + grain - 1) / grain);
+
+    if(threads <= 1)
+    {
+        kernel(0, count);
+        return;
+    }
+
+    int chunk = (count + threads - 1) / threads;
+    chunk = ((chunk + grain - 1) / grain) * grain;
+
+    std::vector<ChunkThread*> workers;
+
+    for(int begin = chunk; begin < count; begin += chunk)
+    {
+        ChunkThread *worker = new ChunkThread(kernel, begin, _mi(begin + chunk, count));
+
+        // process the chunk on the calling thread if no thread is available
+        if(worker->start() != 0)
+        {
+            delete worker;
+            kernel(begin, _mi(begin + chunk, count));
+
+            continue;
+        }
+        workers.push_back(worker);
+    }
+
+    kernel(0, _mi(chunk, count));
+
+    for(unsigned int i = 0; i < workers.size(); ++i)
+    {
+        workers[i]->join();
+        delete workers[i];
+    }
+}
+
+} // namespace osgHimmel
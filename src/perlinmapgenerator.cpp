@@ -30,130 +30,327 @@
 #include "perlinmapgenerator.h"
 
 #include "noise.h"
+#include "parallelfor.h"
+#include "mathmacros.h"
 
 #include <stdlib.h>
 #include <math.h>
 #include <assert.h>
+#include <vector>
 
 
 namespace osgHimmel
 {
 
+namespace
+{
+    // Accumulates all octaves of a row into the shared map and tracks the 
+    // row's extrema, so no per octave buffers are required.
+
+    class OctaveRowKernel : public ParallelFor::Kernel
+    {
+    public:
+        OctaveRowKernel(
+            const Noise &noise
+        ,   const int width
+        ,   const int height
+        ,   const PerlinMapGenerator::e_NoiseType type
+        ,   const int startFrequency
+        ,   const int octaves
+        ,   float *map
+        ,   float *rowMin
+        ,   float *rowMax)
+        :   m_noise(noise)
+        ,   m_width(width)
+        ,   m_height(height)
+        ,   m_type(type)
+        ,   m_startFrequency(startFrequency)
+        ,   m_octaves(octaves)
+        ,   m_map(map)
+        ,   m_rowMin(rowMin)
+        ,   m_rowMax(rowMax)
+        {
+        }
+
+        virtual void operator()(
+            const int begin
+        ,   const int end)
+        {
+            std::vector<float> octave(m_width);
+            float *po = &octave[0];
+
+            for(int y = begin; y < end; ++y)
+            {
+                const float t = static_cast<float>(y) / static_cast<float>(m_height);
+                float *p = m_map + y * m_width;
+
+                for(int x = 0; x < m_width; ++x)
+                    p[x] = 0.5f;
+
+                for(int o = 0; o < m_octaves; ++o)
+                {
+                    m_noise.noise2Line(m_width, t, m_startFrequency + o, po);
+                    accumulate(p, po, 1.f / static_cast<float>(1 << o));
+                }
+
+                float minp = p[0];
+                float maxp = p[0];
+
+                for(int x = 1; x < m_width; ++x)
+                {
+                    minp = _mi(minp, p[x]);
+                    maxp = _ma(maxp, p[x]);
+                }
+                m_rowMin[y] = minp;
+                m_rowMax[y] = maxp;
+            }
+        }
+
+    protected:
+
+        void accumulate(
+            float *p
+        ,   const float *po
+        ,   const float f) const
+        {
+            switch(m_type)
+            {
+            case PerlinMapGenerator::NT_Standard:
+                for(int x = 0; x < m_width; ++x)
+                    p[x] += po[x];
+                break;
+            case PerlinMapGenerator::NT_Cloud:
+                for(int x = 0; x < m_width; ++x)
+                    p[x] += po[x] * f;
+                break;
+            case PerlinMapGenerator::NT_CloudAbs:
+                for(int x = 0; x < m_width; ++x)
+                    p[x] += fabs(po[x] * f);
+                break;
+            case PerlinMapGenerator::NT_Wood:
+                for(int x = 0; x < m_width; ++x)
+                {
+                    const float pf8 = po[x] * f * 8.f;
+                    p[x] += pf8 - static_cast<int>(pf8);
+                }
+                break;
+            case PerlinMapGenerator::NT_Paper:
+                for(int x = 0; x < m_width; ++x)
+                    p[x] += po[x] * po[x] * (po[x] > 0.f ? 1.f : -1.f);
+                break;
+            };
+        }
+
+    protected:
+        const Noise &m_noise;
+
+        const int m_width;
+        const int m_height;
+
+        const PerlinMapGenerator::e_NoiseType m_type;
+
+        const int m_startFrequency;
+        const int m_octaves;
+
+        float *m_map;
+        float *m_rowMin;
+        float *m_rowMax;
+    };
+
+
+    // Fills tileable rows of a 2D or 3D tile, one row per index.
+
+    class TileableRowKernel : public ParallelFor::Kernel
+    {
+    public:
+        TileableRowKernel(
+            const Noise &noise
+        ,   const int width
+        ,   const int height
+        ,   const int depth
+        ,   const int period
+        ,   const int octaves
+        ,   float *dest)
+        :   m_noise(noise)
+        ,   m_width(width)
+        ,   m_height(height)
+        ,   m_depth(depth)
+        ,   m_octaves(octaves)
+        ,   m_dest(dest)
+        {
+            m_period[0] = period;
+            m_period[1] = _ma(1, (period * height + width / 2) / width);
+            m_period[2] = _ma(1, (period * depth  + width / 2) / width);
+
+            float sum = 0.f;
+            for(int o = 0; o < octaves; ++o)
+                sum += 1.f / static_cast<float>(1 << o);
+
+            m_scale = 0.5f / sum;
+        }
+
+        virtual void operator()(
+            const int begin
+        ,   const int end)
+        {
+            for(int r = begin; r < end; ++r)
+            {
+                const int y = r % m_height;
+                const int z = r / m_height;
+
+                float *p = m_dest + r * m_width;
+
+                for(int x = 0; x < m_width; ++x)
+                    p[x] = 0.f;
+
+                for(int o = 0; o < m_octaves; ++o)
+                {
+                    const unsigned int px = m_period[0] << o;
+                    const unsigned int py = m_period[1] << o;
+                    const unsigned int pz = m_period[2] << o;
+
+                    const float f = 1.f / static_cast<float>(1 << o);
+
+                    const float ty = static_cast<float>(y * py) / static_cast<float>(m_height);
+                    const float tz = static_cast<float>(z * pz) / static_cast<float>(m_depth);
+
+                    for(int x = 0; x < m_width; ++x)
+                    {
+                        const float tx = static_cast<float>(x * px) / static_cast<float>(m_width);
+
+                        p[x] += f * (m_depth > 1 
+                            ? m_noise.pnoise3(tx, ty, tz, px, py, pz) 
+                            : m_noise.pnoise2(tx, ty, px, py));
+                    }
+                }
+
+                for(int x = 0; x < m_width; ++x)
+                    p[x] = _clamp(0.f, 1.f, p[x] * m_scale + 0.5f);
+            }
+        }
+
+    protected:
+        const Noise &m_noise;
+
+        const int m_width;
+        const int m_height;
+        const int m_depth;
+        const int m_octaves;
+
+        int m_period[3];
+        float m_scale;
+
+        float *m_dest;
+    };
+
+
+    template<typename T>
+    inline const T toChannel(
+        const float p
+    ,   const float scale)
+    {
+        return static_cast<T>(_clamp(0.f, scale, p) + 0.5f);
+    }
+
+    template<>
+    inline const float toChannel<float>(
+        const float p
+    ,   const float /*scale*/)
+    {
+        return p;
+    }
+}
+
+
 template<typename T, int N>
 void PerlinMapGenerator::generate(
-    const int /*width*/
-,   const int /*height*/
-,   T * /*dest*/
-,   const float /*scale*/
-,   const e_NoiseType /*type*/
-,   const int /*startFrequency*/
-,   const int /*octaves*/
-,   const bool /*normalize*/)
+    const int width
+,   const int height
+,   T *dest
+,   const float scale
+,   const e_NoiseType type
+,   const int startFrequency
+,   const int octaves
+,   const bool normalize)
+{
+    assert(dest);
+
+    const int size = width * height;
+
+    if(size < 1 || octaves < 1)
+        return;
+
+    // The noise is tileable for frequencies up to the permutation size.
+
+    const int maxFrequency = 8;
+
+    assert(startFrequency >= 0 && startFrequency <= maxFrequency);
+    const int f0 = _clamp(0, maxFrequency, startFrequency);
+
+    // The standard noise uses the first octave only.
+    const int numOctaves = type == NT_Standard ? 1 : _mi(octaves, maxFrequency - f0 + 1);
+
+    const Noise noise;
+
+    std::vector<float> map(size);
+    std::vector<float> rowMin(height);
+    std::vector<float> rowMax(height);
+
+    OctaveRowKernel kernel(noise, width, height, type, f0, numOctaves
+        , &map[0], &rowMin[0], &rowMax[0]);
+
+    ParallelFor::run(height, kernel, _ma(1, 4096 / width));
+
+    // Fused normalization and conversion into the destination format.
+
+    float minp = rowMin[0];
+    float maxp = rowMax[0];
+
+    for(int y = 1; y < height; ++y)
+    {
+        minp = _mi(minp, rowMin[y]);
+        maxp = _ma(maxp, rowMax[y]);
+    }
+
+    float offset = 0.f;
+    float factor = scale;
+
+    if(normalize)
+    {
+        offset = -minp;
+        factor = maxp > minp ? scale / (maxp - minp) : 0.f;
+    }
+
+    for(int i = 0; i < size; ++i) 
+    {
+        const T p = toChannel<T>((map[i] + offset) * factor, scale);
+
+        for(int n = 0; n < N; ++n)
+            dest[i * N + n] = p;
+    }
+}
+
+
+void PerlinMapGenerator::generateTileable1f(
+    const int width
+,   const int height
+,   const int depth
+,   float *dest
+,   const int period
+,   const int octaves
+,   const float xOffset
+,   const float yOffset)
 {
-    //const unsigned int size = width * height;
-
-    //if(size < 1) 
-    //    return;
-
-    //float *temp = new float[size * octaves];
-    //float *temp2 = new float[size];
-
-    //int frequency = 1 << startFrequency;
-
-    //// Generate noise data for each octave.
-    //for(int f = 0; f < octaves; ++f, frequency *= 2)
-    //{
-    //    SetNoiseFrequency(frequency);
-
-    //    for(int y = 0; y < height; ++y) 
-    //        for(int x = 0; x < width; ++x) 
-    //        {
-    //            float xf = static_cast<float>(x) / width * frequency;
-    //            float yf = static_cast<float>(y) / height * frequency;
-
-    //            temp[(y * width  + x) + size * f] = static_cast<float>(noise(xf, yf));
-    //        }
-    //}
-
-    //// Generate image using noise data.
-
-    //float *fo = new float[octaves];
-
-    //for(int o = 0; o < octaves; ++o) 
-    //    fo[o] = 1.f / static_cast<float>(1 << o);
-
-
-    //float p, f, po, pf, minp = scale, maxp = 0.;
-
-    //for(int i = 0; i < width * height; ++i) 
-    //{
-    //    p = 0.f;
-
-    //    for(int o = 0; o < octaves; ++o) 
-    //    {
-    //        f = fo[o];
-
-    //        po = temp[i + size * o];
-    //        pf = f * po;
-
-    //        switch(type)
-    //        {
-    //        case NT_Standard:
-    //            p += o > 0 ? 0.f : po; 
-    //            break;
-    //        case NT_Cloud:
-    //            p += pf; 
-    //            break;
-    //        case NT_CloudAbs:
-    //            p += abs(static_cast<float>(pf)); 
-    //            break;
-    //        case NT_Wood:
-    //            p += (pf * 8.f) - int(pf * 8.f); 
-    //            break;
-    //        case NT_Paper:
-    //            p += po * po * (pf > 0 ? 1.f : -1.f); 
-    //            break;
-    //        };
-    //    }
-
-    //    p += 0.5;
-
-    //    if(p > maxp) 
-    //        maxp = p;
-    //    if(p < minp) 
-    //        minp = p;
-
-    //    temp2[i] = p;
-    //}
-
-    //if(normalize)
-    //{
-    //    const float invF = scale / (maxp - minp);
-    //    for(int i = 0; i < width * height; ++i) 
-    //    {
-    //        p = temp2[i];
-
-    //        p -= minp;
-    //        p *= invF;
-
-    //        for(unsigned int n = 0; n < N; ++n)
-    //            dest[i * N + n] = static_cast<T>(p);
-    //    }
-    //}
-    //else
-    //{
-    //    for(int i = 0; i < width * height; ++i) 
-    //    {
-    //        p = temp2[i];
-    //        p *= scale;
-
-    //        for(unsigned int n = 0; n < N; ++n)
-    //            dest[i * N + n] = static_cast<T>(p);
-    //    }
-    //}
-
-    //delete[] temp;
-    //delete[] temp2;
+    assert(dest);
+    assert(period > 0);
+
+    if(width < 1 || height < 1 || depth < 1 || octaves < 1)
+        return;
+
+    const Noise noise(8, xOffset, yOffset);
+
+    TileableRowKernel kernel(noise, width, height, depth, _ma(1, period), octaves, dest);
+    ParallelFor::run(height * depth, kernel, _ma(1, 4096 / width));
 }
 
 
@@ -0,0 +1,338 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "prerenderednoiserefresh.h"
+
+#include "mathmacros.h"
+
+#include <osg/Camera>
+#include <osg/Group>
+#include <osg/Uniform>
+#include <osg/Timer>
+
+#include <sstream>
+#include <iomanip>
+#include <assert.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    // The noise arrays are created by HighCloudLayerGeode::createNoiseArray.
+
+    const unsigned int NUM_TERMS(5);
+
+    const PreRenderedNoiseRefresh::t_noiseTerm TERMS[NUM_TERMS] =
+    {
+    //    array  size   scale  weight    wind   evolution
+        { 0,      64.f, 1.f,   1.00000f, 0.18f, 0.01f }
+    ,   { 1,     128.f, 1.f,   0.50000f, 0.16f, 0.02f }
+    ,   { 2,     256.f, 1.f,   0.25000f, 0.14f, 0.04f }
+    ,   { 3,     256.f, 1.f,   0.12500f, 0.12f, 0.08f }
+    ,   { 3,     256.f, 2.f,   0.06750f, 0.10f, 0.16f }
+    //, { 3,     256.f, 4.f,   0.06125f, 0.08f, 0.32f }
+    //, { 2,     256.f, 8.f,   0.06125f, 0.06f, 0.64f }
+    };
+
+    const unsigned int NUM_SLICES(4);
+
+    const float PARAMETER_EPSILON(1e-4f);
+}
+
+
+PreRenderedNoiseRefresh::PreRenderedNoiseRefresh(
+    osg::Group *preNoise
+,   const unsigned int texSize)
+:   osg::Referenced()
+,   m_camera(NULL)
+,   m_texSize(texSize)
+,   u_time(new osg::Uniform("time", 0.f))
+,   u_coverage(new osg::Uniform("coverage", 0.f))
+,   u_sharpness(new osg::Uniform("sharpness", 0.f))
+,   u_change(new osg::Uniform("change", 0.f))
+,   u_wind(new osg::Uniform("wind", osg::Vec2f(0.f, 0.f)))
+,   m_dirty(true)
+,   m_threshold(0.25f)
+,   m_maxRefreshRate(0.f)
+,   m_lastRefresh(0.0)
+,   m_numBands(1)
+,   m_band(1)
+,   m_updateCount(0)
+,   m_passCount(0)
+{
+    assert(preNoise);
+    assert(preNoise->getNumChildren() > 0);
+
+    m_camera = dynamic_cast<osg::Camera*>(preNoise->getChild(0));
+    assert(m_camera.valid());
+
+    // the bands are not cleared, since the quad overwrites every texel
+    m_camera->setClearMask(0);
+
+    osg::StateSet *stateSet(preNoise->getOrCreateStateSet());
+
+    stateSet->addUniform(u_time);
+    stateSet->addUniform(u_coverage);
+    stateSet->addUniform(u_sharpness);
+    stateSet->addUniform(u_change);
+    stateSet->addUniform(u_wind);
+}
+
+
+PreRenderedNoiseRefresh::~PreRenderedNoiseRefresh()
+{
+}
+
+
+const unsigned int PreRenderedNoiseRefresh::numTerms()
+{
+    return NUM_TERMS;
+}
+
+
+const PreRenderedNoiseRefresh::t_noiseTerm &PreRenderedNoiseRefresh::term(const unsigned int i)
+{
+    assert(i < NUM_TERMS);
+    return TERMS[i];
+}
+
+
+const unsigned int PreRenderedNoiseRefresh::numSlices()
+{
+    return NUM_SLICES;
+}
+
+
+const std::string PreRenderedNoiseRefresh::termsGlsl()
+{
+    std::ostringstream glsl;
+    glsl << std::fixed << std::setprecision(5);
+
+    for(unsigned int i = 0; i < NUM_TERMS; ++i)
+    {
+        const t_noiseTerm &term(TERMS[i]);
+
+        glsl << "   n += " << term.weight << " * texture3D(noise" << term.array 
+            << ", vec3(uv * " << term.scale << " + m * " << term.wind 
+            << ", t * " << term.evolution << ")).r;\n";
+    }
+    return glsl.str();
+}
+
+
+const bool PreRenderedNoiseRefresh::changedVisibly(
+    const float time
+,   const float coverage
+,   const float sharpness
+,   const float change
+,   const osg::Vec2f &wind) const
+{
+    float coverage0, sharpness0, change0, time0;
+    osg::Vec2f wind0;
+
+    u_time->get(time0);
+    u_coverage->get(coverage0);
+    u_sharpness->get(sharpness0);
+    u_change->get(change0);
+    u_wind->get(wind0);
+
+    if(fabs(coverage - coverage0) > PARAMETER_EPSILON 
+    || fabs(sharpness - sharpness0) > PARAMETER_EPSILON)
+        return true;
+
+    // same as in the shader: offsets by wind and evolution
+
+    const float t  = time  * 3600.f;
+    const float t0 = time0 * 3600.f;
+
+    const osg::Vec2f motion = wind * t - wind0 * t0;
+    const float evolution = fabs(t * change - t0 * change0);
+
+    for(unsigned int i = 0; i < NUM_TERMS; ++i)
+    {
+        // shift in texels of the term's noise array (the coordinate scale 
+        // does not scale the offset)
+        if(motion.length() * TERMS[i].wind * TERMS[i].size >= m_threshold)
+            return true;
+
+        // shift in slices, weighted as if the slices were texels apart
+        if(evolution * TERMS[i].evolution * NUM_SLICES >= m_threshold)
+            return true;
+    }
+    return false;
+}
+
+
+void PreRenderedNoiseRefresh::update(
+    const float time
+,   const float coverage
+,   const float sharpness
+,   const float change
+,   const osg::Vec2f &wind)
+{
+    ++m_updateCount;
+
+    // start a new refresh, if the previous is complete
+
+    if(m_band >= m_numBands && (m_dirty || changedVisibly(time, coverage, sharpness, change, wind)))
+    {
+        const double now = osg::Timer::instance()->time_s();
+
+        if(m_dirty || m_maxRefreshRate <= 0.f || now - m_lastRefresh >= 1.0 / m_maxRefreshRate)
+        {
+            u_time->set(time);
+            u_coverage->set(coverage);
+            u_sharpness->set(sharpness);
+            u_change->set(change);
+            u_wind->set(wind);
+
+            m_lastRefresh = now;
+            m_dirty = false;
+            m_band = 0;
+        }
+    }
+
+    if(m_band >= m_numBands)
+    {
+        m_camera->setNodeMask(0);
+        return;
+    }
+
+    // render the next band
+
+    const unsigned int y0 = m_texSize *  m_band      / m_numBands;
+    const unsigned int y1 = m_texSize * (m_band + 1) / m_numBands;
+
+    m_camera->setViewport(0, y0, m_texSize, y1 - y0);
+    m_camera->setNodeMask(~0u);
+
+    ++m_band;
+    ++m_passCount;
+}
+
+
+void PreRenderedNoiseRefresh::dirty()
+{
+    m_dirty = true;
+    m_band = m_numBands;
+}
+
+
+void PreRenderedNoiseRefresh::setThreshold(const float texels)
+{
+    m_threshold = _ma(0.f, texels);
+}
+
+
+const float PreRenderedNoiseRefresh::getThreshold() const
+{
+    return m_threshold;
+}
+
+
+void PreRenderedNoiseRefresh::setMaxRefreshRate(const float rate)
+{
+    m_maxRefreshRate = _ma(0.f, rate);
+}
+
+
+const float PreRenderedNoiseRefresh::getMaxRefreshRate() const
+{
+    return m_maxRefreshRate;
+}
+
+
+void PreRenderedNoiseRefresh::setNumBands(const unsigned int bands)
+{
+    m_numBands = _clamp(1u, m_texSize, bands);
+    dirty();
+}
+
+
+const unsigned int PreRenderedNoiseRefresh::getNumBands() const
+{
+    return m_numBands;
+}
+
+
+const unsigned int PreRenderedNoiseRefresh::getUpdateCount() const
+{
+    return m_updateCount;
+}
+
+
+const unsigned int PreRenderedNoiseRefresh::getPassCount() const
+{
+    return m_passCount;
+}
+
+
+const float PreRenderedNoiseRefresh::getTime() const
+{
+    float time;
+    u_time->get(time);
+
+    return time;
+}
+
+const float PreRenderedNoiseRefresh::getCoverage() const
+{
+    float coverage;
+    u_coverage->get(coverage);
+
+    return coverage;
+}
+
+const float PreRenderedNoiseRefresh::getSharpness() const
+{
+    float sharpness;
+    u_sharpness->get(sharpness);
+
+    return sharpness;
+}
+
+const float PreRenderedNoiseRefresh::getChange() const
+{
+    float change;
+    u_change->get(change);
+
+    return change;
+}
+
+const osg::Vec2f PreRenderedNoiseRefresh::getWind() const
+{
+    osg::Vec2f wind;
+    u_wind->get(wind);
+
+    return wind;
+}
+
+} // namespace osgHimmel
\ No newline at end of file
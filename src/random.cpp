@@ -0,0 +1,173 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "random.h"
+
+#include <OpenThreads/Atomic>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    const unsigned int PHILOX_M(0xd256d193);
+    const unsigned int PHILOX_W(0x9e3779b9);
+
+    const unsigned int PHILOX_ROUNDS(10);
+
+    // Read by generators on any thread, e.g., cloud layers and the noise 
+    // cache, so it is set and read atomically.
+    OpenThreads::Atomic globalSeedValue(0);
+}
+
+
+Random::Random(
+    const unsigned int seed
+,   const unsigned int stream)
+:   m_seed(seed)
+,   m_stream(stream)
+,   m_counter(0)
+{
+}
+
+
+const unsigned int Random::philox(
+    const unsigned int counter0
+,   const unsigned int counter1
+,   const unsigned int key)
+{
+    unsigned int x0 = counter0;
+    unsigned int x1 = counter1;
+    unsigned int k  = key;
+
+    for(unsigned int i = 0; i < PHILOX_ROUNDS; ++i, k += PHILOX_W)
+    {
+        const unsigned long long p = static_cast<unsigned long long>(PHILOX_M) * x0;
+
+        x0 = static_cast<unsigned int>(p >> 32) ^ k ^ x1;
+        x1 = static_cast<unsigned int>(p);
+    }
+    return x0;
+}
+
+
+const float Random::toUnit(const unsigned int value)
+{
+    return static_cast<float>(value >> 8) * (1.f / 16777216.f);
+}
+
+
+const unsigned int Random::at(const unsigned int counter) const
+{
+    return philox(counter, m_stream, m_seed);
+}
+
+
+const float Random::atf(
+    const unsigned int counter
+,   const float min
+,   const float max) const
+{
+    return toUnit(at(counter)) * (max - min) + min;
+}
+
+
+const unsigned int Random::next()
+{
+    return at(m_counter++);
+}
+
+
+const float Random::nextf(
+    const float min
+,   const float max)
+{
+    return atf(m_counter++, min, max);
+}
+
+
+const int Random::nexti(
+    const int min
+,   const int max)
+{
+    if(max <= min)
+        return min;
+
+    // unsigned arithmetic, max - min overflows int for wide ranges
+    const unsigned int range = static_cast<unsigned int>(max) - static_cast<unsigned int>(min) + 1;
+
+    // the full int range wraps to 0
+    const unsigned int offset = range ? next() % range : next();
+    return static_cast<int>(static_cast<unsigned int>(min) + offset);
+}
+
+
+void Random::skip(const unsigned int count)
+{
+    m_counter += count;
+}
+
+
+void Random::setCounter(const unsigned int counter)
+{
+    m_counter = counter;
+}
+
+
+const unsigned int Random::counter() const
+{
+    return m_counter;
+}
+
+
+const unsigned int Random::seed() const
+{
+    return m_seed;
+}
+
+
+const unsigned int Random::stream() const
+{
+    return m_stream;
+}
+
+
+void Random::setGlobalSeed(const unsigned int seed)
+{
+    globalSeedValue.exchange(seed);
+}
+
+
+const unsigned int Random::globalSeed()
+{
+    return globalSeedValue;
+}
+
+} // namespace osgHimmel
\ No newline at end of file
@@ -29,9 +29,7 @@
 
 #include "randommapgenerator.h"
 
-#include "mathmacros.h"
-
-#include <stdlib.h>
+#include "random.h"
 
 
 namespace osgHimmel
@@ -50,11 +48,12 @@ void RandomMapGenerator::generate(
     if(size < 1) 
         return;
 
-    srand(seed);
+    // counter based, so each texel is independent of any evaluation order
+    const Random random(static_cast<unsigned int>(seed));
 
     for(int i = 0; i < width * height; ++i) 
         for(unsigned int n = 0; n < N; ++n)
-            dest[i * N + n] = static_cast<T>(_randf(0.f, scale));
+            dest[i * N + n] = static_cast<T>(random.atf(i * N + n, 0.f, scale));
 }
 
 
@@ -0,0 +1,347 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "skyharmonics.h"
+
+#include "himmel.h"
+#include "atmospheregeode.h"
+#include "atmosphereprecompute.h"
+#include "atmospherequery.h"
+#include "abstractastronomy.h"
+#include "mathmacros.h"
+
+#include <osg/Uniform>
+#include <osg/Notify>
+#include <osg/Timer>
+
+#include <math.h>
+#include <assert.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    // convolution of the bands with the clamped cosine
+    const float A0(static_cast<float>(_PI));
+    const float A1(static_cast<float>(_PI * 2.0 / 3.0));
+    const float A2(static_cast<float>(_PI * 0.25));
+
+    // deterministic jitter within [0;1)
+    inline const float jitter(unsigned int &state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return static_cast<float>(state >> 8) / 16777216.f;
+    }
+}
+
+
+SkyHarmonics::SkyHarmonics(const unsigned int strata)
+:   osg::Referenced()
+,   m_query(new AtmosphereQuery)
+,   u_coefficients(new osg::Uniform(osg::Uniform::FLOAT_VEC3, "skySH", NUM_COEFFICIENTS))
+,   m_dirty(true)
+,   m_altitude(0.f)
+,   m_tablesModifiedCount(0)
+,   m_threshold(defaultThreshold())
+,   m_moonIntensity(defaultMoonIntensity())
+,   m_starsIntensity(defaultStarsIntensity())
+,   m_lastUpdateTime(0.0)
+{
+    for(unsigned int i = 0; i < NUM_COEFFICIENTS; ++i)
+    {
+        m_coefficients[i] = osg::Vec3f(0.f, 0.f, 0.f);
+        u_coefficients->setElement(i, m_coefficients[i]);
+    }
+
+    setupSamples(_ma(1u, strata));
+}
+
+
+SkyHarmonics::~SkyHarmonics()
+{
+}
+
+
+const unsigned int SkyHarmonics::defaultStrata()
+{
+    return 16;
+}
+
+
+void SkyHarmonics::setupSamples(const unsigned int strata)
+{
+    // Stratified in cos theta and phi, which are both uniform in solid angle.
+
+    const unsigned int strataPhi = strata * 2;
+    const unsigned int count = strata * strataPhi;
+
+    m_x.resize(count);
+    m_y.resize(count);
+    m_z.resize(count);
+
+    m_r.resize(count);
+    m_g.resize(count);
+    m_b.resize(count);
+
+    m_basis.resize(NUM_COEFFICIENTS * count);
+
+    unsigned int state = 0x5eed;
+    float Y[NUM_COEFFICIENTS];
+
+    unsigned int i = 0;
+    for(unsigned int t = 0; t < strata; ++t)
+        for(unsigned int p = 0; p < strataPhi; ++p, ++i)
+        {
+            const float z   = 1.f - 2.f * (t + jitter(state)) / strata;
+            const float phi = static_cast<float>(_PI2) * (p + jitter(state)) / strataPhi;
+
+            const float s = sqrtf(_ma(0.f, 1.f - z * z));
+
+            m_x[i] = s * cosf(phi);
+            m_y[i] = s * sinf(phi);
+            m_z[i] = z;
+
+            basis(osg::Vec3f(m_x[i], m_y[i], m_z[i]), Y);
+
+            for(unsigned int j = 0; j < NUM_COEFFICIENTS; ++j)
+                m_basis[j * count + i] = Y[j];
+        }
+}
+
+
+void SkyHarmonics::basis(
+    const osg::Vec3f &v
+,   float *Y)
+{
+    const float x = v[0];
+    const float y = v[1];
+    const float z = v[2];
+
+    Y[0] = 0.282095f;
+
+    Y[1] = 0.488603f * y;
+    Y[2] = 0.488603f * z;
+    Y[3] = 0.488603f * x;
+
+    Y[4] = 1.092548f * x * y;
+    Y[5] = 1.092548f * y * z;
+    Y[6] = 0.315392f * (3.f * z * z - 1.f);
+    Y[7] = 1.092548f * x * z;
+    Y[8] = 0.546274f * (x * x - y * y);
+}
+
+
+void SkyHarmonics::dirty()
+{
+    m_dirty = true;
+}
+
+
+osg::Uniform *SkyHarmonics::getUniform() const
+{
+    return u_coefficients.get();
+}
+
+
+const bool SkyHarmonics::update(const Himmel &himmel)
+{
+    if(!himmel.atmosphere())
+        return false;
+
+    if(!m_query->update(*himmel.atmosphere()->getPrecompute()))
+    {
+        OSG_WARN << "Sky harmonics require the atmosphere tables on the CPU (see e_TableStorage)." << std::endl;
+        return false;
+    }
+    m_query->setAltitude(himmel.getAltitude());
+
+    const osg::Vec3f sun  = himmel.astro()->getSunPosition(true);
+    const osg::Vec3f moon = himmel.astro()->getMoonPosition(true);
+
+    const float cosThreshold = cosf(m_threshold);
+
+    const bool changed = m_dirty
+        || m_tablesModifiedCount != m_query->getModifiedCount()
+        || m_altitude != m_query->getAltitude()
+        || sun  * m_sun  < cosThreshold
+        || moon * m_moon < cosThreshold;
+
+    if(!changed)
+        return false;
+
+    const osg::Timer_t t0 = osg::Timer::instance()->tick();
+
+    m_sun  = sun;
+    m_moon = moon;
+    m_altitude = m_query->getAltitude();
+    m_tablesModifiedCount = m_query->getModifiedCount();
+
+    project(himmel);
+
+    for(unsigned int i = 0; i < NUM_COEFFICIENTS; ++i)
+        u_coefficients->setElement(i, m_coefficients[i]);
+
+    m_dirty = false;
+
+    m_lastUpdateTime = osg::Timer::instance()->delta_m(t0, osg::Timer::instance()->tick());
+    OSG_DEBUG << "Sky harmonics projected " << numSamples() << " samples in " << m_lastUpdateTime << " ms" << std::endl;
+
+    return true;
+}
+
+
+void SkyHarmonics::projectSamples()
+{
+    const unsigned int count = numSamples();
+    const float weight = static_cast<float>(_PI4) / count;
+
+    for(unsigned int j = 0; j < NUM_COEFFICIENTS; ++j)
+    {
+        const float *Y = &m_basis[j * count];
+
+        float r = 0.f, g = 0.f, b = 0.f;
+        for(unsigned int i = 0; i < count; ++i)
+        {
+            r += m_r[i] * Y[i];
+            g += m_g[i] * Y[i];
+            b += m_b[i] * Y[i];
+        }
+        m_coefficients[j] = osg::Vec3f(r, g, b) * weight;
+    }
+}
+
+
+void SkyHarmonics::project(const Himmel &himmel)
+{
+    const unsigned int count = numSamples();
+
+    // atmosphere
+
+    m_query->inscatter(count, &m_x[0], &m_y[0], &m_z[0], m_sun, &m_r[0], &m_g[0], &m_b[0]);
+    projectSamples();
+
+    // moon, with illuminated fraction from the elongation
+
+    const osg::Vec3f sunv  = himmel.astro()->getSunPosition(false);
+    const osg::Vec3f moonv = himmel.astro()->getMoonPosition(false);
+
+    const float fraction = (1.f - sunv * moonv) * 0.5f;
+    const osg::Vec3f moonLight = m_query->sunColor(m_moon) * (m_moonIntensity * fraction);
+
+    float Y[NUM_COEFFICIENTS];
+    basis(m_moon, Y);
+
+    for(unsigned int j = 0; j < NUM_COEFFICIENTS; ++j)
+        m_coefficients[j] += moonLight * Y[j];
+
+    // stars, constant over the upper hemisphere (l2, m0 integrates to zero)
+
+    const float stars = m_starsIntensity * AtmosphereQuery::sunIntensity();
+
+    m_coefficients[0] += osg::Vec3f(1.f, 1.f, 1.f) * (stars * static_cast<float>(_PI2) * 0.282095f);
+    m_coefficients[2] += osg::Vec3f(1.f, 1.f, 1.f) * (stars * static_cast<float>(_PI)  * 0.488603f);
+}
+
+
+const osg::Vec3f SkyHarmonics::irradiance(const osg::Vec3f &normal) const
+{
+    osg::Vec3f n(normal);
+    n.normalize();
+
+    float Y[NUM_COEFFICIENTS];
+    basis(n, Y);
+
+    osg::Vec3f E = m_coefficients[0] * (A0 * Y[0]);
+
+    for(unsigned int j = 1; j < 4; ++j)
+        E += m_coefficients[j] * (A1 * Y[j]);
+    for(unsigned int j = 4; j < NUM_COEFFICIENTS; ++j)
+        E += m_coefficients[j] * (A2 * Y[j]);
+
+    return osg::Vec3f(_ma(0.f, E[0]), _ma(0.f, E[1]), _ma(0.f, E[2]));
+}
+
+
+const float SkyHarmonics::setThreshold(const float angle)
+{
+    m_threshold = _ma(0.f, angle);
+    return getThreshold();
+}
+
+const float SkyHarmonics::getThreshold() const
+{
+    return m_threshold;
+}
+
+const float SkyHarmonics::defaultThreshold()
+{
+    return static_cast<float>(_rad(0.25));
+}
+
+
+const float SkyHarmonics::setMoonIntensity(const float intensity)
+{
+    m_moonIntensity = _ma(0.f, intensity);
+    dirty();
+
+    return getMoonIntensity();
+}
+
+const float SkyHarmonics::getMoonIntensity() const
+{
+    return m_moonIntensity;
+}
+
+const float SkyHarmonics::defaultMoonIntensity()
+{
+    return 2.5e-6f; // about 0.25 lux vs. 100000 lux
+}
+
+
+const float SkyHarmonics::setStarsIntensity(const float intensity)
+{
+    m_starsIntensity = _ma(0.f, intensity);
+    dirty();
+
+    return getStarsIntensity();
+}
+
+const float SkyHarmonics::getStarsIntensity() const
+{
+    return m_starsIntensity;
+}
+
+const float SkyHarmonics::defaultStarsIntensity()
+{
+    return 3e-10f; // about 0.0001 lux (including airglow)
+}
+
+} // namespace osgHimmel
\ No newline at end of file
@@ -0,0 +1,474 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "starcatalogue.h"
+
+#include "brightstars.h"
+#include "coords.h"
+#include "mathmacros.h"
+#include "packedstars.h"
+
+#include <osg/Notify>
+
+#ifdef WIN32
+#include <windows.h>
+#else // WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif // WIN32
+
+#include <fstream>
+#include <algorithm>
+#include <utility>
+#include <string.h>
+#include <assert.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    const char STARS_MAGIC[8] = { 'O', 'S', 'G', 'H', 'S', 'T', 'A', 'R' };
+    const unsigned int STARS_VERSION(1);
+    const unsigned int STARS_ENDIAN (0x01020304);
+
+    // magic, version, endian, count, two offsets, flags
+    const unsigned int HEADER_SIZE(sizeof(STARS_MAGIC) + 6 * sizeof(unsigned int));
+
+    const unsigned int BLOCK_ALIGNMENT(16);
+
+    const unsigned int FLAG_SORTED_BY_MAGNITUDE(0x1);
+    const unsigned int FLAG_SORTED_BY_CELL     (0x2);
+
+    const unsigned int CELL_DEPTH_SHIFT(8);
+    const unsigned int CELL_DEPTH_MASK (0xff);
+
+    inline const unsigned int header(
+        const unsigned char *data
+    ,   const unsigned int i)
+    {
+        unsigned int value;
+        memcpy(&value, data + sizeof(STARS_MAGIC) + i * sizeof(unsigned int), sizeof(unsigned int));
+
+        return value;
+    }
+
+    inline const unsigned int aligned(const unsigned int offset)
+    {
+        return (offset + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+    }
+}
+
+
+StarCatalogue::StarCatalogue()
+:   osg::Referenced()
+,   m_mapping(NULL)
+,   m_mappingSize(0)
+,   m_positions(NULL)
+,   m_colors(NULL)
+,   m_numStars(0)
+,   m_sortedByMagnitude(false)
+,   m_sortedByCell(false)
+,   m_cellDepth(0)
+{
+}
+
+
+StarCatalogue::~StarCatalogue()
+{
+    close();
+}
+
+
+const bool StarCatalogue::open(const char *fileName)
+{
+    close();
+
+    if(map(fileName))
+        return true;
+
+    if(m_mapping)
+    {
+        // has a header, but is invalid
+        close();
+        return false;
+    }
+
+    if(PackedStars::isPackedFile(fileName))
+        return unpack(fileName);
+
+    // fall back to raw bright stars
+
+    BrightStars brightStars(fileName);
+    if(!brightStars.numStars())
+        return false;
+
+    OSG_INFO << "Star catalogue " << fileName << " has no header and was converted." << std::endl;
+
+    assign(brightStars);
+    return true;
+}
+
+
+const bool StarCatalogue::unpack(const char *fileName)
+{
+    PackedStars::t_packedStars packed;
+    if(!PackedStars::fromFile(fileName, packed))
+        return false;
+
+    const unsigned int numStars = static_cast<unsigned int>(packed.size());
+
+    m_convertedPositions.resize(numStars);
+    m_convertedColors.resize(numStars);
+
+    m_numStars = numStars;
+
+    if(numStars)
+    {
+        PackedStars::decode(&packed[0], &m_convertedPositions[0], &m_convertedColors[0], numStars);
+
+        m_positions = &m_convertedPositions[0];
+        m_colors    = &m_convertedColors[0];
+    }
+    return true;
+}
+
+
+const bool StarCatalogue::map(const char *fileName)
+{
+#ifdef WIN32
+
+    HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ
+        , NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size) || size.QuadPart < HEADER_SIZE)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+
+    if(!mapping)
+        return false;
+
+    m_mapping = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+
+    m_mappingSize = static_cast<size_t>(size.QuadPart);
+
+#else // WIN32
+
+    const int file = ::open(fileName, O_RDONLY);
+    if(file < 0)
+        return false;
+
+    struct stat status;
+    if(fstat(file, &status) != 0 || status.st_size < static_cast<off_t>(HEADER_SIZE))
+    {
+        ::close(file);
+        return false;
+    }
+
+    void *mapping = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+
+    m_mapping = mapping == MAP_FAILED ? NULL : mapping;
+    m_mappingSize = static_cast<size_t>(status.st_size);
+
+#endif // WIN32
+
+    if(!m_mapping)
+        return false;
+
+    const unsigned char *data = static_cast<const unsigned char *>(m_mapping);
+
+    if(memcmp(data, STARS_MAGIC, sizeof(STARS_MAGIC)) != 0)
+    {
+        close();
+        return false;
+    }
+
+    // bounds check
+
+    const unsigned int version         = header(data, 0);
+    const unsigned int endian          = header(data, 1);
+    const unsigned int numStars        = header(data, 2);
+    const unsigned int positionsOffset = header(data, 3);
+    const unsigned int colorsOffset    = header(data, 4);
+    const unsigned int flags           = header(data, 5);
+
+    const unsigned long long blockSize = static_cast<unsigned long long>(numStars) * sizeof(osg::Vec4f);
+
+    if(version != STARS_VERSION || endian != STARS_ENDIAN
+    || positionsOffset < HEADER_SIZE || positionsOffset % BLOCK_ALIGNMENT != 0
+    || colorsOffset    < HEADER_SIZE || colorsOffset    % BLOCK_ALIGNMENT != 0
+    || positionsOffset + blockSize > m_mappingSize
+    || colorsOffset    + blockSize > m_mappingSize)
+    {
+        OSG_NOTICE << "Star catalogue " << fileName << " is truncated or has an unsupported format (version " << version 
+            << ", endian " << std::hex << endian << std::dec << ")." << std::endl;
+        return false; // keeps the mapping for open to not fall back
+    }
+
+    m_positions = reinterpret_cast<const osg::Vec4f *>(data + positionsOffset);
+    m_colors    = reinterpret_cast<const osg::Vec4f *>(data + colorsOffset);
+
+    m_numStars = numStars;
+    m_sortedByMagnitude = (flags & FLAG_SORTED_BY_MAGNITUDE) != 0;
+
+    m_sortedByCell = (flags & FLAG_SORTED_BY_CELL) != 0;
+    m_cellDepth = (flags >> CELL_DEPTH_SHIFT) & CELL_DEPTH_MASK;
+
+    return true;
+}
+
+
+void StarCatalogue::close()
+{
+    if(m_mapping)
+    {
+#ifdef WIN32
+        UnmapViewOfFile(m_mapping);
+#else // WIN32
+        munmap(m_mapping, m_mappingSize);
+#endif // WIN32
+    }
+    m_mapping = NULL;
+    m_mappingSize = 0;
+
+    m_convertedPositions.clear();
+    m_convertedColors.clear();
+
+    m_positions = NULL;
+    m_colors = NULL;
+
+    m_numStars = 0;
+    m_sortedByMagnitude = false;
+
+    m_sortedByCell = false;
+    m_cellDepth = 0;
+}
+
+
+void StarCatalogue::assign(const BrightStars &brightStars)
+{
+    close();
+
+    const BrightStars::s_BrightStar *stars = brightStars.stars();
+    const unsigned int numStars = brightStars.numStars();
+
+    m_convertedPositions.resize(numStars);
+    m_convertedColors.resize(numStars);
+
+    for(unsigned int i = 0; i < numStars; ++i)
+    {
+        t_equf equ;
+        equ.right_ascension = _rightascd(stars[i].RA, 0, 0);
+        equ.declination = stars[i].DE;
+
+        const osg::Vec3f vec = equ.toEuclidean();
+
+        m_convertedPositions[i] = osg::Vec4f(vec.x(), vec.y(), vec.z(), static_cast<float>(i));
+        m_convertedColors[i]    = osg::Vec4f(stars[i].sRGB_R, stars[i].sRGB_G, stars[i].sRGB_B, stars[i].Vmag);
+    }
+
+    m_numStars = numStars;
+
+    if(numStars)
+    {
+        m_positions = &m_convertedPositions[0];
+        m_colors    = &m_convertedColors[0];
+    }
+}
+
+
+const bool StarCatalogue::toFile(const char *fileName) const
+{
+    std::ofstream out(fileName, std::ios::binary);
+    if(!out.good())
+        return false;
+
+    const unsigned int blockSize = m_numStars * sizeof(osg::Vec4f);
+
+    const unsigned int positionsOffset = aligned(HEADER_SIZE);
+    const unsigned int colorsOffset    = aligned(positionsOffset + blockSize);
+
+    const unsigned int flags = (m_sortedByMagnitude ? FLAG_SORTED_BY_MAGNITUDE : 0)
+        | (m_sortedByCell ? FLAG_SORTED_BY_CELL | (m_cellDepth & CELL_DEPTH_MASK) << CELL_DEPTH_SHIFT : 0);
+
+    const unsigned int fields[6] = 
+    {
+        STARS_VERSION, STARS_ENDIAN, m_numStars, positionsOffset, colorsOffset, flags
+    };
+
+    out.write(STARS_MAGIC, sizeof(STARS_MAGIC));
+    out.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+
+    const char padding[BLOCK_ALIGNMENT] = { 0 };
+
+    out.write(padding, positionsOffset - HEADER_SIZE);
+    if(m_numStars)
+        out.write(reinterpret_cast<const char*>(m_positions), blockSize);
+
+    out.write(padding, colorsOffset - positionsOffset - blockSize);
+    if(m_numStars)
+        out.write(reinterpret_cast<const char*>(m_colors), blockSize);
+
+    return out.good();
+}
+
+
+void StarCatalogue::sortByMagnitude()
+{
+    if(m_sortedByMagnitude)
+        return;
+
+    std::vector<std::pair<float, unsigned int> > sorted(m_numStars);
+    for(unsigned int i = 0; i < m_numStars; ++i)
+        sorted[i] = std::make_pair(m_colors[i][3], i);
+
+    // pairs compare by index on equal magnitudes, which keeps it stable
+    std::sort(sorted.begin(), sorted.end());
+
+    std::vector<unsigned int> order(m_numStars);
+    for(unsigned int i = 0; i < m_numStars; ++i)
+        order[i] = sorted[i].second;
+
+    reorder(order);
+    m_sortedByMagnitude = true;
+}
+
+
+void StarCatalogue::reorder(const std::vector<unsigned int> &order)
+{
+    assert(order.size() == m_numStars);
+
+    std::vector<osg::Vec4f> positions(m_numStars);
+    std::vector<osg::Vec4f> colors(m_numStars);
+
+    for(unsigned int i = 0; i < m_numStars; ++i)
+    {
+        assert(order[i] < m_numStars);
+
+        positions[i] = m_positions[order[i]];
+        colors[i]    = m_colors   [order[i]];
+    }
+
+    const unsigned int numStars = m_numStars;
+    close();
+
+    m_convertedPositions.swap(positions);
+    m_convertedColors.swap(colors);
+
+    m_numStars = numStars;
+    m_sortedByMagnitude = false;
+
+    if(numStars)
+    {
+        m_positions = &m_convertedPositions[0];
+        m_colors    = &m_convertedColors[0];
+    }
+}
+
+
+const bool StarCatalogue::isSortedByMagnitude() const
+{
+    return m_sortedByMagnitude;
+}
+
+
+void StarCatalogue::setSortedByCell(const unsigned int depth)
+{
+    assert(depth <= CELL_DEPTH_MASK);
+
+    m_sortedByCell = true;
+    m_cellDepth = depth;
+}
+
+
+const bool StarCatalogue::isSortedByCell(const unsigned int depth) const
+{
+    return m_sortedByCell && m_cellDepth == depth;
+}
+
+
+const unsigned int StarCatalogue::numStarsUpTo(const float magnitude) const
+{
+    assert(m_sortedByMagnitude);
+
+    // binary search for the first fainter star
+
+    unsigned int lower = 0;
+    unsigned int upper = m_numStars;
+
+    while(lower < upper)
+    {
+        const unsigned int mid = lower + (upper - lower) / 2;
+
+        if(m_colors[mid][3] <= magnitude)
+            lower = mid + 1;
+        else
+            upper = mid;
+    }
+    return lower;
+}
+
+
+const bool StarCatalogue::isMapped() const
+{
+    return m_mapping != NULL;
+}
+
+
+const unsigned int StarCatalogue::numStars() const
+{
+    return m_numStars;
+}
+
+
+const osg::Vec4f *StarCatalogue::positions() const
+{
+    return m_positions;
+}
+
+
+const osg::Vec4f *StarCatalogue::colors() const
+{
+    return m_colors;
+}
+
+} // namespace osgHimmel
\ No newline at end of file
@@ -0,0 +1,431 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "starmapbaker.h"
+
+#include "starcatalogue.h"
+#include "parallelfor.h"
+#include "mathmacros.h"
+
+#include <osg/ref_ptr>
+#include <osg/Image>
+#include <osg/Texture>
+#include <osg/Notify>
+#include <osgDB/WriteFile>
+
+#include <limits>
+#include <string.h>
+#include <assert.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    // Major axis and the axes of the s and t texture coordinates per face, 
+    // as specified for gl cube maps.
+
+    const float FACES[6][3][3] =
+    {
+        { {  1.f,  0.f,  0.f }, {  0.f, 0.f, -1.f }, { 0.f, -1.f,  0.f } }
+    ,   { { -1.f,  0.f,  0.f }, {  0.f, 0.f,  1.f }, { 0.f, -1.f,  0.f } }
+    ,   { {  0.f,  1.f,  0.f }, {  1.f, 0.f,  0.f }, { 0.f,  0.f,  1.f } }
+    ,   { {  0.f, -1.f,  0.f }, {  1.f, 0.f,  0.f }, { 0.f,  0.f, -1.f } }
+    ,   { {  0.f,  0.f,  1.f }, {  1.f, 0.f,  0.f }, { 0.f, -1.f,  0.f } }
+    ,   { {  0.f,  0.f, -1.f }, { -1.f, 0.f,  0.f }, { 0.f, -1.f,  0.f } }
+    };
+
+    const std::string FACE_EXTENSIONS[6] = { "_px", "_nx", "_py", "_ny", "_pz", "_nz" };
+
+    // rows per work item
+    const unsigned int BLOCK_ROWS(16);
+
+    inline const float dot(
+        const osg::Vec4f &v
+    ,   const float *axis)
+    {
+        return v[0] * axis[0] + v[1] * axis[1] + v[2] * axis[2];
+    }
+
+
+    // A star projected onto a face, in texels, with its normalized color.
+
+    struct s_Splat
+    {
+        float x;
+        float y;
+
+        float rgb[3];
+    };
+
+
+    class BakeKernel : public ParallelFor::Kernel
+    {
+    public:
+        BakeKernel(
+            const unsigned int size
+        ,   const float sigma
+        ,   const int extent
+        ,   const std::vector<s_Splat> *splats
+        ,   const std::vector<std::vector<unsigned int> > &bins
+        ,   std::vector<float> *faces)
+        :   m_size(size)
+        ,   m_sigma(sigma)
+        ,   m_extent(extent)
+        ,   m_numBlocks((size + BLOCK_ROWS - 1) / BLOCK_ROWS)
+        ,   m_splats(splats)
+        ,   m_bins(bins)
+        ,   m_faces(faces)
+        {
+        }
+
+        virtual void operator()(
+            const int begin
+        ,   const int end)
+        {
+            const int size = static_cast<int>(m_size);
+            const float k = -0.5f / (m_sigma * m_sigma);
+
+            std::vector<float> wx(2 * m_extent + 1);
+
+            for(int b = begin; b < end; ++b)
+            {
+                const unsigned int face = b / m_numBlocks;
+
+                const int row0 = (b % m_numBlocks) * BLOCK_ROWS;
+                const int row1 = _mi(row0 + static_cast<int>(BLOCK_ROWS), size);
+
+                const std::vector<s_Splat> &splats(m_splats[face]);
+                const std::vector<unsigned int> &bin(m_bins[b]);
+
+                float *texels = &m_faces[face][0];
+
+                // stars in catalogue order, which makes the sums deterministic
+
+                for(unsigned int s = 0; s < bin.size(); ++s)
+                {
+                    const s_Splat &splat(splats[bin[s]]);
+
+                    const int ix = static_cast<int>(floor(splat.x));
+                    const int iy = static_cast<int>(floor(splat.y));
+
+                    const int i0 = _ma(ix - m_extent, 0);
+                    const int i1 = _mi(ix + m_extent, size - 1);
+                    const int j0 = _ma(iy - m_extent, row0);
+                    const int j1 = _mi(iy + m_extent, row1 - 1);
+
+                    for(int i = i0; i <= i1; ++i)
+                    {
+                        const float dx = i + 0.5f - splat.x;
+                        wx[i - i0] = exp(k * dx * dx);
+                    }
+
+                    for(int j = j0; j <= j1; ++j)
+                    {
+                        const float dy = j + 0.5f - splat.y;
+                        const float wy = exp(k * dy * dy);
+
+                        float *texel = &texels[(j * size + i0) * 3];
+                        for(int i = i0; i <= i1; ++i, texel += 3)
+                        {
+                            const float w = wx[i - i0] * wy;
+
+                            texel[0] += splat.rgb[0] * w;
+                            texel[1] += splat.rgb[1] * w;
+                            texel[2] += splat.rgb[2] * w;
+                        }
+                    }
+                }
+
+                // flux per texel to radiance, the solid angle of a texel 
+                // is proportional to 1 / (1 + u^2 + v^2)^(3/2)
+
+                for(int j = row0; j < row1; ++j)
+                {
+                    const float v = 2.f * (j + 0.5f) / size - 1.f;
+
+                    float *texel = &texels[j * size * 3];
+                    for(int i = 0; i < size; ++i, texel += 3)
+                    {
+                        const float u = 2.f * (i + 0.5f) / size - 1.f;
+
+                        const float r2 = 1.f + u * u + v * v;
+                        const float omega = r2 * sqrt(r2);
+
+                        texel[0] *= omega;
+                        texel[1] *= omega;
+                        texel[2] *= omega;
+                    }
+                }
+            }
+        }
+
+    protected:
+        const unsigned int m_size;
+        const float m_sigma;
+        const int m_extent;
+        const unsigned int m_numBlocks;
+
+        const std::vector<s_Splat> *m_splats;
+        const std::vector<std::vector<unsigned int> > &m_bins;
+
+        std::vector<float> *m_faces;
+    };
+}
+
+
+StarMapBaker::StarMapBaker(const unsigned int size)
+:   m_size(size)
+,   m_brightest(-std::numeric_limits<float>::max())
+,   m_faintest(std::numeric_limits<float>::max())
+,   m_sigma(defaultSigma())
+,   m_referenceMagnitude(defaultReferenceMagnitude())
+,   m_numThreads(0)
+{
+    assert(size > 0);
+
+    for(unsigned int i = 0; i < 6; ++i)
+        m_faces[i].resize(m_size * m_size * 3, 0.f);
+}
+
+
+StarMapBaker::~StarMapBaker()
+{
+}
+
+
+const unsigned int StarMapBaker::size() const
+{
+    return m_size;
+}
+
+
+void StarMapBaker::setMagnitudeRange(
+    const float brightest
+,   const float faintest)
+{
+    m_brightest = brightest;
+    m_faintest = faintest;
+}
+
+
+const float StarMapBaker::getBrightestMagnitude() const
+{
+    return m_brightest;
+}
+
+
+const float StarMapBaker::getFaintestMagnitude() const
+{
+    return m_faintest;
+}
+
+
+const float StarMapBaker::setSigma(const float sigma)
+{
+    m_sigma = _ma(sigma, 0.1f);
+    return getSigma();
+}
+
+const float StarMapBaker::getSigma() const
+{
+    return m_sigma;
+}
+
+const float StarMapBaker::defaultSigma()
+{
+    return 0.75f;
+}
+
+
+const float StarMapBaker::setReferenceMagnitude(const float magnitude)
+{
+    m_referenceMagnitude = magnitude;
+    return getReferenceMagnitude();
+}
+
+const float StarMapBaker::getReferenceMagnitude() const
+{
+    return m_referenceMagnitude;
+}
+
+const float StarMapBaker::defaultReferenceMagnitude()
+{
+    return 6.5f; // about the faintest stars visible (Earth::apparentMagnitudeLimit)
+}
+
+
+void StarMapBaker::setNumThreads(const unsigned int numThreads)
+{
+    m_numThreads = numThreads;
+}
+
+
+const unsigned int StarMapBaker::bake(const StarCatalogue &catalogue)
+{
+    const int size = static_cast<int>(m_size);
+
+    // extent of the point spread function in texels, beyond 3 sigma
+    const int extent = static_cast<int>(ceil(3.f * m_sigma));
+
+    const unsigned int numBlocks = (m_size + BLOCK_ROWS - 1) / BLOCK_ROWS;
+
+    std::vector<s_Splat> splats[6];
+    std::vector<std::vector<unsigned int> > bins(6 * numBlocks);
+
+    const osg::Vec4f *positions = catalogue.positions();
+    const osg::Vec4f *colors = catalogue.colors();
+
+    const float k = -0.5f / (m_sigma * m_sigma);
+
+    unsigned int numBaked = 0;
+
+    for(unsigned int i = 0; i < catalogue.numStars(); ++i)
+    {
+        const float m = colors[i][3];
+        if(m <= m_brightest || m > m_faintest)
+            continue;
+
+        ++numBaked;
+
+        const float flux = pow(2.512f, m_referenceMagnitude - m);
+
+        // Splat onto every face the star projects onto, including the 
+        // neighbours its point spread function reaches into.
+
+        for(unsigned int f = 0; f < 6; ++f)
+        {
+            const float ma = dot(positions[i], FACES[f][0]);
+            if(ma <= 0.f)
+                continue;
+
+            s_Splat splat;
+            splat.x = (dot(positions[i], FACES[f][1]) / ma + 1.f) * 0.5f * size;
+            splat.y = (dot(positions[i], FACES[f][2]) / ma + 1.f) * 0.5f * size;
+
+            if(splat.x < -extent || splat.x > size + extent
+            || splat.y < -extent || splat.y > size + extent)
+                continue;
+
+            // normalization by the whole footprint (separable)
+
+            const int ix = static_cast<int>(floor(splat.x));
+            const int iy = static_cast<int>(floor(splat.y));
+
+            float sx = 0.f;
+            float sy = 0.f;
+
+            for(int o = -extent; o <= extent; ++o)
+            {
+                const float dx = ix + o + 0.5f - splat.x;
+                const float dy = iy + o + 0.5f - splat.y;
+
+                sx += exp(k * dx * dx);
+                sy += exp(k * dy * dy);
+            }
+
+            const float scale = flux / (sx * sy);
+
+            splat.rgb[0] = colors[i][0] * scale;
+            splat.rgb[1] = colors[i][1] * scale;
+            splat.rgb[2] = colors[i][2] * scale;
+
+            const unsigned int index = static_cast<unsigned int>(splats[f].size());
+            splats[f].push_back(splat);
+
+            const int row0 = _ma(iy - extent, 0);
+            const int row1 = _mi(iy + extent, size - 1);
+
+            if(row0 > row1)
+                continue;
+
+            for(int b = row0 / BLOCK_ROWS; b <= row1 / static_cast<int>(BLOCK_ROWS); ++b)
+                bins[f * numBlocks + b].push_back(index);
+        }
+    }
+
+    for(unsigned int f = 0; f < 6; ++f)
+        std::fill(m_faces[f].begin(), m_faces[f].end(), 0.f);
+
+    BakeKernel kernel(m_size, m_sigma, extent, splats, bins, m_faces);
+    ParallelFor::run(6 * numBlocks, kernel, 1, m_numThreads);
+
+    OSG_INFO << "Baked " << numBaked << " stars into a " << m_size << "^2 star map." << std::endl;
+
+    return numBaked;
+}
+
+
+const float *StarMapBaker::face(const unsigned int i) const
+{
+    assert(i < 6);
+    return &m_faces[i][0];
+}
+
+
+osg::Image *StarMapBaker::createImage(const unsigned int i) const
+{
+    assert(i < 6);
+
+    osg::Image *image = new osg::Image;
+    image->allocateImage(m_size, m_size, 1, GL_RGB, GL_FLOAT);
+    image->setInternalTextureFormat(GL_RGB16F_ARB);
+
+    memcpy(image->data(), face(i), m_faces[i].size() * sizeof(float));
+
+    return image;
+}
+
+
+const bool StarMapBaker::write(const std::string &cubeMapFilePath) const
+{
+    const std::string::size_type q = cubeMapFilePath.find("?");
+    if(q == std::string::npos)
+    {
+        OSG_WARN << "Star map path " << cubeMapFilePath << " has no '?' for the face extensions." << std::endl;
+        return false;
+    }
+
+    for(unsigned int i = 0; i < 6; ++i)
+    {
+        std::string filePath(cubeMapFilePath);
+        filePath.replace(q, 1, FACE_EXTENSIONS[i]);
+
+        osg::ref_ptr<osg::Image> image = createImage(i);
+        if(!osgDB::writeImageFile(*image, filePath))
+        {
+            OSG_WARN << "Star map face could not be written to " << filePath << "." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace osgHimmel
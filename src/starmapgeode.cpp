@@ -29,9 +29,7 @@
 
 #include "starmapgeode.h"
 
-#include "himmel.h"
 #include "himmelquad.h"
-#include "abstractastronomy.h"
 #include "earth.h"
 #include "mathmacros.h"
 
@@ -56,9 +54,6 @@ StarMapGeode::StarMapGeode(const char* cubeMapFilePath)
 
 ,   m_hquad(new HimmelQuad())
 
-,   u_R(NULL)
-,   u_q(NULL)
-
 ,   u_color(NULL) // [0,1,2] = color; [3] = intensity
 ,   u_deltaM(NULL)
 ,   u_scattering(NULL)
@@ -83,16 +78,8 @@ StarMapGeode::~StarMapGeode()
 };
 
 
-void StarMapGeode::update(const Himmel &himmel)
+void StarMapGeode::update(const Himmel &)
 {
-    // TODO: starmap and planets also require this ... - find better place
-    const float fov = himmel.getCameraFovHint();
-    const float height = himmel.getViewSizeHeightHint();
-
-    //u_q->set(static_cast<float>(tan(_rad(fov / 2)) / (height * 0.5)));
-    u_q->set(static_cast<float>(sqrt(2.0) * 2.0 * tan(_rad(fov * 0.5)) / height));
-
-    u_R->set(himmel.astro()->getEquToHorTransform());
 }
 
 
@@ -103,11 +90,7 @@ void StarMapGeode::setupNode(osg::StateSet*)
 
 void StarMapGeode::setupUniforms(osg::StateSet* stateSet)
 {
-    u_R = new osg::Uniform("R", osg::Matrixf::identity());
-    stateSet->addUniform(u_R);
-
-    u_q = new osg::Uniform("q", 0.0f);
-    stateSet->addUniform(u_q);
+    // R and q are shared by the himmel
 
     u_color = new osg::Uniform("color", osg::Vec4f(defaultColor(), defaultColorRatio()));
     stateSet->addUniform(u_color);
@@ -176,6 +159,10 @@ void StarMapGeode::setupTextures(
         if(img && !img->valid())
             std::cout << "Image is invalud: " << fp << std::endl;
 
+        // baked star maps (see StarMapBaker) keep their dynamic range
+        if(img && img->getDataType() == GL_FLOAT)
+            tcm->setInternalFormat(GL_RGB16F_ARB);
+
         tcm->setImage(cmFace[i], img);
     }
 
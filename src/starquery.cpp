@@ -0,0 +1,287 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "starquery.h"
+
+#include "abstractastronomy.h"
+#include "brightstars.h"
+#include "starcatalogue.h"
+#include "starskyindex.h"
+#include "mathmacros.h"
+
+#include <osg/Notify>
+
+#include <algorithm>
+#include <assert.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    inline const bool brighter(
+        const StarQuery::t_star &a
+    ,   const StarQuery::t_star &b)
+    {
+        return a.magnitude < b.magnitude 
+            || (a.magnitude == b.magnitude && a.index < b.index);
+    }
+
+
+    // Star tests on normalized horizontal directions.
+
+    class ConeTest
+    {
+    public:
+        ConeTest(
+            const osg::Vec3f &axis
+        ,   const float cosRadius)
+        :   m_axis(axis)
+        ,   m_cosRadius(cosRadius)
+        {
+        }
+
+        inline const bool operator()(const osg::Vec3f &direction) const
+        {
+            return direction * m_axis >= m_cosRadius;
+        }
+
+    protected:
+        const osg::Vec3f m_axis;
+        const float m_cosRadius;
+    };
+
+
+    class BandTest
+    {
+    public:
+        BandTest(
+            const float minZ
+        ,   const float maxZ)
+        :   m_minZ(minZ)
+        ,   m_maxZ(maxZ)
+        {
+        }
+
+        inline const bool operator()(const osg::Vec3f &direction) const
+        {
+            return direction.z() >= m_minZ && direction.z() <= m_maxZ;
+        }
+
+    protected:
+        const float m_minZ;
+        const float m_maxZ;
+    };
+}
+
+
+StarQuery::StarQuery(const unsigned int depth)
+:   osg::Referenced()
+,   m_catalogue(new StarCatalogue)
+,   m_index(new StarSkyIndex(depth))
+,   m_R(osg::Matrixf::identity())
+{
+}
+
+
+StarQuery::~StarQuery()
+{
+}
+
+
+void StarQuery::assign(const BrightStars &brightStars)
+{
+    m_catalogue->assign(brightStars);
+    m_index->build(*m_catalogue);
+
+    updateCells();
+}
+
+
+const bool StarQuery::open(const char *fileName)
+{
+    if(!m_catalogue->open(fileName))
+    {
+        OSG_WARN << "Stars could not be loaded from " << fileName << "." << std::endl;
+
+        m_catalogue->close();
+        m_index->build(*m_catalogue);
+
+        updateCells();
+        return false;
+    }
+
+    m_index->build(*m_catalogue);
+
+    updateCells();
+    return true;
+}
+
+
+const unsigned int StarQuery::numStars() const
+{
+    return m_catalogue->numStars();
+}
+
+
+void StarQuery::setEquToHorTransform(const osg::Matrixf &R)
+{
+    m_R = R;
+    updateCells();
+}
+
+
+void StarQuery::setObserver(
+    const AbstractAstronomy &astronomy
+,   const t_aTime &aTime
+,   const float latitude
+,   const float longitude)
+{
+    setEquToHorTransform(astronomy.getEquToHorTransform(aTime, latitude, longitude));
+}
+
+
+void StarQuery::updateCells()
+{
+    const unsigned int numCells = m_index->numCells();
+
+    m_centers.resize(numCells);
+    m_radii.resize(numCells);
+
+    for(unsigned int c = 0; c < numCells; ++c)
+    {
+        m_centers[c] = osg::Matrixf::transform3x3(m_R, m_index->center(c));
+        m_centers[c].normalize();
+
+        m_radii[c] = m_index->radius(c);
+    }
+}
+
+
+template<typename Test>
+const unsigned int StarQuery::collect(
+    const std::vector<unsigned int> &cells
+,   const float magnitude
+,   const Test &test
+,   t_stars &stars) const
+{
+    const osg::Vec4f *positions = m_catalogue->positions();
+    const osg::Vec4f *colors = m_catalogue->colors();
+
+    const size_t first = stars.size();
+
+    // rows of the transform, for converting the ranges without temporaries
+    const osg::Vec3f rx(m_R(0, 0), m_R(0, 1), m_R(0, 2));
+    const osg::Vec3f ry(m_R(1, 0), m_R(1, 1), m_R(1, 2));
+    const osg::Vec3f rz(m_R(2, 0), m_R(2, 1), m_R(2, 2));
+
+    for(unsigned int i = 0; i < cells.size(); ++i)
+    {
+        const unsigned int c = cells[i];
+
+        const unsigned int begin = m_index->begin(c);
+        const unsigned int end = begin + m_index->numStarsUpTo(c, magnitude);
+
+        for(unsigned int s = begin; s < end; ++s)
+        {
+            const osg::Vec3f p(positions[s][0], positions[s][1], positions[s][2]);
+            const osg::Vec3f d(rx * p, ry * p, rz * p);
+
+            if(!test(d))
+                continue;
+
+            t_star star;
+
+            star.index = static_cast<unsigned int>(positions[s][3]);
+            star.magnitude = colors[s][3];
+            star.direction = d;
+
+            star.altitude = static_cast<float>(_deg(asin(_clamp(-1.f, 1.f, d.z()))));
+            star.azimuth  = static_cast<float>(_deg(atan2(d.x(), d.y())));
+
+            if(star.azimuth < 0.f)
+                star.azimuth += 360.f;
+
+            stars.push_back(star);
+        }
+    }
+
+    // The cells are sorted by magnitude, their union is not.
+    std::sort(stars.begin() + first, stars.end(), brighter);
+
+    return static_cast<unsigned int>(stars.size() - first);
+}
+
+
+const unsigned int StarQuery::cone(
+    const osg::Vec3f &direction
+,   const float radius
+,   const float magnitude
+,   t_stars &stars) const
+{
+    osg::Vec3f axis(direction);
+    axis.normalize();
+
+    const float r = static_cast<float>(_rad(_clamp(0.f, 180.f, radius)));
+
+    std::vector<unsigned int> cells;
+    for(unsigned int c = 0; c < m_centers.size(); ++c)
+    {
+        const float angle = acos(_clamp(-1.f, 1.f, m_centers[c] * axis));
+        if(angle - m_radii[c] <= r)
+            cells.push_back(c);
+    }
+    return collect(cells, magnitude, ConeTest(axis, cos(r)), stars);
+}
+
+
+const unsigned int StarQuery::band(
+    const float minAltitude
+,   const float maxAltitude
+,   const float magnitude
+,   t_stars &stars) const
+{
+    const float minAlt = static_cast<float>(_rad(_clamp(-90.f, 90.f, minAltitude)));
+    const float maxAlt = static_cast<float>(_rad(_clamp(-90.f, 90.f, maxAltitude)));
+
+    if(minAlt > maxAlt)
+        return 0;
+
+    std::vector<unsigned int> cells;
+    for(unsigned int c = 0; c < m_centers.size(); ++c)
+    {
+        const float altitude = asin(_clamp(-1.f, 1.f, m_centers[c].z()));
+        if(altitude + m_radii[c] >= minAlt && altitude - m_radii[c] <= maxAlt)
+            cells.push_back(c);
+    }
+    return collect(cells, magnitude, BandTest(sin(minAlt), sin(maxAlt)), stars);
+}
+
+} // namespace osgHimmel
\ No newline at end of file
@@ -36,6 +36,54 @@
 namespace osgHimmel
 {
 
+namespace
+{
+    const t_longf MIN_TEMPERATURE(1667.0);
+    const t_longf MAX_TEMPERATURE(25000.0);
+
+    const unsigned int COLOR_TABLE_SIZE(1024);
+
+    // sRGB colors sampled uniformly in reciprocal temperature, from the 
+    // hottest to the coolest temperature. Since the temperature is 
+    // reciprocal to the color index, this is also about uniform in B-V.
+
+    class ColorTable
+    {
+    public:
+        ColorTable()
+        :   m_min(1.0 / MAX_TEMPERATURE)
+        ,   m_scale((COLOR_TABLE_SIZE - 1) / (1.0 / MIN_TEMPERATURE - 1.0 / MAX_TEMPERATURE))
+        {
+            for(unsigned int i = 0; i < COLOR_TABLE_SIZE; ++i)
+            {
+                const t_longf r = m_min + i / m_scale;
+                m_colors[i] = Stars::sRgbColor(_clamp(MIN_TEMPERATURE, MAX_TEMPERATURE, 1.0 / r));
+            }
+        }
+
+        // r is the reciprocal temperature.
+        inline const osg::Vec3f lookup(const float r) const
+        {
+            const float f = _clamp(0.f, static_cast<float>(COLOR_TABLE_SIZE - 1), (r - m_min) * m_scale);
+
+            const unsigned int i = _mi(static_cast<unsigned int>(f), COLOR_TABLE_SIZE - 2);
+            const float a = f - i;
+
+            return m_colors[i] * (1.f - a) + m_colors[i + 1] * a;
+        }
+
+    protected:
+        const float m_min;
+        const float m_scale;
+
+        osg::Vec3f m_colors[COLOR_TABLE_SIZE];
+    };
+
+    // Initialized with the library, so lookups are thread safe.
+    const ColorTable g_colorTable;
+}
+
+
 const t_longf Stars::tempratureFromBV(const t_longf BtoV)
 {
     // NOTE: This is just an estimation!
@@ -64,12 +112,14 @@ const osg::Vec2f Stars::planckianLocusInCieXYZ(const t_longf t)
         x = +0.24039 + o * (+222.6347 + o * (+2107037.9 + o * -3025846900.0));
 
 
+    // y is a cubic of x, not of t
+
          if( 1667 <= t && t <=  2222)
-        y = -0.20219683 + t * (+2.18555832 + t * (-1.3481102 + t * -1.1063814));
+        y = -0.20219683 + x * (+2.18555832 + x * (-1.3481102 + x * -1.1063814));
     else if( 2222 <  t && t <=  4000) 
-        y = -0.16748867 + t * (+2.09137015 + t * (-1.3741859 + t * -0.9549476));
+        y = -0.16748867 + x * (+2.09137015 + x * (-1.3741859 + x * -0.9549476));
     else if( 4000 <  t && t <= 25000) 
-        y = -0.37001483 + t * (+3.75112997 + t * (-5.8733867 + t * +3.0817580));
+        y = -0.37001483 + x * (+3.75112997 + x * (-5.8733867 + x * +3.0817580));
 
     return osg::Vec2f(x, y);
 }
@@ -116,6 +166,45 @@ const osg::Vec3f Stars::sRgbColor(const osg::Vec3f xyzTristimulus)
 }
 
 
+const t_longf Stars::minTemperature()
+{
+    return MIN_TEMPERATURE;
+}
+
+const t_longf Stars::maxTemperature()
+{
+    return MAX_TEMPERATURE;
+}
+
+
+const osg::Vec3f Stars::sRgbColorFromTable(const t_longf t)
+{
+    return g_colorTable.lookup(static_cast<float>(1.0 / t));
+}
+
+
+const osg::Vec3f Stars::sRgbColorFromBV(const t_longf BtoV)
+{
+    const t_longf t = tempratureFromBV(BtoV);
+
+    // beyond -0.56 the temperature estimation is infinite or negative
+    if(t <= 0.0)
+        return sRgbColor(MAX_TEMPERATURE);
+
+    return sRgbColor(_clamp(MIN_TEMPERATURE, MAX_TEMPERATURE, t));
+}
+
+
+void Stars::sRgbColorsFromBV(
+    const float *BtoV
+,   osg::Vec3f *colors
+,   const unsigned int count)
+{
+    for(unsigned int i = 0; i < count; ++i)
+        colors[i] = g_colorTable.lookup(static_cast<float>(1.0 / tempratureFromBV(BtoV[i])));
+}
+
+
 const t_equd Stars::apparentPosition(
     const t_julianDay /*t*/
 ,   const t_longf /*a2000*/
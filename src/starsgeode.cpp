@@ -36,6 +36,8 @@
 #include "coords.h"
 #include "earth.h"
 #include "stars.h"
+#include "starskyindex.h"
+#include "pagedstarcatalogue.h"
 #include "strutils.h"
 
 #include "shaderfragment/common.h"
@@ -43,31 +45,88 @@
 
 #include <osg/Geometry>
 #include <osg/Point>
+#include <osg/PointSprite>
+#include <osg/Program>
 #include <osg/BlendFunc>
 #include <osg/Image>
 #include <osg/Texture1D>
 #include <osg/Depth>
+#include <osg/Notify>
+
+#include <limits>
 
 
 namespace
 {
     const float TWO_TIMES_SQRT2(2.0 * sqrt(2.0));
+
+    const double _35OVER13PI(0.85698815511020565414014334123662);
+
+    const float MAGNITUDE_MARGIN(0.01f);
+
+    // Magnitude decrease due to the earth's atmosphere (see vertex shader).
+    const float ATMOSPHERIC_EXTINCTION(0.4f);
+
+    // 384 sky cells of about 11 degrees, ~25 of the bright stars each.
+    const unsigned int INDEX_DEPTH(3);
+
+
+    // Size of a stars sprite (see vertex shader), which for bright stars 
+    // extends far beyond its position due to the glare. The sprites half 
+    // extent k on the tangent plane bounds its angular radius atan(k).
+
+    class GlareMargin : public osgHimmel::StarSkyIndex::Margin
+    {
+    public:
+        GlareMargin(
+            const float apparentMagnitude
+        ,   const float q
+        ,   const float glareScale)
+        :   m_apparentMagnitude(apparentMagnitude)
+        ,   m_q(q)
+        ,   m_glareScale(glareScale)
+        {
+        }
+
+        virtual const float operator()(const float magnitude) const
+        {
+            const float m = magnitude + ATMOSPHERIC_EXTINCTION;
+            const float i_g = pow(2.512f, m_apparentMagnitude - (m + 0.167f)) - 1.f;
+
+            const float k = i_g > 0.f ? sqrt(i_g) * 2e-2f * m_glareScale : 0.f;
+            return k > m_q ? k : m_q;
+        }
+
+    protected:
+        const float m_apparentMagnitude;
+        const float m_q;
+        const float m_glareScale;
+    };
 }
 
 
 namespace osgHimmel
 {
 
-StarsGeode::StarsGeode(const char* brightStarsFilePath)
+StarsGeode::StarsGeode(
+    const char* brightStarsFilePath
+,   const e_ExpansionMode mode)
 :   osg::Geode()
 
+,   m_catalogue(new StarCatalogue)
+,   m_index(new StarSkyIndex(INDEX_DEPTH))
+,   m_paged(NULL)
+,   m_point(new osg::Point(TWO_TIMES_SQRT2))
+,   m_mode(mode)
+,   m_pointSprite(new osg::PointSprite)
+,   m_magnitudeCutoff(0.f)
+,   m_drawnStarCount(0)
+
 ,   m_program(new osg::Program)
 ,   m_vShader(new osg::Shader(osg::Shader::VERTEX))
 ,   m_gShader(new osg::Shader(osg::Shader::GEOMETRY))
 ,   m_fShader(new osg::Shader(osg::Shader::FRAGMENT))
 
-,   u_R(NULL)
-,   u_q(NULL)
 ,   u_noise1(NULL)
 
 ,   u_color(NULL)
@@ -96,25 +155,97 @@ StarsGeode::~StarsGeode()
 
 void StarsGeode::update(const Himmel &himmel)
 {
-    // TODO: starmap and planets also require this ... - find better place
-    const float fov = himmel.getCameraFovHint();
-    const float height = himmel.getViewSizeHeightHint();
+    updateView(himmel);
+}
+
+
+void StarsGeode::updateView(const Himmel &himmel)
+{
+    // R and q are shared by the himmel, updated once per change
+    const float fov = himmel.getViewFov();
+
+    // the shaders scale the shared q, the stars use 4 tan(fov / 2) / height
+    const float q = static_cast<float>(sqrt(2.0)) * himmel.getViewQ();
+
+    // Only submit stars the vertex shader would not discard (i_t >= 0.01).
+
+    const float b = 1.f / sqrt(1.f + pow(himmel.getSunPosition().z() + 1.14f, 32.f));
 
-    //u_q->set(static_cast<float>(tan(_rad(fov / 2)) / (height * 0.5)));
-    u_q->set(static_cast<float>(4.0 * tan(_rad(fov * 0.5)) / height));
+    float m_a;
+    u_apparentMagnitude->get(m_a);
 
-    u_R->set(himmel.astro()->getEquToHorTransform());
+    if(1.167f * b < 0.01f)
+        m_magnitudeCutoff = -std::numeric_limits<float>::infinity();
+    else
+    {
+        // solves 2.512^(m_a - m) * 35/(13 pi) * 4e-7 / q^2 * b = 0.01 for m, 
+        // with some margin for the shaders precision
+        const float i = static_cast<float>(_35OVER13PI * 4e-7 * b / (0.01 * q * q));
+        m_magnitudeCutoff = m_a + log(i) / log(2.512f) + MAGNITUDE_MARGIN;
+    }
+
+    // Cull the sky cells against the view cone (half diagonal) and horizon, 
+    // both transformed into the equatorial system of the stars. Without a 
+    // camera hint the view direction is unknown, so nothing is culled.
+
+    const float aspectRatio = himmel.getViewAspectRatio();
+    const float halfAngle = atan(tan(_rad(fov * 0.5)) * sqrt(1.f + aspectRatio * aspectRatio));
+
+    if(himmel.hasCameraHint() && fov > 0.f && halfAngle < _PI_2)
+    {
+        const osg::Matrixf R(himmel.getEquToHorTransform());
+
+        const osg::Vec3f axis  (osg::Matrixf::transform3x3(himmel.getCameraDirectionHint(), R));
+        const osg::Vec3f zenith(osg::Matrixf::transform3x3(osg::Vec3f(0.f, 0.f, 1.f), R));
+
+        const float radius = static_cast<float>(Earth::meanRadius());
+        const float dip = acos(radius / (radius + himmel.getAltitude()));
+
+        float glareScale;
+        u_glareScale->get(glareScale);
+
+        const GlareMargin margin(m_a, q, glareScale);
+
+        m_index->cull(axis, halfAngle, zenith, dip, &margin);
+    }
+    else
+        m_index->cullNone();
+
+    // the shader adds ATMOSPHERIC_EXTINCTION for the atmosphere
+
+    m_drawnStarCount = 0;
+
+    if(m_paged)
+    {
+        updateTiles();
+        return;
+    }
+
+    for(unsigned int c = 0; c < m_index->numCells(); ++c)
+    {
+        const unsigned int count = m_index->isVisible(c) ? 
+            m_index->numStarsUpTo(c, m_magnitudeCutoff - ATMOSPHERIC_EXTINCTION) : 0;
+
+        m_cellDrawArrays[c]->setCount(count);
+        m_drawnStarCount += count;
+    }
 }
 
 
-void StarsGeode::setupUniforms(osg::StateSet* stateSet)
+const float StarsGeode::getMagnitudeCutoff() const
+{
+    return m_magnitudeCutoff;
+}
+
+
+const unsigned int StarsGeode::getDrawnStarCount() const
 {
-    u_R = new osg::Uniform("R", osg::Matrixf::identity());
-    stateSet->addUniform(u_R);
+    return m_drawnStarCount;
+}
 
-    u_q = new osg::Uniform("q", 0.0f);
-    stateSet->addUniform(u_q);
 
+void StarsGeode::setupUniforms(osg::StateSet* stateSet)
+{
     u_noise1 = new osg::Uniform("noise1", 0);
     stateSet->addUniform(u_noise1);
 
@@ -145,36 +276,125 @@ void StarsGeode::setupUniforms(osg::StateSet* stateSet)
 
 void StarsGeode::createAndAddDrawable(const char* brightStarsFilePath)
 {
-    BrightStars bs(brightStarsFilePath);
-    const BrightStars::s_BrightStar *stars = bs.stars();
+    // Large catalogues are paged per sky cell and tier, see updateTiles.
+    if(PagedStarCatalogue::isPagedFile(brightStarsFilePath))
+    {
+        m_paged = new PagedStarCatalogue;
+        if(!m_paged->open(brightStarsFilePath))
+        {
+            OSG_WARN << "Stars could not be loaded from " << brightStarsFilePath << "." << std::endl;
+            m_paged = NULL;
+        }
+        else
+        {
+            m_index = m_paged->index();
+            return;
+        }
+    }
 
-    osg::ref_ptr<osg::Vec4Array> cAry = new osg::Vec4Array(bs.numStars());
-    osg::ref_ptr<osg::Vec4Array> vAry = new osg::Vec4Array(bs.numStars());
+    if(!m_catalogue->open(brightStarsFilePath))
+        OSG_WARN << "Stars could not be loaded from " << brightStarsFilePath << "." << std::endl;
 
-    for(unsigned int i = 0; i < bs.numStars(); ++i)
-    {
-        t_equf equ;
-        equ.right_ascension = _rightascd(stars[i].RA, 0, 0);
-        equ.declination = stars[i].DE;
+    // Grouped by sky cell and sorted by magnitude within, the stars visible 
+    // for a magnitude cutoff are a prefix of each cell.
+    m_index->build(*m_catalogue);
 
-        osg::Vec3f vec = equ.toEuclidean();
-        (*vAry)[i] = osg::Vec4f(vec.x(), vec.y(), vec.z(), i);
+    // The catalogue is already laid out as vertex arrays, so the blocks are 
+    // copied as is (osg arrays own their storage).
 
-        (*cAry)[i] = osg::Vec4f(stars[i].sRGB_R, stars[i].sRGB_G, stars[i].sRGB_B, stars[i].Vmag + 0.4);
-        // the 0.4 accounts for magnitude decrease due to the earth's atmosphere
-    }
-      
-    osg::ref_ptr<osg::Geometry> g = new osg::Geometry;
+    const unsigned int numStars = m_catalogue->numStars();
+
+    const osg::Vec4f *positions = m_catalogue->positions();
+    const osg::Vec4f *colors = m_catalogue->colors();
+
+    osg::ref_ptr<osg::Vec4Array> cAry = new osg::Vec4Array(numStars, colors);
+    osg::ref_ptr<osg::Vec4Array> vAry = new osg::Vec4Array(numStars, positions);
+
+    osg::ref_ptr<osg::Geometry> g = createGeometry(vAry, cAry);
     addDrawable(g);
 
+    // one range per sky cell
+
+    m_cellDrawArrays.resize(m_index->numCells());
+    for(unsigned int c = 0; c < m_index->numCells(); ++c)
+    {
+        m_cellDrawArrays[c] = new osg::DrawArrays(osg::PrimitiveSet::POINTS
+            , m_index->begin(c), m_index->end(c) - m_index->begin(c));
+        g->addPrimitiveSet(m_cellDrawArrays[c]);
+    }
+}
+
+
+osg::Geometry *StarsGeode::createGeometry(
+    osg::Vec4Array *vAry
+,   osg::Vec4Array *cAry)
+{
+    osg::Geometry *g = new osg::Geometry;
+
     g->setColorBinding(osg::Geometry::BIND_PER_VERTEX);
     g->setColorArray(cAry);
     g->setVertexArray(vAry);
 
-    g->addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::POINTS, 0, vAry->size()));
+    // The counts change per frame, which display lists do not reflect.
+    g->setUseDisplayList(false);
+    g->setUseVertexBufferObjects(true);
+    g->setDataVariance(osg::Object::DYNAMIC);
 
     // If things go wrong, fall back to big point rendering without geometry shader.
-    g->getOrCreateStateSet()->setAttribute(new osg::Point(TWO_TIMES_SQRT2));
+    g->getOrCreateStateSet()->setAttribute(m_point);
+
+    return g;
+}
+
+
+void StarsGeode::updateTiles()
+{
+    // Request the tiles of visible cells and draw the resident ones. Tiles 
+    // are sorted by magnitude, so the visible stars are a prefix again.
+
+    const float magnitude = m_magnitudeCutoff - ATMOSPHERIC_EXTINCTION;
+    m_paged->update(magnitude);
+
+    const std::vector<unsigned int> &requested(m_paged->requestedTiles());
+
+    t_tileGeometries geometries;
+
+    for(unsigned int i = 0; i < requested.size(); ++i)
+    {
+        const unsigned int tile = requested[i];
+        if(!m_paged->isResident(tile))
+            continue;
+
+        osg::ref_ptr<osg::Geometry> g;
+
+        t_tileGeometries::iterator found = m_tileGeometries.find(tile);
+        if(found != m_tileGeometries.end() && found->second->getVertexArray() == m_paged->positions(tile))
+        {
+            g = found->second;
+            m_tileGeometries.erase(found);
+        }
+        else
+        {
+            g = createGeometry(m_paged->positions(tile), m_paged->colors(tile));
+            g->addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::POINTS, 0, 0));
+
+            addDrawable(g);
+        }
+
+        const unsigned int count = m_paged->numStarsUpTo(tile, magnitude);
+
+        static_cast<osg::DrawArrays*>(g->getPrimitiveSet(0))->setCount(count);
+        m_drawnStarCount += count;
+
+        geometries[tile] = g;
+    }
+
+    // remaining geometries are not visible or their tiles were released
+
+    for(t_tileGeometries::iterator i = m_tileGeometries.begin(); i != m_tileGeometries.end(); ++i)
+        removeDrawable(i->second);
+
+    m_tileGeometries.swap(geometries);
 }
 
 
@@ -194,18 +414,50 @@ void StarsGeode::setupNode(
 
 void StarsGeode::setupShader(osg::StateSet* stateSet)
 {
-    m_vShader->setShaderSource(getVertexShaderSource());
     m_gShader->setShaderSource(getGeometryShaderSource());
-    m_fShader->setShaderSource(getFragmentShaderSource());
 
     m_program->addShader(m_vShader);
-    m_program->addShader(m_gShader);
     m_program->addShader(m_fShader);
 
+    updateShader(stateSet);
+
     stateSet->setAttributeAndModes(m_program, osg::StateAttribute::ON);
 }
 
 
+void StarsGeode::updateShader(osg::StateSet* stateSet)
+{
+    m_vShader->setShaderSource(getVertexShaderSource());
+    m_fShader->setShaderSource(getFragmentShaderSource());
+
+    if(m_mode == EM_PointSprites)
+    {
+        m_program->removeShader(m_gShader);
+
+        stateSet->setTextureAttributeAndModes(0, m_pointSprite, osg::StateAttribute::ON);
+        stateSet->setMode(GL_VERTEX_PROGRAM_POINT_SIZE, osg::StateAttribute::ON);
+    }
+    else
+    {
+        m_program->addShader(m_gShader);
+
+        stateSet->removeTextureAttribute(0, m_pointSprite.get());
+        stateSet->removeMode(GL_VERTEX_PROGRAM_POINT_SIZE);
+    }
+}
+
+
+void StarsGeode::setExpansionMode(const e_ExpansionMode mode)
+{
+    if(mode == m_mode)
+        return;
+
+    m_mode = mode;
+
+    updateShader(getOrCreateStateSet());
+}
+
+
 void StarsGeode::setupTextures(osg::StateSet* stateSet)
 {   
     const int noiseN = 256;
@@ -396,13 +648,15 @@ const std::string StarsGeode::getVertexShaderSource()
 
     sprintf_s(apparentMagLimit, 8, "%.2f", static_cast<float>(Earth::apparentMagnitudeLimit()));
 
-    return glsl_version_150()
+    std::string source = glsl_version_150()
 
     +   glsl_horizon()
     +   glsl_scattering()
 
     +   PRAGMA_ONCE(main,
 
+        ENABLE_IF(pointSprites, m_mode == EM_PointSprites)
+
         "uniform vec3 sun;\n"
         "\n"
         "uniform mat4 R;\n" // rgb and alpha for mix
@@ -421,6 +675,8 @@ const std::string StarsGeode::getVertexShaderSource()
 
         "const float PI = 3.1415926535897932384626433832795;\n"
         "const float _35OVER13PI = 0.85698815511020565414014334123662;\n"
+        "const float SQRT2 = 1.4142135623730950488016887242097;\n"
+        "const float TWO_TIMES_SQRT2 = 2.8284271247461900976033774484194;\n"
         "\n"
 
         "out float v_k;\n"
@@ -430,21 +686,31 @@ const std::string StarsGeode::getVertexShaderSource()
         "void main(void)\n"
         "{\n"
         "    vec4 v = gl_Vertex * R;\n"
-        "    gl_Position = v;\n"
+        "    float qs = SQRT2 * q;\n" // stars use a larger q than the shared one
+        "\n"
+
+        IF_ELSE_ENABLED(pointSprites, 
+
+        // clipped, unless the star is visible
+        "    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+        "    gl_PointSize = 1.0;\n",
+
+        "    gl_Position = v;\n")
+
         "\n"
         "    v_k = 0;\n"
         "\n"
         "    if(belowHorizon(v.xyz))\n" // "discard" stars below horizon
         "        return;\n"
         "\n"
-        "    float m = gl_Color.w;\n"
+        "    float m = gl_Color.w + %ATMOSPHERIC_EXTINCTION%;\n" // accounts for magnitude decrease due to the earth's atmosphere
         "    float m_a = apparentMagnitude;\n"
         "\n"
         "    float delta_m = pow(2.512, m_a - m);\n"
         "\n"
         "    float i_t = delta_m * _35OVER13PI;\n"
         "\n"
-        "    i_t *= 4e-7 / (q * q);  // resolution correlated \n"
+        "    i_t *= 4e-7 / (qs * qs);  // resolution correlated \n"
         "    i_t = min(1.167, i_t);	// volume of smoothstep (V_T)\n"
         "\n"
             // Day-Twilight-Night-Intensity Mapping (Butterworth-Filter)
@@ -471,9 +737,21 @@ const std::string StarsGeode::getVertexShaderSource()
         "    v_color *= v_t;\n"
         "\n"
         "    v_color = max(vec3(0.0), v_color);\n"
-        "    v_k = max(q, sqrt(i_g) * 2e-2 * glareScale);\n"
+        "    v_k = max(qs, sqrt(i_g) * 2e-2 * glareScale);\n"
+
+        // the sprite covers the quad of the geometry shader (k / qs pixels 
+        // per texture coordinate unit, see fragment shader)
+        IF_ENABLED(pointSprites,
+
+        "\n"
+        "    gl_Position = gl_ModelViewProjectionMatrix * vec4(v.xyz, 1.0);\n"
+        "    gl_PointSize = TWO_TIMES_SQRT2 * v_k / qs;\n")
+
         "}\n");
 
+    replace(source, "%ATMOSPHERIC_EXTINCTION%", ATMOSPHERIC_EXTINCTION);
+    return source;
+
     // Day-Twilight-Night-Intensity Mapping (Butterworth-Filter)
     // "    float b = 1.0 / sqrt(1 + pow(sun.z + 1.3, 16));\n"
 }
@@ -493,6 +771,8 @@ const std::string StarsGeode::getGeometryShaderSource()
         "\n"
         "uniform float q;\n"
         "\n"
+        "const float SQRT2 = 1.4142135623730950488016887242097;\n"
+        "\n"
         "in float v_k[];\n"
         "in vec3 v_color[];\n"
         "\n"
@@ -512,7 +792,7 @@ const std::string StarsGeode::getGeometryShaderSource()
         "    vec3 v = cross(u, p);\n"
         "\n"
         // used to have const psf function appearance
-        "    gl_TexCoord[0].z = k / q;\n"
+        "    gl_TexCoord[0].z = k / (SQRT2 * q);\n"
         "\n"
         "    g_color = v_color[0];\n"
         "\n"
@@ -541,25 +821,49 @@ const std::string StarsGeode::getFragmentShaderSource()
         
     +   PRAGMA_ONCE(main,
 
+        ENABLE_IF(pointSprites, m_mode == EM_PointSprites)
+
         "uniform float q;\n"
         "uniform float scale;\n"
         "uniform float glareIntensity;\n"
         "\n"
         "uniform vec3 sun;\n"
         "\n"
-        "in vec3 g_color;\n"
+        "const float SQRT2 = 1.4142135623730950488016887242097;\n"
+        "\n"
+
+        IF_ELSE_ENABLED(pointSprites,
+
+        "in float v_k;\n"
+        "in vec3 v_color;\n"
+        "\n"
+        "#define g_color v_color",
+
+        "in vec3 g_color;")
+
         "\n"
         "void main(void)\n"
         "{\n"
+
+        IF_ELSE_ENABLED(pointSprites,
+
+        "    float x = gl_PointCoord.x * 2.0 - 1.0;\n"
+        "    float y = gl_PointCoord.y * 2.0 - 1.0;\n",
+
         "    float x = gl_TexCoord[0].x;\n"
-        "    float y = gl_TexCoord[0].y;\n"
+        "    float y = gl_TexCoord[0].y;\n")
+
         "\n"
         "    float zz = (1 - x * x - y * y);\n"
         "\n"
         "    if(zz < 0)\n"
         "        discard;\n"
         "\n"
-        "    float k =  gl_TexCoord[0].z;\n"
+        IF_ELSE_ENABLED(pointSprites,
+
+        "    float k = v_k / (SQRT2 * q);\n",
+
+        "    float k =  gl_TexCoord[0].z;\n")
         "\n"
         "    float l = length(vec2(x, y));\n"
         "\n"
@@ -0,0 +1,472 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "starskyindex.h"
+
+#include "starcatalogue.h"
+#include "mathmacros.h"
+
+#include <algorithm>
+#include <utility>
+#include <limits>
+#include <assert.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    // Cube faces (+x, -x, +y, -y, +z, -z), with normal and two tangents 
+    // spanning the face at distance 1: n + u * s + v * t for u, v in [-1;1].
+
+    const float FACES[6][3][3] =
+    {
+        { {  1.f,  0.f,  0.f }, { 0.f, 1.f, 0.f }, { 0.f, 0.f, 1.f } }
+    ,   { { -1.f,  0.f,  0.f }, { 0.f, 1.f, 0.f }, { 0.f, 0.f, 1.f } }
+    ,   { {  0.f,  1.f,  0.f }, { 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f } }
+    ,   { {  0.f, -1.f,  0.f }, { 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f } }
+    ,   { {  0.f,  0.f,  1.f }, { 1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f } }
+    ,   { {  0.f,  0.f, -1.f }, { 1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f } }
+    };
+
+    inline const osg::Vec3f faceVector(
+        const unsigned int face
+    ,   const unsigned int i)
+    {
+        return osg::Vec3f(FACES[face][i][0], FACES[face][i][1], FACES[face][i][2]);
+    }
+
+    inline const osg::Vec3f facePoint(
+        const unsigned int face
+    ,   const float u
+    ,   const float v)
+    {
+        osg::Vec3f p(faceVector(face, 0) + faceVector(face, 1) * u + faceVector(face, 2) * v);
+        p.normalize();
+
+        return p;
+    }
+
+    // Interleaves the bits of x (even) and y (odd).
+
+    inline const unsigned int morton(
+        const unsigned int x
+    ,   const unsigned int y)
+    {
+        unsigned int m = 0;
+        for(unsigned int b = 0; b < 16; ++b)
+            m |= ((x >> b) & 1) << (2 * b) | ((y >> b) & 1) << (2 * b + 1);
+
+        return m;
+    }
+
+    inline void demorton(
+        const unsigned int m
+    ,   unsigned int &x
+    ,   unsigned int &y)
+    {
+        x = y = 0;
+        for(unsigned int b = 0; b < 16; ++b)
+        {
+            x |= ((m >> (2 * b)) & 1) << b;
+            y |= ((m >> (2 * b + 1)) & 1) << b;
+        }
+    }
+
+    inline const float angle(
+        const osg::Vec3f &a
+    ,   const osg::Vec3f &b)
+    {
+        const float d = a * b;
+        return acos(_clamp(-1.f, 1.f, d));
+    }
+}
+
+
+StarSkyIndex::StarSkyIndex(const unsigned int depth)
+:   osg::Referenced()
+,   m_depth(depth)
+,   m_catalogue(NULL)
+,   m_numVisibleStars(0)
+,   m_numTestedNodes(0)
+,   m_halfAngle(0.f)
+,   m_dip(0.f)
+,   m_margin(NULL)
+{
+    assert(depth < 16);
+
+    // bounding cones of all nodes, level by level
+
+    const unsigned int numNodes = nodeIndex(m_depth + 1, 0);
+
+    m_centers.resize(numNodes);
+    m_radii.resize(numNodes);
+    m_brightest.resize(numNodes, std::numeric_limits<float>::max());
+
+    for(unsigned int l = 0; l <= m_depth; ++l)
+    {
+        const unsigned int n = 1 << l;
+        const float size = 2.f / n;
+
+        for(unsigned int i = 0; i < 6 * n * n; ++i)
+        {
+            const unsigned int face = i / (n * n);
+
+            unsigned int x, y;
+            demorton(i % (n * n), x, y);
+
+            const float u = -1.f + x * size;
+            const float v = -1.f + y * size;
+
+            const osg::Vec3f c(facePoint(face, u + size * 0.5f, v + size * 0.5f));
+
+            // cell edges are great circle arcs, so the farthest point is a corner
+            float r = angle(c, facePoint(face, u, v));
+            r = _ma(r, angle(c, facePoint(face, u + size, v)));
+            r = _ma(r, angle(c, facePoint(face, u, v + size)));
+            r = _ma(r, angle(c, facePoint(face, u + size, v + size)));
+
+            m_centers[nodeIndex(l, i)] = c;
+            m_radii[nodeIndex(l, i)] = r;
+        }
+    }
+
+    m_offsets.resize(numCells() + 1, 0);
+    m_visible.resize(numCells(), false);
+}
+
+
+StarSkyIndex::~StarSkyIndex()
+{
+}
+
+
+const unsigned int StarSkyIndex::nodeIndex(
+    const unsigned int level
+,   const unsigned int node) const
+{
+    // 6 x (4^0 + ... + 4^(level - 1)) nodes on the levels above
+    return 2 * ((1 << 2 * level) - 1) + node;
+}
+
+
+void StarSkyIndex::build(StarCatalogue &catalogue)
+{
+    const unsigned int numStars = catalogue.numStars();
+
+    std::vector<unsigned int> cells(numStars);
+    for(unsigned int i = 0; i < numStars; ++i)
+    {
+        const osg::Vec4f &p(catalogue.positions()[i]);
+        cells[i] = cell(osg::Vec3f(p[0], p[1], p[2]));
+    }
+
+    // Catalogues written after a build are already in order and are only 
+    // verified, so that mapped stars are not copied.
+
+    bool ordered = catalogue.isSortedByCell(m_depth);
+
+    for(unsigned int i = 1; ordered && i < numStars; ++i)
+        ordered = cells[i - 1] < cells[i] || (cells[i - 1] == cells[i] 
+            && catalogue.colors()[i - 1][3] <= catalogue.colors()[i][3]);
+
+    if(!ordered)
+    {
+        // order by cell, magnitude, and former position
+
+        std::vector<std::pair<std::pair<unsigned int, float>, unsigned int> > sorted(numStars);
+        for(unsigned int i = 0; i < numStars; ++i)
+            sorted[i] = std::make_pair(std::make_pair(cells[i], catalogue.colors()[i][3]), i);
+
+        std::sort(sorted.begin(), sorted.end());
+
+        std::vector<unsigned int> order(numStars);
+        for(unsigned int i = 0; i < numStars; ++i)
+        {
+            order[i] = sorted[i].second;
+            cells[i] = sorted[i].first.first;
+        }
+        catalogue.reorder(order);
+        catalogue.setSortedByCell(m_depth);
+    }
+
+    // brightest star per cell is its first
+
+    std::vector<unsigned int> counts(numCells(), 0);
+    std::vector<float> brightest(numCells(), std::numeric_limits<float>::max());
+
+    for(unsigned int i = numStars; i > 0; --i)
+    {
+        const unsigned int c = cells[i - 1];
+
+        ++counts[c];
+        brightest[c] = catalogue.colors()[i - 1][3];
+    }
+
+    assign(counts, brightest);
+    m_catalogue = &catalogue;
+}
+
+
+void StarSkyIndex::assign(
+    const std::vector<unsigned int> &counts
+,   const std::vector<float> &brightest)
+{
+    assert(counts.size() == numCells());
+    assert(brightest.size() == numCells());
+
+    m_catalogue = NULL;
+
+    // ranges
+
+    m_offsets[0] = 0;
+    for(unsigned int c = 0; c < numCells(); ++c)
+        m_offsets[c + 1] = m_offsets[c] + counts[c];
+
+    // brightest star per node
+
+    std::fill(m_brightest.begin(), m_brightest.end(), std::numeric_limits<float>::max());
+
+    for(unsigned int c = 0; c < numCells(); ++c)
+        if(counts[c])
+            m_brightest[nodeIndex(m_depth, c)] = brightest[c];
+
+    for(unsigned int l = m_depth; l > 0; --l)
+        for(unsigned int i = 0; i < 6u << 2 * l; ++i)
+        {
+            float &b(m_brightest[nodeIndex(l - 1, i >> 2)]);
+            b = _mi(b, m_brightest[nodeIndex(l, i)]);
+        }
+
+    cullNone();
+}
+
+
+const unsigned int StarSkyIndex::depth() const
+{
+    return m_depth;
+}
+
+
+const unsigned int StarSkyIndex::numCells() const
+{
+    return 6u << 2 * m_depth;
+}
+
+
+const unsigned int StarSkyIndex::cell(const osg::Vec3f &direction) const
+{
+    // face of the major axis
+
+    const float ax = _abs(direction[0]);
+    const float ay = _abs(direction[1]);
+    const float az = _abs(direction[2]);
+
+    unsigned int face;
+    if(ax >= ay && ax >= az)
+        face = direction[0] >= 0.f ? 0 : 1;
+    else if(ay >= az)
+        face = direction[1] >= 0.f ? 2 : 3;
+    else
+        face = direction[2] >= 0.f ? 4 : 5;
+
+    const float d = direction * faceVector(face, 0);
+    if(d <= 0.f)
+        return 0; // null vector
+
+    const float u = (direction * faceVector(face, 1)) / d;
+    const float v = (direction * faceVector(face, 2)) / d;
+
+    const int n = 1 << m_depth;
+
+    const int x = _clamp(0, n - 1, static_cast<int>(floor((u + 1.f) * 0.5f * n)));
+    const int y = _clamp(0, n - 1, static_cast<int>(floor((v + 1.f) * 0.5f * n)));
+
+    return face * n * n + morton(x, y);
+}
+
+
+const unsigned int StarSkyIndex::begin(const unsigned int cell) const
+{
+    return m_offsets[cell];
+}
+
+
+const unsigned int StarSkyIndex::end(const unsigned int cell) const
+{
+    return m_offsets[cell + 1];
+}
+
+
+const unsigned int StarSkyIndex::numStarsUpTo(
+    const unsigned int cell
+,   const float magnitude) const
+{
+    assert(m_catalogue);
+
+    const osg::Vec4f *colors = m_catalogue->colors();
+
+    // binary search for the first fainter star
+
+    unsigned int lower = begin(cell);
+    unsigned int upper = end(cell);
+
+    while(lower < upper)
+    {
+        const unsigned int mid = lower + (upper - lower) / 2;
+
+        if(colors[mid][3] <= magnitude)
+            lower = mid + 1;
+        else
+            upper = mid;
+    }
+    return lower - begin(cell);
+}
+
+
+const osg::Vec3f &StarSkyIndex::center(const unsigned int cell) const
+{
+    return m_centers[nodeIndex(m_depth, cell)];
+}
+
+
+const float StarSkyIndex::radius(const unsigned int cell) const
+{
+    return m_radii[nodeIndex(m_depth, cell)];
+}
+
+
+const unsigned int StarSkyIndex::cull(
+    const osg::Vec3f &axis
+,   const float halfAngle
+,   const osg::Vec3f &zenith
+,   const float dip
+,   const Margin *margin)
+{
+    m_axis = axis;
+    m_axis.normalize();
+    m_halfAngle = halfAngle;
+
+    m_zenith = zenith;
+    m_zenith.normalize();
+    m_dip = dip;
+
+    m_margin = margin;
+
+    std::fill(m_visible.begin(), m_visible.end(), false);
+
+    m_numVisibleStars = 0;
+    m_numTestedNodes = 0;
+
+    for(unsigned int face = 0; face < 6; ++face)
+        cullNode(0, face);
+
+    m_margin = NULL;
+
+    return static_cast<unsigned int>(std::count(m_visible.begin(), m_visible.end(), true));
+}
+
+
+void StarSkyIndex::cullNode(
+    const unsigned int level
+,   const unsigned int node)
+{
+    ++m_numTestedNodes;
+
+    // leaf cells below the node
+
+    const unsigned int shift = 2 * (m_depth - level);
+
+    const unsigned int first = m_offsets[node << shift];
+    const unsigned int last  = m_offsets[(node + 1) << shift];
+
+    if(first == last)
+        return;
+
+    const unsigned int i = nodeIndex(level, node);
+
+    const float r = m_radii[i] + (m_margin ? (*m_margin)(m_brightest[i]) : 0.f);
+
+    if(angle(m_centers[i], m_axis) > m_halfAngle + r)
+        return;
+
+    if(angle(m_centers[i], m_zenith) - r > _PI_2 + m_dip)
+        return;
+
+    if(level == m_depth)
+    {
+        m_visible[node] = true;
+        m_numVisibleStars += last - first;
+
+        return;
+    }
+
+    for(unsigned int k = 0; k < 4; ++k)
+        cullNode(level + 1, node << 2 | k);
+}
+
+
+const unsigned int StarSkyIndex::cullNone()
+{
+    m_numVisibleStars = 0;
+    m_numTestedNodes = 0;
+
+    unsigned int numVisible = 0;
+    for(unsigned int c = 0; c < numCells(); ++c)
+    {
+        m_visible[c] = begin(c) < end(c);
+
+        if(m_visible[c])
+            ++numVisible;
+    }
+    m_numVisibleStars = m_offsets.back();
+
+    return numVisible;
+}
+
+
+const bool StarSkyIndex::isVisible(const unsigned int cell) const
+{
+    return m_visible[cell];
+}
+
+
+const unsigned int StarSkyIndex::getVisibleStarCount() const
+{
+    return m_numVisibleStars;
+}
+
+
+const unsigned int StarSkyIndex::getTestedNodeCount() const
+{
+    return m_numTestedNodes;
+}
+
+} // namespace osgHimmel
@@ -0,0 +1,362 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "worleynoise.h"
+
+#include "perlinmapgenerator.h"
+#include "parallelfor.h"
+#include "mathmacros.h"
+#include "simd.h"
+
+#include <math.h>
+#include <limits.h>
+#include <assert.h>
+
+
+namespace osgHimmel
+{
+
+namespace
+{
+    // 27 neighbor cells, padded to a multiple of 4
+    const unsigned int NEIGHBORS(27);
+    const unsigned int NEIGHBORS_PADDED(28);
+
+    // far away padding point, its squared distance is still finite
+    const float FAR_POINT(1e10f);
+
+
+    inline const unsigned int wrap(
+        const int i
+    ,   const unsigned int period)
+    {
+        const int r = i % static_cast<int>(period);
+        return r < 0 ? r + period : r;
+    }
+
+
+    // Accumulates one octave of inverted Worley noise per row of a tile.
+
+    class WorleyRowKernel : public ParallelFor::Kernel
+    {
+    public:
+        WorleyRowKernel(
+            const std::vector<WorleyNoise> &noises
+        ,   const int width
+        ,   const int height
+        ,   const int depth
+        ,   const unsigned int *periods
+        ,   float *dest)
+        :   m_noises(noises)
+        ,   m_width(width)
+        ,   m_height(height)
+        ,   m_depth(depth)
+        ,   m_periods(periods)
+        ,   m_dest(dest)
+        {
+            float sum = 0.f;
+            for(unsigned int o = 0; o < noises.size(); ++o)
+                sum += 1.f / static_cast<float>(1 << o);
+
+            m_scale = 1.f / sum;
+        }
+
+        virtual void operator()(
+            const int begin
+        ,   const int end)
+        {
+            std::vector<float> f1(m_width);
+
+            for(int r = begin; r < end; ++r)
+            {
+                const int y = r % m_height;
+                const int z = r / m_height;
+
+                float *p = m_dest + r * m_width;
+
+                for(int x = 0; x < m_width; ++x)
+                    p[x] = 0.f;
+
+                for(unsigned int o = 0; o < m_noises.size(); ++o)
+                {
+                    const float ty = static_cast<float>(y * (m_periods[1] << o)) / static_cast<float>(m_height);
+                    const float tz = static_cast<float>(z * (m_periods[2] << o)) / static_cast<float>(m_depth);
+
+                    m_noises[o].worley3Row(m_width, ty, tz, &f1[0]);
+
+                    const float f = m_scale / static_cast<float>(1 << o);
+
+                    for(int x = 0; x < m_width; ++x)
+                        p[x] += f * (1.f - _mi(1.f, f1[x]));
+                }
+            }
+        }
+
+    protected:
+        const std::vector<WorleyNoise> &m_noises;
+
+        const int m_width;
+        const int m_height;
+        const int m_depth;
+
+        const unsigned int *m_periods;
+
+        float m_scale;
+        float *m_dest;
+    };
+}
+
+
+WorleyNoise::WorleyNoise(
+    const unsigned int px
+,   const unsigned int py
+,   const unsigned int pz
+,   const unsigned int seed
+,   const unsigned int stream)
+{
+    m_period[0] = _ma(1u, px);
+    m_period[1] = _ma(1u, py);
+    m_period[2] = _ma(1u, pz);
+
+    const unsigned int count = m_period[0] * m_period[1] * m_period[2] * 3;
+    m_points.resize(count);
+
+    const Random random(seed, stream);
+
+    for(unsigned int i = 0; i < count; ++i)
+        m_points[i] = random.atf(i);
+}
+
+
+const float WorleyNoise::worley3(
+    const float x
+,   const float y
+,   const float z) const
+{
+    const int cx = static_cast<int>(floor(x));
+    const int cy = static_cast<int>(floor(y));
+    const int cz = static_cast<int>(floor(z));
+
+    float d2 = FAR_POINT * FAR_POINT;
+
+    for(int k = -1; k <= 1; ++k)
+    for(int j = -1; j <= 1; ++j)
+    for(int i = -1; i <= 1; ++i)
+    {
+        const float *p = &m_points[3 * (
+            (wrap(cz + k, m_period[2]) * m_period[1] + wrap(cy + j, m_period[1])) * m_period[0] 
+          + wrap(cx + i, m_period[0]))];
+
+        const float dx = (static_cast<float>(cx + i) + p[0]) - x;
+        const float dy = (static_cast<float>(cy + j) + p[1]) - y;
+        const float dz = (static_cast<float>(cz + k) + p[2]) - z;
+
+        d2 = _mi(d2, dx * dx + dy * dy + dz * dz);
+    }
+    return sqrt(d2);
+}
+
+
+void WorleyNoise::gather(
+    const int x
+,   const int y
+,   const int z
+,   float *px
+,   float *py
+,   float *pz) const
+{
+    unsigned int n = 0;
+
+    for(int k = -1; k <= 1; ++k)
+    for(int j = -1; j <= 1; ++j)
+    for(int i = -1; i <= 1; ++i, ++n)
+    {
+        const float *p = &m_points[3 * (
+            (wrap(z + k, m_period[2]) * m_period[1] + wrap(y + j, m_period[1])) * m_period[0] 
+          + wrap(x + i, m_period[0]))];
+
+        px[n] = static_cast<float>(x + i) + p[0];
+        py[n] = static_cast<float>(y + j) + p[1];
+        pz[n] = static_cast<float>(z + k) + p[2];
+    }
+
+    for(; n < NEIGHBORS_PADDED; ++n)
+    {
+        px[n] = FAR_POINT;
+        py[n] = FAR_POINT;
+        pz[n] = FAR_POINT;
+    }
+}
+
+
+void WorleyNoise::worley3Row(
+    const unsigned int size
+,   const float y
+,   const float z
+,   float *dest
+,   const float scale
+,   const float bias) const
+{
+    assert(dest);
+
+    const int cy = static_cast<int>(floor(y));
+    const int cz = static_cast<int>(floor(z));
+
+    // The feature points of the 27 neighbors are gathered once per cell 
+    // (as structure of arrays), all texels of the cell reuse them.
+
+    float px[NEIGHBORS_PADDED];
+    float py[NEIGHBORS_PADDED];
+    float pz[NEIGHBORS_PADDED];
+
+    int cx = INT_MIN;
+
+    for(unsigned int i = 0; i < size; ++i)
+    {
+        const float x = static_cast<float>(i * m_period[0]) / static_cast<float>(size);
+
+        const int c = static_cast<int>(floor(x));
+        if(c != cx)
+        {
+            gather(c, cy, cz, px, py, pz);
+            cx = c;
+        }
+
+#ifdef OSGH_SSE2
+
+        const __m128 x4 = _mm_set1_ps(x);
+        const __m128 y4 = _mm_set1_ps(y);
+        const __m128 z4 = _mm_set1_ps(z);
+
+        __m128 d2 = _mm_set1_ps(FAR_POINT * FAR_POINT);
+
+        for(unsigned int n = 0; n < NEIGHBORS_PADDED; n += 4)
+        {
+            const __m128 dx = _mm_sub_ps(_mm_loadu_ps(px + n), x4);
+            const __m128 dy = _mm_sub_ps(_mm_loadu_ps(py + n), y4);
+            const __m128 dz = _mm_sub_ps(_mm_loadu_ps(pz + n), z4);
+
+            d2 = _mm_min_ps(d2, _mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+        }
+
+        d2 = _mm_min_ps(d2, _mm_shuffle_ps(d2, d2, _MM_SHUFFLE(1, 0, 3, 2)));
+        d2 = _mm_min_ps(d2, _mm_shuffle_ps(d2, d2, _MM_SHUFFLE(2, 3, 0, 1)));
+
+        const float f1 = sqrt(_mm_cvtss_f32(d2));
+
+#else // OSGH_SSE2
+
+        float d2 = FAR_POINT * FAR_POINT;
+
+        for(unsigned int n = 0; n < NEIGHBORS; ++n)
+        {
+            const float dx = px[n] - x;
+            const float dy = py[n] - y;
+            const float dz = pz[n] - z;
+
+            d2 = _mi(d2, dx * dx + dy * dy + dz * dz);
+        }
+
+        const float f1 = sqrt(d2);
+
+#endif // OSGH_SSE2
+
+        dest[i] = f1 * scale + bias;
+    }
+}
+
+
+void WorleyNoise::generateTileable1f(
+    const int width
+,   const int height
+,   const int depth
+,   float *dest
+,   const int period
+,   const int octaves
+,   const unsigned int seed)
+{
+    assert(dest);
+    assert(period > 0);
+
+    if(width < 1 || height < 1 || depth < 1 || octaves < 1)
+        return;
+
+    // same periods as for PerlinMapGenerator::generateTileable1f
+
+    unsigned int periods[3];
+    periods[0] = _ma(1, period);
+    periods[1] = _ma(1, (period * height + width / 2) / width);
+    periods[2] = _ma(1, (period * depth  + width / 2) / width);
+
+    std::vector<WorleyNoise> noises;
+    noises.reserve(octaves);
+
+    for(int o = 0; o < octaves; ++o)
+        noises.push_back(WorleyNoise(periods[0] << o, periods[1] << o, periods[2] << o, seed, o));
+
+    WorleyRowKernel kernel(noises, width, height, depth, periods, dest);
+    ParallelFor::run(height * depth, kernel, _ma(1, 4096 / width));
+}
+
+
+void WorleyNoise::generatePerlinWorley1f(
+    const int width
+,   const int height
+,   const int depth
+,   float *dest
+,   const int period
+,   const int octaves
+,   const unsigned int seed)
+{
+    assert(dest);
+
+    if(width < 1 || height < 1 || depth < 1 || octaves < 1)
+        return;
+
+    const unsigned int count = width * height * depth;
+
+    // the streams below octaves place the feature points
+    Random random(seed, octaves);
+
+    const float xOffset = random.nextf();
+    const float yOffset = random.nextf();
+
+    PerlinMapGenerator::generateTileable1f(width, height, depth, dest, period, octaves, xOffset, yOffset);
+
+    std::vector<float> worley(count);
+    generateTileable1f(width, height, depth, &worley[0], period, octaves, seed);
+
+    // remap perlin from [worley - 1;1] to [0;1]
+
+    for(unsigned int i = 0; i < count; ++i)
+        dest[i] = _clamp(0.f, 1.f, (dest[i] - worley[i] + 1.f) / (2.f - worley[i]));
+}
+
+} // namespace osgHimmel
\ No newline at end of file
@@ -0,0 +1,128 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_analyticsky.h"
+
+#include "test.h"
+
+#include "osgHimmel/analyticsky.h"
+#include "osgHimmel/atmospherequery.h"
+
+#include <osg/ref_ptr>
+
+
+using namespace osgHimmel;
+
+namespace
+{
+    // Serves the radiance of an analytic sky as reference, instead of the 
+    // precomputed tables.
+
+    class AnalyticReference : public AtmosphereQuery
+    {
+    public:
+        AnalyticReference(const AnalyticSky &sky)
+        :   AtmosphereQuery()
+        ,   m_sky(sky)
+        {
+            m_valid = true;
+        }
+
+        virtual void inscatter(
+            const unsigned int count
+        ,   const float *x
+        ,   const float *y
+        ,   const float *z
+        ,   const osg::Vec3f &sun
+        ,   float *r
+        ,   float *g
+        ,   float *b) const
+        {
+            for(unsigned int i = 0; i < count; ++i)
+            {
+                const osg::Vec3f L = m_sky.radiance(osg::Vec3f(x[i], y[i], z[i]), sun);
+
+                r[i] = L[0];
+                g[i] = L[1];
+                b[i] = L[2];
+            }
+        }
+
+    protected:
+        const AnalyticSky &m_sky;
+    };
+}
+
+
+void test_analyticsky()
+{
+    osg::ref_ptr<AnalyticSky> reference = new AnalyticSky();
+    osg::ref_ptr<AnalyticReference> query = new AnalyticReference(*reference);
+
+    osg::ref_ptr<AnalyticSky> sky = new AnalyticSky();
+
+    // An unfitted sky equals the reference, the fit has to keep it that way.
+
+    AnalyticSky::t_errorReport report = sky->errorReport(*query);
+
+    ASSERT_EQ(unsigned int, AnalyticSky::tableSize() - 1, report.rmsError.size());
+    ASSERT_AB(float, 0.f, report.maxRmsError, 1e-4f);
+
+    ASSERT_EQ(bool, true, sky->fit(*query));
+    ASSERT_EQ(bool, true, sky->isFitted());
+
+    report = sky->errorReport(*query);
+
+    ASSERT_AB(float, 0.f, report.maxRmsError, 1e-3f);
+    ASSERT_AB(float, 0.f, report.avgRmsError, 1e-3f);
+
+    ASSERT_AB(float, 0.f, (sky->radiance(osg::Vec3f(0.f, 1.f, 0.5f), osg::Vec3f(1.f, 0.f, 0.3f)) 
+        - reference->radiance(osg::Vec3f(0.f, 1.f, 0.5f), osg::Vec3f(1.f, 0.f, 0.3f))).length(), 1e-4f);
+
+    // A different turbidity is reported as error, that the fit can reduce 
+    // (only the gains are fitted, so it remains).
+
+    sky->resetFit();
+    sky->setTurbidity(6.f);
+
+    const float unfitted = sky->errorReport(*query).avgRmsError;
+    ASSERT_EQ(int, 1, unfitted > 0.01f ? 1 : 0);
+
+    sky->fit(*query);
+    ASSERT_EQ(int, 1, sky->errorReport(*query).avgRmsError < unfitted ? 1 : 0);
+
+    // Invalid references are rejected.
+
+    osg::ref_ptr<AtmosphereQuery> invalid = new AtmosphereQuery();
+
+    ASSERT_EQ(bool, false, sky->fit(*invalid));
+    ASSERT_EQ(unsigned int, 0, sky->errorReport(*invalid).rmsError.size());
+
+    TEST_REPORT();
+}
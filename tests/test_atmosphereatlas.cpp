@@ -0,0 +1,202 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_atmosphereatlas.h"
+
+#include "test.h"
+
+#include "osgHimmel/atmosphereatlas.h"
+#include "osgHimmel/atmosphereprecompute.h"
+#include "osgHimmel/halffloat.h"
+
+#include <osg/Image>
+#include <osg/ref_ptr>
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <stdio.h>
+
+
+using namespace osgHimmel;
+
+namespace
+{
+    const char *ATLAS_FILE = "test_atmosphereatlas.bin";
+
+    const char ATLAS_MAGIC[8] = { 'O', 'S', 'G', 'H', 'A', 'T', 'L', 'S' };
+    const unsigned int ATLAS_VERSION(1);
+    const unsigned int ATLAS_ENDIAN (0x01020304);
+
+
+    void tableSizes(
+        const AtmospherePrecompute &precompute
+    ,   unsigned int sizes[AtmosphereAtlas::T_NumTables])
+    {
+        const AtmospherePrecompute::t_preTexCfg &tc(precompute.getTextureConfig());
+
+        sizes[0] = tc.transmittanceWidth * tc.transmittanceHeight * 3;
+        sizes[1] = tc.skyWidth * tc.skyHeight * 3;
+        sizes[2] = tc.resMuS * tc.resNu * tc.resMu * tc.resR * 4;
+    }
+
+    // Writes an atlas with the given scattering samples (one thickness and 
+    // phase g sample), the tables of the i-th entry are filled with values[i].
+    void writeAtlas(
+        const std::vector<float> &scattering
+    ,   const float *values
+    ,   const unsigned int sizes[AtmosphereAtlas::T_NumTables]
+    ,   const unsigned int numScatteringSamples)
+    {
+        std::ofstream out(ATLAS_FILE, std::ios::binary);
+
+        out.write(ATLAS_MAGIC, sizeof(ATLAS_MAGIC));
+        out.write(reinterpret_cast<const char*>(&ATLAS_VERSION), sizeof(unsigned int));
+        out.write(reinterpret_cast<const char*>(&ATLAS_ENDIAN), sizeof(unsigned int));
+
+        const float other(1.f);
+        const unsigned int one(1);
+
+        out.write(reinterpret_cast<const char*>(&numScatteringSamples), sizeof(unsigned int));
+        out.write(reinterpret_cast<const char*>(&scattering[0]), scattering.size() * sizeof(float));
+
+        for(int a = 1; a < 3; ++a)
+        {
+            out.write(reinterpret_cast<const char*>(&one), sizeof(unsigned int));
+            out.write(reinterpret_cast<const char*>(&other), sizeof(float));
+        }
+
+        for(int i = 0; i < AtmosphereAtlas::T_NumTables; ++i)
+            out.write(reinterpret_cast<const char*>(&sizes[i]), sizeof(unsigned int));
+
+        for(unsigned int e = 0; e < scattering.size(); ++e)
+            for(int i = 0; i < AtmosphereAtlas::T_NumTables; ++i)
+            {
+                const std::vector<t_half> table(sizes[i], HalfFloat::toHalf(values[e]));
+                out.write(reinterpret_cast<const char*>(&table[0]), table.size() * sizeof(t_half));
+            }
+    }
+
+    // Precompute with another inscatter resolution than the atlas.
+    class MismatchedPrecompute : public AtmospherePrecompute
+    {
+    public:
+        MismatchedPrecompute()
+        {
+            getTextureConfig().resR += 1;
+        }
+    };
+
+    void truncate(const unsigned int bytes)
+    {
+        std::vector<char> data;
+        {
+            std::ifstream in(ATLAS_FILE, std::ios::binary);
+            data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        std::ofstream out(ATLAS_FILE, std::ios::binary);
+        out.write(&data[0], data.size() - bytes);
+    }
+}
+
+
+void test_atmosphereatlas()
+{
+    osg::ref_ptr<AtmosphereAtlas> atlas = new AtmosphereAtlas();
+
+    unsigned int sizes[AtmosphereAtlas::T_NumTables];
+    tableSizes(*atlas->getPrecompute(), sizes);
+
+    // Check loading and blending of two entries.
+
+    std::vector<float> scattering;
+    scattering.push_back(0.002f);
+    scattering.push_back(0.006f);
+
+    const float values[2] = { 1.f, 3.f };
+
+    writeAtlas(scattering, values, sizes, 2);
+
+    ASSERT_EQ(bool, true, atlas->load(ATLAS_FILE));
+    ASSERT_EQ(bool, true, atlas->isComplete());
+    ASSERT_EQ(unsigned int, 2, atlas->numEntries());
+    ASSERT_EQ(float, 0.006f, atlas->getScatteringMieSamples().back());
+
+    osg::ref_ptr<AtmospherePrecompute> target = new AtmospherePrecompute();
+    target->setTableStorage(AtmospherePrecompute::TS_Float);
+
+    ASSERT_EQ(bool, true, atlas->blend(*target, 0.004f, 1.f, 1.f));
+
+    const float *transmittance = reinterpret_cast<const float*>(target->getTransmittanceImage()->data());
+    const float *inscatter = reinterpret_cast<const float*>(target->getInscatterImage()->data());
+
+    ASSERT_AB(float, 2.f, transmittance[0], 1e-5f);
+    ASSERT_AB(float, 2.f, inscatter[sizes[2] - 1], 1e-5f);
+
+    // parameters outside the samples are clamped
+    ASSERT_EQ(bool, true, atlas->blend(*target, 1.f, 1.f, 1.f));
+    ASSERT_AB(float, 3.f, transmittance[0], 1e-5f);
+
+    // a mismatched target is rejected before its tables are touched
+    osg::ref_ptr<AtmospherePrecompute> mismatched = new MismatchedPrecompute();
+    mismatched->setTableStorage(AtmospherePrecompute::TS_Half);
+
+    ASSERT_EQ(bool, false, atlas->blend(*mismatched, 0.004f, 1.f, 1.f));
+    ASSERT_EQ(int, 1, NULL == mismatched->getTransmittanceImage()->data() ? 1 : 0);
+    ASSERT_EQ(int, 1, NULL == mismatched->getInscatterImage()->data() ? 1 : 0);
+
+    // Check that invalid files are rejected and keep the loaded atlas.
+
+    std::vector<float> descending(scattering.rbegin(), scattering.rend());
+    writeAtlas(descending, values, sizes, 2);
+    ASSERT_EQ(bool, false, atlas->load(ATLAS_FILE));
+
+    std::vector<float> duplicates(2, 0.002f);
+    writeAtlas(duplicates, values, sizes, 2);
+    ASSERT_EQ(bool, false, atlas->load(ATLAS_FILE));
+
+    // more samples than supported, the header lies about the count
+    writeAtlas(scattering, values, sizes, 65);
+    ASSERT_EQ(bool, false, atlas->load(ATLAS_FILE));
+
+    unsigned int wrongSizes[AtmosphereAtlas::T_NumTables] = { sizes[0] + 3, sizes[1], sizes[2] };
+    writeAtlas(scattering, values, wrongSizes, 2);
+    ASSERT_EQ(bool, false, atlas->load(ATLAS_FILE));
+
+    writeAtlas(scattering, values, sizes, 2);
+    truncate(2);
+    ASSERT_EQ(bool, false, atlas->load(ATLAS_FILE));
+
+    ASSERT_EQ(bool, true, atlas->isComplete());
+    ASSERT_EQ(float, 0.006f, atlas->getScatteringMieSamples().back());
+
+    remove(ATLAS_FILE);
+
+    TEST_REPORT();
+}
@@ -0,0 +1,173 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_atmospherequery.h"
+
+#include "test.h"
+
+#include "osgHimmel/atmospherequery.h"
+#include "osgHimmel/random.h"
+
+#include <vector>
+
+
+using namespace osgHimmel;
+
+namespace
+{
+    // Fills the tables with random data instead of copying them from a 
+    // precompute, which would require a graphics context.
+
+    class SyntheticQuery : public AtmosphereQuery
+    {
+    public:
+        SyntheticQuery()
+        :   AtmosphereQuery()
+        {
+            Random random(1234);
+
+            m_resR   = 4;
+            m_resMu  = 8;
+            m_resMuS = 4;
+            m_resNu  = 4;
+
+            m_mieG  = 0.8f;
+            m_betaR = osg::Vec3f(5.8e-3f, 1.35e-2f, 3.31e-2f);
+
+            fill(m_transmittance, 16, 8, 1, 3, random);
+            fill(m_irradiance, 8, 4, 1, 3, random);
+            fill(m_inscatter, m_resMuS * m_resNu, m_resMu, m_resR, 4, random);
+
+            m_valid = true;
+        }
+
+    protected:
+        static void fill(
+            t_table &table
+        ,   const int width
+        ,   const int height
+        ,   const int depth
+        ,   const int components
+        ,   Random &random)
+        {
+            table.width  = width;
+            table.height = height;
+            table.depth  = depth;
+            table.components = components;
+
+            table.data.resize(width * height * depth * components);
+            for(unsigned int i = 0; i < table.data.size(); ++i)
+                table.data[i] = random.nextf(0.f, 1.f);
+        }
+    };
+}
+
+
+void test_atmospherequery()
+{
+    SyntheticQuery query;
+    query.setAltitude(0.5f);
+
+    // Random, not normalized directions covering both hemispheres, enough 
+    // to be split over several threads.
+
+    Random random(42);
+
+    const unsigned int n = 10000;
+
+    std::vector<float> x(n), y(n), z(n);
+    for(unsigned int i = 0; i < n; ++i)
+    {
+        const float scale = random.nextf(0.1f, 10.f);
+
+        osg::Vec3f v(random.nextf(-1.f, 1.f), random.nextf(-1.f, 1.f), random.nextf(-1.f, 1.f));
+        v.normalize();
+
+        x[i] = v.x() * scale;
+        y[i] = v.y() * scale;
+        z[i] = v.z() * scale;
+    }
+
+    // a zero length direction, left unnormalized as by osg
+    x[n / 2] = y[n / 2] = z[n / 2] = 0.f;
+
+    // The batch results equal the single direction ones.
+
+    std::vector<float> r(n), g(n), b(n);
+
+    for(int s = 0; s < 2; ++s)
+    {
+        const osg::Vec3f sun = s == 0 ? osg::Vec3f(0.3f, 0.4f, 0.6f) : osg::Vec3f(0.f, -1.f, -0.05f);
+
+        query.inscatter(n, &x[0], &y[0], &z[0], sun, &r[0], &g[0], &b[0]);
+
+        int mismatches = 0;
+        for(unsigned int i = 0; i < n; ++i)
+        {
+            const osg::Vec3f expected = query.inscatter(osg::Vec3f(x[i], y[i], z[i]), sun);
+            const osg::Vec3f difference = expected - osg::Vec3f(r[i], g[i], b[i]);
+
+            if(difference.length() > 1e-4f * (1.f + expected.length()))
+                ++mismatches;
+        }
+        ASSERT_EQ(int, 0, mismatches);
+    }
+
+    query.transmittance(n, &x[0], &y[0], &z[0], &r[0], &g[0], &b[0]);
+
+    int mismatches = 0;
+    int shadowed = 0;
+
+    for(unsigned int i = 0; i < n; ++i)
+    {
+        const osg::Vec3f expected = query.transmittance(osg::Vec3f(x[i], y[i], z[i]));
+        const osg::Vec3f difference = expected - osg::Vec3f(r[i], g[i], b[i]);
+
+        if(difference.length() > 1e-5f)
+            ++mismatches;
+        if(expected.length() == 0.f)
+            ++shadowed;
+    }
+    ASSERT_EQ(int, 0, mismatches);
+
+    // directions below the horizon hit the ground
+    ASSERT_EQ(int, 1, shadowed > 0 && shadowed < static_cast<int>(n) ? 1 : 0);
+
+    // An invalid query returns black for batches as well.
+
+    AtmosphereQuery invalid;
+
+    r.assign(n, 1.f);
+    invalid.inscatter(n, &x[0], &y[0], &z[0], osg::Vec3f(0.f, 0.f, 1.f), &r[0], &g[0], &b[0]);
+
+    ASSERT_EQ(float, 0.f, r[0]);
+    ASSERT_EQ(float, 0.f, r[n - 1]);
+
+    TEST_REPORT();
+}
@@ -0,0 +1,138 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_cloudlayerevaluator.h"
+
+#include "test.h"
+
+#include "osgHimmel/cloudlayerevaluator.h"
+
+#include <osg/Vec3f>
+
+#include <math.h>
+#include <vector>
+
+
+using namespace osgHimmel;
+
+void test_cloudlayerevaluator()
+{
+    // With constant noise arrays, the pre rendered noise is the remapped sum
+    // of the octave weights, independent of position and time.
+
+    const unsigned int size = 16;
+    const unsigned int slices = 4;
+
+    std::vector<float> constant(size * size * slices, 0.6f);
+
+    CloudLayerEvaluator e;
+    for(unsigned int i = 0; i < 4; ++i)
+        e.setNoiseArray(i, &constant[0], size, slices);
+
+    e.setCoverage(0.5f);
+    e.setSharpness(0.5f);
+    e.setWind(osg::Vec2f(0.01f, -0.02f));
+    e.setTime(0.3f);
+
+    const float n = 0.6f * 1.9425f * 0.76f;
+    const float expected = static_cast<float>(pow((n - 1.f + 0.5f) / 0.5f, 0.5f));
+
+    ASSERT_AB(float, expected, e.noise(0.f, 0.f), 1e-5f);
+    ASSERT_AB(float, expected, e.noise(0.37f, -4.2f), 1e-5f);
+
+    ASSERT_AB(float, expected, e.density(osg::Vec3f(0.f, 0.f, 1.f)), 1e-5f);
+    ASSERT_AB(float, expected, e.density(osg::Vec3f(0.3f, 0.2f, 0.1f)), 1e-5f);
+    ASSERT_AB(float, 0.f, e.density(osg::Vec3f(0.f, 0.f, -1.f)), 0.f);
+    ASSERT_AB(float, expected, e.occlusion(osg::Vec3f(0.f, 1.f, 1.f), 0.01f), 1e-5f);
+
+    // Sampling is periodic and interpolates linearly between texel centers.
+
+    std::vector<float> ramp(size * size * slices);
+    for(unsigned int i = 0; i < size * size * slices; ++i)
+        ramp[i] = static_cast<float>(i % size) / size;
+
+    for(unsigned int i = 0; i < 4; ++i)
+        e.setNoiseArray(i, &ramp[0], size, slices);
+
+    e.setTime(0.f);
+    e.setCoverage(1.f);
+    e.setSharpness(0.f);
+
+    int mismatches = 0;
+    for(int i = 0; i < 64; ++i)
+    {
+        const float u = i * 0.0713f;
+        const float v = i * 0.0391f;
+
+        if(fabs(e.noise(u, v) - e.noise(u + 1.f, v - 2.f)) > 1e-5f)
+            ++mismatches;
+    }
+    ASSERT_EQ(int, 0, mismatches);
+
+    // between texel 2 and 3 of all arrays (the fifth term samples twice)
+    const float u = 2.75f / size;
+    const float s = 2.75f / size * 2.f - 0.5f / size;
+    ASSERT_AB(float, (2.25f / size * 1.875f + s * 0.0675f) * 0.76f, e.noise(u, 0.f), 1e-5f);
+
+    // Batch and scalar evaluation match, for both models.
+
+    std::vector<osg::Vec3f> directions;
+    for(int i = 0; i < 200; ++i)
+        directions.push_back(osg::Vec3f(sin(i * 0.7f), cos(i * 0.3f), sin(i * 0.11f)));
+
+    std::vector<float> batch(directions.size());
+
+    e.setCoverage(0.3f);
+    e.setTime(0.1f);
+
+    CloudLayerEvaluator d(CloudLayerEvaluator::LM_Dube);
+    for(unsigned int i = 0; i < 4; ++i)
+        d.setNoiseArray(i, &ramp[0], size, slices);
+
+    mismatches = 0;
+    int outOfRange = 0;
+
+    for(unsigned int j = 0; j < 2; ++j)
+    {
+        const CloudLayerEvaluator &evaluator(j ? d : e);
+        evaluator.density(static_cast<unsigned int>(directions.size()), &directions[0], &batch[0]);
+
+        for(unsigned int i = 0; i < directions.size(); ++i)
+        {
+            if(batch[i] != evaluator.density(directions[i]))
+                ++mismatches;
+            if(batch[i] < 0.f || batch[i] > 1.f)
+                ++outOfRange;
+        }
+    }
+    ASSERT_EQ(int, 0, mismatches);
+    ASSERT_EQ(int, 0, outOfRange);
+
+    TEST_REPORT();
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "test_halffloat.h"
+
+#include "test.h"
+
+#include "osgHimmel/halffloat.h"
+
+#include <math.h>
+#include <vector>
+
+
+using namespace osgHimmel;
+
+void test_halffloat()
+{
+    // Check exactly representable values and specials.
+
+    ASSERT_EQ(unsigned short, 0x0000, HalfFloat::toHalf( 0.f));
+    ASSERT_EQ(unsigned short, 0x8000, HalfFloat::toHalf(-0.f));
+    ASSERT_EQ(unsigned short, 0x3c00, HalfFloat::toHalf( 1.f));
+    ASSERT_EQ(unsigned short, 0xc000, HalfFloat::toHalf(-2.f));
+    ASSERT_EQ(unsigned short, 0x3800, HalfFloat::toHalf( 0.5f));
+    ASSERT_EQ(unsigned short, 0x7bff, HalfFloat::toHalf( 65504.f));
+    ASSERT_EQ(unsigned short, 0x0001, HalfFloat::toHalf( 5.9604645e-8f)); // smallest denormal
+
+    ASSERT_EQ(unsigned short, 0x7c00, HalfFloat::toHalf( 1e6f));  // overflow
+    ASSERT_EQ(unsigned short, 0xfc00, HalfFloat::toHalf(-1e6f));
+    ASSERT_EQ(unsigned short, 0x0000, HalfFloat::toHalf( 1e-9f)); // underflow
+
+    // Check rounding to nearest even (1 + 2^-11 is exactly between two halfs).
+
+    ASSERT_EQ(unsigned short, 0x3c00, HalfFloat::toHalf(1.00048828125f));
+    ASSERT_EQ(unsigned short, 0x3c02, HalfFloat::toHalf(1.00146484375f));
+
+    ASSERT_EQ(float, 1.f, HalfFloat::toFloat(0x3c00));
+    ASSERT_EQ(float, 65504.f, HalfFloat::toFloat(0x7bff));
+    ASSERT_EQ(float, 5.9604645e-8f, HalfFloat::toFloat(0x0001));
+
+    // Check that all finite halfs survive a round trip, for the scalar and 
+    // the batch variant.
+
+    std::vector<t_half> halfs(0x10000);
+    std::vector<float> floats(0x10000);
+    std::vector<t_half> result(0x10000);
+
+    for(unsigned int i = 0; i < 0x10000; ++i)
+        halfs[i] = static_cast<t_half>(i);
+
+    HalfFloat::toFloat(&halfs[0], &floats[0], 0x10000);
+    HalfFloat::toHalf(&floats[0], &result[0], 0x10000);
+
+    int scalarMismatches = 0;
+    int batchMismatches = 0;
+
+    for(unsigned int i = 0; i < 0x10000; ++i)
+    {
+        if((i & 0x7c00) == 0x7c00 && (i & 0x03ff)) // skip nans
+            continue;
+
+        if(HalfFloat::toHalf(HalfFloat::toFloat(halfs[i])) != halfs[i])
+            ++scalarMismatches;
+        if(result[i] != halfs[i] || floats[i] != HalfFloat::toFloat(halfs[i]))
+            ++batchMismatches;
+    }
+    ASSERT_EQ(int, 0, scalarMismatches);
+    ASSERT_EQ(int, 0, batchMismatches);
+
+    // Check the round trip error of a table with values in the range of the 
+    // atmosphere tables (positive, up to 1e+2). Within the normal half range
+    // (>= 2^-14) the relative error is bound by 2^-11, below the absolute error
+    // is bound by 2^-25. An odd count includes the scalar remainder of the 
+    // batch conversion.
+
+    const unsigned int count = 32 * 128 * 8 * 4 + 3;
+
+    std::vector<float> table(count);
+    std::vector<t_half> packed(count);
+    std::vector<float> unpacked(count);
+
+    for(unsigned int i = 0; i < count; ++i)
+        table[i] = static_cast<float>(pow(10.0, -7.0 + 9.0 * i / (count - 1.0)));
+
+    HalfFloat::toHalf(&table[0], &packed[0], count);
+    HalfFloat::toFloat(&packed[0], &unpacked[0], count);
+
+    double maxRelativeError = 0.0;
+    double maxAbsoluteError = 0.0;
+    int batchVsScalar = 0;
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const double e = fabs(unpacked[i] - table[i]);
+
+        if(table[i] < 6.103515625e-5f)
+            maxAbsoluteError = e > maxAbsoluteError ? e : maxAbsoluteError;
+        else if(e / table[i] > maxRelativeError)
+            maxRelativeError = e / table[i];
+
+        if(packed[i] != HalfFloat::toHalf(table[i]))
+            ++batchVsScalar;
+    }
+    ASSERT_AB(double, 0.0, maxRelativeError, 1.0 / 2048.0);
+    ASSERT_AB(double, 0.0, maxAbsoluteError, 1.0 / 33554432.0);
+    ASSERT_EQ(int, 0, batchVsScalar);
+
+    TEST_REPORT();
+}
@@ -0,0 +1,314 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_noise.h"
+
+#include "test.h"
+
+#include "osgHimmel/noise.h"
+#include "osgHimmel/perlinmapgenerator.h"
+#include "osgHimmel/worleynoise.h"
+
+#include <osg/Vec2f>
+
+#include <math.h>
+#include <vector>
+
+
+using namespace osgHimmel;
+
+void test_noise()
+{
+    // Check that the batch row variant matches the scalar noise for several
+    // ranks, offsets and sizes (odd sizes include the scalar remainder).
+
+    const unsigned int sizes[] = { 64, 100, 67 };
+    const unsigned int octaves[] = { 3, 4, 6 };
+    const float offsets[][2] = { { 0.f, 0.f }, { 0.37f, 0.81f }, { 0.93f, 0.12f } };
+
+    int mismatches = 0;
+    int outOfRange = 0;
+
+    for(unsigned int i = 0; i < 3; ++i)
+    for(unsigned int j = 0; j < 3; ++j)
+    {
+        const unsigned int size = sizes[i];
+        const unsigned int octave = octaves[i];
+        const float oneOverSize = 1.f / static_cast<float>(size);
+
+        Noise n(1 << (octave + 2), offsets[j][0], offsets[j][1]);
+
+        std::vector<float> row(size);
+        std::vector<float> scaled(size);
+
+        for(unsigned int t = 0; t < size; ++t)
+        {
+            n.noise2Row(size, t, octave, &row[0]);
+            n.noise2Row(size, t, octave, &scaled[0], 0.5f, 0.5f);
+
+            for(unsigned int s = 0; s < size; ++s)
+            {
+                const float expected = n.noise2(s * oneOverSize, t * oneOverSize, octave);
+
+                if(fabs(expected - row[s]) > 1e-6f || fabs(expected * 0.5f + 0.5f - scaled[s]) > 1e-6f)
+                    ++mismatches;
+                if(scaled[s] < 0.f || scaled[s] > 1.f)
+                    ++outOfRange;
+            }
+        }
+    }
+    ASSERT_EQ(int, 0, mismatches);
+    ASSERT_EQ(int, 0, outOfRange);
+
+    // Check range and determinism of the generated maps for all noise types,
+    // with and without normalization (the non square map has an odd width).
+
+    const int w = 129;
+    const int h = 64;
+
+    std::vector<float> map(w * h);
+    std::vector<float> map2(w * h);
+    std::vector<unsigned char> map8(w * h);
+
+    const PerlinMapGenerator::e_NoiseType types[] = 
+    {
+        PerlinMapGenerator::NT_Standard
+    ,   PerlinMapGenerator::NT_Cloud
+    ,   PerlinMapGenerator::NT_CloudAbs
+    ,   PerlinMapGenerator::NT_Wood
+    ,   PerlinMapGenerator::NT_Paper
+    };
+
+    for(unsigned int i = 0; i < 5; ++i)
+    {
+        PerlinMapGenerator::generate1f(w, h, &map[0], types[i], 2, 5);
+        PerlinMapGenerator::generate1f(w, h, &map2[0], types[i], 2, 5);
+        PerlinMapGenerator::generate1(w, h, &map8[0], types[i], 2, 5);
+
+        float minp = map[0];
+        float maxp = map[0];
+        int unequal = 0;
+
+        unsigned char min8 = map8[0];
+        unsigned char max8 = map8[0];
+
+        for(int j = 0; j < w * h; ++j)
+        {
+            minp = map[j] < minp ? map[j] : minp;
+            maxp = map[j] > maxp ? map[j] : maxp;
+
+            min8 = map8[j] < min8 ? map8[j] : min8;
+            max8 = map8[j] > max8 ? map8[j] : max8;
+
+            if(map[j] != map2[j])
+                ++unequal;
+        }
+
+        ASSERT_EQ(int, 0, unequal);
+        ASSERT_AB(float, 0.f, minp, 1e-6f);
+        ASSERT_AB(float, 1.f, maxp, 1e-6f);
+        ASSERT_EQ(int, 0, min8);
+        ASSERT_EQ(int, 255, max8);
+    }
+
+    // Without normalization, noise of [-1;+1] is shifted by 0.5.
+
+    PerlinMapGenerator::generate1f(w, h, &map[0], PerlinMapGenerator::NT_Standard, 3, 1, false);
+
+    outOfRange = 0;
+    for(int j = 0; j < w * h; ++j)
+        if(map[j] < -0.5f || map[j] > 1.5f)
+            ++outOfRange;
+
+    ASSERT_EQ(int, 0, outOfRange);
+
+    // Check periodicity of the tileable noise for arbitrary periods.
+
+    const Noise pn(8, 0.42f, 0.17f);
+    
+    mismatches = 0;
+    for(int i = 0; i < 64; ++i)
+    {
+        const float x = i * 0.173f;
+        const float y = i * 0.311f;
+        const float z = i * 0.097f;
+
+        if(fabs(pn.pnoise2(x, y, 5, 3) - pn.pnoise2(x + 5.f, y - 3.f, 5, 3)) > 1e-4f)
+            ++mismatches;
+        if(fabs(pn.pnoise3(x, y, z, 7, 3, 2) - pn.pnoise3(x - 7.f, y + 6.f, z + 2.f, 7, 3, 2)) > 1e-4f)
+            ++mismatches;
+    }
+    ASSERT_EQ(int, 0, mismatches);
+
+    // The wrap around differences of a seamless tile do not exceed the 
+    // largest difference of adjacent texels within the tile.
+
+    const int ts = 32;
+    const int td = 4;
+
+    std::vector<float> tile(ts * ts * td);
+    PerlinMapGenerator::generateTileable1f(ts, ts, td, &tile[0], 3, 2);
+
+    float maxInner = 0.f;
+    float maxWrap = 0.f;
+
+    outOfRange = 0;
+    for(int z = 0; z < td; ++z)
+    for(int y = 0; y < ts; ++y)
+    for(int x = 0; x < ts; ++x)
+    {
+        const float v  = tile[(z * ts + y) * ts + x];
+        const float vx = tile[(z * ts + y) * ts + (x + 1) % ts];
+        const float vy = tile[(z * ts + (y + 1) % ts) * ts + x];
+
+        const float dx = static_cast<float>(fabs(v - vx));
+        const float dy = static_cast<float>(fabs(v - vy));
+
+        if(x < ts - 1) maxInner = dx > maxInner ? dx : maxInner;
+        else           maxWrap  = dx > maxWrap  ? dx : maxWrap;
+        if(y < ts - 1) maxInner = dy > maxInner ? dy : maxInner;
+        else           maxWrap  = dy > maxWrap  ? dy : maxWrap;
+
+        if(v < 0.f || v > 1.f)
+            ++outOfRange;
+    }
+    ASSERT_EQ(int, 0, outOfRange);
+    ASSERT_EQ(int, 1, maxWrap <= maxInner ? 1 : 0);
+
+    // Check that the batch simplex noise matches the scalar variant (an odd
+    // count includes the scalar remainder) and stays within [-1;+1].
+
+    const unsigned int sc = 1027;
+
+    std::vector<float> sx(sc);
+    std::vector<float> sy(sc);
+    std::vector<float> sz(sc);
+    std::vector<float> sw(sc);
+    std::vector<float> s3(sc);
+    std::vector<float> s4(sc);
+
+    for(unsigned int i = 0; i < sc; ++i)
+    {
+        sx[i] = -20.f + i * 0.0391f;
+        sy[i] =  13.f - i * 0.0173f;
+        sz[i] = fmod(i * 0.7331f, 17.f) - 3.f;
+        sw[i] = fmod(i * 1.3117f, 11.f);
+    }
+
+    pn.simplex3(sc, &sx[0], &sy[0], &sz[0], &s3[0]);
+    pn.simplex4(sc, &sx[0], &sy[0], &sz[0], &sw[0], &s4[0]);
+
+    mismatches = 0;
+    outOfRange = 0;
+
+    for(unsigned int i = 0; i < sc; ++i)
+    {
+        const float n3 = pn.simplex3(sx[i], sy[i], sz[i]);
+        const float n4 = pn.simplex4(sx[i], sy[i], sz[i], sw[i]);
+
+        if(fabs(n3 - s3[i]) > 1e-6f || fabs(n4 - s4[i]) > 1e-6f)
+            ++mismatches;
+        if(fabs(n3) > 1.f || fabs(n4) > 1.f)
+            ++outOfRange;
+    }
+    ASSERT_EQ(int, 0, mismatches);
+    ASSERT_EQ(int, 0, outOfRange);
+
+    // Check that the batch worley noise matches the scalar variant (odd 
+    // size), is periodic, and that F1 is within the farthest possible 
+    // distance to the own cells feature point.
+
+    const WorleyNoise wn(5, 3, 4, 42);
+    std::vector<float> f1s(67);
+
+    mismatches = 0;
+    outOfRange = 0;
+
+    for(int j = 0; j < 16; ++j)
+    {
+        const float y = j * 0.2131f;
+        const float z = j * 0.2677f;
+
+        wn.worley3Row(67, y, z, &f1s[0]);
+
+        for(unsigned int i = 0; i < 67; ++i)
+        {
+            const float x = static_cast<float>(i * 5) / 67.f;
+            const float f1 = wn.worley3(x, y, z);
+
+            if(f1 != f1s[i] || fabs(f1 - wn.worley3(x - 5.f, y + 3.f, z + 8.f)) > 1e-5f)
+                ++mismatches;
+            if(f1 < 0.f || f1 > sqrt(3.f))
+                ++outOfRange;
+        }
+    }
+    ASSERT_EQ(int, 0, mismatches);
+    ASSERT_EQ(int, 0, outOfRange);
+
+    // The worley and perlin-worley tiles are within [0;1] and seamless.
+
+    const int ws = 32;
+    std::vector<float> wtile(ws * ws * ws);
+
+    for(int k = 0; k < 2; ++k)
+    {
+        if(k == 0)
+            WorleyNoise::generateTileable1f(ws, ws, ws, &wtile[0], 4, 3, 7);
+        else
+            WorleyNoise::generatePerlinWorley1f(ws, ws, ws, &wtile[0], 4, 3, 7);
+
+        maxInner = 0.f;
+        maxWrap = 0.f;
+        outOfRange = 0;
+
+        for(int z = 0; z < ws; ++z)
+        for(int y = 0; y < ws; ++y)
+        for(int x = 0; x < ws; ++x)
+        {
+            const float v  = wtile[(z * ws + y) * ws + x];
+            const float vx = wtile[(z * ws + y) * ws + (x + 1) % ws];
+            const float vz = wtile[(((z + 1) % ws) * ws + y) * ws + x];
+
+            const float dx = static_cast<float>(fabs(v - vx));
+            const float dz = static_cast<float>(fabs(v - vz));
+
+            if(x < ws - 1) maxInner = dx > maxInner ? dx : maxInner;
+            else           maxWrap  = dx > maxWrap  ? dx : maxWrap;
+            if(z < ws - 1) maxInner = dz > maxInner ? dz : maxInner;
+            else           maxWrap  = dz > maxWrap  ? dz : maxWrap;
+
+            if(v < 0.f || v > 1.f)
+                ++outOfRange;
+        }
+        ASSERT_EQ(int, 0, outOfRange);
+        ASSERT_EQ(int, 1, maxWrap <= maxInner ? 1 : 0);
+    }
+
+    TEST_REPORT();
+}
\ No newline at end of file
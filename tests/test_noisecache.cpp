@@ -0,0 +1,183 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_noisecache.h"
+
+#include "test.h"
+
+#include "osgHimmel/noisecache.h"
+
+#include <osg/Image>
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <stdio.h>
+#include <math.h>
+
+
+using namespace osgHimmel;
+
+namespace
+{
+    class TestCache : public NoiseCache
+    {
+    public:
+        using NoiseCache::load;
+
+        static const std::string noisePath(
+            const unsigned int seed
+        ,   const unsigned int octave = 2)
+        {
+            return filePath(AT_Noise, 32, octave, 2, seed);
+        }
+
+        static const std::string perlinWorleyPath(const unsigned int seed)
+        {
+            return filePath(AT_PerlinWorley, 32, 2, 2, seed);
+        }
+    };
+
+
+    const float maxDifference(
+        const osg::Image &a
+    ,   const osg::Image &b)
+    {
+        const float *fa = reinterpret_cast<const float*>(a.data());
+        const float *fb = reinterpret_cast<const float*>(b.data());
+
+        float difference = 0.f;
+        for(int i = 0; i < a.s() * a.t() * a.r(); ++i)
+            difference = fabsf(fa[i] - fb[i]) > difference ? fabsf(fa[i] - fb[i]) : difference;
+
+        return difference;
+    }
+
+    const bool exists(const std::string &path)
+    {
+        return std::ifstream(path.c_str(), std::ios::binary).good();
+    }
+
+    // Rewrites the file without its last bytes or with a modified word.
+    void modify(
+        const std::string &path
+    ,   const unsigned int truncate
+    ,   const unsigned int offset = 0
+    ,   const unsigned int value = 0)
+    {
+        std::vector<char> data;
+        {
+            std::ifstream in(path.c_str(), std::ios::binary);
+            data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        if(offset)
+            *reinterpret_cast<unsigned int*>(&data[offset]) = value;
+
+        std::ofstream out(path.c_str(), std::ios::binary);
+        out.write(&data[0], data.size() - truncate);
+    }
+}
+
+
+void test_noisecache()
+{
+    const std::string directory = NoiseCache::directory();
+
+    NoiseCache::setDirectory(".");
+    NoiseCache::clear();
+
+    const std::string path = TestCache::noisePath(7);
+    remove(path.c_str());
+
+    // A miss generates and writes the array (at half precision), hits 
+    // share it.
+
+    osg::ref_ptr<osg::Image> generated = NoiseCache::noiseArray(32, 2, 2, 7);
+    osg::ref_ptr<osg::Image> reference = NoiseCache::generate(32, 2, 2, 7);
+
+    ASSERT_AB(float, 0.f, maxDifference(*reference, *generated), 1e-3f);
+    ASSERT_EQ(bool, true, exists(path));
+    ASSERT_EQ(int, 1, NoiseCache::noiseArray(32, 2, 2, 7) == generated ? 1 : 0);
+
+    // After clearing, the array is loaded from disk, bit-identical.
+
+    NoiseCache::clear();
+
+    osg::ref_ptr<osg::Image> loaded = NoiseCache::noiseArray(32, 2, 2, 7);
+
+    ASSERT_EQ(int, 0, loaded == generated ? 1 : 0);
+    ASSERT_EQ(int, 32, loaded->s());
+    ASSERT_EQ(int, 2, loaded->r());
+    ASSERT_EQ(float, 0.f, maxDifference(*generated, *loaded));
+
+    // Keys and types are kept apart, in memory and on disk.
+
+    osg::ref_ptr<osg::Image> seeded = NoiseCache::noiseArray(32, 2, 2, 8);
+    osg::ref_ptr<osg::Image> octave = NoiseCache::noiseArray(32, 3, 2, 7);
+    osg::ref_ptr<osg::Image> perlinWorley = NoiseCache::perlinWorleyArray(32, 2, 2, 7);
+
+    ASSERT_EQ(int, 1, maxDifference(*loaded, *seeded) > 0.1f ? 1 : 0);
+    ASSERT_EQ(int, 1, maxDifference(*loaded, *octave) > 0.1f ? 1 : 0);
+    ASSERT_EQ(int, 1, maxDifference(*loaded, *perlinWorley) > 0.1f ? 1 : 0);
+
+    ASSERT_EQ(int, 0, path == TestCache::perlinWorleyPath(7) ? 1 : 0);
+    ASSERT_EQ(bool, true, exists(TestCache::perlinWorleyPath(7)));
+
+    // Files that do not match the request or are damaged are rejected.
+
+    osg::ref_ptr<osg::Image> valid = TestCache::load(path, 32, 2);
+    ASSERT_EQ(int, 1, valid.valid() ? 1 : 0);
+    ASSERT_EQ(int, 0, osg::ref_ptr<osg::Image>(TestCache::load(path, 32, 4)).valid() ? 1 : 0);
+
+    modify(path, 2);
+    ASSERT_EQ(int, 0, osg::ref_ptr<osg::Image>(TestCache::load(path, 32, 2)).valid() ? 1 : 0);
+
+    NoiseCache::clear();
+    remove(path.c_str());
+    NoiseCache::noiseArray(32, 2, 2, 7);
+
+    // version follows the 8 byte magic
+    modify(path, 0, 8, 0xffffffff);
+    ASSERT_EQ(int, 0, osg::ref_ptr<osg::Image>(TestCache::load(path, 32, 2)).valid() ? 1 : 0);
+
+    // a rejected file is regenerated and replaced
+    NoiseCache::clear();
+    ASSERT_EQ(float, 0.f, maxDifference(*generated, *NoiseCache::noiseArray(32, 2, 2, 7)));
+    ASSERT_EQ(int, 1, osg::ref_ptr<osg::Image>(TestCache::load(path, 32, 2)).valid() ? 1 : 0);
+
+    remove(path.c_str());
+    remove(TestCache::noisePath(8).c_str());
+    remove(TestCache::perlinWorleyPath(7).c_str());
+    remove(TestCache::noisePath(7, 3).c_str());
+
+    NoiseCache::clear();
+    NoiseCache::setDirectory(directory);
+
+    TEST_REPORT();
+}
@@ -0,0 +1,253 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_packedstars.h"
+
+#include "test.h"
+
+#include "osgHimmel/brightstars.h"
+#include "osgHimmel/mathmacros.h"
+#include "osgHimmel/packedstars.h"
+#include "osgHimmel/starcatalogue.h"
+
+#include <osg/ref_ptr>
+#include <osg/Timer>
+
+#include <fstream>
+#include <vector>
+#include <stdio.h>
+#include <math.h>
+
+
+using namespace osgHimmel;
+
+namespace
+{
+    const char *PACKED_FILE = "test_packedstars.bin";
+
+    // odd, includes the scalar remainder of the batch decoding
+    const unsigned int NUM_STARS(9091);
+
+    // decimal hours and degrees per year
+    const float MAX_PM_RA(11.f / (15.f * 3600.f));
+    const float MAX_PM_DE(11.f / 3600.f);
+}
+
+
+void test_packedstars()
+{
+    ASSERT_EQ(int, 12, static_cast<int>(sizeof(PackedStars::t_packedStar)));
+
+    // Stars spread evenly over the sphere (golden spiral), including the 
+    // poles and the fold of the octahedral mapping.
+
+    std::vector<BrightStars::s_BrightStar> stars(NUM_STARS);
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+    {
+        BrightStars::s_BrightStar &star(stars[i]);
+
+        const double z  = 1.0 - 2.0 * i / (NUM_STARS - 1.0);
+        const double ra = fmod(i * 137.50776405, 360.0);
+
+        star.Vmag   = -1.5f + 10.f * (i % 101) / 100.f;
+        star.RA     = static_cast<float>(ra / 15.0);
+        star.DE     = static_cast<float>(asin(z) * 180.0 / 3.14159265358979323846);
+        star.pmRA   = MAX_PM_RA * ((i % 53) / 26.f - 1.f);
+        star.pmDE   = MAX_PM_DE * ((i % 47) / 23.f - 1.f) * 0.1f;
+        star.sRGB_R = (i % 256) / 255.f + 0.001f;
+        star.sRGB_G = 1.f - (i % 17) / 16.f;
+        star.sRGB_B = 0.5f;
+    }
+    stars[1].DE = 0.f; // equator
+    stars[2].RA = 0.f;
+
+    PackedStars::t_packedStars packed(NUM_STARS);
+    PackedStars::encode(&stars[0], &packed[0], NUM_STARS);
+
+    std::vector<osg::Vec4f> positions(NUM_STARS);
+    std::vector<osg::Vec4f> colors(NUM_STARS);
+
+    PackedStars::decode(&packed[0], &positions[0], &colors[0], NUM_STARS, 5);
+
+    std::vector<BrightStars::s_BrightStar> decoded(NUM_STARS);
+    PackedStars::decode(&packed[0], &decoded[0], NUM_STARS);
+
+    // Check the error budget.
+
+    const double magnitudeStep = (PackedStars::maxMagnitude() - PackedStars::minMagnitude()) / 65535.0;
+    const double M = PackedStars::maxProperMotion();
+
+    double maxAngle = 0.0;
+    double maxMagnitudeError = 0.0;
+    double maxColorError = 0.0;
+    double maxLength = 0.0;
+
+    int properMotionErrors = 0;
+    int batchVsScalar = 0;
+    int indexErrors = 0;
+
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+    {
+        const BrightStars::s_BrightStar &star(stars[i]);
+
+        const double ra = star.RA * 15.0 * 3.14159265358979323846 / 180.0;
+        const double de = star.DE * 3.14159265358979323846 / 180.0;
+
+        const double x = sin(ra) * cos(de);
+        const double y = cos(ra) * cos(de);
+        const double z = sin(de);
+
+        const osg::Vec4f &p(positions[i]);
+        // from the chord, acos lacks precision for small angles
+        const double chord = sqrt((x - p.x()) * (x - p.x()) + (y - p.y()) * (y - p.y()) + (z - p.z()) * (z - p.z()));
+
+        maxAngle = _ma(maxAngle, 2.0 * asin(0.5 * chord) * 180.0 / 3.14159265358979323846);
+        maxLength = _ma(maxLength, fabs(sqrt(p.x() * p.x() + p.y() * p.y() + p.z() * p.z()) - 1.0));
+
+        maxMagnitudeError = _ma(maxMagnitudeError, fabs(colors[i].w() - star.Vmag));
+
+        maxColorError = _ma(maxColorError, fabs(colors[i].x() - _clamp(0.f, 1.f, star.sRGB_R)));
+        maxColorError = _ma(maxColorError, fabs(colors[i].y() - _clamp(0.f, 1.f, star.sRGB_G)));
+        maxColorError = _ma(maxColorError, fabs(colors[i].z() - _clamp(0.f, 1.f, star.sRGB_B)));
+
+        // arcsec per year
+        const double pm[2] = { star.pmRA * 15.0 * 3600.0, star.pmDE * 3600.0 };
+        const double pmDecoded[2] = { decoded[i].pmRA * 15.0 * 3600.0, decoded[i].pmDE * 3600.0 };
+
+        for(int j = 0; j < 2; ++j)
+            if(fabs(pmDecoded[j] - pm[j]) > sqrt(fabs(pm[j]) * M) / 127.0 + M / (4.0 * 127.0 * 127.0) + 1e-5)
+                ++properMotionErrors;
+
+        osg::Vec4f position, color;
+        PackedStars::decode(packed[i], position, color, 5 + i);
+
+        if(position != p || color != colors[i])
+            ++batchVsScalar;
+        if(p.w() != static_cast<float>(5 + i))
+            ++indexErrors;
+    }
+
+    ASSERT_EQ(int, 1, maxAngle < 0.0025 ? 1 : 0);
+    ASSERT_AB(double, 0.0, maxLength, 1e-6);
+    ASSERT_EQ(int, 1, maxMagnitudeError <= 0.5 * magnitudeStep + 1e-5 ? 1 : 0);
+    ASSERT_EQ(int, 1, maxColorError <= 0.5 / 255.0 + 1e-6 ? 1 : 0);
+    ASSERT_EQ(int, 0, properMotionErrors);
+    ASSERT_EQ(int, 0, batchVsScalar);
+    ASSERT_EQ(int, 0, indexErrors);
+
+    // Check the full decoding of the direction (away from the poles, where 
+    // the right ascension is ill conditioned).
+
+    double maxDeError = 0.0;
+    double maxRaError = 0.0;
+
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+    {
+        maxDeError = _ma(maxDeError, fabs(decoded[i].DE - stars[i].DE));
+
+        if(fabs(stars[i].DE) > 80.f)
+            continue;
+
+        double d = fabs(decoded[i].RA - stars[i].RA);
+        d = _mi(d, 24.0 - d);
+
+        maxRaError = _ma(maxRaError, d * 15.0 * cos(stars[i].DE * 3.14159265358979323846 / 180.0));
+    }
+    ASSERT_EQ(int, 1, maxDeError < 0.0025 ? 1 : 0);
+    ASSERT_EQ(int, 1, maxRaError < 0.0025 ? 1 : 0);
+
+    // Check clamping out of range values.
+
+    BrightStars::s_BrightStar extreme(stars[0]);
+    extreme.Vmag = 40.f;
+    extreme.pmRA = -1.f;
+    extreme.sRGB_G = 1.5f;
+
+    PackedStars::t_packedStar clamped;
+    PackedStars::encode(&extreme, &clamped, 1);
+
+    ASSERT_EQ(int, 65535, clamped.magnitude);
+    ASSERT_EQ(int, -127, clamped.properMotion[0]);
+    ASSERT_EQ(int, 255, clamped.sRGB[1]);
+
+    // Check the file round trip and opening packed files as star catalogue.
+
+    ASSERT_EQ(bool, true, PackedStars::toFile(PACKED_FILE, packed));
+    ASSERT_EQ(bool, true, PackedStars::isPackedFile(PACKED_FILE));
+
+    PackedStars::t_packedStars read;
+    ASSERT_EQ(bool, true, PackedStars::fromFile(PACKED_FILE, read));
+    ASSERT_EQ(unsigned int, NUM_STARS, static_cast<unsigned int>(read.size()));
+
+    // a count beyond the file size is rejected without allocating it
+    {
+        std::fstream file(PACKED_FILE, std::ios::binary | std::ios::in | std::ios::out);
+
+        const unsigned int count(0xffffffff);
+        file.seekp(8 + 2 * sizeof(unsigned int)); // magic, version, endian
+        file.write(reinterpret_cast<const char*>(&count), sizeof(unsigned int));
+    }
+    ASSERT_EQ(bool, false, PackedStars::fromFile(PACKED_FILE, read));
+    ASSERT_EQ(int, 1, read.empty() ? 1 : 0);
+
+    ASSERT_EQ(bool, true, PackedStars::toFile(PACKED_FILE, packed));
+
+    osg::ref_ptr<StarCatalogue> catalogue(new StarCatalogue());
+    ASSERT_EQ(bool, true, catalogue->open(PACKED_FILE));
+    ASSERT_EQ(unsigned int, NUM_STARS, catalogue->numStars());
+    ASSERT_EQ(bool, false, catalogue->isMapped());
+
+    int catalogueMismatches = 0;
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+    {
+        osg::Vec4f position(positions[i]);
+        position[3] = static_cast<float>(i);
+
+        if(catalogue->positions()[i] != position || catalogue->colors()[i] != colors[i])
+            ++catalogueMismatches;
+    }
+    ASSERT_EQ(int, 0, catalogueMismatches);
+
+    catalogue = NULL;
+    remove(PACKED_FILE);
+
+    // Check the decoding throughput (loose bound, holds for debug builds).
+
+    const unsigned int repetitions = 64;
+
+    const osg::Timer_t t0 = osg::Timer::instance()->tick();
+    for(unsigned int i = 0; i < repetitions; ++i)
+        PackedStars::decode(&packed[0], &positions[0], &colors[0], NUM_STARS);
+    const double seconds = osg::Timer::instance()->delta_s(t0, osg::Timer::instance()->tick());
+
+    const double starsPerSecond = repetitions * NUM_STARS / _ma(seconds, 1e-9);
+    ASSERT_EQ(int, 1, starsPerSecond > 1e6 ? 1 : 0);
+
+    TEST_REPORT();
+}
@@ -0,0 +1,193 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_pagedstarcatalogue.h"
+
+#include "test.h"
+
+#include "osgHimmel/brightstars.h"
+#include "osgHimmel/starcatalogue.h"
+#include "osgHimmel/starskyindex.h"
+#include "osgHimmel/pagedstarcatalogue.h"
+#include "osgHimmel/random.h"
+#include "osgHimmel/mathmacros.h"
+
+#include <osg/ref_ptr>
+
+#include <fstream>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+
+using namespace osgHimmel;
+
+namespace
+{
+    const char *RAW_FILE   = "test_pagedstarcatalogue_raw.bin";
+    const char *PAGED_FILE = "test_pagedstarcatalogue.bin";
+
+    const unsigned int NUM_STARS(3000);
+}
+
+
+void test_pagedstarcatalogue()
+{
+    // Uniformly distributed stars, written as raw bright stars.
+
+    Random random(11);
+
+    std::vector<BrightStars::s_BrightStar> raw(NUM_STARS);
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+    {
+        BrightStars::s_BrightStar &star(raw[i]);
+        memset(&star, 0, sizeof(BrightStars::s_BrightStar));
+
+        star.Vmag = random.nextf(-1.5f, 10.f);
+        star.RA   = random.nextf(0.f, 24.f);
+        star.DE   = static_cast<float>(_deg(asin(random.nextf(-1.f, 1.f))));
+    }
+    {
+        std::ofstream out(RAW_FILE, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&raw[0]), NUM_STARS * sizeof(BrightStars::s_BrightStar));
+    }
+
+    osg::ref_ptr<StarCatalogue> catalogue = new StarCatalogue;
+    ASSERT_EQ(int, 1, catalogue->open(RAW_FILE) ? 1 : 0);
+
+    std::vector<float> tierLimits;
+    tierLimits.push_back(3.f);
+    tierLimits.push_back(6.f);
+
+    ASSERT_EQ(int, 0, PagedStarCatalogue::isPagedFile(RAW_FILE) ? 1 : 0);
+    ASSERT_EQ(int, 1, PagedStarCatalogue::toFile(PAGED_FILE, *catalogue, tierLimits, 2) ? 1 : 0);
+    ASSERT_EQ(int, 1, PagedStarCatalogue::isPagedFile(PAGED_FILE) ? 1 : 0);
+
+    osg::ref_ptr<PagedStarCatalogue> paged = new PagedStarCatalogue;
+    ASSERT_EQ(int, 1, paged->open(PAGED_FILE) ? 1 : 0);
+
+    ASSERT_EQ(unsigned int, NUM_STARS, paged->numStars());
+    ASSERT_EQ(unsigned int, 3, paged->numTiers());
+    ASSERT_EQ(unsigned int, 96 * 3, paged->numTiles());
+    ASSERT_EQ(unsigned int, NUM_STARS, paged->index()->getVisibleStarCount());
+    ASSERT_EQ(unsigned int, 0, paged->getResidentTileCount());
+
+    // Requesting stars up to magnitude 5 loads the first two tiers only.
+
+    paged->update(5.f);
+    paged->wait();
+    paged->update(5.f);
+
+    const std::vector<unsigned int> requested(paged->requestedTiles());
+
+    unsigned int drawable = 0;
+    int mismatches = 0;
+
+    for(unsigned int i = 0; i < requested.size(); ++i)
+    {
+        const unsigned int tile = requested[i];
+
+        if(tile % 3 == 2 || !paged->isResident(tile))
+            ++mismatches;
+        if(paged->positions(tile)->size() != paged->tileSize(tile))
+            ++mismatches;
+
+        // stars are in the tiles cell and tier, sorted by magnitude
+
+        const osg::Vec4Array &positions(*paged->positions(tile));
+        const osg::Vec4Array &colors(*paged->colors(tile));
+
+        for(unsigned int j = 0; j < positions.size(); ++j)
+        {
+            const osg::Vec3f p(positions[j][0], positions[j][1], positions[j][2]);
+            if(paged->index()->cell(p) != tile / 3)
+                ++mismatches;
+
+            const float m = colors[j][3];
+            if(m > (tile % 3 ? 6.f : 3.f) || (tile % 3 && m <= 3.f))
+                ++mismatches;
+            if(j && colors[j - 1][3] > m)
+                ++mismatches;
+            if(raw[static_cast<unsigned int>(positions[j][3])].Vmag != m)
+                ++mismatches;
+        }
+        drawable += paged->numStarsUpTo(tile, 5.f);
+    }
+    ASSERT_EQ(int, 0, mismatches);
+    ASSERT_EQ(unsigned int, requested.size(), paged->getResidentTileCount());
+    ASSERT_EQ(unsigned int, requested.size(), paged->getLoadCount());
+
+    unsigned int expected = 0;
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+        if(raw[i].Vmag <= 5.f)
+            ++expected;
+    ASSERT_EQ(unsigned int, expected, drawable);
+
+    // Without budget, tiles of cells that left the view are released.
+
+    paged->setMemoryBudget(0);
+
+    const osg::Vec3f zenith(0.f, 0.f, 1.f);
+    paged->index()->cull(zenith, static_cast<float>(_rad(5.0)), zenith, 0.f);
+
+    paged->update(5.f);
+    paged->wait();
+    paged->update(5.f);
+
+    ASSERT_EQ(int, 1, paged->requestedTiles().size() < requested.size() ? 1 : 0);
+
+    unsigned int bytes = 0;
+    for(unsigned int i = 0; i < paged->requestedTiles().size(); ++i)
+        bytes += paged->tileSize(paged->requestedTiles()[i]) * 2 * sizeof(osg::Vec4f);
+
+    ASSERT_EQ(unsigned int, paged->requestedTiles().size(), paged->getResidentTileCount());
+    ASSERT_EQ(unsigned int, bytes, paged->getResidentBytes());
+
+    paged->close();
+    ASSERT_EQ(unsigned int, 0, paged->numStars());
+
+    // Truncated files are rejected.
+
+    std::vector<char> file;
+    {
+        std::ifstream in(PAGED_FILE, std::ios::binary);
+        file.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out(PAGED_FILE, std::ios::binary);
+        out.write(&file[0], file.size() - 1);
+    }
+    ASSERT_EQ(int, 0, paged->open(PAGED_FILE) ? 1 : 0);
+
+    remove(RAW_FILE);
+    remove(PAGED_FILE);
+
+    TEST_REPORT();
+}
\ No newline at end of file
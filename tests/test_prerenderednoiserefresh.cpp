@@ -0,0 +1,183 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_prerenderednoiserefresh.h"
+
+#include "test.h"
+
+#include "osgHimmel/prerenderednoiserefresh.h"
+
+#include <osg/Camera>
+#include <osg/Group>
+
+#include <string>
+
+
+using namespace osgHimmel;
+
+namespace
+{
+    class TestRefresh : public PreRenderedNoiseRefresh
+    {
+    public:
+        TestRefresh(
+            osg::Group *preNoise
+        ,   const unsigned int texSize)
+        :   PreRenderedNoiseRefresh(preNoise, texSize)
+        {
+        }
+
+        using PreRenderedNoiseRefresh::changedVisibly;
+
+        const bool passEnabled() const
+        {
+            return m_camera->getNodeMask() != 0;
+        }
+
+        const int bandY() const
+        {
+            return static_cast<int>(m_camera->getViewport()->y());
+        }
+
+        const int bandHeight() const
+        {
+            return static_cast<int>(m_camera->getViewport()->height());
+        }
+    };
+}
+
+
+void test_prerenderednoiserefresh()
+{
+    osg::ref_ptr<osg::Group> preNoise = new osg::Group;
+    preNoise->addChild(new osg::Camera);
+
+    osg::ref_ptr<TestRefresh> refresh = new TestRefresh(preNoise.get(), 256);
+
+    const osg::Vec2f wind(0.001f, 0.f);
+    const osg::Vec2f calm(0.f, 0.f);
+
+    // The first update refreshes, unchanged inputs do not.
+
+    refresh->update(1.f, 0.5f, 0.5f, 0.f, wind);
+    ASSERT_EQ(bool, true, refresh->passEnabled());
+
+    refresh->update(1.f, 0.5f, 0.5f, 0.f, wind);
+    ASSERT_EQ(bool, false, refresh->passEnabled());
+    ASSERT_EQ(unsigned int, 2, refresh->getUpdateCount());
+    ASSERT_EQ(unsigned int, 1, refresh->getPassCount());
+
+    // Wind shifts the terms by 3.6 uv per hour, which is 3.6 * 0.12 * 256 
+    // texels of the fastest term. The default threshold is 0.25 texels.
+
+    ASSERT_EQ(bool, false, refresh->changedVisibly(1.001f, 0.5f, 0.5f, 0.f, wind));
+    ASSERT_EQ(bool, true,  refresh->changedVisibly(1.003f, 0.5f, 0.5f, 0.f, wind));
+
+    refresh->setThreshold(1.f);
+    ASSERT_EQ(bool, false, refresh->changedVisibly(1.003f, 0.5f, 0.5f, 0.f, wind));
+    refresh->setThreshold(0.25f);
+
+    ASSERT_EQ(bool, true, refresh->changedVisibly(1.f, 0.6f, 0.5f, 0.f, wind));
+    ASSERT_EQ(bool, true, refresh->changedVisibly(1.f, 0.5f, 0.4f, 0.f, wind));
+
+    // Evolution moves along the slices by 3600 * change * 0.16 * 4 slices 
+    // per hour for the fastest term, weighted like texels.
+
+    refresh->update(1.f, 0.5f, 0.5f, 1.f, calm);
+    refresh->update(1.f, 0.5f, 0.5f, 1.f, calm);
+
+    ASSERT_EQ(bool, false, refresh->passEnabled());
+
+    // the snapshot keeps the inputs of the last refresh
+    refresh->update(1.00005f, 0.5f, 0.5f, 1.f, calm);
+
+    ASSERT_EQ(float, 1.f, refresh->getTime());
+    ASSERT_EQ(float, 1.f, refresh->getChange());
+    ASSERT_EQ(float, 0.5f, refresh->getCoverage());
+    ASSERT_EQ(float, 0.f, refresh->getWind().x());
+    ASSERT_EQ(bool, false, refresh->changedVisibly(1.00005f, 0.5f, 0.5f, 1.f, calm));
+    ASSERT_EQ(bool, true,  refresh->changedVisibly(1.0002f,  0.5f, 0.5f, 1.f, calm));
+
+    // A refresh split into bands renders one band per update, covering the 
+    // texture once, with the inputs of its start.
+
+    refresh->setNumBands(4);
+
+    int covered = 0;
+    for(int i = 0; i < 4; ++i)
+    {
+        refresh->update(2.f + i, 0.5f, 0.5f, 1.f, wind);
+
+        ASSERT_EQ(bool, true, refresh->passEnabled());
+        ASSERT_EQ(int, covered, refresh->bandY());
+
+        covered += refresh->bandHeight();
+    }
+    ASSERT_EQ(int, 256, covered);
+
+    // the bands used the snapshot of the first, so the last inputs differ
+    ASSERT_EQ(bool, true, refresh->changedVisibly(5.f, 0.5f, 0.5f, 1.f, wind));
+
+    refresh->update(2.f, 0.5f, 0.5f, 1.f, wind);
+    ASSERT_EQ(bool, false, refresh->passEnabled());
+
+    // The rate limit defers refreshes, dirty enforces one.
+
+    refresh->setNumBands(1);
+    refresh->setMaxRefreshRate(1e-3f);
+
+    refresh->update(2.f, 0.5f, 0.5f, 1.f, wind);
+    ASSERT_EQ(bool, true, refresh->passEnabled());
+
+    const unsigned int passes = refresh->getPassCount();
+
+    refresh->update(3.f, 0.5f, 0.5f, 1.f, wind);
+    refresh->update(4.f, 0.5f, 0.5f, 1.f, wind);
+    ASSERT_EQ(bool, false, refresh->passEnabled());
+    ASSERT_EQ(unsigned int, passes, refresh->getPassCount());
+
+    refresh->dirty();
+    refresh->update(4.f, 0.5f, 0.5f, 1.f, wind);
+    ASSERT_EQ(bool, true, refresh->passEnabled());
+
+    refresh->setMaxRefreshRate(0.f);
+    refresh->update(5.f, 0.5f, 0.5f, 1.f, wind);
+    ASSERT_EQ(bool, true, refresh->passEnabled());
+
+    // The shader statements are generated from the terms.
+
+    const std::string glsl = PreRenderedNoiseRefresh::termsGlsl();
+
+    ASSERT_EQ(int, 1, glsl.find("n += 1.00000 * texture3D(noise0, vec3(uv * 1.00000 + m * 0.18000, t * 0.01000)).r;") 
+        != std::string::npos ? 1 : 0);
+    ASSERT_EQ(int, 1, glsl.find("texture3D(noise3, vec3(uv * 2.00000 + m * 0.10000, t * 0.16000))") 
+        != std::string::npos ? 1 : 0);
+
+    TEST_REPORT();
+}
@@ -0,0 +1,122 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_random.h"
+
+#include "test.h"
+
+#include "osgHimmel/random.h"
+
+#include <limits.h>
+
+
+using namespace osgHimmel;
+
+void test_random()
+{
+    // Known answers of Philox2x32-10 (first word), from the Random123 kat vectors.
+
+    ASSERT_EQ(unsigned int, 0xff1dae59, Random::philox(0x00000000, 0x00000000, 0x00000000));
+    ASSERT_EQ(unsigned int, 0x2c3f628b, Random::philox(0xffffffff, 0xffffffff, 0xffffffff));
+    ASSERT_EQ(unsigned int, 0xdd7ce038, Random::philox(0x243f6a88, 0x85a308d3, 0x13198a2e));
+
+    // Sequential draws equal the counter based ones, skipping jumps ahead, 
+    // and equal seeds reproduce the sequence.
+
+    Random a(42);
+    Random b(42);
+    Random c(42, 1);
+    Random d(43);
+
+    int mismatches = 0;
+    int collisions = 0;
+
+    for(unsigned int i = 0; i < 1000; ++i)
+    {
+        const unsigned int v = a.next();
+
+        if(v != b.at(i))
+            ++mismatches;
+        if(v == c.at(i) || v == d.at(i))
+            ++collisions;
+    }
+    ASSERT_EQ(int, 0, mismatches);
+    ASSERT_EQ(int, 0, collisions);
+
+    b.skip(1000);
+    ASSERT_EQ(unsigned int, a.next(), b.next());
+    ASSERT_EQ(unsigned int, 1001, b.counter());
+
+    // Ranges and uniformity.
+
+    Random r(7);
+
+    double sum = 0.0;
+    int outOfRange = 0;
+    int hits[5] = { 0, 0, 0, 0, 0 };
+
+    const int n = 100000;
+
+    for(int i = 0; i < n; ++i)
+    {
+        const float f = r.nextf(-1.f, 3.f);
+        const int k = r.nexti(-2, 2);
+
+        if(f < -1.f || f >= 3.f || k < -2 || k > 2)
+            ++outOfRange;
+        else
+            ++hits[k + 2];
+
+        sum += f;
+    }
+    ASSERT_EQ(int, 0, outOfRange);
+    ASSERT_AB(double, 1.0, sum / n, 0.02);
+
+    for(int i = 0; i < 5; ++i)
+        ASSERT_AB(double, 0.2, static_cast<double>(hits[i]) / n, 0.01);
+
+    // wide and full int ranges
+    int negative = 0;
+    for(int i = 0; i < 1000; ++i)
+    {
+        const int wide = r.nexti(-2000000000, 2000000000);
+        const int full = r.nexti(INT_MIN, INT_MAX);
+
+        if(wide < -2000000000 || wide > 2000000000)
+            ++outOfRange;
+        negative += full < 0 ? 1 : 0;
+    }
+    ASSERT_EQ(int, 0, outOfRange);
+    ASSERT_AB(double, 0.5, negative / 1000.0, 0.1);
+
+    ASSERT_EQ(float, 0.f, Random::toUnit(0));
+    ASSERT_EQ(int, 1, Random::toUnit(0xffffffff) < 1.f ? 1 : 0);
+
+    TEST_REPORT();
+}
\ No newline at end of file
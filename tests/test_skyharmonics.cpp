@@ -0,0 +1,142 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_skyharmonics.h"
+
+#include "test.h"
+
+#include "osgHimmel/skyharmonics.h"
+#include "osgHimmel/mathmacros.h"
+
+#include <math.h>
+
+
+using namespace osgHimmel;
+
+namespace
+{
+    // Projects analytic radiance instead of the atmosphere.
+
+    class TestHarmonics : public SkyHarmonics
+    {
+    public:
+        TestHarmonics(const unsigned int strata)
+        :   SkyHarmonics(strata)
+        {
+        }
+
+        void projectConstant(const osg::Vec3f &radiance)
+        {
+            for(unsigned int i = 0; i < numSamples(); ++i)
+            {
+                m_r[i] = radiance[0];
+                m_g[i] = radiance[1];
+                m_b[i] = radiance[2];
+            }
+            projectSamples();
+        }
+
+        // Clamped cosine around z, scaled per channel.
+        void projectCosineLobe(const osg::Vec3f &radiance)
+        {
+            for(unsigned int i = 0; i < numSamples(); ++i)
+            {
+                const float c = _ma(0.f, m_z[i]);
+
+                m_r[i] = radiance[0] * c;
+                m_g[i] = radiance[1] * c;
+                m_b[i] = radiance[2] * c;
+            }
+            projectSamples();
+        }
+    };
+}
+
+
+void test_skyharmonics()
+{
+    // more than the default strata, to keep the integration error small
+    TestHarmonics harmonics(64);
+
+    const osg::Vec3f radiance(1.f, 0.5f, 0.25f);
+
+    // Constant radiance projects to l0 only, Y0 * 4PI, and gives 
+    // PI * radiance irradiance for every normal.
+
+    harmonics.projectConstant(radiance);
+
+    const float c0 = static_cast<float>(0.282095 * _PI4);
+
+    for(int i = 0; i < 3; ++i)
+        ASSERT_AB(float, c0 * radiance[i], harmonics.getCoefficient(0)[i], 1e-3f);
+
+    for(unsigned int j = 1; j < SkyHarmonics::NUM_COEFFICIENTS; ++j)
+        ASSERT_AB(float, 0.f, harmonics.getCoefficient(j).length(), 2e-2f);
+
+    const osg::Vec3f up = harmonics.irradiance(osg::Vec3f(0.f, 0.f, 1.f));
+    const osg::Vec3f side = harmonics.irradiance(osg::Vec3f(1.f, 1.f, 0.f));
+
+    for(int i = 0; i < 3; ++i)
+    {
+        ASSERT_AB(float, static_cast<float>(_PI) * radiance[i], up[i], 5e-2f);
+        ASSERT_AB(float, static_cast<float>(_PI) * radiance[i], side[i], 5e-2f);
+    }
+
+    // The clamped cosine around z projects to the zonal coefficients 
+    // Y0 PI, Y1 2PI/3 and Y2 PI/4 (with Y the normalization of m = 0).
+
+    harmonics.projectCosineLobe(radiance);
+
+    const float z0 = static_cast<float>(0.282095 * _PI);
+    const float z1 = static_cast<float>(0.488603 * _PI * 2.0 / 3.0);
+    const float z2 = static_cast<float>(0.315392 * _PI * 0.5);
+
+    for(int i = 0; i < 3; ++i)
+    {
+        ASSERT_AB(float, z0 * radiance[i], harmonics.getCoefficient(0)[i], 1e-2f);
+        ASSERT_AB(float, z1 * radiance[i], harmonics.getCoefficient(2)[i], 1e-2f);
+        ASSERT_AB(float, z2 * radiance[i], harmonics.getCoefficient(6)[i], 1e-2f);
+    }
+
+    // non zonal coefficients vanish
+    ASSERT_AB(float, 0.f, harmonics.getCoefficient(1).length(), 1e-2f);
+    ASSERT_AB(float, 0.f, harmonics.getCoefficient(3).length(), 1e-2f);
+    ASSERT_AB(float, 0.f, harmonics.getCoefficient(5).length(), 1e-2f);
+
+    // Irradiance of the lobe facing it is PI (1/4 + 1/3 + 5/64) for the L2 
+    // approximation (2PI/3 exact), facing away it is clamped to zero.
+
+    const osg::Vec3f facing = harmonics.irradiance(osg::Vec3f(0.f, 0.f, 1.f));
+    const osg::Vec3f away = harmonics.irradiance(osg::Vec3f(0.f, 0.f, -1.f));
+
+    ASSERT_AB(float, static_cast<float>(_PI * (1.0 / 4.0 + 1.0 / 3.0 + 5.0 / 64.0)), facing[0], 5e-2f);
+    ASSERT_AB(float, 0.f, away[0], 1e-2f);
+
+    TEST_REPORT();
+}
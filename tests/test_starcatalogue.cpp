@@ -0,0 +1,196 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_starcatalogue.h"
+
+#include "test.h"
+
+#include "osgHimmel/brightstars.h"
+#include "osgHimmel/starcatalogue.h"
+
+#include <osg/ref_ptr>
+
+#include <fstream>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+
+using namespace osgHimmel;
+
+namespace
+{
+    const char *RAW_FILE       = "test_starcatalogue_raw.bin";
+    const char *RAW_COPY_FILE  = "test_starcatalogue_raw_copy.bin";
+    const char *CATALOGUE_FILE = "test_starcatalogue.bin";
+
+    const unsigned int NUM_STARS(37);
+}
+
+
+void test_starcatalogue()
+{
+    // Write raw bright stars without header.
+
+    std::vector<BrightStars::s_BrightStar> raw(NUM_STARS);
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+    {
+        BrightStars::s_BrightStar &star(raw[i]);
+
+        star.Vmag   = -1.5f + i * 0.2f;
+        star.RA     = i * 24.f / NUM_STARS;
+        star.DE     = -89.f + i * 178.f / NUM_STARS;
+        star.pmRA   = i * 0.001f;
+        star.pmDE   = i * -0.002f;
+        star.sRGB_R = 0.5f + i * 0.01f;
+        star.sRGB_G = 0.9f;
+        star.sRGB_B = 1.2f - i * 0.01f;
+    }
+    {
+        std::ofstream out(RAW_FILE, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&raw[0]), NUM_STARS * sizeof(BrightStars::s_BrightStar));
+    }
+
+    // Round trip of the raw format writes the stars, not the pointer.
+
+    BrightStars bs(RAW_FILE);
+    ASSERT_EQ(unsigned int, NUM_STARS, bs.numStars());
+    ASSERT_EQ(unsigned int, NUM_STARS, bs.toFile(RAW_COPY_FILE));
+
+    BrightStars copy(RAW_COPY_FILE);
+    ASSERT_EQ(unsigned int, NUM_STARS, copy.numStars());
+    ASSERT_EQ(int, 0, memcmp(&raw[0], copy.stars(), NUM_STARS * sizeof(BrightStars::s_BrightStar)));
+
+    // A raw file with a partial star is rejected.
+    {
+        std::ofstream out(RAW_COPY_FILE, std::ios::binary | std::ios::app);
+        out.write("x", 1);
+    }
+    ASSERT_EQ(unsigned int, 0, copy.fromFile(RAW_COPY_FILE));
+
+    // Raw files are converted, catalogue files are mapped as is.
+
+    osg::ref_ptr<StarCatalogue> converted = new StarCatalogue;
+    ASSERT_EQ(int, 1, converted->open(RAW_FILE) ? 1 : 0);
+    ASSERT_EQ(int, 0, converted->isMapped() ? 1 : 0);
+    ASSERT_EQ(unsigned int, NUM_STARS, converted->numStars());
+    ASSERT_EQ(int, 1, converted->toFile(CATALOGUE_FILE) ? 1 : 0);
+
+    osg::ref_ptr<StarCatalogue> mapped = new StarCatalogue;
+    ASSERT_EQ(int, 1, mapped->open(CATALOGUE_FILE) ? 1 : 0);
+    ASSERT_EQ(int, 1, mapped->isMapped() ? 1 : 0);
+    ASSERT_EQ(unsigned int, NUM_STARS, mapped->numStars());
+
+    ASSERT_EQ(int, 0, memcmp(converted->positions(), mapped->positions(), NUM_STARS * sizeof(osg::Vec4f)));
+    ASSERT_EQ(int, 0, memcmp(converted->colors(), mapped->colors(), NUM_STARS * sizeof(osg::Vec4f)));
+
+    int mismatches = 0;
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+    {
+        const osg::Vec4f &p(mapped->positions()[i]);
+        const osg::Vec4f &c(mapped->colors()[i]);
+
+        const float length = sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+
+        if(fabs(length - 1.f) > 1e-5f || p[3] != static_cast<float>(i))
+            ++mismatches;
+        if(c[0] != raw[i].sRGB_R || c[1] != raw[i].sRGB_G || c[2] != raw[i].sRGB_B || c[3] != raw[i].Vmag)
+            ++mismatches;
+    }
+    ASSERT_EQ(int, 0, mismatches);
+
+    // Sorting by magnitude keeps the indices and survives a round trip.
+
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+        raw[i].Vmag = static_cast<float>((i * 7) % 5); // 0, 2, 4, 1, 3, ...
+    {
+        std::ofstream out(RAW_FILE, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&raw[0]), NUM_STARS * sizeof(BrightStars::s_BrightStar));
+    }
+    osg::ref_ptr<StarCatalogue> sorted = new StarCatalogue;
+    ASSERT_EQ(int, 1, sorted->open(RAW_FILE) ? 1 : 0);
+    ASSERT_EQ(int, 0, sorted->isSortedByMagnitude() ? 1 : 0);
+
+    sorted->sortByMagnitude();
+    ASSERT_EQ(int, 1, sorted->isSortedByMagnitude() ? 1 : 0);
+
+    int unordered = 0;
+    for(unsigned int i = 1; i < NUM_STARS; ++i)
+    {
+        const osg::Vec4f &c0(sorted->colors()[i - 1]);
+        const osg::Vec4f &c1(sorted->colors()[i]);
+
+        if(c0[3] > c1[3] || (c0[3] == c1[3] && sorted->positions()[i - 1][3] > sorted->positions()[i][3]))
+            ++unordered;
+        if(raw[static_cast<unsigned int>(sorted->positions()[i][3])].Vmag != c1[3])
+            ++unordered;
+    }
+    ASSERT_EQ(int, 0, unordered);
+
+    ASSERT_EQ(unsigned int,  0, sorted->numStarsUpTo(-0.5f));
+    ASSERT_EQ(unsigned int,  8, sorted->numStarsUpTo(0.f));
+    ASSERT_EQ(unsigned int, 15, sorted->numStarsUpTo(1.5f));
+    ASSERT_EQ(unsigned int, NUM_STARS, sorted->numStarsUpTo(4.f));
+
+    ASSERT_EQ(int, 1, sorted->toFile(CATALOGUE_FILE) ? 1 : 0);
+    ASSERT_EQ(int, 1, mapped->open(CATALOGUE_FILE) ? 1 : 0);
+    ASSERT_EQ(int, 1, mapped->isSortedByMagnitude() ? 1 : 0);
+    ASSERT_EQ(unsigned int, 15, mapped->numStarsUpTo(1.5f));
+
+    mapped->close();
+    ASSERT_EQ(unsigned int, 0, mapped->numStars());
+
+    // Truncated catalogues and other versions are rejected.
+
+    std::vector<char> file;
+    {
+        std::ifstream in(CATALOGUE_FILE, std::ios::binary);
+        file.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out(CATALOGUE_FILE, std::ios::binary);
+        out.write(&file[0], file.size() - 1);
+    }
+    ASSERT_EQ(int, 0, mapped->open(CATALOGUE_FILE) ? 1 : 0);
+
+    file[8] = 2; // version
+    {
+        std::ofstream out(CATALOGUE_FILE, std::ios::binary);
+        out.write(&file[0], file.size());
+    }
+    ASSERT_EQ(int, 0, mapped->open(CATALOGUE_FILE) ? 1 : 0);
+    ASSERT_EQ(unsigned int, 0, mapped->numStars());
+
+    remove(RAW_FILE);
+    remove(RAW_COPY_FILE);
+    remove(CATALOGUE_FILE);
+
+    TEST_REPORT();
+}
\ No newline at end of file
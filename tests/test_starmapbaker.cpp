@@ -0,0 +1,187 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_starmapbaker.h"
+
+#include "test.h"
+
+#include "osgHimmel/brightstars.h"
+#include "osgHimmel/starcatalogue.h"
+#include "osgHimmel/starmapbaker.h"
+#include "osgHimmel/random.h"
+#include "osgHimmel/mathmacros.h"
+
+#include <osg/ref_ptr>
+
+#include <fstream>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+
+using namespace osgHimmel;
+
+namespace
+{
+    const char *RAW_FILE = "test_starmapbaker_raw.bin";
+
+    // odd, so that the face centers are texel centers
+    const unsigned int SIZE(33);
+
+    osg::ref_ptr<StarCatalogue> createCatalogue(const std::vector<BrightStars::s_BrightStar> &raw)
+    {
+        {
+            std::ofstream out(RAW_FILE, std::ios::binary);
+            out.write(reinterpret_cast<const char*>(&raw[0]), raw.size() * sizeof(BrightStars::s_BrightStar));
+        }
+        osg::ref_ptr<StarCatalogue> catalogue = new StarCatalogue;
+        catalogue->open(RAW_FILE);
+
+        remove(RAW_FILE);
+        return catalogue;
+    }
+
+    // Sum of the faces flux, i.e., radiances times texel solid angles.
+
+    const double flux(
+        const StarMapBaker &baker
+    ,   const unsigned int channel)
+    {
+        double sum = 0.0;
+
+        for(unsigned int f = 0; f < 6; ++f)
+        for(unsigned int j = 0; j < SIZE; ++j)
+        for(unsigned int i = 0; i < SIZE; ++i)
+        {
+            const float u = 2.f * (i + 0.5f) / SIZE - 1.f;
+            const float v = 2.f * (j + 0.5f) / SIZE - 1.f;
+
+            const float r2 = 1.f + u * u + v * v;
+            sum += baker.face(f)[(j * SIZE + i) * 3 + channel] / (r2 * sqrt(r2));
+        }
+        return sum;
+    }
+}
+
+
+void test_starmapbaker()
+{
+    // A single star at the celestial pole, of the reference magnitude.
+
+    std::vector<BrightStars::s_BrightStar> raw(1);
+    memset(&raw[0], 0, sizeof(BrightStars::s_BrightStar));
+
+    raw[0].Vmag = StarMapBaker::defaultReferenceMagnitude();
+    raw[0].DE = 90.f;
+    raw[0].sRGB_R = 1.f;
+    raw[0].sRGB_G = 0.5f;
+    raw[0].sRGB_B = 0.25f;
+
+    osg::ref_ptr<StarCatalogue> pole = createCatalogue(raw);
+    ASSERT_EQ(unsigned int, 1, pole->numStars());
+
+    StarMapBaker baker(SIZE);
+    ASSERT_EQ(unsigned int, 1, baker.bake(*pole));
+
+    // The peak is at the center of the face of the poles major axis.
+
+    const osg::Vec4f &p(pole->positions()[0]);
+
+    unsigned int axis = 0;
+    for(unsigned int i = 1; i < 3; ++i)
+        if(fabs(p[i]) > fabs(p[axis]))
+            axis = i;
+
+    const unsigned int face = axis * 2 + (p[axis] < 0.f ? 1 : 0);
+
+    unsigned int peak = 0;
+    for(unsigned int i = 1; i < SIZE * SIZE; ++i)
+        if(baker.face(face)[i * 3] > baker.face(face)[peak * 3])
+            peak = i;
+
+    ASSERT_EQ(unsigned int, (SIZE / 2) * SIZE + SIZE / 2, peak);
+
+    // The flux of the star is kept (and its color).
+
+    ASSERT_AB(double, 1.0, flux(baker, 0), 1e-4);
+    ASSERT_AB(double, 0.5, flux(baker, 1), 1e-4);
+    ASSERT_AB(double, 0.25, flux(baker, 2), 1e-4);
+
+    // Stars out of the magnitude range are ignored.
+
+    baker.setMagnitudeRange(raw[0].Vmag, 20.f);
+    ASSERT_EQ(unsigned int, 0, baker.bake(*pole));
+    ASSERT_AB(double, 0.0, flux(baker, 0), 1e-8);
+
+    // Random stars are baked the same on any number of threads.
+
+    Random random(7);
+
+    raw.resize(2000);
+    for(unsigned int i = 0; i < raw.size(); ++i)
+    {
+        BrightStars::s_BrightStar &star(raw[i]);
+        memset(&star, 0, sizeof(BrightStars::s_BrightStar));
+
+        star.Vmag = random.nextf(-1.5f, 10.f);
+        star.RA   = random.nextf(0.f, 24.f);
+        star.DE   = static_cast<float>(_deg(asin(random.nextf(-1.f, 1.f))));
+
+        star.sRGB_R = random.nextf(0.5f, 1.f);
+        star.sRGB_G = random.nextf(0.5f, 1.f);
+        star.sRGB_B = random.nextf(0.5f, 1.f);
+    }
+    osg::ref_ptr<StarCatalogue> catalogue = createCatalogue(raw);
+
+    unsigned int expected = 0;
+    for(unsigned int i = 0; i < raw.size(); ++i)
+        if(raw[i].Vmag > 4.f && raw[i].Vmag <= 8.f)
+            ++expected;
+
+    StarMapBaker single(SIZE);
+    single.setMagnitudeRange(4.f, 8.f);
+    single.setNumThreads(1);
+
+    StarMapBaker multi(SIZE);
+    multi.setMagnitudeRange(4.f, 8.f);
+    multi.setNumThreads(4);
+
+    ASSERT_EQ(unsigned int, expected, single.bake(*catalogue));
+    ASSERT_EQ(unsigned int, expected, multi.bake(*catalogue));
+
+    int mismatches = 0;
+    for(unsigned int f = 0; f < 6; ++f)
+        if(memcmp(single.face(f), multi.face(f), SIZE * SIZE * 3 * sizeof(float)))
+            ++mismatches;
+
+    ASSERT_EQ(int, 0, mismatches);
+
+    TEST_REPORT();
+}
\ No newline at end of file
@@ -0,0 +1,181 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_starquery.h"
+
+#include "test.h"
+
+#include "osgHimmel/brightstars.h"
+#include "osgHimmel/starcatalogue.h"
+#include "osgHimmel/starquery.h"
+#include "osgHimmel/random.h"
+#include "osgHimmel/mathmacros.h"
+
+#include <osg/ref_ptr>
+#include <osg/Matrix>
+
+#include <fstream>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+
+using namespace osgHimmel;
+
+namespace
+{
+    const char *RAW_FILE = "test_starquery_raw.bin";
+
+    const unsigned int NUM_STARS(3000);
+
+
+    // Compares a query result with the expected stars (by index) and checks 
+    // the order and coordinates.
+
+    const int mismatches(
+        const StarQuery::t_stars &stars
+    ,   const std::vector<bool> &expected)
+    {
+        int mismatches = 0;
+
+        for(unsigned int i = 0; i < stars.size(); ++i)
+        {
+            const StarQuery::t_star &star(stars[i]);
+
+            if(!expected[star.index])
+                ++mismatches;
+            if(i && stars[i - 1].magnitude > star.magnitude)
+                ++mismatches;
+
+            if(fabs(sin(_rad(star.altitude)) - star.direction.z()) > 1e-4f)
+                ++mismatches;
+            if(star.azimuth < 0.f || star.azimuth >= 360.f)
+                ++mismatches;
+        }
+        return mismatches;
+    }
+
+    const unsigned int count(const std::vector<bool> &expected)
+    {
+        unsigned int count = 0;
+        for(unsigned int i = 0; i < expected.size(); ++i)
+            if(expected[i])
+                ++count;
+
+        return count;
+    }
+}
+
+
+void test_starquery()
+{
+    Random random(13);
+
+    std::vector<BrightStars::s_BrightStar> raw(NUM_STARS);
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+    {
+        BrightStars::s_BrightStar &star(raw[i]);
+        memset(&star, 0, sizeof(BrightStars::s_BrightStar));
+
+        star.Vmag = random.nextf(-1.5f, 8.f);
+        star.RA   = random.nextf(0.f, 24.f);
+        star.DE   = static_cast<float>(_deg(asin(random.nextf(-1.f, 1.f))));
+    }
+    {
+        std::ofstream out(RAW_FILE, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&raw[0]), NUM_STARS * sizeof(BrightStars::s_BrightStar));
+    }
+
+    osg::ref_ptr<StarQuery> query = new StarQuery;
+    ASSERT_EQ(int, 1, query->open(RAW_FILE) ? 1 : 0);
+    ASSERT_EQ(unsigned int, NUM_STARS, query->numStars());
+
+    // unsorted reference positions
+    osg::ref_ptr<StarCatalogue> catalogue = new StarCatalogue;
+    catalogue->open(RAW_FILE);
+
+    remove(RAW_FILE);
+
+    const osg::Matrixf R(osg::Matrixf::rotate(_rad(40.0), 1.0, 0.3, 0.2));
+    query->setEquToHorTransform(R);
+
+    std::vector<osg::Vec3f> horizontal(NUM_STARS);
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+    {
+        const osg::Vec4f &p(catalogue->positions()[i]);
+        horizontal[i] = osg::Matrixf::transform3x3(R, osg::Vec3f(p[0], p[1], p[2]));
+    }
+
+    // All stars above 10 degrees brighter than magnitude 3.
+
+    std::vector<bool> expected(NUM_STARS);
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+        expected[i] = raw[i].Vmag <= 3.f && horizontal[i].z() >= sin(_rad(10.0));
+
+    StarQuery::t_stars stars;
+    ASSERT_EQ(unsigned int, count(expected), query->band(10.f, 90.f, 3.f, stars));
+    ASSERT_EQ(int, 0, mismatches(stars, expected));
+
+    // Horizon band, appended to the previous result.
+
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+        expected[i] = raw[i].Vmag <= 6.f 
+            && horizontal[i].z() >= sin(_rad(-5.0)) && horizontal[i].z() <= sin(_rad(5.0));
+
+    const unsigned int found = static_cast<unsigned int>(stars.size());
+
+    ASSERT_EQ(unsigned int, count(expected), query->band(-5.f, 5.f, 6.f, stars));
+    ASSERT_EQ(unsigned int, found + count(expected), stars.size());
+
+    stars.erase(stars.begin(), stars.begin() + found);
+    ASSERT_EQ(int, 0, mismatches(stars, expected));
+
+    // Cone of 20 degrees around a direction in the north east.
+
+    osg::Vec3f axis(1.f, 1.f, 0.5f);
+    axis.normalize();
+
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+        expected[i] = raw[i].Vmag <= 5.f && horizontal[i] * axis >= cos(_rad(20.0));
+
+    stars.clear();
+    ASSERT_EQ(unsigned int, count(expected), query->cone(osg::Vec3f(2.f, 2.f, 1.f), 20.f, 5.f, stars));
+    ASSERT_EQ(int, 0, mismatches(stars, expected));
+
+    // Azimuth is measured from north over east.
+
+    for(unsigned int i = 0; i < stars.size(); ++i)
+        ASSERT_AB(float, 45.f, stars[i].azimuth, 30.f);
+
+    stars.clear();
+    ASSERT_EQ(unsigned int, 0, query->band(20.f, 10.f, 8.f, stars));
+
+    TEST_REPORT();
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_stars.h"
+
+#include "test.h"
+
+#include "osgHimmel/stars.h"
+#include "osgHimmel/mathmacros.h"
+
+#include <vector>
+#include <math.h>
+
+
+using namespace osgHimmel;
+
+namespace
+{
+    const float maxDifference(
+        const osg::Vec3f &a
+    ,   const osg::Vec3f &b)
+    {
+        return _ma(_ma(fabs(a[0] - b[0]), fabs(a[1] - b[1])), fabs(a[2] - b[2]));
+    }
+}
+
+
+void test_stars()
+{
+    // Hotter stars are bluer.
+
+    const osg::Vec3f red  = Stars::sRgbColor(static_cast<t_longf>(3000.0));
+    const osg::Vec3f sun  = Stars::sRgbColor(static_cast<t_longf>(5800.0));
+    const osg::Vec3f blue = Stars::sRgbColor(static_cast<t_longf>(20000.0));
+
+    ASSERT_EQ(int, 1, red[2] / red[0] < sun[2] / sun[0] ? 1 : 0);
+    ASSERT_EQ(int, 1, sun[2] / sun[0] < blue[2] / blue[0] ? 1 : 0);
+
+    ASSERT_AB(float, 1.f, sun[1], 0.05f);
+
+    // The table matches the exact chain over the color indices of the 
+    // catalogue (and the temperature range at its ends).
+
+    ASSERT_AB(float, 0.f, maxDifference(Stars::sRgbColor(Stars::minTemperature())
+        , Stars::sRgbColorFromTable(Stars::minTemperature())), 1e-4f);
+    ASSERT_AB(float, 0.f, maxDifference(Stars::sRgbColor(Stars::maxTemperature())
+        , Stars::sRgbColorFromTable(Stars::maxTemperature())), 1e-4f);
+
+    std::vector<float> BtoV;
+    for(float bv = -0.4f; bv <= 2.5f; bv += 0.001f)
+        BtoV.push_back(bv);
+
+    std::vector<osg::Vec3f> colors(BtoV.size());
+    Stars::sRgbColorsFromBV(&BtoV[0], &colors[0], static_cast<unsigned int>(BtoV.size()));
+
+    float maxError = 0.f;
+    int mismatches = 0;
+
+    for(unsigned int i = 0; i < BtoV.size(); ++i)
+    {
+        maxError = _ma(maxError, maxDifference(Stars::sRgbColorFromBV(BtoV[i]), colors[i]));
+
+        const osg::Vec3f table = Stars::sRgbColorFromTable(Stars::tempratureFromBV(BtoV[i]));
+        if(maxDifference(table, colors[i]) > 1e-6f)
+            ++mismatches;
+    }
+    ASSERT_AB(float, 0.f, maxError, 1e-3f);
+    ASSERT_EQ(int, 0, mismatches);
+
+    // Temperatures out of range are clamped, even for B-V below -0.56.
+
+    ASSERT_AB(float, 0.f, maxDifference(Stars::sRgbColor(Stars::maxTemperature())
+        , Stars::sRgbColorFromBV(-1.0)), 1e-6f);
+    ASSERT_AB(float, 0.f, maxDifference(Stars::sRgbColorFromTable(Stars::maxTemperature())
+        , Stars::sRgbColorFromTable(100000.0)), 1e-6f);
+    ASSERT_AB(float, 0.f, maxDifference(Stars::sRgbColorFromTable(Stars::minTemperature())
+        , Stars::sRgbColorFromTable(1000.0)), 1e-6f);
+
+    TEST_REPORT();
+}
\ No newline at end of file
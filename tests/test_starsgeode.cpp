@@ -0,0 +1,172 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_starsgeode.h"
+
+#include "test.h"
+
+#include "osgHimmel/brightstars.h"
+#include "osgHimmel/starsgeode.h"
+#include "osgHimmel/random.h"
+#include "osgHimmel/mathmacros.h"
+
+#include <osg/ref_ptr>
+#include <osg/Geometry>
+#include <osg/Program>
+#include <osg/PointSprite>
+
+#include <fstream>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+
+using namespace osgHimmel;
+
+namespace
+{
+    const char *RAW_FILE = "test_starsgeode_raw.bin";
+
+    const unsigned int NUM_STARS(500);
+
+
+    const unsigned int numShaders(
+        const StarsGeode &stars
+    ,   const osg::Shader::Type type)
+    {
+        const osg::Program *program = dynamic_cast<const osg::Program*>(
+            stars.getStateSet()->getAttribute(osg::StateAttribute::PROGRAM));
+
+        unsigned int count = 0;
+        for(unsigned int i = 0; i < program->getNumShaders(); ++i)
+            if(program->getShader(i)->getType() == type)
+                ++count;
+
+        return count;
+    }
+
+    const bool hasPointSprites(const StarsGeode &stars)
+    {
+        return stars.getStateSet()->getTextureAttribute(0, osg::StateAttribute::POINTSPRITE) != NULL
+            && (stars.getStateSet()->getMode(GL_VERTEX_PROGRAM_POINT_SIZE) & osg::StateAttribute::ON);
+    }
+
+    // Every star is a single point, drawn by one range per sky cell.
+
+    const int checkDrawables(const StarsGeode &stars)
+    {
+        int mismatches = 0;
+
+        if(stars.getNumDrawables() != 1)
+            return 1;
+
+        const osg::Geometry *g = stars.getDrawable(0)->asGeometry();
+        if(g->getVertexArray()->getNumElements() != NUM_STARS)
+            ++mismatches;
+        if(g->getNumPrimitiveSets() != stars.index()->numCells())
+            ++mismatches;
+
+        unsigned int count = 0;
+        for(unsigned int i = 0; i < g->getNumPrimitiveSets(); ++i)
+        {
+            const osg::DrawArrays *da = dynamic_cast<const osg::DrawArrays*>(g->getPrimitiveSet(i));
+            if(!da || da->getMode() != osg::PrimitiveSet::POINTS)
+                ++mismatches;
+            else
+                count += da->getCount();
+        }
+        if(count != NUM_STARS)
+            ++mismatches;
+
+        return mismatches;
+    }
+}
+
+
+void test_starsgeode()
+{
+    Random random(5);
+
+    std::vector<BrightStars::s_BrightStar> raw(NUM_STARS);
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+    {
+        BrightStars::s_BrightStar &star(raw[i]);
+        memset(&star, 0, sizeof(BrightStars::s_BrightStar));
+
+        star.Vmag = random.nextf(-1.5f, 8.f);
+        star.RA   = random.nextf(0.f, 24.f);
+        star.DE   = static_cast<float>(_deg(asin(random.nextf(-1.f, 1.f))));
+    }
+    {
+        std::ofstream out(RAW_FILE, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&raw[0]), NUM_STARS * sizeof(BrightStars::s_BrightStar));
+    }
+
+    // Geometry shader expansion (default).
+
+    osg::ref_ptr<StarsGeode> stars = new StarsGeode(RAW_FILE);
+
+    ASSERT_EQ(int, StarsGeode::EM_GeometryShader, stars->getExpansionMode());
+    ASSERT_EQ(int, 0, checkDrawables(*stars));
+
+    ASSERT_EQ(unsigned int, 1, numShaders(*stars, osg::Shader::VERTEX));
+    ASSERT_EQ(unsigned int, 1, numShaders(*stars, osg::Shader::GEOMETRY));
+    ASSERT_EQ(unsigned int, 1, numShaders(*stars, osg::Shader::FRAGMENT));
+    ASSERT_EQ(int, 0, hasPointSprites(*stars) ? 1 : 0);
+
+    // Point sprites keep the drawables but drop the geometry shader.
+
+    stars->setExpansionMode(StarsGeode::EM_PointSprites);
+
+    ASSERT_EQ(int, StarsGeode::EM_PointSprites, stars->getExpansionMode());
+    ASSERT_EQ(int, 0, checkDrawables(*stars));
+
+    ASSERT_EQ(unsigned int, 1, numShaders(*stars, osg::Shader::VERTEX));
+    ASSERT_EQ(unsigned int, 0, numShaders(*stars, osg::Shader::GEOMETRY));
+    ASSERT_EQ(unsigned int, 1, numShaders(*stars, osg::Shader::FRAGMENT));
+    ASSERT_EQ(int, 1, hasPointSprites(*stars) ? 1 : 0);
+
+    // ... and switching back restores it.
+
+    stars->setExpansionMode(StarsGeode::EM_GeometryShader);
+
+    ASSERT_EQ(unsigned int, 1, numShaders(*stars, osg::Shader::GEOMETRY));
+    ASSERT_EQ(int, 0, hasPointSprites(*stars) ? 1 : 0);
+
+    osg::ref_ptr<StarsGeode> sprites = new StarsGeode(RAW_FILE, StarsGeode::EM_PointSprites);
+
+    ASSERT_EQ(int, 0, checkDrawables(*sprites));
+    ASSERT_EQ(unsigned int, 0, numShaders(*sprites, osg::Shader::GEOMETRY));
+    ASSERT_EQ(int, 1, hasPointSprites(*sprites) ? 1 : 0);
+
+    remove(RAW_FILE);
+
+    TEST_REPORT();
+}
\ No newline at end of file
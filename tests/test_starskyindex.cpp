@@ -0,0 +1,213 @@
+
+// Copyright (c) 2011-2012, Daniel Mller <dm@g4t3.de>
+// Computer Graphics Systems Group at the Hasso-Plattner-Institute, Germany
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are met:
+//   * Redistributions of source code must retain the above copyright notice, 
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright 
+//     notice, this list of conditions and the following disclaimer in the 
+//     documentation and/or other materials provided with the distribution.
+//   * Neither the name of the Computer Graphics Systems Group at the 
+//     Hasso-Plattner-Institute (HPI), Germany nor the names of its 
+//     contributors may be used to endorse or promote products derived from 
+//     this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "test_starskyindex.h"
+
+#include "test.h"
+
+#include "osgHimmel/brightstars.h"
+#include "osgHimmel/starcatalogue.h"
+#include "osgHimmel/starskyindex.h"
+#include "osgHimmel/random.h"
+#include "osgHimmel/mathmacros.h"
+
+#include <osg/ref_ptr>
+
+#include <fstream>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+
+using namespace osgHimmel;
+
+namespace
+{
+    const char *RAW_FILE = "test_starskyindex_raw.bin";
+    const char *CATALOGUE_FILE = "test_starskyindex.bin";
+
+    const unsigned int NUM_STARS(2000);
+
+
+    class ConstantMargin : public StarSkyIndex::Margin
+    {
+    public:
+        ConstantMargin(const float margin)
+        :   m_margin(margin)
+        {
+        }
+
+        virtual const float operator()(const float) const
+        {
+            return m_margin;
+        }
+
+    protected:
+        const float m_margin;
+    };
+}
+
+
+void test_starskyindex()
+{
+    osg::ref_ptr<StarSkyIndex> index = new StarSkyIndex(3);
+    ASSERT_EQ(unsigned int, 384, index->numCells());
+
+    // Cell centers lie in their cells, the radii are within a face.
+
+    int mismatches = 0;
+    for(unsigned int c = 0; c < index->numCells(); ++c)
+    {
+        if(index->cell(index->center(c)) != c)
+            ++mismatches;
+        if(index->radius(c) <= 0.f || index->radius(c) > _PI_4)
+            ++mismatches;
+    }
+    ASSERT_EQ(int, 0, mismatches);
+
+    // Uniformly distributed stars, written as raw bright stars.
+
+    Random random(7);
+
+    std::vector<BrightStars::s_BrightStar> raw(NUM_STARS);
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+    {
+        BrightStars::s_BrightStar &star(raw[i]);
+        memset(&star, 0, sizeof(BrightStars::s_BrightStar));
+
+        star.Vmag = random.nextf(-1.5f, 8.f);
+        star.RA   = random.nextf(0.f, 24.f);
+        star.DE   = static_cast<float>(_deg(asin(random.nextf(-1.f, 1.f))));
+    }
+    {
+        std::ofstream out(RAW_FILE, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&raw[0]), NUM_STARS * sizeof(BrightStars::s_BrightStar));
+    }
+
+    osg::ref_ptr<StarCatalogue> catalogue = new StarCatalogue;
+    ASSERT_EQ(int, 1, catalogue->open(RAW_FILE) ? 1 : 0);
+
+    index->build(*catalogue);
+
+    ASSERT_EQ(unsigned int, NUM_STARS, catalogue->numStars());
+    ASSERT_EQ(unsigned int, 0, index->begin(0));
+    ASSERT_EQ(unsigned int, NUM_STARS, index->end(index->numCells() - 1));
+    ASSERT_EQ(unsigned int, NUM_STARS, index->getVisibleStarCount());
+
+    // Every star is in the range of its cell, sorted by magnitude.
+
+    mismatches = 0;
+    for(unsigned int c = 0; c < index->numCells(); ++c)
+    {
+        for(unsigned int i = index->begin(c); i < index->end(c); ++i)
+        {
+            const osg::Vec4f &p(catalogue->positions()[i]);
+            if(index->cell(osg::Vec3f(p[0], p[1], p[2])) != c)
+                ++mismatches;
+
+            if(i > index->begin(c) && catalogue->colors()[i - 1][3] > catalogue->colors()[i][3])
+                ++mismatches;
+        }
+
+        unsigned int brighter = 0;
+        for(unsigned int i = index->begin(c); i < index->end(c); ++i)
+            if(catalogue->colors()[i][3] <= 3.f)
+                ++brighter;
+
+        if(index->numStarsUpTo(c, 3.f) != brighter)
+            ++mismatches;
+    }
+    ASSERT_EQ(int, 0, mismatches);
+
+    // A narrow view keeps all stars within its cone, and few others.
+
+    const osg::Vec3f axis(0.6f, 0.f, 0.8f);
+    const osg::Vec3f zenith(0.f, 0.f, 1.f);
+
+    const float halfAngle = static_cast<float>(_rad(2.0));
+
+    const unsigned int visibleCells = index->cull(axis, halfAngle, zenith, 0.f);
+    ASSERT_EQ(int, 1, visibleCells > 0 && visibleCells <= 4 ? 1 : 0);
+
+    mismatches = 0;
+    for(unsigned int i = 0; i < NUM_STARS; ++i)
+    {
+        const osg::Vec4f &p(catalogue->positions()[i]);
+        const osg::Vec3f d(p[0], p[1], p[2]);
+
+        if(acos(_clamp(-1.f, 1.f, d * axis)) <= halfAngle && !index->isVisible(index->cell(d)))
+            ++mismatches;
+    }
+    ASSERT_EQ(int, 0, mismatches);
+    ASSERT_EQ(int, 1, index->getVisibleStarCount() < NUM_STARS / 20 ? 1 : 0);
+
+    // Views below the horizon are skipped, unless the margin reaches above.
+
+    ASSERT_EQ(unsigned int, 0, index->cull(-zenith, halfAngle, zenith, 0.f));
+    ASSERT_EQ(unsigned int, 6, index->getTestedNodeCount());
+
+    const ConstantMargin margin(static_cast<float>(_PI));
+    ASSERT_EQ(unsigned int, index->cullNone(), index->cull(-zenith, halfAngle, zenith, 0.f, &margin));
+    ASSERT_EQ(unsigned int, NUM_STARS, index->getVisibleStarCount());
+
+    // A catalogue written in cell order stays mapped for an index of the 
+    // same depth, and gets the same ranges.
+
+    ASSERT_EQ(bool, true, catalogue->isSortedByCell(3));
+    ASSERT_EQ(bool, true, catalogue->toFile(CATALOGUE_FILE));
+
+    osg::ref_ptr<StarCatalogue> mapped = new StarCatalogue;
+    ASSERT_EQ(bool, true, mapped->open(CATALOGUE_FILE));
+
+    osg::ref_ptr<StarSkyIndex> mappedIndex = new StarSkyIndex(3);
+    mappedIndex->build(*mapped);
+
+    ASSERT_EQ(bool, true, mapped->isMapped());
+
+    mismatches = 0;
+    for(unsigned int c = 0; c < index->numCells(); ++c)
+        if(mappedIndex->begin(c) != index->begin(c) || mappedIndex->end(c) != index->end(c))
+            ++mismatches;
+    ASSERT_EQ(int, 0, mismatches);
+
+    // other depths reorder
+    osg::ref_ptr<StarSkyIndex> coarse = new StarSkyIndex(2);
+    coarse->build(*mapped);
+
+    ASSERT_EQ(bool, false, mapped->isMapped());
+    ASSERT_EQ(bool, true, mapped->isSortedByCell(2));
+
+    mapped = NULL;
+
+    remove(RAW_FILE);
+    remove(CATALOGUE_FILE);
+
+    TEST_REPORT();
+}
\ No newline at end of file
@@ -33,6 +33,24 @@
 #include "test_astronomy2.h"
 #include "test_time.h"
 #include "test_twounitschanger.h"
+#include "test_halffloat.h"
+#include "test_noise.h"
+#include "test_random.h"
+#include "test_cloudlayerevaluator.h"
+#include "test_starcatalogue.h"
+#include "test_starskyindex.h"
+#include "test_pagedstarcatalogue.h"
+#include "test_starmapbaker.h"
+#include "test_starquery.h"
+#include "test_packedstars.h"
+#include "test_atmosphereatlas.h"
+#include "test_atmospherequery.h"
+#include "test_skyharmonics.h"
+#include "test_analyticsky.h"
+#include "test_noisecache.h"
+#include "test_prerenderednoiserefresh.h"
+#include "test_stars.h"
+#include "test_starsgeode.h"
 
 int main(int argc, char* argv[])
 {
@@ -41,6 +59,24 @@ int main(int argc, char* argv[])
     test_astronomy2();
     test_time();
     test_twounitschanger();
+    test_halffloat();
+    test_noise();
+    test_random();
+    test_cloudlayerevaluator();
+    test_starcatalogue();
+    test_starskyindex();
+    test_pagedstarcatalogue();
+    test_starmapbaker();
+    test_stars();
+    test_starsgeode();
+    test_starquery();
+    test_packedstars();
+    test_atmosphereatlas();
+    test_atmospherequery();
+    test_skyharmonics();
+    test_analyticsky();
+    test_noisecache();
+    test_prerenderednoiserefresh();
 
     return 0;
 }
\ No newline at end of file